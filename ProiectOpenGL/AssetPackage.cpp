@@ -0,0 +1,521 @@
+#include "AssetPackage.hpp"
+#include "AsyncReader.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined (_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace gps {
+
+	static const char ASSET_MAGIC[8] = { 'G', 'P', 'S', 'P', 'A', 'C', 'K', 0 };
+
+	static const size_t LZ_MIN_MATCH = 4;
+	static const size_t LZ_MAX_OFFSET = 65535;
+	static const int LZ_HASH_BITS = 16;
+	static const size_t LZ_NO_POSITION = (size_t)-1;
+
+	static uint64_t alignBlob(uint64_t offset) {
+		return (offset + ASSET_BLOB_ALIGNMENT - 1) / ASSET_BLOB_ALIGNMENT * ASSET_BLOB_ALIGNMENT;
+	}
+
+	static void putU16(std::vector<unsigned char>& bytes, uint16_t value) {
+		for (int i = 0; i < 2; i++)
+			bytes.push_back((unsigned char)(value >> (8 * i)));
+	}
+
+	static void putU32(std::vector<unsigned char>& bytes, uint32_t value) {
+		for (int i = 0; i < 4; i++)
+			bytes.push_back((unsigned char)(value >> (8 * i)));
+	}
+
+	static void putU64(std::vector<unsigned char>& bytes, uint64_t value) {
+		for (int i = 0; i < 8; i++)
+			bytes.push_back((unsigned char)(value >> (8 * i)));
+	}
+
+	static uint64_t getLittleEndian(const unsigned char* bytes, int count) {
+
+		uint64_t value = 0;
+		for (int i = count - 1; i >= 0; i--)
+			value = (value << 8) | bytes[i];
+		return value;
+	}
+
+	std::string normalizeAssetPath(const std::string& path) {
+
+		std::vector<std::string> parts;
+		std::string part;
+		for (size_t i = 0; i <= path.size(); i++) {
+			char c = i < path.size() ? path[i] : '/';
+			if (c != '/' && c != '\\') {
+				part += c;
+				continue;
+			}
+			if (part == "..") {
+				// a path that leaves the working directory keeps its ".." parts
+				if (!parts.empty() && parts.back() != "..")
+					parts.pop_back();
+				else
+					parts.push_back(part);
+			}
+			else if (!part.empty() && part != ".")
+				parts.push_back(part);
+			part.clear();
+		}
+
+		std::string result;
+		for (size_t i = 0; i < parts.size(); i++) {
+			if (i > 0)
+				result += '/';
+			result += parts[i];
+		}
+		return result;
+	}
+
+	static void writeLength(std::vector<unsigned char>& result, size_t length) {
+
+		while (length >= 255) {
+			result.push_back(255);
+			length -= 255;
+		}
+		result.push_back((unsigned char)length);
+	}
+
+	static void writeSequence(std::vector<unsigned char>& result, const unsigned char* literals, size_t literalCount,
+		size_t offset, size_t matchLength) {
+
+		// the last sequence has no match, the decoder knows it from the end of the input
+		size_t extra = matchLength >= LZ_MIN_MATCH ? matchLength - LZ_MIN_MATCH : 0;
+		result.push_back((unsigned char)((std::min(literalCount, (size_t)15) << 4) | std::min(extra, (size_t)15)));
+		if (literalCount >= 15)
+			writeLength(result, literalCount - 15);
+		result.insert(result.end(), literals, literals + literalCount);
+		if (matchLength == 0)
+			return;
+		putU16(result, (uint16_t)offset);
+		if (extra >= 15)
+			writeLength(result, extra - 15);
+	}
+
+	void compressAsset(const unsigned char* data, size_t size, std::vector<unsigned char>& result) {
+
+		result.clear();
+		std::vector<size_t> table((size_t)1 << LZ_HASH_BITS, LZ_NO_POSITION);
+		size_t anchor = 0;
+		size_t position = 0;
+		while (position + LZ_MIN_MATCH <= size) {
+
+			uint32_t sequence;
+			memcpy(&sequence, data + position, sizeof(sequence));
+			uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+			size_t candidate = table[hash];
+			table[hash] = position;
+
+			if (candidate == LZ_NO_POSITION || position - candidate > LZ_MAX_OFFSET ||
+				memcmp(data + candidate, data + position, LZ_MIN_MATCH) != 0) {
+				position++;
+				continue;
+			}
+
+			size_t length = LZ_MIN_MATCH;
+			while (position + length < size && data[candidate + length] == data[position + length])
+				length++;
+			writeSequence(result, data + anchor, position - anchor, position - candidate, length);
+			position += length;
+			anchor = position;
+		}
+		writeSequence(result, data + anchor, size - anchor, 0, 0);
+	}
+
+	static bool readLength(const unsigned char* data, size_t storedSize, size_t& position, size_t& length) {
+
+		unsigned char byte;
+		do {
+			if (position >= storedSize)
+				return false;
+			byte = data[position++];
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	bool decompressAsset(const unsigned char* data, size_t storedSize, unsigned char* result, size_t size) {
+
+		size_t in = 0;
+		size_t out = 0;
+		while (in < storedSize) {
+
+			unsigned char token = data[in++];
+			size_t literalCount = token >> 4;
+			if (literalCount == 15 && !readLength(data, storedSize, in, literalCount))
+				return false;
+			if (literalCount > storedSize - in || literalCount > size - out)
+				return false;
+			memcpy(result + out, data + in, literalCount);
+			in += literalCount;
+			out += literalCount;
+			if (in == storedSize)
+				break;
+
+			if (storedSize - in < 2)
+				return false;
+			size_t offset = (size_t)getLittleEndian(data + in, 2);
+			in += 2;
+			size_t length = token & 15;
+			if (length == 15 && !readLength(data, storedSize, in, length))
+				return false;
+			length += LZ_MIN_MATCH;
+			if (offset == 0 || offset > out || length > size - out)
+				return false;
+			// the match may overlap what it writes, a run of one byte has offset 1
+			for (size_t i = 0; i < length; i++)
+				result[out + i] = result[out - offset + i];
+			out += length;
+		}
+		return out == size;
+	}
+
+	static bool readWholeFile(const char* fileName, std::vector<unsigned char>& contents) {
+
+		FILE* file = fopen(fileName, "rb");
+		if (file == NULL)
+			return false;
+		contents.clear();
+		unsigned char block[65536];
+		size_t read;
+		while ((read = fread(block, 1, sizeof(block), file)) > 0)
+			contents.insert(contents.end(), block, block + read);
+		bool failed = ferror(file) != 0;
+		fclose(file);
+		return !failed;
+	}
+
+	bool writeAssetPackage(const char* fileName, const std::vector<std::string>& files, bool compress) {
+
+		std::vector<AssetEntry> entries;
+		for (size_t i = 0; i < files.size(); i++) {
+			AssetEntry entry;
+			entry.path = normalizeAssetPath(files[i]);
+			entry.offset = 0;
+			entry.storedSize = 0;
+			entry.size = 0;
+			entry.flags = 0;
+			entries.push_back(entry);
+		}
+		std::sort(entries.begin(), entries.end(), [](const AssetEntry& a, const AssetEntry& b) {
+			return a.path < b.path;
+		});
+		for (size_t i = 0; i + 1 < entries.size(); i++) {
+			if (entries[i].path == entries[i + 1].path) {
+				entries.erase(entries.begin() + i + 1);
+				i--;
+			}
+		}
+
+		std::vector<std::vector<unsigned char> > blobs(entries.size());
+		for (size_t i = 0; i < entries.size(); i++) {
+
+			if (!readWholeFile(entries[i].path.c_str(), blobs[i])) {
+				fprintf(stderr, "ERROR: could not read %s into the package\n", entries[i].path.c_str());
+				return false;
+			}
+			entries[i].size = blobs[i].size();
+			entries[i].storedSize = blobs[i].size();
+
+			if (compress && !blobs[i].empty()) {
+				std::vector<unsigned char> compressed;
+				compressAsset(&blobs[i][0], blobs[i].size(), compressed);
+				if (compressed.size() <= blobs[i].size() - blobs[i].size() / 8) {
+					blobs[i].swap(compressed);
+					entries[i].storedSize = blobs[i].size();
+					entries[i].flags |= ASSET_COMPRESSED;
+				}
+			}
+		}
+
+		std::vector<unsigned char> strings;
+		std::vector<uint32_t> pathOffsets;
+		for (size_t i = 0; i < entries.size(); i++) {
+			pathOffsets.push_back((uint32_t)strings.size());
+			strings.insert(strings.end(), entries[i].path.begin(), entries[i].path.end());
+		}
+
+		uint64_t tocSize = entries.size() * ASSET_ENTRY_SIZE + strings.size();
+		uint64_t offset = alignBlob(ASSET_HEADER_SIZE + tocSize);
+		for (size_t i = 0; i < entries.size(); i++) {
+			entries[i].offset = offset;
+			offset = alignBlob(offset + entries[i].storedSize);
+		}
+
+		std::vector<unsigned char> header(ASSET_MAGIC, ASSET_MAGIC + sizeof(ASSET_MAGIC));
+		putU32(header, ASSET_PACKAGE_VERSION);
+		putU32(header, (uint32_t)entries.size());
+		putU64(header, tocSize);
+		for (size_t i = 0; i < entries.size(); i++) {
+			putU64(header, entries[i].offset);
+			putU64(header, entries[i].storedSize);
+			putU64(header, entries[i].size);
+			putU32(header, pathOffsets[i]);
+			putU16(header, (uint16_t)entries[i].path.size());
+			putU16(header, entries[i].flags);
+		}
+		header.insert(header.end(), strings.begin(), strings.end());
+
+		FILE* file = fopen(fileName, "wb");
+		if (file == NULL) {
+			fprintf(stderr, "ERROR: could not write the package %s\n", fileName);
+			return false;
+		}
+
+		bool failed = fwrite(&header[0], 1, header.size(), file) != header.size();
+		uint64_t written = header.size();
+		std::vector<unsigned char> padding(ASSET_BLOB_ALIGNMENT, 0);
+		for (size_t i = 0; i < entries.size() && !failed; i++) {
+			size_t gap = (size_t)(entries[i].offset - written);
+			if (gap > 0 && fwrite(&padding[0], 1, gap, file) != gap)
+				failed = true;
+			if (!blobs[i].empty() && fwrite(&blobs[i][0], 1, blobs[i].size(), file) != blobs[i].size())
+				failed = true;
+			written = entries[i].offset + blobs[i].size();
+		}
+		if (fclose(file) != 0)
+			failed = true;
+		if (failed) {
+			fprintf(stderr, "ERROR: could not write the package %s\n", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	AssetFileSystem::AssetFileSystem() {
+
+		mapped = NULL;
+		mappedSize = 0;
+		fileHandle = NULL;
+		mappingHandle = NULL;
+		memset(&stats, 0, sizeof(stats));
+	}
+
+	AssetFileSystem::~AssetFileSystem() {
+		unmount();
+	}
+
+	bool AssetFileSystem::mount(const char* fileName) {
+
+		unmount();
+
+#if defined (_WIN32)
+		// the view is read in order, the cache manager reads ahead of it
+		HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			fprintf(stderr, "ERROR: could not open the package %s\n", fileName);
+			return false;
+		}
+		LARGE_INTEGER size;
+		HANDLE mapping = NULL;
+		void* view = NULL;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+			mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (mapping != NULL)
+				view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+		if (view == NULL) {
+			fprintf(stderr, "ERROR: could not map the package %s\n", fileName);
+			if (mapping != NULL)
+				CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		fileHandle = file;
+		mappingHandle = mapping;
+		mapped = (const unsigned char*)view;
+		mappedSize = (size_t)size.QuadPart;
+#else
+		int file = open(fileName, O_RDONLY);
+		if (file < 0) {
+			fprintf(stderr, "ERROR: could not open the package %s\n", fileName);
+			return false;
+		}
+		struct stat info;
+		void* view = MAP_FAILED;
+		if (fstat(file, &info) == 0 && info.st_size > 0)
+			view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		// the mapping keeps its own reference to the file
+		close(file);
+		if (view == MAP_FAILED) {
+			fprintf(stderr, "ERROR: could not map the package %s\n", fileName);
+			return false;
+		}
+		// one readahead of the whole file instead of a page fault per touched page
+		madvise(view, (size_t)info.st_size, MADV_WILLNEED);
+		mapped = (const unsigned char*)view;
+		mappedSize = (size_t)info.st_size;
+#endif
+
+		packageName = fileName;
+		if (!readEntries()) {
+			fprintf(stderr, "ERROR: %s is not a valid asset package\n", fileName);
+			unmount();
+			return false;
+		}
+		return true;
+	}
+
+	bool AssetFileSystem::readEntries() {
+
+		if (mappedSize < ASSET_HEADER_SIZE || memcmp(mapped, ASSET_MAGIC, sizeof(ASSET_MAGIC)) != 0)
+			return false;
+		uint32_t version = (uint32_t)getLittleEndian(mapped + 8, 4);
+		if (version != ASSET_PACKAGE_VERSION) {
+			fprintf(stderr, "ERROR: %s is a version %u package, this build reads version %u\n",
+				packageName.c_str(), version, ASSET_PACKAGE_VERSION);
+			return false;
+		}
+		uint64_t count = getLittleEndian(mapped + 12, 4);
+		uint64_t tocSize = getLittleEndian(mapped + 16, 8);
+		if (tocSize > mappedSize - ASSET_HEADER_SIZE || count * ASSET_ENTRY_SIZE > tocSize)
+			return false;
+
+		const unsigned char* strings = mapped + ASSET_HEADER_SIZE + count * ASSET_ENTRY_SIZE;
+		uint64_t stringsSize = tocSize - count * ASSET_ENTRY_SIZE;
+		entries.resize((size_t)count);
+		for (size_t i = 0; i < entries.size(); i++) {
+
+			const unsigned char* record = mapped + ASSET_HEADER_SIZE + i * ASSET_ENTRY_SIZE;
+			AssetEntry& entry = entries[i];
+			entry.offset = getLittleEndian(record, 8);
+			entry.storedSize = getLittleEndian(record + 8, 8);
+			entry.size = getLittleEndian(record + 16, 8);
+			uint64_t pathOffset = getLittleEndian(record + 24, 4);
+			uint64_t pathLength = getLittleEndian(record + 28, 2);
+			entry.flags = (uint16_t)getLittleEndian(record + 30, 2);
+
+			if (pathOffset + pathLength > stringsSize || entry.offset > mappedSize || entry.storedSize > mappedSize - entry.offset)
+				return false;
+			if (!(entry.flags & ASSET_COMPRESSED) && entry.storedSize != entry.size)
+				return false;
+			entry.path.assign((const char*)strings + pathOffset, (size_t)pathLength);
+			// find() relies on the order the packer wrote
+			if (i > 0 && !(entries[i - 1].path < entry.path))
+				return false;
+		}
+		return true;
+	}
+
+	void AssetFileSystem::unmount() {
+
+		if (mapped != NULL) {
+#if defined (_WIN32)
+			UnmapViewOfFile(mapped);
+			CloseHandle((HANDLE)mappingHandle);
+			CloseHandle((HANDLE)fileHandle);
+#else
+			munmap((void*)mapped, mappedSize);
+#endif
+		}
+		mapped = NULL;
+		mappedSize = 0;
+		fileHandle = NULL;
+		mappingHandle = NULL;
+		entries.clear();
+		packageName.clear();
+	}
+
+	bool AssetFileSystem::isMounted() const {
+		return mapped != NULL;
+	}
+
+	const AssetEntry* AssetFileSystem::find(const std::string& path) const {
+
+		if (entries.empty())
+			return NULL;
+		std::string key = normalizeAssetPath(path);
+		std::vector<AssetEntry>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), key,
+			[](const AssetEntry& entry, const std::string& key) {
+			return entry.path < key;
+		});
+		return it != entries.end() && it->path == key ? &*it : NULL;
+	}
+
+	bool AssetFileSystem::read(const std::string& path, AssetData& asset) {
+
+		asset.buffer.clear();
+		asset.data = NULL;
+		asset.size = 0;
+
+		const AssetEntry* entry = find(path);
+		if (entry == NULL)
+			return readLooseFile(path, asset);
+
+		const unsigned char* blob = mapped + entry->offset;
+		stats.packageReads++;
+		stats.bytesRead += entry->storedSize;
+		if (!(entry->flags & ASSET_COMPRESSED)) {
+			asset.data = blob;
+			asset.size = (size_t)entry->size;
+			return true;
+		}
+
+		asset.buffer.resize((size_t)entry->size);
+		if (!decompressAsset(blob, (size_t)entry->storedSize, asset.buffer.empty() ? NULL : &asset.buffer[0], asset.buffer.size())) {
+			fprintf(stderr, "ERROR: %s is damaged in the package %s\n", entry->path.c_str(), packageName.c_str());
+			asset.buffer.clear();
+			return false;
+		}
+		stats.decompressions++;
+		asset.data = asset.buffer.empty() ? NULL : &asset.buffer[0];
+		asset.size = asset.buffer.size();
+		return true;
+	}
+
+	void AssetFileSystem::prefetch(const std::vector<std::string>& paths) {
+
+		if (!asyncReader().isRunning())
+			return;
+		// packaged assets are already on their way in through the mapping
+		std::vector<std::string> loose;
+		for (size_t i = 0; i < paths.size(); i++) {
+			if (find(paths[i]) == NULL)
+				loose.push_back(paths[i]);
+		}
+		asyncReader().submit(loose);
+	}
+
+	bool AssetFileSystem::readLooseFile(const std::string& path, AssetData& asset) {
+
+		if (!asyncReader().take(path, asset.buffer) && !readWholeFile(path.c_str(), asset.buffer)) {
+			asset.buffer.clear();
+			return false;
+		}
+		stats.looseReads++;
+		stats.bytesRead += asset.buffer.size();
+		asset.data = asset.buffer.empty() ? NULL : &asset.buffer[0];
+		asset.size = asset.buffer.size();
+		return true;
+	}
+
+	const std::vector<AssetEntry>& AssetFileSystem::getEntries() const {
+		return entries;
+	}
+
+	AssetStats AssetFileSystem::getStats() const {
+		return stats;
+	}
+
+	AssetFileSystem& vfs() {
+
+		static AssetFileSystem instance;
+		return instance;
+	}
+}
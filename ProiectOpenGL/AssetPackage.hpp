@@ -0,0 +1,109 @@
+#ifndef AssetPackage_hpp
+#define AssetPackage_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Package file layout, little endian:
+    //   header   magic, version, entry count, size of the table of contents
+    //   entries  ASSET_ENTRY_SIZE bytes each, sorted by path
+    //   strings  the paths the entries point into
+    //   blobs    each starting on an ASSET_BLOB_ALIGNMENT boundary, in the order of the entries
+    // Everything the application reads at start-up comes one after the other, the table of contents
+    // first, so mapping the file and reading it front to back is the only I/O loading does
+    const uint32_t ASSET_PACKAGE_VERSION = 1;
+    const uint64_t ASSET_BLOB_ALIGNMENT = 4096;
+    const size_t ASSET_HEADER_SIZE = 24;
+    const size_t ASSET_ENTRY_SIZE = 32;
+
+    // The blob is compressed with compressAsset, the other blobs are the file as it was
+    const uint16_t ASSET_COMPRESSED = 1;
+
+    struct AssetEntry {
+        std::string path;
+        uint64_t offset;
+        // bytes in the package and bytes of the file, the same for stored blobs
+        uint64_t storedSize;
+        uint64_t size;
+        uint16_t flags;
+    };
+
+    // Bytes of an asset. Points into the mapped package for stored blobs, into buffer for compressed
+    // blobs and loose files, so it must not be copied
+    struct AssetData {
+        const unsigned char* data;
+        size_t size;
+        std::vector<unsigned char> buffer;
+
+        AssetData() : data(NULL), size(0) {}
+        AssetData(const AssetData&) = delete;
+        AssetData& operator=(const AssetData&) = delete;
+    };
+
+    // How the loading went, for the statistics of the application
+    struct AssetStats {
+        unsigned int packageReads;
+        unsigned int looseReads;
+        unsigned int decompressions;
+        uint64_t bytesRead;
+    };
+
+    // Paths the way the package stores them: forward slashes, no "." and no "dir/.." parts
+    std::string normalizeAssetPath(const std::string& path);
+
+    // LZ77 with the sequence layout of LZ4: a token with the literal count and the match length,
+    // the literals, a 16 bit offset back into the output and the rest of the match length
+    void compressAsset(const unsigned char* data, size_t size, std::vector<unsigned char>& result);
+    // False when the input is damaged or does not decompress to exactly size bytes
+    bool decompressAsset(const unsigned char* data, size_t storedSize, unsigned char* result, size_t size);
+
+    // Writes the files into a package. Compressed blobs are kept when they save at least an eighth,
+    // images already compressed by their format stay stored and can be read without a copy
+    bool writeAssetPackage(const char* fileName, const std::vector<std::string>& files, bool compress);
+
+    // Where the application reads its assets from. A mounted package is looked up first, what it
+    // does not have is read from the loose file, so a partial package still works
+    class AssetFileSystem {
+
+    public:
+        AssetFileSystem();
+        ~AssetFileSystem();
+
+        // Maps the package, replacing the one mounted before
+        bool mount(const char* fileName);
+        void unmount();
+        bool isMounted() const;
+
+        // Entry of the path in the mounted package, NULL when there is none
+        const AssetEntry* find(const std::string& path) const;
+
+        // False when the asset is neither in the package nor on disk
+        bool read(const std::string& path, AssetData& asset);
+        // Hands the loose files among the paths to the async reader, read() takes them from it later
+        void prefetch(const std::vector<std::string>& paths);
+
+        const std::vector<AssetEntry>& getEntries() const;
+        AssetStats getStats() const;
+
+    private:
+        std::string packageName;
+        const unsigned char* mapped;
+        size_t mappedSize;
+        // the handles of the mapping, only used by the platform code
+        void* fileHandle;
+        void* mappingHandle;
+        std::vector<AssetEntry> entries;
+        AssetStats stats;
+
+        bool readEntries();
+        bool readLooseFile(const std::string& path, AssetData& asset);
+    };
+
+    AssetFileSystem& vfs();
+}
+
+#endif /* AssetPackage_hpp */
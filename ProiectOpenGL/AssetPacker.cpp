@@ -0,0 +1,148 @@
+// Builds the asset package the application mounts with --package. Run it from the directory the
+// application runs in, the paths in the package are the ones the application opens:
+//   AssetPacker scene.pak models/cartier/cartier.obj skybox/right.jpg shaders/basic.vert ...
+// The material libraries of OBJ files and the textures of the materials are added with them.
+// --list reads more paths from a file, one per line, --store keeps every blob uncompressed.
+
+#include "AssetPackage.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+	std::string getDirectory(const std::string& path) {
+
+		size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	}
+
+	bool hasExtension(const std::string& path, const char* extension) {
+
+		size_t length = strlen(extension);
+		if (path.size() < length)
+			return false;
+		for (size_t i = 0; i < length; i++) {
+			if (tolower((unsigned char)path[path.size() - length + i]) != extension[i])
+				return false;
+		}
+		return true;
+	}
+
+	bool fileExists(const std::string& path) {
+
+		FILE* file = fopen(path.c_str(), "rb");
+		if (file == NULL)
+			return false;
+		fclose(file);
+		return true;
+	}
+
+	// Files an OBJ or MTL file refers to, relative to its directory the way ModelLoader resolves them.
+	// The application loads without the missing ones, so they are left out with a warning
+	void addReferences(const std::string& path, std::vector<std::string>& pending) {
+
+		bool obj = hasExtension(path, ".obj");
+		bool mtl = hasExtension(path, ".mtl");
+		if (!obj && !mtl)
+			return;
+
+		std::ifstream file(path.c_str());
+		std::string line;
+		while (std::getline(file, line)) {
+
+			std::istringstream words(line);
+			std::string keyword;
+			words >> keyword;
+			bool reference = obj ? keyword == "mtllib" :
+				keyword.compare(0, 4, "map_") == 0 || keyword == "bump" || keyword == "disp" || keyword == "refl";
+			if (!reference)
+				continue;
+
+			// texture options come first, the file name is the last word
+			std::string word, name;
+			while (words >> word)
+				name = word;
+			if (name.empty())
+				continue;
+			if (fileExists(getDirectory(path) + name)) {
+				pending.push_back(getDirectory(path) + name);
+				// blocks cooked by --compress-textures, the package has no image to check them against
+				if (mtl && fileExists(getDirectory(path) + name + ".bct"))
+					pending.push_back(getDirectory(path) + name + ".bct");
+			}
+			else
+				fprintf(stderr, "WARNING: %s refers to %s, which does not exist\n", path.c_str(), (getDirectory(path) + name).c_str());
+		}
+	}
+}
+
+int main(int argc, const char* argv[]) {
+
+	const char* output = NULL;
+	bool compress = true;
+	std::vector<std::string> pending;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--store") == 0)
+			compress = false;
+		else if (strcmp(argv[i], "--list") == 0 && i + 1 < argc) {
+			std::ifstream list(argv[++i]);
+			if (!list) {
+				fprintf(stderr, "ERROR: could not open the list %s\n", argv[i]);
+				return 1;
+			}
+			std::string line;
+			while (std::getline(list, line)) {
+				if (!line.empty() && line[line.size() - 1] == '\r')
+					line.erase(line.size() - 1);
+				if (!line.empty() && line[0] != '#')
+					pending.push_back(line);
+			}
+		}
+		else if (output == NULL)
+			output = argv[i];
+		else
+			pending.push_back(argv[i]);
+	}
+
+	if (output == NULL || pending.empty()) {
+		fprintf(stderr, "usage: AssetPacker <package> [--store] [--list <file>] <asset>...\n");
+		return 1;
+	}
+
+	std::set<std::string> seen;
+	std::vector<std::string> files;
+	while (!pending.empty()) {
+		std::string path = gps::normalizeAssetPath(pending.back());
+		pending.pop_back();
+		if (!seen.insert(path).second)
+			continue;
+		files.push_back(path);
+		addReferences(path, pending);
+	}
+
+	if (!gps::writeAssetPackage(output, files, compress))
+		return 1;
+
+	gps::AssetFileSystem package;
+	if (!package.mount(output))
+		return 1;
+	unsigned long long storedBytes = 0, bytes = 0;
+	unsigned int compressed = 0;
+	const std::vector<gps::AssetEntry>& entries = package.getEntries();
+	for (size_t i = 0; i < entries.size(); i++) {
+		storedBytes += entries[i].storedSize;
+		bytes += entries[i].size;
+		if (entries[i].flags & gps::ASSET_COMPRESSED)
+			compressed++;
+	}
+	fprintf(stdout, "%s: %u assets, %u compressed, %.2f MB of files stored in %.2f MB\n", output,
+		(unsigned int)entries.size(), compressed, bytes / (1024.0 * 1024.0), storedBytes / (1024.0 * 1024.0));
+	return 0;
+}
@@ -0,0 +1,567 @@
+#include "AsyncReader.hpp"
+#include "AssetPackage.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+
+#if !defined (_WIN32)
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#if defined (__linux__) && defined (__has_include)
+	#if __has_include(<linux/io_uring.h>)
+		#define GPS_HAS_IO_URING 1
+		#include <linux/io_uring.h>
+		#include <sys/mman.h>
+		#include <sys/syscall.h>
+		#include <sys/uio.h>
+	#endif
+#endif
+
+namespace gps {
+
+	struct AsyncFileReader::Request {
+		std::string path;
+		std::vector<unsigned char> contents;
+		bool done;
+		bool failed;
+#ifdef GPS_HAS_IO_URING
+		int file;
+		size_t offset;
+		struct iovec target;
+#endif
+	};
+
+#ifdef GPS_HAS_IO_URING
+	struct AsyncFileReader::Ring {
+		int file;
+		unsigned int entries;
+		unsigned int* sqHead;
+		unsigned int* sqTail;
+		unsigned int* sqMask;
+		unsigned int* sqArray;
+		unsigned int* cqHead;
+		unsigned int* cqTail;
+		unsigned int* cqMask;
+		struct io_uring_sqe* sqes;
+		struct io_uring_cqe* cqes;
+		void* sqMapping;
+		size_t sqMappingSize;
+		void* cqMapping;
+		size_t cqMappingSize;
+		size_t sqesSize;
+		// pushed to the submission queue, not yet given to the kernel
+		unsigned int unsubmitted;
+		// given to the kernel, not yet completed
+		unsigned int inFlight;
+		// reads waiting for room in the ring
+		std::deque<Request*> backlog;
+		// pushed to the submission queue or in flight
+		std::unordered_set<Request*> reads;
+		// io_uring_enter failed, the ring takes no more reads
+		bool failed;
+		// buffers of the reads in flight when the ring failed, the kernel may still write to them until they complete
+		std::vector<std::vector<unsigned char> > abandoned;
+	};
+#endif
+
+	// Blocking read of the whole file into contents, sized once from the file size
+	static bool readFile(const std::string& path, std::vector<unsigned char>& contents) {
+
+#if defined (_WIN32)
+		FILE* file = fopen(path.c_str(), "rb");
+		if (file == NULL)
+			return false;
+		bool ok = _fseeki64(file, 0, SEEK_END) == 0;
+		long long size = ok ? _ftelli64(file) : -1;
+		ok = size >= 0 && _fseeki64(file, 0, SEEK_SET) == 0;
+		if (ok) {
+			contents.resize((size_t)size);
+			ok = size == 0 || fread(&contents[0], 1, (size_t)size, file) == (size_t)size;
+		}
+		fclose(file);
+		return ok;
+#else
+		int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+		struct stat info;
+		if (fstat(file, &info) != 0) {
+			close(file);
+			return false;
+		}
+#if defined (__linux__)
+		// doubles the readahead window, the whole file is read front to back
+		posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		contents.resize((size_t)info.st_size);
+		size_t offset = 0;
+		while (offset < contents.size()) {
+			ssize_t read = pread(file, &contents[offset], contents.size() - offset, (off_t)offset);
+			if (read < 0 && errno == EINTR)
+				continue;
+			if (read <= 0)
+				break;
+			offset += (size_t)read;
+		}
+		close(file);
+		return offset == contents.size();
+#endif
+	}
+
+	AsyncFileReader::AsyncFileReader() {
+
+		running = false;
+		stopping = false;
+		ring = NULL;
+		pendingReads = 0;
+		memset(&stats, 0, sizeof(stats));
+		stats.backend = "blocking";
+	}
+
+	AsyncFileReader::~AsyncFileReader() {
+		stop();
+	}
+
+	void AsyncFileReader::start() {
+
+		if (running)
+			return;
+		stopping = false;
+		running = true;
+		if (openRing()) {
+			stats.backend = "io_uring";
+			reaper = std::thread(&AsyncFileReader::runReaper, this);
+			return;
+		}
+		stats.backend = "threads";
+		for (int i = 0; i < ASYNC_READ_THREADS; i++)
+			workers.push_back(std::thread(&AsyncFileReader::runWorker, this));
+	}
+
+	void AsyncFileReader::stop() {
+
+		if (!running)
+			return;
+
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			finished.wait(guard, [this] { return pendingReads == 0; });
+			for (std::unordered_map<std::string, Request*>::iterator it = requests.begin(); it != requests.end(); ++it)
+				delete it->second;
+			requests.clear();
+			stopping = true;
+		}
+		queued.notify_all();
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+		workers.clear();
+
+#ifdef GPS_HAS_IO_URING
+		if (ring != NULL) {
+			reaper.join();
+			closeRing();
+		}
+#endif
+		running = false;
+	}
+
+	bool AsyncFileReader::isRunning() const {
+		return running;
+	}
+
+	const char* AsyncFileReader::getBackendName() const {
+		return stats.backend;
+	}
+
+	void AsyncFileReader::submit(const std::vector<std::string>& paths) {
+
+		if (!running)
+			return;
+
+		std::unique_lock<std::mutex> guard(lock);
+		for (size_t i = 0; i < paths.size(); i++) {
+
+			std::string key = normalizeAssetPath(paths[i]);
+			if (requests.count(key) != 0)
+				continue;
+
+			Request* request = new Request();
+			request->path = key;
+			request->done = false;
+			request->failed = false;
+			requests[key] = request;
+			if (pendingReads++ == 0)
+				busyStart = std::chrono::steady_clock::now();
+
+#ifdef GPS_HAS_IO_URING
+			if (ring != NULL) {
+				request->file = -1;
+				// take() falls back to reading the file itself once the ring failed
+				if (ring->failed) {
+					finish(request, false);
+					continue;
+				}
+				// opening is quick next to the read, only the reads go through the ring
+				request->file = open(key.c_str(), O_RDONLY | O_CLOEXEC);
+				struct stat info;
+				if (request->file < 0 || fstat(request->file, &info) != 0) {
+					finish(request, false);
+					continue;
+				}
+				posix_fadvise(request->file, 0, 0, POSIX_FADV_SEQUENTIAL);
+				request->contents.resize((size_t)info.st_size);
+				request->offset = 0;
+				if (request->contents.empty())
+					finish(request, true);
+				else
+					queueRingRead(request);
+				continue;
+			}
+#endif
+			queue.push_back(request);
+		}
+
+#ifdef GPS_HAS_IO_URING
+		if (ring != NULL) {
+			// the whole batch in one system call
+			flushRing();
+			return;
+		}
+#endif
+		guard.unlock();
+		queued.notify_all();
+	}
+
+	bool AsyncFileReader::take(const std::string& path, std::vector<unsigned char>& contents) {
+
+		if (!running)
+			return false;
+
+		std::unique_lock<std::mutex> guard(lock);
+		std::string key = normalizeAssetPath(path);
+		std::unordered_map<std::string, Request*>::iterator it = requests.find(key);
+		if (it == requests.end())
+			return false;
+
+		Request* request = it->second;
+		if (!request->done) {
+			std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+			finished.wait(guard, [request] { return request->done; });
+			stats.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+		}
+		requests.erase(key);
+
+		bool ok = !request->failed;
+		if (ok)
+			contents.swap(request->contents);
+		delete request;
+		return ok;
+	}
+
+	// Called with the lock held
+	void AsyncFileReader::finish(Request* request, bool ok) {
+
+#ifdef GPS_HAS_IO_URING
+		if (ring != NULL && request->file >= 0)
+			close(request->file);
+#endif
+		request->done = true;
+		request->failed = !ok;
+		if (ok) {
+			stats.files++;
+			stats.bytes += request->contents.size();
+		}
+		else {
+			stats.failed++;
+			request->contents.clear();
+		}
+		if (--pendingReads == 0)
+			stats.readSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - busyStart).count();
+		finished.notify_all();
+	}
+
+	void AsyncFileReader::runWorker() {
+
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			queued.wait(guard, [this] { return stopping || !queue.empty(); });
+			if (stopping)
+				return;
+			Request* request = queue.front();
+			queue.pop_front();
+
+			guard.unlock();
+			std::vector<unsigned char> contents;
+			bool ok = readFile(request->path, contents);
+			guard.lock();
+
+			request->contents.swap(contents);
+			finish(request, ok);
+		}
+	}
+
+	AsyncReadStats AsyncFileReader::getStats() const {
+
+		std::lock_guard<std::mutex> guard(lock);
+		return stats;
+	}
+
+#ifdef GPS_HAS_IO_URING
+
+	// Entries of the submission queue. The completion queue gets twice as many, and no more reads
+	// than this are in flight, so completions are never dropped
+	static const unsigned int RING_ENTRIES = 64;
+	// one read asks for at most this much, larger files take several
+	static const size_t MAX_READ_BYTES = (size_t)1 << 30;
+
+	bool AsyncFileReader::openRing() {
+
+		struct io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		// seccomp profiles of containers often refuse io_uring, the threads take over then
+		int file = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+		if (file < 0)
+			return false;
+
+		Ring* created = new Ring();
+		created->file = file;
+		created->entries = params.sq_entries;
+		created->unsubmitted = 0;
+		created->inFlight = 0;
+		created->failed = false;
+		created->sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+		created->cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+		created->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+		bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (singleMapping)
+			created->sqMappingSize = created->cqMappingSize = std::max(created->sqMappingSize, created->cqMappingSize);
+
+		created->sqMapping = mmap(NULL, created->sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, file, IORING_OFF_SQ_RING);
+		created->cqMapping = singleMapping ? created->sqMapping :
+			mmap(NULL, created->cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, file, IORING_OFF_CQ_RING);
+		void* sqes = mmap(NULL, created->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, file, IORING_OFF_SQES);
+		if (created->sqMapping == MAP_FAILED || created->cqMapping == MAP_FAILED || sqes == MAP_FAILED) {
+			if (sqes != MAP_FAILED)
+				munmap(sqes, created->sqesSize);
+			if (created->cqMapping != MAP_FAILED && !singleMapping)
+				munmap(created->cqMapping, created->cqMappingSize);
+			if (created->sqMapping != MAP_FAILED)
+				munmap(created->sqMapping, created->sqMappingSize);
+			close(file);
+			delete created;
+			return false;
+		}
+
+		unsigned char* sq = (unsigned char*)created->sqMapping;
+		unsigned char* cq = (unsigned char*)created->cqMapping;
+		created->sqHead = (unsigned int*)(sq + params.sq_off.head);
+		created->sqTail = (unsigned int*)(sq + params.sq_off.tail);
+		created->sqMask = (unsigned int*)(sq + params.sq_off.ring_mask);
+		created->sqArray = (unsigned int*)(sq + params.sq_off.array);
+		created->cqHead = (unsigned int*)(cq + params.cq_off.head);
+		created->cqTail = (unsigned int*)(cq + params.cq_off.tail);
+		created->cqMask = (unsigned int*)(cq + params.cq_off.ring_mask);
+		created->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+		created->sqes = (struct io_uring_sqe*)sqes;
+		ring = created;
+		return true;
+	}
+
+	void AsyncFileReader::closeRing() {
+
+		munmap(ring->sqes, ring->sqesSize);
+		if (ring->cqMapping != ring->sqMapping)
+			munmap(ring->cqMapping, ring->cqMappingSize);
+		munmap(ring->sqMapping, ring->sqMappingSize);
+		close(ring->file);
+		delete ring;
+		ring = NULL;
+	}
+
+	// Called with the lock held
+	bool AsyncFileReader::queueRingRead(Request* request) {
+
+		if (ring->inFlight + ring->unsubmitted >= ring->entries) {
+			ring->backlog.push_back(request);
+			return false;
+		}
+
+		unsigned int tail = *ring->sqTail;
+		unsigned int index = tail & *ring->sqMask;
+		struct io_uring_sqe* entry = &ring->sqes[index];
+		memset(entry, 0, sizeof(*entry));
+		request->target.iov_base = &request->contents[request->offset];
+		request->target.iov_len = std::min(request->contents.size() - request->offset, MAX_READ_BYTES);
+		entry->opcode = IORING_OP_READV;
+		entry->fd = request->file;
+		entry->addr = (uint64_t)(uintptr_t)&request->target;
+		entry->len = 1;
+		entry->off = request->offset;
+		entry->user_data = (uint64_t)(uintptr_t)request;
+		ring->sqArray[index] = index;
+		// the kernel must see the entry before the new tail
+		__atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+		ring->unsubmitted++;
+		ring->reads.insert(request);
+		return true;
+	}
+
+	// Called with the lock held, does not wait for anything
+	void AsyncFileReader::flushRing() {
+
+		bool submittedAny = false;
+		while (ring->unsubmitted > 0 && !ring->failed) {
+			int submitted = (int)syscall(__NR_io_uring_enter, ring->file, ring->unsubmitted, 0, 0, NULL, 0);
+			if (submitted < 0 && errno == EINTR)
+				continue;
+			// short of memory or of room for completions, the reaper submits again after the next one
+			if (submitted < 0 && (errno == EAGAIN || errno == EBUSY) && ring->inFlight > 0)
+				break;
+			if (submitted < 0)
+				fprintf(stderr, "ERROR: io_uring_enter failed: %s\n", strerror(errno));
+			else if (submitted == 0)
+				fprintf(stderr, "ERROR: io_uring_enter submitted none of %u reads\n", ring->unsubmitted);
+			if (submitted <= 0) {
+				failRing();
+				return;
+			}
+			ring->unsubmitted -= submitted;
+			ring->inFlight += submitted;
+			submittedAny = true;
+		}
+		if (submittedAny)
+			queued.notify_all();
+	}
+
+	// Called with the lock held. Fails every read the ring holds so take() and stop() do not wait
+	// for them, the callers read the files themselves
+	void AsyncFileReader::failRing() {
+
+		ring->failed = true;
+
+		// the entries the kernel did not take are taken back
+		unsigned int tail = *ring->sqTail;
+		for (; ring->unsubmitted > 0; ring->unsubmitted--) {
+			tail--;
+			Request* request = (Request*)(uintptr_t)ring->sqes[tail & *ring->sqMask].user_data;
+			ring->reads.erase(request);
+			finish(request, false);
+		}
+		__atomic_store_n(ring->sqTail, tail, __ATOMIC_RELEASE);
+
+		// what is left is in flight, its buffer lives until the reaper saw the read complete
+		for (std::unordered_set<Request*>::iterator it = ring->reads.begin(); it != ring->reads.end(); ++it) {
+			ring->abandoned.push_back(std::vector<unsigned char>());
+			ring->abandoned.back().swap((*it)->contents);
+			finish(*it, false);
+		}
+		ring->reads.clear();
+
+		for (size_t i = 0; i < ring->backlog.size(); i++)
+			finish(ring->backlog[i], false);
+		ring->backlog.clear();
+		queued.notify_all();
+	}
+
+	void AsyncFileReader::runReaper() {
+
+		while (true) {
+
+			{
+				// nothing to wait for in the kernel, stop() and a failed ring end the reaper once the reads are back,
+				// closing the ring earlier would leave the kernel writing to freed buffers
+				std::unique_lock<std::mutex> guard(lock);
+				queued.wait(guard, [this] { return ring->inFlight > 0 || stopping || ring->failed; });
+				if (ring->inFlight == 0)
+					return;
+			}
+
+			// sleeps in the kernel until a read completes
+			bool waited = syscall(__NR_io_uring_enter, ring->file, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) >= 0 || errno == EINTR;
+			if (!waited) {
+				std::lock_guard<std::mutex> guard(lock);
+				if (!ring->failed) {
+					fprintf(stderr, "ERROR: io_uring_enter failed: %s\n", strerror(errno));
+					failRing();
+				}
+			}
+
+			// the completions still land in the mapped queue, without io_uring_enter they are polled for
+			if (!waited)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			std::lock_guard<std::mutex> guard(lock);
+			unsigned int head = *ring->cqHead;
+			unsigned int tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+			for (; head != tail; head++) {
+
+				const struct io_uring_cqe& completion = ring->cqes[head & *ring->cqMask];
+				Request* request = (Request*)(uintptr_t)completion.user_data;
+				ring->inFlight--;
+				// failRing() finished it already
+				if (ring->failed)
+					continue;
+				ring->reads.erase(request);
+
+				if (completion.res == -EINTR || completion.res == -EAGAIN)
+					queueRingRead(request);
+				else if (completion.res <= 0)
+					finish(request, false);
+				else {
+					// short reads continue where they stopped
+					request->offset += (size_t)completion.res;
+					if (request->offset < request->contents.size())
+						queueRingRead(request);
+					else
+						finish(request, true);
+				}
+			}
+			__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+			if (ring->failed && ring->inFlight == 0)
+				ring->abandoned.clear();
+
+			while (!ring->failed && !ring->backlog.empty() && ring->inFlight + ring->unsubmitted < ring->entries) {
+				Request* request = ring->backlog.front();
+				ring->backlog.pop_front();
+				queueRingRead(request);
+			}
+			flushRing();
+		}
+	}
+
+#else
+
+	bool AsyncFileReader::openRing() {
+		return false;
+	}
+
+	void AsyncFileReader::closeRing() {
+	}
+
+	bool AsyncFileReader::queueRingRead(Request*) {
+		return false;
+	}
+
+	void AsyncFileReader::flushRing() {
+	}
+
+	void AsyncFileReader::failRing() {
+	}
+
+	void AsyncFileReader::runReaper() {
+	}
+
+#endif
+
+	AsyncFileReader& asyncReader() {
+
+		static AsyncFileReader instance;
+		return instance;
+	}
+}
@@ -0,0 +1,89 @@
+#ifndef AsyncReader_hpp
+#define AsyncReader_hpp
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gps {
+
+    // Workers of the fallback backend, reads of separate files overlap in the disk queue
+    const int ASYNC_READ_THREADS = 4;
+
+    struct AsyncReadStats {
+        const char* backend;
+        unsigned int files;
+        unsigned int failed;
+        uint64_t bytes;
+        // while at least one read was in flight
+        double readSeconds;
+        // what the loading thread spent blocked in take()
+        double waitSeconds;
+    };
+
+    // Reads whole files in the background while the loading thread parses and uploads what came
+    // in before. On Linux the reads of a batch go to the kernel in one io_uring submission, elsewhere
+    // and where io_uring is not allowed a few threads do blocking reads. The file lands in the
+    // buffer take() hands out, nothing is copied on the way to the decoder
+    class AsyncFileReader {
+
+    public:
+        AsyncFileReader();
+        ~AsyncFileReader();
+
+        void start();
+        // Waits for the reads in flight and drops what was not taken
+        void stop();
+        bool isRunning() const;
+        const char* getBackendName() const;
+
+        // Starts reading the files, paths already submitted are skipped
+        void submit(const std::vector<std::string>& paths);
+        // Waits for the read of a submitted path and moves the file into contents. False when the
+        // path was not submitted or the read failed, the caller reads the file itself then
+        bool take(const std::string& path, std::vector<unsigned char>& contents);
+
+        AsyncReadStats getStats() const;
+
+    private:
+        struct Request;
+        struct Ring;
+
+        bool running;
+        bool stopping;
+        // the io_uring backend, NULL when the threads do the reads
+        Ring* ring;
+        std::vector<std::thread> workers;
+        std::thread reaper;
+
+        mutable std::mutex lock;
+        std::condition_variable queued;
+        std::condition_variable finished;
+        std::unordered_map<std::string, Request*> requests;
+        std::deque<Request*> queue;
+        unsigned int pendingReads;
+        std::chrono::steady_clock::time_point busyStart;
+        AsyncReadStats stats;
+
+        void finish(Request* request, bool ok);
+        void runWorker();
+
+        bool openRing();
+        void closeRing();
+        bool queueRingRead(Request* request);
+        void flushRing();
+        void failRing();
+        void runReaper();
+    };
+
+    AsyncFileReader& asyncReader();
+}
+
+#endif /* AsyncReader_hpp */
@@ -0,0 +1,132 @@
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace gps {
+
+	Benchmark::Benchmark() {
+
+		frames = 600;
+		warmupFrames = 30;
+		frameStep = 1.0 / 60.0;
+		frameIndex = 0;
+		loadTimeMs = 0.0;
+		cpuWaitMs = 0.0;
+		drawCalls = 0.0;
+		triangles = 0.0;
+		stateChanges = 0.0;
+		packets = 0.0;
+		packetsCulled = 0.0;
+		trianglesCulled = 0.0;
+		submitMs = 0.0;
+	}
+
+	void Benchmark::configure(int frames, int warmupFrames, double frameStep) {
+
+		this->frames = frames > 0 ? frames : 1;
+		this->warmupFrames = warmupFrames > 0 ? warmupFrames : 0;
+		this->frameStep = frameStep;
+		frameTimes.reserve(this->frames);
+	}
+
+	double Benchmark::getTime() const {
+		return frameIndex * frameStep;
+	}
+
+	void Benchmark::setLoadTime(double loadTimeMs) {
+		this->loadTimeMs = loadTimeMs;
+	}
+
+	void Benchmark::setCpuWaitTime(double averageWaitMs) {
+		this->cpuWaitMs = averageWaitMs;
+	}
+
+	void Benchmark::endFrame(double frameMs, double submitMs, const gps::RenderStats& stats) {
+
+		if (frameIndex >= warmupFrames) {
+
+			frameTimes.push_back(frameMs);
+			drawCalls += stats.drawCalls;
+			triangles += stats.triangles;
+			stateChanges += stats.programChanges + stats.vaoChanges + stats.textureChanges;
+			packets += stats.packets;
+			packetsCulled += stats.packetsCulled;
+			trianglesCulled += stats.trianglesCulled;
+			this->submitMs += submitMs;
+		}
+		frameIndex++;
+
+		if (isFinished()) {
+			sortedFrameTimes = frameTimes;
+			std::sort(sortedFrameTimes.begin(), sortedFrameTimes.end());
+		}
+	}
+
+	bool Benchmark::isFinished() const {
+		return frameIndex >= warmupFrames + frames;
+	}
+
+	double Benchmark::percentile(double p) const {
+
+		if (sortedFrameTimes.empty())
+			return 0.0;
+
+		// nearest rank
+		size_t rank = (size_t)std::ceil(p / 100.0 * sortedFrameTimes.size());
+		if (rank < 1)
+			rank = 1;
+		if (rank > sortedFrameTimes.size())
+			rank = sortedFrameTimes.size();
+		return sortedFrameTimes[rank - 1];
+	}
+
+	// A JSON string with quotes, backslashes and control characters escaped
+	static void writeJsonString(FILE* file, const char* text) {
+
+		fputc('"', file);
+		for (const char* c = text != NULL ? text : ""; *c != 0; c++) {
+			if (*c == '"' || *c == '\\')
+				fprintf(file, "\\%c", *c);
+			else if ((unsigned char)*c < 0x20)
+				fprintf(file, "\\u%04x", (unsigned int)(unsigned char)*c);
+			else
+				fputc(*c, file);
+		}
+		fputc('"', file);
+	}
+
+	void Benchmark::writeJson(FILE* file, const BenchmarkInfo& info) const {
+
+		double count = frameTimes.empty() ? 1.0 : (double)frameTimes.size();
+		double total = 0.0;
+		for (size_t i = 0; i < frameTimes.size(); i++)
+			total += frameTimes[i];
+
+		fprintf(file, "{\n");
+		fprintf(file, "  \"renderer\": ");
+		writeJsonString(file, info.renderer);
+		fprintf(file, ",\n  \"glVersion\": ");
+		writeJsonString(file, info.glVersion);
+		fprintf(file, ",\n  \"renderPath\": ");
+		writeJsonString(file, info.renderPath);
+		fprintf(file, ",\n");
+		fprintf(file, "  \"resolution\": [%d, %d],\n", info.width, info.height);
+		fprintf(file, "  \"scene\": { \"cityGridSize\": %d, \"instances\": %u, \"memoryMB\": %.3f, \"generateMs\": %.3f },\n",
+			info.cityGridSize, info.sceneInstances, info.sceneMemoryBytes / (1024.0 * 1024.0), info.sceneGenerateMs);
+		fprintf(file, "  \"frames\": %u,\n", (unsigned int)frameTimes.size());
+		fprintf(file, "  \"warmupFrames\": %d,\n", warmupFrames);
+		fprintf(file, "  \"loadTimeMs\": %.3f,\n", loadTimeMs);
+		fprintf(file, "  \"frameTimeMs\": { \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f },\n",
+			total / count, percentile(50.0), percentile(95.0), percentile(99.0), percentile(100.0));
+		fprintf(file, "  \"cpuWaitMs\": %.4f,\n", cpuWaitMs);
+		fprintf(file, "  \"cpuSubmitMs\": %.4f,\n", submitMs / count);
+		fprintf(file, "  \"drawCalls\": %.1f,\n", drawCalls / count);
+		fprintf(file, "  \"packets\": %.1f,\n", packets / count);
+		fprintf(file, "  \"triangles\": %.1f,\n", triangles / count);
+		fprintf(file, "  \"packetsCulled\": %.1f,\n", packetsCulled / count);
+		fprintf(file, "  \"trianglesCulled\": %.1f,\n", trianglesCulled / count);
+		fprintf(file, "  \"stateChanges\": %.1f\n", stateChanges / count);
+		fprintf(file, "}\n");
+	}
+}
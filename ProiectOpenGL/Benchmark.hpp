@@ -0,0 +1,72 @@
+#ifndef Benchmark_hpp
+#define Benchmark_hpp
+
+#include "RenderQueue.hpp"
+
+#include <stdio.h>
+#include <vector>
+
+namespace gps {
+
+    // Renderer description written next to the numbers, so results from different machines are told apart
+    struct BenchmarkInfo {
+        const char* renderer;
+        const char* glVersion;
+        const char* renderPath;
+        int width;
+        int height;
+        // 0 for the original scene, N for an N x N synthetic city
+        int cityGridSize;
+        unsigned int sceneInstances;
+        double sceneMemoryBytes;
+        double sceneGenerateMs;
+    };
+
+    // Fixed length run on a fixed clock: frame n always shows the scene at time n * frameStep,
+    // so two runs render the same frames and only the measured times differ
+    class Benchmark {
+
+    public:
+        Benchmark();
+
+        // warmupFrames are rendered but not measured, they hide shader compilation and first uploads
+        void configure(int frames, int warmupFrames, double frameStep);
+
+        // Scene time of the current frame, in seconds
+        double getTime() const;
+
+        void setLoadTime(double loadTimeMs);
+        void setCpuWaitTime(double averageWaitMs);
+        // Records the wall time, the time spent queueing the scene and the render stats of a frame,
+        // then advances the clock
+        void endFrame(double frameMs, double submitMs, const gps::RenderStats& stats);
+        bool isFinished() const;
+
+        // Frame time percentile over the measured frames, p in [0, 100]
+        double percentile(double p) const;
+
+        void writeJson(FILE* file, const BenchmarkInfo& info) const;
+
+    private:
+        int frames;
+        int warmupFrames;
+        double frameStep;
+        int frameIndex;
+
+        double loadTimeMs;
+        double cpuWaitMs;
+        std::vector<double> frameTimes;
+        std::vector<double> sortedFrameTimes;
+
+        // totals over the measured frames
+        double drawCalls;
+        double triangles;
+        double stateChanges;
+        double packets;
+        double packetsCulled;
+        double trianglesCulled;
+        double submitMs;
+    };
+}
+
+#endif /* Benchmark_hpp */
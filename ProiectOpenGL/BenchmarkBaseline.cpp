@@ -0,0 +1,301 @@
+#include "BenchmarkBaseline.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <iostream>
+
+namespace gps {
+
+	static const char* TOLERANCES_KEY = "tolerances.";
+	static const char* SCENARIOS_KEY = "scenarios.";
+
+	// Recursive descent over the subset of JSON the benchmark writes
+	class JsonNumberReader {
+
+	public:
+		JsonNumberReader(const std::string& text, BenchmarkMetrics& metrics) : text(text), position(0), metrics(metrics) {}
+
+		bool read() {
+			if (!readValue(""))
+				return false;
+			skipSpace();
+			return position == text.size();
+		}
+
+	private:
+		const std::string& text;
+		size_t position;
+		BenchmarkMetrics& metrics;
+
+		void skipSpace() {
+			while (position < text.size() && strchr(" \t\r\n", text[position]) != NULL)
+				position++;
+		}
+
+		bool expect(char c) {
+			skipSpace();
+			if (position >= text.size() || text[position] != c)
+				return false;
+			position++;
+			return true;
+		}
+
+		bool readString(std::string& value) {
+			if (!expect('"'))
+				return false;
+			value.clear();
+			while (position < text.size() && text[position] != '"') {
+				if (text[position] != '\\' || position + 1 >= text.size()) {
+					value += text[position++];
+					continue;
+				}
+				char escaped = text[position + 1];
+				position += 2;
+				switch (escaped) {
+				case '"':
+				case '\\':
+				case '/':
+					value += escaped;
+					break;
+				case 'b':
+					value += '\b';
+					break;
+				case 'f':
+					value += '\f';
+					break;
+				case 'n':
+					value += '\n';
+					break;
+				case 'r':
+					value += '\r';
+					break;
+				case 't':
+					value += '\t';
+					break;
+				case 'u':
+					// only the control characters the writers escape, the rest of the text stays UTF-8
+					if (position + 4 > text.size())
+						return false;
+					value += (char)strtol(text.substr(position, 4).c_str(), NULL, 16);
+					position += 4;
+					break;
+				default:
+					return false;
+				}
+			}
+			return expect('"');
+		}
+
+		bool readValue(const std::string& path) {
+
+			skipSpace();
+			if (position >= text.size())
+				return false;
+
+			char c = text[position];
+			if (c == '{') {
+				position++;
+				skipSpace();
+				if (position < text.size() && text[position] == '}') {
+					position++;
+					return true;
+				}
+				do {
+					std::string key;
+					if (!readString(key) || !expect(':') || !readValue(path.empty() ? key : path + "." + key))
+						return false;
+				} while (expect(','));
+				return expect('}');
+			}
+			if (c == '[') {
+				position++;
+				skipSpace();
+				if (position < text.size() && text[position] == ']') {
+					position++;
+					return true;
+				}
+				int index = 0;
+				do {
+					std::ostringstream element;
+					element << path << "." << index++;
+					if (!readValue(element.str()))
+						return false;
+				} while (expect(','));
+				return expect(']');
+			}
+			if (c == '"') {
+				std::string ignored;
+				return readString(ignored);
+			}
+			if (text.compare(position, 4, "true") == 0 || text.compare(position, 4, "null") == 0) {
+				position += 4;
+				return true;
+			}
+			if (text.compare(position, 5, "false") == 0) {
+				position += 5;
+				return true;
+			}
+
+			const char* start = text.c_str() + position;
+			char* end = NULL;
+			double value = strtod(start, &end);
+			if (end == start)
+				return false;
+			position += end - start;
+			metrics[path] = value;
+			return true;
+		}
+	};
+
+	// Writes text as a JSON string, the names come from the command line
+	static std::string jsonString(const std::string& text) {
+
+		std::ostringstream escaped;
+		escaped << '"';
+		for (size_t i = 0; i < text.size(); i++) {
+			unsigned char c = (unsigned char)text[i];
+			if (c == '"' || c == '\\')
+				escaped << '\\' << (char)c;
+			else if (c < 0x20) {
+				char code[8];
+				snprintf(code, sizeof(code), "\\u%04x", (unsigned int)c);
+				escaped << code;
+			}
+			else
+				escaped << (char)c;
+		}
+		escaped << '"';
+		return escaped.str();
+	}
+
+	bool parseBenchmarkJson(const std::string& text, BenchmarkMetrics& metrics) {
+		JsonNumberReader reader(text, metrics);
+		return reader.read();
+	}
+
+	bool readBenchmarkJson(const std::string& fileName, BenchmarkMetrics& metrics) {
+
+		std::ifstream file(fileName.c_str());
+		if (!file.is_open()) {
+			std::cerr << "ERROR: could not open " << fileName << std::endl;
+			return false;
+		}
+
+		std::stringstream text;
+		text << file.rdbuf();
+		if (!parseBenchmarkJson(text.str(), metrics)) {
+			std::cerr << "ERROR: " << fileName << " is not valid JSON" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool BenchmarkBaseline::load(const std::string& fileName) {
+
+		BenchmarkMetrics values;
+		if (!readBenchmarkJson(fileName, values))
+			return false;
+
+		tolerances.clear();
+		scenarios.clear();
+
+		size_t tolerancesLength = strlen(TOLERANCES_KEY);
+		size_t scenariosLength = strlen(SCENARIOS_KEY);
+		for (BenchmarkMetrics::const_iterator it = values.begin(); it != values.end(); ++it) {
+
+			const std::string& path = it->first;
+			if (path.compare(0, tolerancesLength, TOLERANCES_KEY) == 0)
+				tolerances[path.substr(tolerancesLength)] = it->second;
+			else if (path.compare(0, scenariosLength, SCENARIOS_KEY) == 0) {
+				// scenario names have no dots, the metric keeps the rest of the path
+				size_t dot = path.find('.', scenariosLength);
+				if (dot != std::string::npos)
+					scenarios[path.substr(scenariosLength, dot - scenariosLength)][path.substr(dot + 1)] = it->second;
+			}
+		}
+
+		if (tolerances.empty()) {
+			std::cerr << "ERROR: " << fileName << " has no tolerances" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool BenchmarkBaseline::save(const std::string& fileName) const {
+
+		std::ofstream file(fileName.c_str());
+		if (!file.is_open()) {
+			std::cerr << "ERROR: could not write " << fileName << std::endl;
+			return false;
+		}
+
+		file.precision(10);
+		file << "{\n  \"tolerances\": {\n";
+		for (BenchmarkMetrics::const_iterator it = tolerances.begin(); it != tolerances.end(); ++it)
+			file << "    " << jsonString(it->first) << ": " << it->second << (std::next(it) == tolerances.end() ? "\n" : ",\n");
+		file << "  },\n  \"scenarios\": {\n";
+
+		for (std::map<std::string, BenchmarkMetrics>::const_iterator scenario = scenarios.begin(); scenario != scenarios.end(); ++scenario) {
+			file << "    " << jsonString(scenario->first) << ": {\n";
+			const BenchmarkMetrics& metrics = scenario->second;
+			for (BenchmarkMetrics::const_iterator it = metrics.begin(); it != metrics.end(); ++it)
+				file << "      " << jsonString(it->first) << ": " << it->second << (std::next(it) == metrics.end() ? "\n" : ",\n");
+			file << (std::next(scenario) == scenarios.end() ? "    }\n" : "    },\n");
+		}
+		file << "  }\n}\n";
+		return true;
+	}
+
+	const BenchmarkMetrics& BenchmarkBaseline::getTolerances() const {
+		return tolerances;
+	}
+
+	bool BenchmarkBaseline::hasScenario(const std::string& scenario) const {
+		return scenarios.find(scenario) != scenarios.end();
+	}
+
+	bool BenchmarkBaseline::compare(const std::string& scenario, const BenchmarkMetrics& results, std::vector<BenchmarkRegression>& regressions) const {
+
+		std::map<std::string, BenchmarkMetrics>::const_iterator reference = scenarios.find(scenario);
+		if (reference == scenarios.end())
+			return true;
+
+		bool passed = true;
+		for (BenchmarkMetrics::const_iterator it = tolerances.begin(); it != tolerances.end(); ++it) {
+
+			BenchmarkMetrics::const_iterator baselineValue = reference->second.find(it->first);
+			BenchmarkMetrics::const_iterator currentValue = results.find(it->first);
+
+			// a metric that stopped being reported cannot be checked, which must not pass for within tolerance
+			BenchmarkRegression regression;
+			regression.scenario = scenario;
+			regression.metric = it->first;
+			regression.baseline = baselineValue != reference->second.end() ? baselineValue->second : 0.0;
+			regression.current = currentValue != results.end() ? currentValue->second : 0.0;
+			regression.tolerance = it->second;
+			regression.missing = baselineValue == reference->second.end() || currentValue == results.end();
+			regression.missingFromBaseline = baselineValue == reference->second.end();
+
+			if (regression.missing || regression.current > regression.baseline * (1.0 + it->second)) {
+				regressions.push_back(regression);
+				passed = false;
+			}
+		}
+		return passed;
+	}
+
+	void BenchmarkBaseline::update(const std::string& scenario, const BenchmarkMetrics& results) {
+
+		BenchmarkMetrics& metrics = scenarios[scenario];
+		metrics.clear();
+		for (BenchmarkMetrics::const_iterator it = tolerances.begin(); it != tolerances.end(); ++it) {
+			BenchmarkMetrics::const_iterator value = results.find(it->first);
+			if (value != results.end())
+				metrics[it->first] = value->second;
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef BenchmarkBaseline_hpp
+#define BenchmarkBaseline_hpp
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Numbers of a JSON document by path, nested keys are joined with dots ("frameTimeMs.p95")
+    // and array elements get their index. Strings, booleans and nulls are skipped
+    typedef std::map<std::string, double> BenchmarkMetrics;
+
+    bool parseBenchmarkJson(const std::string& text, BenchmarkMetrics& metrics);
+    bool readBenchmarkJson(const std::string& fileName, BenchmarkMetrics& metrics);
+
+    // One metric of one scenario that got worse than its tolerance allows, or that the run or the
+    // baseline does not have. Missing metrics leave baseline and current at 0
+    struct BenchmarkRegression {
+        std::string scenario;
+        std::string metric;
+        double baseline;
+        double current;
+        double tolerance;
+        bool missing;
+        bool missingFromBaseline;
+    };
+
+    // Reference results of the benchmark scenarios. Every tracked metric is lower-is-better and has a
+    // relative tolerance, a result fails when it exceeds baseline * (1 + tolerance)
+    class BenchmarkBaseline {
+
+    public:
+        bool load(const std::string& fileName);
+        bool save(const std::string& fileName) const;
+
+        const BenchmarkMetrics& getTolerances() const;
+        bool hasScenario(const std::string& scenario) const;
+
+        // Compares the tracked metrics of a run, returns false and fills regressions when one got worse
+        // or is missing. A scenario without a baseline has nothing to compare and passes, check hasScenario
+        bool compare(const std::string& scenario, const BenchmarkMetrics& results, std::vector<BenchmarkRegression>& regressions) const;
+        // Replaces the reference values of a scenario with the tracked metrics of a run
+        void update(const std::string& scenario, const BenchmarkMetrics& results);
+
+    private:
+        BenchmarkMetrics tolerances;
+        std::map<std::string, BenchmarkMetrics> scenarios;
+    };
+}
+
+#endif /* BenchmarkBaseline_hpp */
@@ -0,0 +1,322 @@
+// Runs the benchmark scenarios of the application and compares their results against the stored baseline.
+// Exit code 0 when every scenario is within tolerance, 1 on a regression, 2 when a scenario could not run
+// or has no baseline to compare against.
+// Run it from the application directory, the scenes load their models from relative paths.
+
+#include "BenchmarkBaseline.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+	struct Scenario {
+		const char* name;
+		// extra arguments of the application
+		const char* arguments;
+	};
+
+	// names must not contain dots, they are keys of the baseline
+	const Scenario scenarios[] = {
+		{ "idle-city", "--no-intro" },
+		{ "rain", "--rain" },
+		{ "night", "--night" },
+		{ "wireframe", "--wireframe" },
+		{ "max-fog", "--fog" },
+		{ "fast-flythrough", "--path-speed 4" }
+	};
+	const int scenarioCount = sizeof(scenarios) / sizeof(scenarios[0]);
+
+#if defined (GPS_BENCHMARK_EXECUTABLE)
+	const char* defaultExecutable = GPS_BENCHMARK_EXECUTABLE;
+#elif defined (_WIN32)
+	const char* defaultExecutable = "ProiectOpenGL.exe";
+#else
+	const char* defaultExecutable = "./ProiectOpenGL";
+#endif
+
+	struct RunnerOptions {
+		std::string executable;
+		std::string baselineFile;
+		std::string contextApi;
+		std::string onlyScenario;
+		int frames;
+		int warmupFrames;
+		int repeats;
+		bool updateBaseline;
+		// grid sizes of the city sweep, empty when the scenarios run instead
+		std::vector<int> citySizes;
+		std::string sweepOutput;
+	};
+
+	// columns of the sweep table, paths into the benchmark JSON
+	const char* sweepColumns[] = {
+		"scene.cityGridSize",
+		"scene.instances",
+		"scene.memoryMB",
+		"scene.generateMs",
+		"loadTimeMs",
+		"frameTimeMs.p50",
+		"frameTimeMs.p95",
+		"cpuSubmitMs",
+		"cpuWaitMs",
+		"packets",
+		"drawCalls",
+		"triangles",
+		"packetsCulled",
+		"trianglesCulled"
+	};
+	const int sweepColumnCount = sizeof(sweepColumns) / sizeof(sweepColumns[0]);
+
+	void printUsage() {
+		fprintf(stdout,
+			"usage: BenchmarkRunner [options]\n"
+			"  --exe file           application to run (default %s)\n"
+			"  --baseline file      baseline results (default benchmarks/baseline.json)\n"
+			"  --context egl|osmesa context of the application, osmesa runs without a GPU\n"
+			"  --scenario name      runs a single scenario\n"
+			"  --frames N           measured frames per run (default 600)\n"
+			"  --warmup N           frames skipped before measuring (default 30)\n"
+			"  --repeat N           runs per scenario, the best value of each metric is kept (default 1)\n"
+			"  --update-baseline    stores the results as the new baseline instead of comparing\n"
+			"  --city-sweep N,N,... runs the synthetic city at every grid size and writes a CSV table\n"
+			"  --sweep-output file  table of the city sweep (default city_scaling.csv)\n"
+			"The committed baseline has no scenarios, timings only compare on the machine that recorded them.\n"
+			"Run once with --update-baseline on the reference machine and commit the file, until then every\n"
+			"scenario fails with exit code 2.\n",
+			defaultExecutable);
+	}
+
+	// Runs the application once, fills results with its JSON output
+	bool runScenario(const RunnerOptions& options, const Scenario& scenario, int run, gps::BenchmarkMetrics& results) {
+
+		std::ostringstream outputFile;
+		outputFile << "benchmark_" << scenario.name << "_" << run << ".json";
+
+		std::ostringstream command;
+		command << "\"" << options.executable << "\" --benchmark"
+			<< " --benchmark-frames " << options.frames
+			<< " --benchmark-warmup " << options.warmupFrames
+			<< " --benchmark-output " << outputFile.str();
+		if (!options.contextApi.empty())
+			command << " --context " << options.contextApi;
+		command << " " << scenario.arguments;
+
+		fprintf(stdout, "[%s] %s\n", scenario.name, command.str().c_str());
+		fflush(stdout);
+
+		// the output file of an earlier run must not pass for this one
+		remove(outputFile.str().c_str());
+		int status = system(command.str().c_str());
+		if (status != 0) {
+			fprintf(stderr, "ERROR: scenario %s exited with status %d\n", scenario.name, status);
+			return false;
+		}
+		return gps::readBenchmarkJson(outputFile.str(), results);
+	}
+
+	// Every tracked metric is lower-is-better, so repeats keep the minimum
+	void keepBest(gps::BenchmarkMetrics& best, const gps::BenchmarkMetrics& results) {
+
+		for (gps::BenchmarkMetrics::const_iterator it = results.begin(); it != results.end(); ++it) {
+			gps::BenchmarkMetrics::iterator current = best.find(it->first);
+			if (current == best.end())
+				best[it->first] = it->second;
+			else
+				current->second = std::min(current->second, it->second);
+		}
+	}
+
+	std::vector<int> parseSizes(const char* list) {
+
+		std::vector<int> sizes;
+		std::istringstream values(list);
+		std::string value;
+		while (std::getline(values, value, ','))
+			if (atoi(value.c_str()) > 0)
+				sizes.push_back(atoi(value.c_str()));
+		return sizes;
+	}
+
+	// One row per grid size, benchmarks/plot_city_scaling.gp turns the table into scaling curves
+	int runCitySweep(const RunnerOptions& options) {
+
+		FILE* table = fopen(options.sweepOutput.c_str(), "w");
+		if (table == NULL) {
+			fprintf(stderr, "ERROR: could not write %s\n", options.sweepOutput.c_str());
+			return 2;
+		}
+
+		for (int c = 0; c < sweepColumnCount; c++)
+			fprintf(table, c == 0 ? "%s" : ",%s", sweepColumns[c]);
+		fprintf(table, "\n");
+
+		bool failedToRun = false;
+		for (size_t i = 0; i < options.citySizes.size(); i++) {
+
+			std::ostringstream name;
+			name << "city-" << options.citySizes[i];
+			std::ostringstream arguments;
+			arguments << "--city " << options.citySizes[i];
+			std::string nameText = name.str();
+			std::string argumentsText = arguments.str();
+
+			Scenario scenario;
+			scenario.name = nameText.c_str();
+			scenario.arguments = argumentsText.c_str();
+
+			gps::BenchmarkMetrics best;
+			bool ran = true;
+			for (int run = 0; run < options.repeats && ran; run++) {
+				gps::BenchmarkMetrics results;
+				ran = runScenario(options, scenario, run, results);
+				if (ran)
+					keepBest(best, results);
+			}
+			if (!ran) {
+				failedToRun = true;
+				continue;
+			}
+
+			for (int c = 0; c < sweepColumnCount; c++)
+				fprintf(table, c == 0 ? "%g" : ",%g", best[sweepColumns[c]]);
+			fprintf(table, "\n");
+			fflush(table);
+		}
+
+		fclose(table);
+		fprintf(stdout, "City sweep written to %s\n", options.sweepOutput.c_str());
+		return failedToRun ? 2 : EXIT_SUCCESS;
+	}
+
+}
+
+int main(int argc, const char* argv[]) {
+
+	RunnerOptions options;
+	options.executable = defaultExecutable;
+	options.baselineFile = "benchmarks/baseline.json";
+	options.frames = 600;
+	options.warmupFrames = 30;
+	options.repeats = 1;
+	options.updateBaseline = false;
+	options.sweepOutput = "city_scaling.csv";
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--exe") == 0 && i + 1 < argc)
+			options.executable = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			options.baselineFile = argv[++i];
+		else if (strcmp(argv[i], "--context") == 0 && i + 1 < argc)
+			options.contextApi = argv[++i];
+		else if (strcmp(argv[i], "--scenario") == 0 && i + 1 < argc)
+			options.onlyScenario = argv[++i];
+		else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			options.frames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			options.warmupFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+			options.repeats = std::max(atoi(argv[++i]), 1);
+		else if (strcmp(argv[i], "--update-baseline") == 0)
+			options.updateBaseline = true;
+		else if (strcmp(argv[i], "--city-sweep") == 0 && i + 1 < argc)
+			options.citySizes = parseSizes(argv[++i]);
+		else if (strcmp(argv[i], "--sweep-output") == 0 && i + 1 < argc)
+			options.sweepOutput = argv[++i];
+		else {
+			printUsage();
+			return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : 2;
+		}
+	}
+
+	if (!options.citySizes.empty())
+		return runCitySweep(options);
+
+	gps::BenchmarkBaseline baseline;
+	if (!baseline.load(options.baselineFile))
+		return 2;
+
+	bool failedToRun = false;
+	bool missingBaseline = false;
+	std::vector<gps::BenchmarkRegression> regressions;
+	int scenariosRun = 0;
+
+	for (int i = 0; i < scenarioCount; i++) {
+
+		const Scenario& scenario = scenarios[i];
+		if (!options.onlyScenario.empty() && options.onlyScenario != scenario.name)
+			continue;
+		scenariosRun++;
+
+		gps::BenchmarkMetrics best;
+		bool ran = true;
+		for (int run = 0; run < options.repeats && ran; run++) {
+			gps::BenchmarkMetrics results;
+			ran = runScenario(options, scenario, run, results);
+			if (ran)
+				keepBest(best, results);
+		}
+		if (!ran) {
+			failedToRun = true;
+			continue;
+		}
+
+		if (options.updateBaseline) {
+			baseline.update(scenario.name, best);
+			continue;
+		}
+
+		// nothing to compare against is not a pass, the gate would never fail otherwise
+		if (!baseline.hasScenario(scenario.name)) {
+			fprintf(stderr, "ERROR: [%s] has no baseline, record one with --update-baseline\n", scenario.name);
+			missingBaseline = true;
+			continue;
+		}
+
+		const gps::BenchmarkMetrics& tolerances = baseline.getTolerances();
+		size_t firstRegression = regressions.size();
+		bool passed = baseline.compare(scenario.name, best, regressions);
+		for (gps::BenchmarkMetrics::const_iterator it = tolerances.begin(); it != tolerances.end(); ++it) {
+			gps::BenchmarkMetrics::const_iterator value = best.find(it->first);
+			if (value != best.end())
+				fprintf(stdout, "[%s]   %-18s %12.4f\n", scenario.name, it->first.c_str(), value->second);
+		}
+		for (size_t r = firstRegression; r < regressions.size(); r++) {
+			const gps::BenchmarkRegression& regression = regressions[r];
+			if (regression.missing)
+				fprintf(stdout, "[%s] REGRESSION %s: missing from the %s\n", scenario.name, regression.metric.c_str(),
+					regression.missingFromBaseline ? "baseline" : "results");
+			else
+				fprintf(stdout, "[%s] REGRESSION %s: %.4f, baseline %.4f (+%.0f%% allowed)\n", scenario.name,
+					regression.metric.c_str(), regression.current, regression.baseline, regression.tolerance * 100.0);
+		}
+		fprintf(stdout, "[%s] %s\n", scenario.name, passed ? "passed" : "FAILED");
+	}
+
+	if (scenariosRun == 0) {
+		fprintf(stderr, "ERROR: unknown scenario %s\n", options.onlyScenario.c_str());
+		return 2;
+	}
+
+	if (options.updateBaseline) {
+		if (failedToRun || !baseline.save(options.baselineFile))
+			return 2;
+		fprintf(stdout, "Baseline written to %s\n", options.baselineFile.c_str());
+		return EXIT_SUCCESS;
+	}
+
+	if (failedToRun || missingBaseline)
+		return 2;
+	if (!regressions.empty()) {
+		fprintf(stdout, "%u regression(s)\n", (unsigned int)regressions.size());
+		return 1;
+	}
+	fprintf(stdout, "All scenarios within tolerance\n");
+	return EXIT_SUCCESS;
+}
@@ -59,4 +59,18 @@ namespace gps {
         return this->cameraPosition;
     }
 
+    glm::vec3 Camera::getCameraFrontDirection() const {
+        return this->cameraFrontDirection;
+    }
+
+    glm::vec3 Camera::getCameraUpDirection() const {
+        return this->cameraUpDirection;
+    }
+
+    void Camera::setCameraPose(const glm::vec3& newPosition, const glm::vec3& frontDirection) {
+        this->cameraPosition = newPosition;
+        this->cameraFrontDirection = glm::normalize(frontDirection);
+        this->cameraRightDirection = glm::normalize(glm::cross(this->cameraFrontDirection, this->cameraUpDirection));
+    }
+
 }
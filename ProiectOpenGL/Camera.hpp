@@ -26,6 +26,11 @@ namespace gps {
 
         glm::vec3 getCameraPosition() const;
         void setCameraPosition(const glm::vec3& newPosition);
+
+        glm::vec3 getCameraFrontDirection() const;
+        glm::vec3 getCameraUpDirection() const;
+        //place the camera and point it along frontDirection, used by recorded paths
+        void setCameraPose(const glm::vec3& newPosition, const glm::vec3& frontDirection);
         
     private:
         glm::vec3 cameraPosition;
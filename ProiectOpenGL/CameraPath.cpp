@@ -0,0 +1,167 @@
+#include "CameraPath.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+namespace gps {
+
+	static const char* pathFileHeader = "# camera path v1";
+
+	// Uniform Catmull-Rom segment between p1 and p2
+	static glm::vec3 catmullRom(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, const glm::vec3& p3, float t) {
+
+		float t2 = t * t;
+		float t3 = t2 * t;
+		return 0.5f * ((2.0f * p1) +
+			(p2 - p0) * t +
+			(2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+			(3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+	}
+
+	void CameraPath::clear() {
+		samples.clear();
+	}
+
+	void CameraPath::addSample(float time, const glm::vec3& position, const glm::vec3& frontDirection, const glm::vec3& upDirection) {
+
+		// the camera looks down -z in its own space
+		glm::vec3 front = glm::normalize(frontDirection);
+		glm::vec3 right = glm::normalize(glm::cross(front, upDirection));
+		glm::vec3 up = glm::cross(right, front);
+
+		CameraSample sample;
+		sample.time = time;
+		sample.position = position;
+		sample.orientation = glm::quat_cast(glm::mat3(right, up, -front));
+
+		// keep neighbouring quaternions in the same hemisphere so slerp takes the short way
+		if (!samples.empty() && glm::dot(samples.back().orientation, sample.orientation) < 0.0f)
+			sample.orientation = -sample.orientation;
+
+		samples.push_back(sample);
+	}
+
+	void CameraPath::addSample(float time, const gps::Camera& camera) {
+		addSample(time, camera.getCameraPosition(), camera.getCameraFrontDirection(), camera.getCameraUpDirection());
+	}
+
+	bool CameraPath::isEmpty() const {
+		return samples.empty();
+	}
+
+	size_t CameraPath::getSampleCount() const {
+		return samples.size();
+	}
+
+	float CameraPath::getDuration() const {
+		return samples.empty() ? 0.0f : samples.back().time - samples.front().time;
+	}
+
+	void CameraPath::evaluate(float time, glm::vec3& position, glm::vec3& frontDirection) const {
+
+		if (samples.empty())
+			return;
+
+		time += samples.front().time;
+
+		size_t segment = 0;
+		if (time <= samples.front().time)
+			segment = 0;
+		else if (time >= samples.back().time)
+			segment = samples.size() - 1;
+		else {
+			// binary search for the last sample at or before time
+			size_t low = 0;
+			size_t high = samples.size() - 1;
+			while (high - low > 1) {
+				size_t middle = (low + high) / 2;
+				if (samples[middle].time <= time)
+					low = middle;
+				else
+					high = middle;
+			}
+			segment = low;
+		}
+
+		if (segment + 1 >= samples.size()) {
+			position = samples.back().position;
+			frontDirection = samples.back().orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+			return;
+		}
+
+		const CameraSample& a = samples[segment];
+		const CameraSample& b = samples[segment + 1];
+		float span = b.time - a.time;
+		float t = span > 0.0f ? glm::clamp((time - a.time) / span, 0.0f, 1.0f) : 0.0f;
+
+		// the ends repeat the first and last points
+		const glm::vec3& before = samples[segment > 0 ? segment - 1 : segment].position;
+		const glm::vec3& after = samples[segment + 2 < samples.size() ? segment + 2 : segment + 1].position;
+
+		position = catmullRom(before, a.position, b.position, after, t);
+		frontDirection = glm::slerp(a.orientation, b.orientation, t) * glm::vec3(0.0f, 0.0f, -1.0f);
+	}
+
+	void CameraPath::apply(float time, gps::Camera& camera) const {
+
+		if (samples.empty())
+			return;
+
+		glm::vec3 position;
+		glm::vec3 frontDirection;
+		evaluate(time, position, frontDirection);
+		camera.setCameraPose(position, frontDirection);
+	}
+
+	bool CameraPath::save(const std::string& fileName) const {
+
+		std::ofstream file(fileName.c_str());
+		if (!file.is_open()) {
+			std::cerr << "ERROR: could not write the camera path " << fileName << std::endl;
+			return false;
+		}
+
+		file << pathFileHeader << "\n";
+		file.precision(7);
+		for (size_t i = 0; i < samples.size(); i++) {
+			const CameraSample& sample = samples[i];
+			file << sample.time << " "
+				<< sample.position.x << " " << sample.position.y << " " << sample.position.z << " "
+				<< sample.orientation.w << " " << sample.orientation.x << " " << sample.orientation.y << " " << sample.orientation.z << "\n";
+		}
+		return true;
+	}
+
+	bool CameraPath::load(const std::string& fileName) {
+
+		std::ifstream file(fileName.c_str());
+		if (!file.is_open()) {
+			std::cerr << "ERROR: could not open the camera path " << fileName << std::endl;
+			return false;
+		}
+
+		std::vector<CameraSample> loaded;
+		std::string line;
+		while (std::getline(file, line)) {
+
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			std::istringstream values(line);
+			CameraSample sample;
+			values >> sample.time
+				>> sample.position.x >> sample.position.y >> sample.position.z
+				>> sample.orientation.w >> sample.orientation.x >> sample.orientation.y >> sample.orientation.z;
+			if (values.fail()) {
+				std::cerr << "ERROR: bad camera path sample in " << fileName << ": " << line << std::endl;
+				return false;
+			}
+			sample.orientation = glm::normalize(sample.orientation);
+			loaded.push_back(sample);
+		}
+
+		samples.swap(loaded);
+		return true;
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef CameraPath_hpp
+#define CameraPath_hpp
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Camera.hpp"
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Camera pose at a point in time of a path, in seconds from its start
+    struct CameraSample {
+        float time;
+        glm::vec3 position;
+        glm::quat orientation;
+    };
+
+    // Timed camera poses. Positions are joined with Catmull-Rom splines and orientations with
+    // slerp, so a path recorded at an uneven frame rate plays back smoothly at any fixed step
+    class CameraPath {
+
+    public:
+        void clear();
+
+        // Samples must come in increasing time order
+        void addSample(float time, const glm::vec3& position, const glm::vec3& frontDirection, const glm::vec3& upDirection);
+        void addSample(float time, const gps::Camera& camera);
+
+        bool isEmpty() const;
+        size_t getSampleCount() const;
+        float getDuration() const;
+
+        // Pose at time, clamped to the first and last sample
+        void evaluate(float time, glm::vec3& position, glm::vec3& frontDirection) const;
+        // Moves the camera to the pose at time
+        void apply(float time, gps::Camera& camera) const;
+
+        // Text file, one "time px py pz qw qx qy qz" line per sample
+        bool save(const std::string& fileName) const;
+        bool load(const std::string& fileName);
+
+    private:
+        std::vector<CameraSample> samples;
+    };
+}
+
+#endif /* CameraPath_hpp */
@@ -0,0 +1,104 @@
+#include "CityGenerator.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+namespace gps {
+
+	// Small xorshift generator, std::rand differs between runtimes and the layout has to be the same everywhere
+	class CityRandom {
+
+	public:
+		explicit CityRandom(unsigned int seed) : state(seed != 0 ? seed : 0x9E3779B9u) {}
+
+		uint32_t next() {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
+
+		// uniform in [minimum, maximum)
+		float range(float minimum, float maximum) {
+			return minimum + (maximum - minimum) * (next() >> 8) * (1.0f / 16777216.0f);
+		}
+
+	private:
+		uint32_t state;
+	};
+
+	size_t CityLayout::getInstanceCount() const {
+		return tiles.size() * CITY_MODELS_PER_TILE + cars.size();
+	}
+
+	size_t CityLayout::getMemorySize() const {
+		return tiles.capacity() * sizeof(glm::mat4) + cars.capacity() * sizeof(CityCar) + lights.capacity() * sizeof(glm::vec3);
+	}
+
+	void generateCity(const CitySettings& settings, const std::vector<glm::vec3>& tileLights, CityLayout& layout) {
+
+		CityRandom random(settings.seed);
+		int gridSize = std::max(settings.gridSize, 1);
+		size_t tileCount = (size_t)gridSize * gridSize;
+
+		layout.tiles.clear();
+		layout.cars.clear();
+		layout.lights.clear();
+		layout.tiles.reserve(tileCount);
+		layout.cars.reserve(tileCount * settings.carsPerTile);
+		layout.lights.reserve(tileCount * tileLights.size());
+
+		int middle = gridSize / 2;
+		float halfTile = settings.tileSize * 0.5f;
+
+		for (int row = 0; row < gridSize; row++) {
+			for (int column = 0; column < gridSize; column++) {
+
+				glm::vec3 origin((column - middle) * settings.tileSize, 0.0f, (row - middle) * settings.tileSize);
+
+				// half of the tiles are turned around so the streets do not repeat every tile
+				glm::mat4 tile = glm::translate(glm::mat4(1.0f), origin);
+				if ((row != middle || column != middle) && (random.next() & 1))
+					tile = glm::rotate(tile, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+				layout.tiles.push_back(tile);
+
+				for (size_t i = 0; i < tileLights.size(); i++)
+					layout.lights.push_back(glm::vec3(tile * glm::vec4(tileLights[i], 1.0f)));
+
+				for (int i = 0; i < settings.carsPerTile; i++) {
+					glm::vec3 position = origin + glm::vec3(random.range(-halfTile, halfTile), 0.0f, random.range(-halfTile, halfTile));
+					float heading = random.range(0.0f, 360.0f);
+					float scale = random.range(0.9f, 1.1f);
+
+					CityCar car;
+					car.transform = glm::translate(glm::mat4(1.0f), position);
+					car.transform = glm::rotate(car.transform, glm::radians(heading), glm::vec3(0.0f, 1.0f, 0.0f));
+					car.transform = glm::scale(car.transform, glm::vec3(scale));
+					layout.cars.push_back(car);
+				}
+			}
+		}
+	}
+
+	struct CloserTo {
+		glm::vec3 position;
+
+		bool operator()(const glm::vec3& a, const glm::vec3& b) const {
+			glm::vec3 toA = a - position;
+			glm::vec3 toB = b - position;
+			return glm::dot(toA, toA) < glm::dot(toB, toB);
+		}
+	};
+
+	void selectNearestLights(std::vector<glm::vec3>& lights, const glm::vec3& position, size_t count) {
+
+		if (lights.size() <= count)
+			return;
+
+		CloserTo closer;
+		closer.position = position;
+		std::nth_element(lights.begin(), lights.begin() + count, lights.end(), closer);
+	}
+}
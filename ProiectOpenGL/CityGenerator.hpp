@@ -0,0 +1,48 @@
+#ifndef CityGenerator_hpp
+#define CityGenerator_hpp
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace gps {
+
+    struct CitySettings {
+        // the city is gridSize x gridSize copies of the suburb
+        int gridSize;
+        unsigned int seed;
+        // distance between the centres of neighbouring tiles
+        float tileSize;
+        // parked cars scattered over every tile
+        int carsPerTile;
+    };
+
+    // Parked car, scattered with a random heading and a slightly random size
+    struct CityCar {
+        glm::mat4 transform;
+    };
+
+    // Models drawn per tile: the suburb, the dodge and the two propellers
+    const size_t CITY_MODELS_PER_TILE = 4;
+
+    // Where every copy of the scene goes. Tiles carry the suburb with its animated props,
+    // the tile in the middle of the grid is the original scene and keeps the identity transform
+    struct CityLayout {
+        std::vector<glm::mat4> tiles;
+        std::vector<CityCar> cars;
+        // street lights of every tile, in world space
+        std::vector<glm::vec3> lights;
+
+        // Model instances drawn, CITY_MODELS_PER_TILE for every tile and one per car
+        size_t getInstanceCount() const;
+        size_t getMemorySize() const;
+    };
+
+    // Deterministic for a given seed, so benchmark runs at the same size render the same city
+    void generateCity(const CitySettings& settings, const std::vector<glm::vec3>& tileLights, CityLayout& layout);
+
+    // Moves the count lights closest to position to the front of lights
+    void selectNearestLights(std::vector<glm::vec3>& lights, const glm::vec3& position, size_t count);
+}
+
+#endif /* CityGenerator_hpp */
@@ -0,0 +1,681 @@
+#define GPS_GL_TRACE_IMPLEMENTATION
+#include "FrameCapture.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+namespace gps {
+
+	// spare unit the texture snapshot binds to, its bindings are restored afterwards
+	static const GLuint SNAPSHOT_UNIT = CAPTURE_TEXTURE_UNITS - 1;
+
+	static const GLenum textureBindingQueries[3] = {
+		GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_2D_ARRAY
+	};
+	static const GLenum textureTargets[3] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY };
+
+	static GLint getInteger(GLenum name) {
+		GLint value = 0;
+		glGetIntegerv(name, &value);
+		return value;
+	}
+
+	// Layout glGetTexImage writes the uncompressed images in, close enough to the internal format to round trip
+	static void chooseReadFormat(GLint internalFormat, GLenum& format, GLenum& type) {
+
+		switch (internalFormat) {
+		case GL_DEPTH_COMPONENT:
+		case GL_DEPTH_COMPONENT16:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32:
+		case GL_DEPTH_COMPONENT32F:
+			format = GL_DEPTH_COMPONENT;
+			type = GL_FLOAT;
+			return;
+		case GL_RED:
+		case GL_R8:
+			format = GL_RED;
+			type = GL_UNSIGNED_BYTE;
+			return;
+		case GL_RG:
+		case GL_RG8:
+			format = GL_RG;
+			type = GL_UNSIGNED_BYTE;
+			return;
+		case GL_R16F:
+		case GL_R32F:
+			format = GL_RED;
+			type = GL_FLOAT;
+			return;
+		case GL_RG16F:
+		case GL_RG32F:
+			format = GL_RG;
+			type = GL_FLOAT;
+			return;
+		case GL_RGB16F:
+		case GL_RGB32F:
+		case GL_RGBA16F:
+		case GL_RGBA32F:
+		case GL_R11F_G11F_B10F:
+			format = GL_RGBA;
+			type = GL_FLOAT;
+			return;
+		}
+		format = GL_RGBA;
+		type = GL_UNSIGNED_BYTE;
+	}
+
+	// Bytes of an upload read with the given unpack alignment, the last row is not padded
+	static GLuint64 imageSize(GLuint64 width, GLuint64 height, GLuint64 depth, GLuint64 format, GLuint64 type, GLint alignment) {
+
+		if (width == 0 || height == 0 || depth == 0)
+			return 0;
+		GLuint64 rowSize = width * getTracePixelSize(format, type);
+		GLuint64 alignedRow = alignment > 1 ? (rowSize + alignment - 1) / alignment * alignment : rowSize;
+		return alignedRow * (height * depth - 1) + rowSize;
+	}
+
+	FrameCapture::FrameCapture() {
+
+		pending = false;
+		active = false;
+		activeUnit = GL_TEXTURE0;
+		unpackAlignment = 4;
+		capture.width = 0;
+		capture.height = 0;
+	}
+
+	void FrameCapture::request(const char* fileName, int width, int height) {
+
+		if (!glTrace().isInstalled()) {
+			fprintf(stderr, "ERROR: frame captures need a build with GPS_GL_TRACING\n");
+			return;
+		}
+		this->fileName = fileName;
+		capture.width = width;
+		capture.height = height;
+		pending = true;
+	}
+
+	bool FrameCapture::isPending() const {
+		return pending || active;
+	}
+
+	void FrameCapture::frameBegin() {
+
+		if (!pending)
+			return;
+		pending = false;
+		active = true;
+
+		capture.calls.clear();
+		buffers.clear();
+		textures.clear();
+		samplers.clear();
+		programs.clear();
+		vertexArrays.clear();
+		framebuffers.clear();
+		renderTargets.clear();
+
+		captureState();
+	}
+
+	void FrameCapture::captureState() {
+
+		CapturedState& state = capture.state;
+		state.program = getInteger(GL_CURRENT_PROGRAM);
+		state.vertexArray = getInteger(GL_VERTEX_ARRAY_BINDING);
+		state.drawFramebuffer = getInteger(GL_DRAW_FRAMEBUFFER_BINDING);
+		state.activeTexture = getInteger(GL_ACTIVE_TEXTURE);
+		state.arrayBuffer = getInteger(GL_ARRAY_BUFFER_BINDING);
+		state.uniformBuffer = getInteger(GL_UNIFORM_BUFFER_BINDING);
+		state.drawIndirectBuffer = getInteger(GL_DRAW_INDIRECT_BUFFER_BINDING);
+
+		for (int unit = 0; unit < CAPTURE_TEXTURE_UNITS; unit++) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			for (int target = 0; target < 3; target++) {
+				state.textures[unit][target] = getInteger(textureBindingQueries[target]);
+				if (state.textures[unit][target] != 0)
+					textures[state.textures[unit][target]] = textureTargets[target];
+			}
+			state.samplers[unit] = getInteger(GL_SAMPLER_BINDING);
+			if (state.samplers[unit] != 0)
+				samplers.insert(state.samplers[unit]);
+		}
+		glActiveTexture(state.activeTexture);
+
+		for (int binding = 0; binding < CAPTURE_UNIFORM_BINDINGS; binding++) {
+			GLint buffer = 0;
+			glGetIntegeri_v(GL_UNIFORM_BUFFER_BINDING, binding, &buffer);
+			state.uniformBuffers[binding] = buffer;
+			glGetInteger64i_v(GL_UNIFORM_BUFFER_START, binding, &state.uniformStarts[binding]);
+			glGetInteger64i_v(GL_UNIFORM_BUFFER_SIZE, binding, &state.uniformSizes[binding]);
+			if (buffer != 0)
+				buffers.insert(buffer);
+		}
+
+		glGetIntegerv(GL_VIEWPORT, state.viewport);
+		for (int i = 0; i < CAPTURE_CAPABILITY_COUNT; i++)
+			state.capabilities[i] = glIsEnabled(captureCapabilities[i]);
+		glGetFloatv(GL_COLOR_CLEAR_VALUE, state.clearColor);
+		state.blendSource = getInteger(GL_BLEND_SRC_RGB);
+		state.blendDestination = getInteger(GL_BLEND_DST_RGB);
+		state.cullFaceMode = getInteger(GL_CULL_FACE_MODE);
+		state.frontFace = getInteger(GL_FRONT_FACE);
+		state.depthFunc = getInteger(GL_DEPTH_FUNC);
+		// front and back, core profiles keep them equal
+		GLint polygonMode[2] = { GL_FILL, GL_FILL };
+		glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+		state.polygonMode = polygonMode[0];
+		glGetBooleanv(GL_DEPTH_WRITEMASK, &state.depthMask);
+		state.unpackAlignment = getInteger(GL_UNPACK_ALIGNMENT);
+
+		activeUnit = state.activeTexture;
+		unpackAlignment = state.unpackAlignment;
+
+		if (state.program != 0)
+			programs.insert(state.program);
+		if (state.vertexArray != 0)
+			vertexArrays.insert(state.vertexArray);
+		if (state.drawFramebuffer != 0)
+			framebuffers.insert(state.drawFramebuffer);
+		if (state.arrayBuffer != 0)
+			buffers.insert(state.arrayBuffer);
+		if (state.uniformBuffer != 0)
+			buffers.insert(state.uniformBuffer);
+		if (state.drawIndirectBuffer != 0)
+			buffers.insert(state.drawIndirectBuffer);
+	}
+
+	void FrameCapture::call(const GLTraceCall& call) {
+
+		if (!active)
+			return;
+
+		CapturedCall captured;
+		captured.entry = call.entry;
+		captured.arguments.assign(call.arguments, call.arguments + call.argumentCount);
+		copyData(call, captured);
+		capture.calls.push_back(captured);
+
+		reference(call);
+	}
+
+	// Pointer arguments that point into client memory are saved with the call,
+	// the ones that are offsets into a bound buffer stay as they are
+	void FrameCapture::copyData(const GLTraceCall& call, CapturedCall& captured) {
+
+		const GLTraceArgument* a = call.arguments;
+		const void* data = NULL;
+		GLuint64 size = 0;
+
+		switch (call.entry) {
+		case TRACE_glBufferData:
+			data = a[2].pointer;
+			size = a[1].unsignedInteger;
+			break;
+		case TRACE_glBufferSubData:
+			data = a[3].pointer;
+			size = a[2].unsignedInteger;
+			break;
+		case TRACE_glTexImage2D:
+			data = a[8].pointer;
+			size = imageSize(a[3].unsignedInteger, a[4].unsignedInteger, 1, a[6].unsignedInteger, a[7].unsignedInteger, unpackAlignment);
+			break;
+		case TRACE_glTexSubImage2D:
+			data = a[8].pointer;
+			size = imageSize(a[4].unsignedInteger, a[5].unsignedInteger, 1, a[6].unsignedInteger, a[7].unsignedInteger, unpackAlignment);
+			break;
+		case TRACE_glTexImage3D:
+			data = a[9].pointer;
+			size = imageSize(a[3].unsignedInteger, a[4].unsignedInteger, a[5].unsignedInteger,
+				a[7].unsignedInteger, a[8].unsignedInteger, unpackAlignment);
+			break;
+		case TRACE_glTexSubImage3D:
+			data = a[10].pointer;
+			size = imageSize(a[5].unsignedInteger, a[6].unsignedInteger, a[7].unsignedInteger,
+				a[8].unsignedInteger, a[9].unsignedInteger, unpackAlignment);
+			break;
+		case TRACE_glCompressedTexImage2D:
+			data = a[7].pointer;
+			size = a[6].unsignedInteger;
+			break;
+		case TRACE_glCompressedTexSubImage2D:
+			data = a[8].pointer;
+			size = a[7].unsignedInteger;
+			break;
+		case TRACE_glUniform3fv:
+			data = a[2].pointer;
+			size = a[1].unsignedInteger * 3 * sizeof(GLfloat);
+			break;
+		case TRACE_glUniform4fv:
+			data = a[2].pointer;
+			size = a[1].unsignedInteger * 4 * sizeof(GLfloat);
+			break;
+		case TRACE_glUniformMatrix3fv:
+			data = a[3].pointer;
+			size = a[1].unsignedInteger * 9 * sizeof(GLfloat);
+			break;
+		case TRACE_glUniformMatrix4fv:
+			data = a[3].pointer;
+			size = a[1].unsignedInteger * 16 * sizeof(GLfloat);
+			break;
+		case TRACE_glPixelStorei:
+			if (a[0].unsignedInteger == GL_UNPACK_ALIGNMENT)
+				unpackAlignment = (GLint)a[1].integer;
+			break;
+		default:
+			break;
+		}
+
+		if (data != NULL && size > 0)
+			captured.data.assign((const char*)data, (const char*)data + size);
+	}
+
+	void FrameCapture::reference(const GLTraceCall& call) {
+
+		const GLTraceArgument* a = call.arguments;
+		switch (call.entry) {
+		case TRACE_glUseProgram:
+			programs.insert((GLuint)a[0].unsignedInteger);
+			break;
+		case TRACE_glBindVertexArray:
+			vertexArrays.insert((GLuint)a[0].unsignedInteger);
+			break;
+		case TRACE_glBindBuffer:
+			buffers.insert((GLuint)a[1].unsignedInteger);
+			break;
+		case TRACE_glBindBufferRange:
+			buffers.insert((GLuint)a[2].unsignedInteger);
+			break;
+		case TRACE_glActiveTexture:
+			activeUnit = (GLenum)a[0].unsignedInteger;
+			break;
+		case TRACE_glBindTexture:
+			if (a[1].unsignedInteger != 0)
+				textures[(GLuint)a[1].unsignedInteger] = (GLenum)a[0].unsignedInteger;
+			break;
+		case TRACE_glBindSampler:
+			samplers.insert((GLuint)a[1].unsignedInteger);
+			break;
+		case TRACE_glBindFramebuffer:
+			framebuffers.insert((GLuint)a[1].unsignedInteger);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void FrameCapture::frameEnd() {
+
+		if (!active)
+			return;
+		active = false;
+
+		captureObjects();
+
+		size_t bytes = 0;
+		for (size_t i = 0; i < capture.buffers.size(); i++)
+			bytes += capture.buffers[i].data.size();
+		for (size_t i = 0; i < capture.textures.size(); i++) {
+			for (size_t image = 0; image < capture.textures[i].images.size(); image++)
+				bytes += capture.textures[i].images[image].data.size();
+		}
+
+		if (writeFrameCapture(fileName.c_str(), capture))
+			fprintf(stdout, "Frame captured to %s: %u calls, %u buffers, %u textures, %u programs, %.1f MB of data\n",
+				fileName.c_str(), (unsigned int)capture.calls.size(), (unsigned int)capture.buffers.size(),
+				(unsigned int)capture.textures.size(), (unsigned int)capture.programs.size(), bytes / (1024.0 * 1024.0));
+
+		// the contents can be hundreds of MB, nothing is kept
+		FrameCaptureData empty;
+		empty.width = capture.width;
+		empty.height = capture.height;
+		std::swap(capture, empty);
+	}
+
+	void FrameCapture::captureObjects() {
+
+		// the frame ring sections and the render targets must hold what the frame wrote
+		glFinish();
+
+		GLint packAlignment = getInteger(GL_PACK_ALIGNMENT);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		GLint previousUnit = getInteger(GL_ACTIVE_TEXTURE);
+		glActiveTexture(GL_TEXTURE0 + SNAPSHOT_UNIT);
+		GLint snapshotBindings[3];
+		for (int target = 0; target < 3; target++)
+			snapshotBindings[target] = getInteger(textureBindingQueries[target]);
+
+		// framebuffers reference textures and vertex arrays reference buffers, they go first
+		for (std::set<GLuint>::const_iterator it = framebuffers.begin(); it != framebuffers.end(); ++it)
+			captureFramebuffer(*it);
+		for (std::set<GLuint>::const_iterator it = vertexArrays.begin(); it != vertexArrays.end(); ++it)
+			captureVertexArray(*it);
+		for (std::map<GLuint, GLenum>::const_iterator it = textures.begin(); it != textures.end(); ++it)
+			captureTexture(it->first, it->second);
+		for (std::set<GLuint>::const_iterator it = buffers.begin(); it != buffers.end(); ++it)
+			captureBuffer(*it);
+		for (std::set<GLuint>::const_iterator it = samplers.begin(); it != samplers.end(); ++it)
+			captureSampler(*it);
+		for (std::set<GLuint>::const_iterator it = programs.begin(); it != programs.end(); ++it)
+			captureProgram(*it);
+
+		for (int target = 0; target < 3; target++)
+			glBindTexture(textureTargets[target], snapshotBindings[target]);
+		glActiveTexture(previousUnit);
+		glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+
+	void FrameCapture::captureBuffer(GLuint name) {
+
+		if (name == 0 || !glIsBuffer(name))
+			return;
+
+		CapturedBuffer buffer;
+		buffer.name = name;
+		buffer.size = 0;
+		buffer.immutable = false;
+
+		glBindBuffer(GL_COPY_READ_BUFFER, name);
+		glGetBufferParameteri64v(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &buffer.size);
+		glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_USAGE, &buffer.flags);
+#if !defined (__APPLE__)
+		if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+			GLint immutable = GL_FALSE;
+			glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_IMMUTABLE_STORAGE, &immutable);
+			if (immutable) {
+				buffer.immutable = true;
+				glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_STORAGE_FLAGS, &buffer.flags);
+			}
+		}
+#endif
+
+		GLint mapped = GL_FALSE;
+		GLint accessFlags = 0;
+		glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_MAPPED, &mapped);
+		glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_ACCESS_FLAGS, &accessFlags);
+		buffer.data.resize((size_t)buffer.size);
+		// buffers mapped without the persistent bit cannot be read, the replay gets zeros
+		if (buffer.size > 0 && (!mapped || (accessFlags & GL_MAP_PERSISTENT_BIT) != 0))
+			glGetBufferSubData(GL_COPY_READ_BUFFER, 0, buffer.size, &buffer.data[0]);
+		else if (buffer.size > 0)
+			fprintf(stderr, "ERROR: buffer %u is mapped at the end of the frame, its contents are not captured\n", name);
+
+		capture.buffers.push_back(buffer);
+	}
+
+	void FrameCapture::captureTexture(GLuint name, GLenum target) {
+
+		if (!glIsTexture(name))
+			return;
+		if (target != GL_TEXTURE_2D && target != GL_TEXTURE_CUBE_MAP && target != GL_TEXTURE_2D_ARRAY) {
+			fprintf(stderr, "ERROR: texture %u has a target the frame capture does not support\n", name);
+			return;
+		}
+
+		CapturedTexture texture;
+		texture.name = name;
+		texture.target = target;
+
+		glBindTexture(target, name);
+		GLenum firstImage = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : target;
+		GLint compressed = GL_FALSE;
+		glGetTexLevelParameteriv(firstImage, 0, GL_TEXTURE_INTERNAL_FORMAT, &texture.internalFormat);
+		glGetTexLevelParameteriv(firstImage, 0, GL_TEXTURE_COMPRESSED, &compressed);
+		texture.compressed = compressed != GL_FALSE;
+		chooseReadFormat(texture.internalFormat, texture.format, texture.type);
+
+		for (int p = 0; p < CAPTURE_TEXTURE_PARAMETER_COUNT; p++)
+			glGetTexParameteriv(target, captureTextureParameters[p], &texture.parameters[p]);
+		glGetTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, texture.borderColor);
+
+		bool contents = renderTargets.find(name) == renderTargets.end();
+		int faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+		for (GLint level = 0; level < 16; level++) {
+
+			GLint width = 0;
+			glGetTexLevelParameteriv(firstImage, level, GL_TEXTURE_WIDTH, &width);
+			if (width == 0)
+				break;
+
+			for (int face = 0; face < faces; face++) {
+
+				CapturedImage image;
+				image.target = faces == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : target;
+				image.level = level;
+				image.width = width;
+				image.height = 0;
+				image.depth = 1;
+				glGetTexLevelParameteriv(image.target, level, GL_TEXTURE_HEIGHT, &image.height);
+				if (target == GL_TEXTURE_2D_ARRAY)
+					glGetTexLevelParameteriv(image.target, level, GL_TEXTURE_DEPTH, &image.depth);
+
+				if (contents && texture.compressed) {
+					GLint size = 0;
+					glGetTexLevelParameteriv(image.target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+					image.data.resize(size);
+					if (size > 0)
+						glGetCompressedTexImage(image.target, level, &image.data[0]);
+				}
+				else if (contents) {
+					image.data.resize((size_t)imageSize(image.width, image.height, image.depth, texture.format, texture.type, 1));
+					if (!image.data.empty())
+						glGetTexImage(image.target, level, texture.format, texture.type, &image.data[0]);
+				}
+				texture.images.push_back(image);
+			}
+		}
+
+		capture.textures.push_back(texture);
+	}
+
+	void FrameCapture::captureSampler(GLuint name) {
+
+		if (name == 0 || !glIsSampler(name))
+			return;
+
+		CapturedSampler sampler;
+		sampler.name = name;
+		for (int p = 0; p < CAPTURE_SAMPLER_PARAMETER_COUNT; p++)
+			glGetSamplerParameteriv(name, captureTextureParameters[p], &sampler.parameters[p]);
+		glGetSamplerParameterfv(name, GL_TEXTURE_BORDER_COLOR, sampler.borderColor);
+		capture.samplers.push_back(sampler);
+	}
+
+	void FrameCapture::captureProgram(GLuint name) {
+
+		if (name == 0 || !glIsProgram(name))
+			return;
+
+		CapturedProgram program;
+		program.name = name;
+
+		// the engine deletes its shaders after linking, they live on while they are attached
+		GLint shaderCount = 0;
+		glGetProgramiv(name, GL_ATTACHED_SHADERS, &shaderCount);
+		std::vector<GLuint> shaders(shaderCount > 0 ? shaderCount : 1);
+		glGetAttachedShaders(name, shaderCount, NULL, &shaders[0]);
+		for (GLint i = 0; i < shaderCount; i++) {
+			CapturedShader shader;
+			GLint type = 0;
+			GLint length = 0;
+			glGetShaderiv(shaders[i], GL_SHADER_TYPE, &type);
+			glGetShaderiv(shaders[i], GL_SHADER_SOURCE_LENGTH, &length);
+			std::vector<GLchar> source(length > 0 ? length : 1, 0);
+			glGetShaderSource(shaders[i], (GLsizei)source.size(), NULL, &source[0]);
+			shader.type = type;
+			shader.source = &source[0];
+			program.shaders.push_back(shader);
+		}
+		if (shaderCount == 0)
+			fprintf(stderr, "ERROR: program %u has no attached shaders, the replay cannot rebuild it\n", name);
+
+		GLchar text[256];
+		GLint count = 0;
+		glGetProgramiv(name, GL_ACTIVE_ATTRIBUTES, &count);
+		for (GLint i = 0; i < count; i++) {
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveAttrib(name, i, sizeof(text), NULL, &size, &type, text);
+			if (strncmp(text, "gl_", 3) == 0)
+				continue;
+			CapturedBinding attribute;
+			attribute.name = text;
+			attribute.index = glGetAttribLocation(name, text);
+			program.attributes.push_back(attribute);
+		}
+
+		glGetProgramiv(name, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+		for (GLint i = 0; i < count; i++) {
+			CapturedBinding block;
+			glGetActiveUniformBlockName(name, i, sizeof(text), NULL, text);
+			block.name = text;
+			glGetActiveUniformBlockiv(name, i, GL_UNIFORM_BLOCK_BINDING, &block.index);
+			program.uniformBlocks.push_back(block);
+		}
+
+		glGetProgramiv(name, GL_ACTIVE_UNIFORMS, &count);
+		for (GLint i = 0; i < count; i++) {
+
+			GLint size = 0;
+			GLenum type = 0;
+			GLint blockIndex = -1;
+			GLuint index = i;
+			glGetActiveUniform(name, index, sizeof(text), NULL, &size, &type, text);
+			glGetActiveUniformsiv(name, 1, &index, GL_UNIFORM_BLOCK_INDEX, &blockIndex);
+			// block members live in the buffers
+			if (blockIndex != -1 || strncmp(text, "gl_", 3) == 0)
+				continue;
+
+			std::string baseName = text;
+			if (baseName.size() > 3 && baseName.compare(baseName.size() - 3, 3, "[0]") == 0)
+				baseName.erase(baseName.size() - 3);
+
+			bool isFloat;
+			bool isUnsigned;
+			int components = getUniformComponents(type, isFloat, isUnsigned);
+			for (GLint element = 0; element < size; element++) {
+
+				CapturedUniform uniform;
+				if (size > 1) {
+					std::ostringstream elementName;
+					elementName << baseName << "[" << element << "]";
+					uniform.name = elementName.str();
+				}
+				else
+					uniform.name = baseName;
+				uniform.type = type;
+				uniform.location = glGetUniformLocation(name, uniform.name.c_str());
+				if (uniform.location < 0)
+					continue;
+
+				uniform.words.resize(components);
+				if (isFloat)
+					glGetUniformfv(name, uniform.location, (GLfloat*)&uniform.words[0]);
+				else if (isUnsigned)
+					glGetUniformuiv(name, uniform.location, &uniform.words[0]);
+				else
+					glGetUniformiv(name, uniform.location, (GLint*)&uniform.words[0]);
+				program.uniforms.push_back(uniform);
+			}
+		}
+
+		capture.programs.push_back(program);
+	}
+
+	void FrameCapture::captureVertexArray(GLuint name) {
+
+		if (name == 0 || !glIsVertexArray(name))
+			return;
+
+		CapturedVertexArray vertexArray;
+		vertexArray.name = name;
+
+		GLint previous = getInteger(GL_VERTEX_ARRAY_BINDING);
+		glBindVertexArray(name);
+		vertexArray.elementBuffer = getInteger(GL_ELEMENT_ARRAY_BUFFER_BINDING);
+		if (vertexArray.elementBuffer != 0)
+			buffers.insert(vertexArray.elementBuffer);
+
+		GLint maxAttributes = getInteger(GL_MAX_VERTEX_ATTRIBS);
+		for (GLint i = 0; i < maxAttributes && i < CAPTURE_VERTEX_ATTRIBUTES; i++) {
+
+			CapturedAttribute attribute;
+			GLint value = 0;
+			attribute.index = i;
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &attribute.enabled);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &value);
+			attribute.buffer = value;
+			if (!attribute.enabled && attribute.buffer == 0)
+				continue;
+
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_SIZE, &attribute.size);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_TYPE, &value);
+			attribute.type = value;
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_NORMALIZED, &attribute.normalized);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_INTEGER, &attribute.integer);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_STRIDE, &attribute.stride);
+			glGetVertexAttribiv(i, GL_VERTEX_ATTRIB_ARRAY_DIVISOR, &value);
+			attribute.divisor = value;
+			void* offset = NULL;
+			glGetVertexAttribPointerv(i, GL_VERTEX_ATTRIB_ARRAY_POINTER, &offset);
+			attribute.offset = (GLuint64)(size_t)offset;
+
+			if (attribute.buffer != 0)
+				buffers.insert(attribute.buffer);
+			vertexArray.attributes.push_back(attribute);
+		}
+
+		glBindVertexArray(previous);
+		capture.vertexArrays.push_back(vertexArray);
+	}
+
+	void FrameCapture::captureFramebuffer(GLuint name) {
+
+		if (name == 0 || !glIsFramebuffer(name))
+			return;
+
+		CapturedFramebuffer framebuffer;
+		framebuffer.name = name;
+
+		GLint previousDraw = getInteger(GL_DRAW_FRAMEBUFFER_BINDING);
+		GLint previousRead = getInteger(GL_READ_FRAMEBUFFER_BINDING);
+		glBindFramebuffer(GL_FRAMEBUFFER, name);
+		framebuffer.drawBuffer = getInteger(GL_DRAW_BUFFER);
+		framebuffer.readBuffer = getInteger(GL_READ_BUFFER);
+
+		const GLenum attachments[] = {
+			GL_DEPTH_ATTACHMENT, GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3
+		};
+		for (size_t i = 0; i < sizeof(attachments) / sizeof(attachments[0]); i++) {
+
+			GLint type = GL_NONE;
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, attachments[i], GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+			if (type == GL_NONE)
+				continue;
+			if (type != GL_TEXTURE) {
+				fprintf(stderr, "ERROR: framebuffer %u has a renderbuffer, the frame capture only supports textures\n", name);
+				continue;
+			}
+
+			CapturedAttachment attachment;
+			GLint texture = 0;
+			attachment.attachment = attachments[i];
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, attachments[i], GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &texture);
+			glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, attachments[i], GL_FRAMEBUFFER_ATTACHMENT_TEXTURE_LEVEL, &attachment.level);
+			attachment.texture = texture;
+			framebuffer.attachments.push_back(attachment);
+
+			renderTargets.insert(attachment.texture);
+			if (textures.find(attachment.texture) == textures.end())
+				textures[attachment.texture] = GL_TEXTURE_2D;
+		}
+
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+		capture.framebuffers.push_back(framebuffer);
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef FrameCapture_hpp
+#define FrameCapture_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include "GLTrace.hpp"
+#include "FrameCaptureFile.hpp"
+
+#include <map>
+#include <set>
+#include <string>
+
+namespace gps {
+
+    // Serializes the next traced frame for FrameReplay: the state when it begins, its calls with
+    // the data they point to, and when it ends every buffer, texture, sampler, program, vertex array
+    // and framebuffer the calls or the starting state reference. Needs the GL trace to be installed
+    class FrameCapture : public GLTraceObserver {
+
+    public:
+        FrameCapture();
+
+        // The frame that begins next is written to fileName, width and height are the window size
+        void request(const char* fileName, int width, int height);
+        bool isPending() const;
+
+        void frameBegin();
+        void frameEnd();
+        void call(const GLTraceCall& call);
+
+    private:
+        bool pending;
+        bool active;
+        std::string fileName;
+        FrameCaptureData capture;
+
+        std::set<GLuint> buffers;
+        // target of every texture
+        std::map<GLuint, GLenum> textures;
+        std::set<GLuint> samplers;
+        std::set<GLuint> programs;
+        std::set<GLuint> vertexArrays;
+        std::set<GLuint> framebuffers;
+        // textures written by the frame, their contents are not saved
+        std::set<GLuint> renderTargets;
+
+        GLenum activeUnit;
+        GLint unpackAlignment;
+
+        void captureState();
+        void captureObjects();
+        void captureBuffer(GLuint name);
+        void captureTexture(GLuint name, GLenum target);
+        void captureSampler(GLuint name);
+        void captureProgram(GLuint name);
+        void captureVertexArray(GLuint name);
+        void captureFramebuffer(GLuint name);
+        void reference(const GLTraceCall& call);
+        void copyData(const GLTraceCall& call, CapturedCall& captured);
+    };
+}
+
+#endif /* FrameCapture_hpp */
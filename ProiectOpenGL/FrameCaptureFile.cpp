@@ -0,0 +1,649 @@
+#include "FrameCaptureFile.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace gps {
+
+	static const char CAPTURE_MAGIC[8] = { 'G', 'P', 'S', 'F', 'R', 'A', 'M', 'E' };
+	static const GLuint CAPTURE_VERSION = 1;
+
+	enum CaptureChunk {
+		CHUNK_STATE = 1,
+		CHUNK_BUFFER,
+		CHUNK_TEXTURE,
+		CHUNK_SAMPLER,
+		CHUNK_PROGRAM,
+		CHUNK_VERTEX_ARRAY,
+		CHUNK_FRAMEBUFFER,
+		CHUNK_CALL
+	};
+
+	int getUniformComponents(GLenum type, bool& isFloat, bool& isUnsigned) {
+
+		isFloat = false;
+		isUnsigned = false;
+		switch (type) {
+		case GL_FLOAT: isFloat = true; return 1;
+		case GL_FLOAT_VEC2: isFloat = true; return 2;
+		case GL_FLOAT_VEC3: isFloat = true; return 3;
+		case GL_FLOAT_VEC4: isFloat = true; return 4;
+		case GL_FLOAT_MAT2: isFloat = true; return 4;
+		case GL_FLOAT_MAT3: isFloat = true; return 9;
+		case GL_FLOAT_MAT4: isFloat = true; return 16;
+		case GL_INT_VEC2:
+		case GL_BOOL_VEC2: return 2;
+		case GL_INT_VEC3:
+		case GL_BOOL_VEC3: return 3;
+		case GL_INT_VEC4:
+		case GL_BOOL_VEC4: return 4;
+		case GL_UNSIGNED_INT: isUnsigned = true; return 1;
+		case GL_UNSIGNED_INT_VEC2: isUnsigned = true; return 2;
+		case GL_UNSIGNED_INT_VEC3: isUnsigned = true; return 3;
+		case GL_UNSIGNED_INT_VEC4: isUnsigned = true; return 4;
+		}
+		// int, bool and every sampler type
+		return 1;
+	}
+
+	// Appends little endian values to a chunk, the same layout the reader expects
+	class CaptureWriter {
+
+	public:
+		std::vector<char> bytes;
+
+		void u8(unsigned int value) {
+			bytes.push_back((char)value);
+		}
+
+		void u32(GLuint value) {
+			for (int i = 0; i < 4; i++)
+				bytes.push_back((char)(value >> (8 * i)));
+		}
+
+		void i32(GLint value) {
+			u32((GLuint)value);
+		}
+
+		void u64(GLuint64 value) {
+			u32((GLuint)value);
+			u32((GLuint)(value >> 32));
+		}
+
+		void f32(GLfloat value) {
+			GLuint word;
+			memcpy(&word, &value, sizeof(word));
+			u32(word);
+		}
+
+		void string(const std::string& value) {
+			u32((GLuint)value.size());
+			bytes.insert(bytes.end(), value.begin(), value.end());
+		}
+
+		void blob(const std::vector<char>& value) {
+			u32((GLuint)value.size());
+			bytes.insert(bytes.end(), value.begin(), value.end());
+		}
+	};
+
+	// Reads what CaptureWriter wrote, every read past the end clears ok and returns zeros
+	class CaptureReader {
+
+	public:
+		CaptureReader(const char* data, size_t size) : data(data), size(size), position(0), ok(true) {}
+
+		bool isOk() const {
+			return ok;
+		}
+
+		bool atEnd() const {
+			return position >= size;
+		}
+
+		unsigned int u8() {
+			if (!has(1))
+				return 0;
+			return (unsigned char)data[position++];
+		}
+
+		GLuint u32() {
+			if (!has(4))
+				return 0;
+			GLuint value = 0;
+			for (int i = 0; i < 4; i++)
+				value |= (GLuint)(unsigned char)data[position++] << (8 * i);
+			return value;
+		}
+
+		GLint i32() {
+			return (GLint)u32();
+		}
+
+		GLuint64 u64() {
+			GLuint64 low = u32();
+			GLuint64 high = u32();
+			return low | (high << 32);
+		}
+
+		GLfloat f32() {
+			GLuint word = u32();
+			GLfloat value;
+			memcpy(&value, &word, sizeof(value));
+			return value;
+		}
+
+		std::string string() {
+			GLuint length = u32();
+			if (!has(length))
+				return std::string();
+			std::string value(data + position, length);
+			position += length;
+			return value;
+		}
+
+		void blob(std::vector<char>& value) {
+			GLuint length = u32();
+			value.clear();
+			if (!has(length))
+				return;
+			value.assign(data + position, data + position + length);
+			position += length;
+		}
+
+		// Count of a list, capped by what the remaining bytes could hold
+		GLuint count() {
+			GLuint value = u32();
+			if (value > size - position) {
+				ok = false;
+				return 0;
+			}
+			return value;
+		}
+
+	private:
+		const char* data;
+		size_t size;
+		size_t position;
+		bool ok;
+
+		bool has(size_t bytes) {
+			if (!ok || bytes > size - position) {
+				ok = false;
+				return false;
+			}
+			return true;
+		}
+	};
+
+	static void writeState(CaptureWriter& out, const CapturedState& state) {
+
+		out.u32(state.program);
+		out.u32(state.vertexArray);
+		out.u32(state.drawFramebuffer);
+		out.u32(state.activeTexture);
+		out.u32(state.arrayBuffer);
+		out.u32(state.uniformBuffer);
+		out.u32(state.drawIndirectBuffer);
+		for (int unit = 0; unit < CAPTURE_TEXTURE_UNITS; unit++) {
+			for (int target = 0; target < 3; target++)
+				out.u32(state.textures[unit][target]);
+			out.u32(state.samplers[unit]);
+		}
+		for (int binding = 0; binding < CAPTURE_UNIFORM_BINDINGS; binding++) {
+			out.u32(state.uniformBuffers[binding]);
+			out.u64((GLuint64)state.uniformStarts[binding]);
+			out.u64((GLuint64)state.uniformSizes[binding]);
+		}
+		for (int i = 0; i < 4; i++)
+			out.i32(state.viewport[i]);
+		for (int i = 0; i < CAPTURE_CAPABILITY_COUNT; i++)
+			out.u8(state.capabilities[i]);
+		for (int i = 0; i < 4; i++)
+			out.f32(state.clearColor[i]);
+		out.i32(state.blendSource);
+		out.i32(state.blendDestination);
+		out.i32(state.cullFaceMode);
+		out.i32(state.frontFace);
+		out.i32(state.depthFunc);
+		out.i32(state.polygonMode);
+		out.u8(state.depthMask);
+		out.i32(state.unpackAlignment);
+	}
+
+	static void readState(CaptureReader& in, CapturedState& state) {
+
+		state.program = in.u32();
+		state.vertexArray = in.u32();
+		state.drawFramebuffer = in.u32();
+		state.activeTexture = in.u32();
+		state.arrayBuffer = in.u32();
+		state.uniformBuffer = in.u32();
+		state.drawIndirectBuffer = in.u32();
+		for (int unit = 0; unit < CAPTURE_TEXTURE_UNITS; unit++) {
+			for (int target = 0; target < 3; target++)
+				state.textures[unit][target] = in.u32();
+			state.samplers[unit] = in.u32();
+		}
+		for (int binding = 0; binding < CAPTURE_UNIFORM_BINDINGS; binding++) {
+			state.uniformBuffers[binding] = in.u32();
+			state.uniformStarts[binding] = (GLint64)in.u64();
+			state.uniformSizes[binding] = (GLint64)in.u64();
+		}
+		for (int i = 0; i < 4; i++)
+			state.viewport[i] = in.i32();
+		for (int i = 0; i < CAPTURE_CAPABILITY_COUNT; i++)
+			state.capabilities[i] = (GLboolean)in.u8();
+		for (int i = 0; i < 4; i++)
+			state.clearColor[i] = in.f32();
+		state.blendSource = in.i32();
+		state.blendDestination = in.i32();
+		state.cullFaceMode = in.i32();
+		state.frontFace = in.i32();
+		state.depthFunc = in.i32();
+		state.polygonMode = in.i32();
+		state.depthMask = (GLboolean)in.u8();
+		state.unpackAlignment = in.i32();
+	}
+
+	static void writeTexture(CaptureWriter& out, const CapturedTexture& texture) {
+
+		out.u32(texture.name);
+		out.u32(texture.target);
+		out.i32(texture.internalFormat);
+		out.u8(texture.compressed ? 1 : 0);
+		out.u32(texture.format);
+		out.u32(texture.type);
+		out.u32(CAPTURE_TEXTURE_PARAMETER_COUNT);
+		for (int i = 0; i < CAPTURE_TEXTURE_PARAMETER_COUNT; i++)
+			out.i32(texture.parameters[i]);
+		for (int i = 0; i < 4; i++)
+			out.f32(texture.borderColor[i]);
+		out.u32((GLuint)texture.images.size());
+		for (size_t i = 0; i < texture.images.size(); i++) {
+			const CapturedImage& image = texture.images[i];
+			out.u32(image.target);
+			out.i32(image.level);
+			out.i32(image.width);
+			out.i32(image.height);
+			out.i32(image.depth);
+			out.blob(image.data);
+		}
+	}
+
+	static void readTexture(CaptureReader& in, CapturedTexture& texture) {
+
+		texture.name = in.u32();
+		texture.target = in.u32();
+		texture.internalFormat = in.i32();
+		texture.compressed = in.u8() != 0;
+		texture.format = in.u32();
+		texture.type = in.u32();
+		GLuint parameterCount = in.count();
+		for (GLuint i = 0; i < parameterCount; i++) {
+			GLint value = in.i32();
+			if (i < (GLuint)CAPTURE_TEXTURE_PARAMETER_COUNT)
+				texture.parameters[i] = value;
+		}
+		for (int i = 0; i < 4; i++)
+			texture.borderColor[i] = in.f32();
+		texture.images.resize(in.count());
+		for (size_t i = 0; i < texture.images.size(); i++) {
+			CapturedImage& image = texture.images[i];
+			image.target = in.u32();
+			image.level = in.i32();
+			image.width = in.i32();
+			image.height = in.i32();
+			image.depth = in.i32();
+			in.blob(image.data);
+		}
+	}
+
+	static void writeProgram(CaptureWriter& out, const CapturedProgram& program) {
+
+		out.u32(program.name);
+		out.u32((GLuint)program.shaders.size());
+		for (size_t i = 0; i < program.shaders.size(); i++) {
+			out.u32(program.shaders[i].type);
+			out.string(program.shaders[i].source);
+		}
+		out.u32((GLuint)program.attributes.size());
+		for (size_t i = 0; i < program.attributes.size(); i++) {
+			out.string(program.attributes[i].name);
+			out.i32(program.attributes[i].index);
+		}
+		out.u32((GLuint)program.uniformBlocks.size());
+		for (size_t i = 0; i < program.uniformBlocks.size(); i++) {
+			out.string(program.uniformBlocks[i].name);
+			out.i32(program.uniformBlocks[i].index);
+		}
+		out.u32((GLuint)program.uniforms.size());
+		for (size_t i = 0; i < program.uniforms.size(); i++) {
+			const CapturedUniform& uniform = program.uniforms[i];
+			out.string(uniform.name);
+			out.u32(uniform.type);
+			out.i32(uniform.location);
+			out.u32((GLuint)uniform.words.size());
+			for (size_t w = 0; w < uniform.words.size(); w++)
+				out.u32(uniform.words[w]);
+		}
+	}
+
+	static void readBindings(CaptureReader& in, std::vector<CapturedBinding>& bindings) {
+
+		bindings.resize(in.count());
+		for (size_t i = 0; i < bindings.size(); i++) {
+			bindings[i].name = in.string();
+			bindings[i].index = in.i32();
+		}
+	}
+
+	static void readProgram(CaptureReader& in, CapturedProgram& program) {
+
+		program.name = in.u32();
+		program.shaders.resize(in.count());
+		for (size_t i = 0; i < program.shaders.size(); i++) {
+			program.shaders[i].type = in.u32();
+			program.shaders[i].source = in.string();
+		}
+		readBindings(in, program.attributes);
+		readBindings(in, program.uniformBlocks);
+		program.uniforms.resize(in.count());
+		for (size_t i = 0; i < program.uniforms.size(); i++) {
+			CapturedUniform& uniform = program.uniforms[i];
+			uniform.name = in.string();
+			uniform.type = in.u32();
+			uniform.location = in.i32();
+			uniform.words.resize(in.count());
+			for (size_t w = 0; w < uniform.words.size(); w++)
+				uniform.words[w] = in.u32();
+		}
+	}
+
+	static void writeChunk(FILE* file, CaptureChunk type, const CaptureWriter& chunk, bool& failed) {
+
+		CaptureWriter header;
+		header.u32(type);
+		header.u32((GLuint)chunk.bytes.size());
+		if (fwrite(&header.bytes[0], 1, header.bytes.size(), file) != header.bytes.size())
+			failed = true;
+		if (!chunk.bytes.empty() && fwrite(&chunk.bytes[0], 1, chunk.bytes.size(), file) != chunk.bytes.size())
+			failed = true;
+	}
+
+	bool writeFrameCapture(const char* fileName, const FrameCaptureData& capture) {
+
+		FILE* file = fopen(fileName, "wb");
+		if (file == NULL) {
+			fprintf(stderr, "ERROR: could not write the frame capture to %s\n", fileName);
+			return false;
+		}
+
+		bool failed = false;
+		CaptureWriter header;
+		header.bytes.assign(CAPTURE_MAGIC, CAPTURE_MAGIC + sizeof(CAPTURE_MAGIC));
+		header.u32(CAPTURE_VERSION);
+		header.i32(capture.width);
+		header.i32(capture.height);
+		header.u32(TRACE_ENTRY_COUNT);
+		for (int entry = 0; entry < TRACE_ENTRY_COUNT; entry++)
+			header.string(getTraceEntryName((GLTraceEntry)entry));
+		if (fwrite(&header.bytes[0], 1, header.bytes.size(), file) != header.bytes.size())
+			failed = true;
+
+		CaptureWriter state;
+		writeState(state, capture.state);
+		writeChunk(file, CHUNK_STATE, state, failed);
+
+		for (size_t i = 0; i < capture.buffers.size(); i++) {
+			const CapturedBuffer& buffer = capture.buffers[i];
+			CaptureWriter chunk;
+			chunk.u32(buffer.name);
+			chunk.u64((GLuint64)buffer.size);
+			chunk.u8(buffer.immutable ? 1 : 0);
+			chunk.i32(buffer.flags);
+			chunk.blob(buffer.data);
+			writeChunk(file, CHUNK_BUFFER, chunk, failed);
+		}
+
+		for (size_t i = 0; i < capture.textures.size(); i++) {
+			CaptureWriter chunk;
+			writeTexture(chunk, capture.textures[i]);
+			writeChunk(file, CHUNK_TEXTURE, chunk, failed);
+		}
+
+		for (size_t i = 0; i < capture.samplers.size(); i++) {
+			const CapturedSampler& sampler = capture.samplers[i];
+			CaptureWriter chunk;
+			chunk.u32(sampler.name);
+			chunk.u32(CAPTURE_SAMPLER_PARAMETER_COUNT);
+			for (int p = 0; p < CAPTURE_SAMPLER_PARAMETER_COUNT; p++)
+				chunk.i32(sampler.parameters[p]);
+			for (int c = 0; c < 4; c++)
+				chunk.f32(sampler.borderColor[c]);
+			writeChunk(file, CHUNK_SAMPLER, chunk, failed);
+		}
+
+		for (size_t i = 0; i < capture.programs.size(); i++) {
+			CaptureWriter chunk;
+			writeProgram(chunk, capture.programs[i]);
+			writeChunk(file, CHUNK_PROGRAM, chunk, failed);
+		}
+
+		for (size_t i = 0; i < capture.vertexArrays.size(); i++) {
+			const CapturedVertexArray& vertexArray = capture.vertexArrays[i];
+			CaptureWriter chunk;
+			chunk.u32(vertexArray.name);
+			chunk.u32(vertexArray.elementBuffer);
+			chunk.u32((GLuint)vertexArray.attributes.size());
+			for (size_t a = 0; a < vertexArray.attributes.size(); a++) {
+				const CapturedAttribute& attribute = vertexArray.attributes[a];
+				chunk.u32(attribute.index);
+				chunk.i32(attribute.enabled);
+				chunk.i32(attribute.size);
+				chunk.u32(attribute.type);
+				chunk.i32(attribute.normalized);
+				chunk.i32(attribute.integer);
+				chunk.i32(attribute.stride);
+				chunk.u64(attribute.offset);
+				chunk.u32(attribute.buffer);
+				chunk.u32(attribute.divisor);
+			}
+			writeChunk(file, CHUNK_VERTEX_ARRAY, chunk, failed);
+		}
+
+		for (size_t i = 0; i < capture.framebuffers.size(); i++) {
+			const CapturedFramebuffer& framebuffer = capture.framebuffers[i];
+			CaptureWriter chunk;
+			chunk.u32(framebuffer.name);
+			chunk.u32(framebuffer.drawBuffer);
+			chunk.u32(framebuffer.readBuffer);
+			chunk.u32((GLuint)framebuffer.attachments.size());
+			for (size_t a = 0; a < framebuffer.attachments.size(); a++) {
+				chunk.u32(framebuffer.attachments[a].attachment);
+				chunk.u32(framebuffer.attachments[a].texture);
+				chunk.i32(framebuffer.attachments[a].level);
+			}
+			writeChunk(file, CHUNK_FRAMEBUFFER, chunk, failed);
+		}
+
+		for (size_t i = 0; i < capture.calls.size(); i++) {
+			const CapturedCall& call = capture.calls[i];
+			CaptureWriter chunk;
+			chunk.u32(call.entry);
+			chunk.u8((unsigned int)call.arguments.size());
+			for (size_t a = 0; a < call.arguments.size(); a++) {
+				chunk.u8((unsigned char)call.arguments[a].kind);
+				chunk.u64(call.arguments[a].unsignedInteger);
+			}
+			chunk.blob(call.data);
+			writeChunk(file, CHUNK_CALL, chunk, failed);
+		}
+
+		if (fclose(file) != 0)
+			failed = true;
+		if (failed) {
+			fprintf(stderr, "ERROR: could not write the frame capture to %s\n", fileName);
+			return false;
+		}
+		return true;
+	}
+
+	bool readFrameCapture(const char* fileName, FrameCaptureData& capture) {
+
+		FILE* file = fopen(fileName, "rb");
+		if (file == NULL) {
+			fprintf(stderr, "ERROR: could not open the frame capture %s\n", fileName);
+			return false;
+		}
+		std::vector<char> contents;
+		char block[65536];
+		size_t read;
+		while ((read = fread(block, 1, sizeof(block), file)) > 0)
+			contents.insert(contents.end(), block, block + read);
+		fclose(file);
+
+		if (contents.size() < sizeof(CAPTURE_MAGIC) || memcmp(&contents[0], CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) {
+			fprintf(stderr, "ERROR: %s is not a frame capture\n", fileName);
+			return false;
+		}
+
+		CaptureReader in(&contents[0] + sizeof(CAPTURE_MAGIC), contents.size() - sizeof(CAPTURE_MAGIC));
+		GLuint version = in.u32();
+		if (version != CAPTURE_VERSION) {
+			fprintf(stderr, "ERROR: %s is a version %u frame capture, this build reads version %u\n",
+				fileName, version, CAPTURE_VERSION);
+			return false;
+		}
+		capture.width = in.i32();
+		capture.height = in.i32();
+
+		// entry points are stored by name, the enum of this build may be ordered differently
+		std::vector<GLTraceEntry> entries(in.count());
+		for (size_t i = 0; i < entries.size(); i++) {
+			std::string name = in.string();
+			entries[i] = TRACE_ENTRY_COUNT;
+			for (int entry = 0; entry < TRACE_ENTRY_COUNT; entry++) {
+				if (name == getTraceEntryName((GLTraceEntry)entry))
+					entries[i] = (GLTraceEntry)entry;
+			}
+		}
+
+		bool hasState = false;
+		while (in.isOk() && !in.atEnd()) {
+
+			GLuint type = in.u32();
+			std::vector<char> payload;
+			in.blob(payload);
+			if (!in.isOk())
+				break;
+			// keeps the reader valid for empty chunks
+			payload.push_back(0);
+			CaptureReader chunk(&payload[0], payload.size() - 1);
+
+			switch (type) {
+			case CHUNK_STATE:
+				readState(chunk, capture.state);
+				hasState = true;
+				break;
+			case CHUNK_BUFFER: {
+				CapturedBuffer buffer;
+				buffer.name = chunk.u32();
+				buffer.size = (GLint64)chunk.u64();
+				buffer.immutable = chunk.u8() != 0;
+				buffer.flags = chunk.i32();
+				chunk.blob(buffer.data);
+				capture.buffers.push_back(buffer);
+				break;
+			}
+			case CHUNK_TEXTURE: {
+				CapturedTexture texture;
+				readTexture(chunk, texture);
+				capture.textures.push_back(texture);
+				break;
+			}
+			case CHUNK_SAMPLER: {
+				CapturedSampler sampler;
+				sampler.name = chunk.u32();
+				GLuint parameterCount = chunk.count();
+				for (GLuint p = 0; p < parameterCount; p++) {
+					GLint value = chunk.i32();
+					if (p < (GLuint)CAPTURE_SAMPLER_PARAMETER_COUNT)
+						sampler.parameters[p] = value;
+				}
+				for (int c = 0; c < 4; c++)
+					sampler.borderColor[c] = chunk.f32();
+				capture.samplers.push_back(sampler);
+				break;
+			}
+			case CHUNK_PROGRAM: {
+				CapturedProgram program;
+				readProgram(chunk, program);
+				capture.programs.push_back(program);
+				break;
+			}
+			case CHUNK_VERTEX_ARRAY: {
+				CapturedVertexArray vertexArray;
+				vertexArray.name = chunk.u32();
+				vertexArray.elementBuffer = chunk.u32();
+				vertexArray.attributes.resize(chunk.count());
+				for (size_t a = 0; a < vertexArray.attributes.size(); a++) {
+					CapturedAttribute& attribute = vertexArray.attributes[a];
+					attribute.index = chunk.u32();
+					attribute.enabled = chunk.i32();
+					attribute.size = chunk.i32();
+					attribute.type = chunk.u32();
+					attribute.normalized = chunk.i32();
+					attribute.integer = chunk.i32();
+					attribute.stride = chunk.i32();
+					attribute.offset = chunk.u64();
+					attribute.buffer = chunk.u32();
+					attribute.divisor = chunk.u32();
+				}
+				capture.vertexArrays.push_back(vertexArray);
+				break;
+			}
+			case CHUNK_FRAMEBUFFER: {
+				CapturedFramebuffer framebuffer;
+				framebuffer.name = chunk.u32();
+				framebuffer.drawBuffer = chunk.u32();
+				framebuffer.readBuffer = chunk.u32();
+				framebuffer.attachments.resize(chunk.count());
+				for (size_t a = 0; a < framebuffer.attachments.size(); a++) {
+					framebuffer.attachments[a].attachment = chunk.u32();
+					framebuffer.attachments[a].texture = chunk.u32();
+					framebuffer.attachments[a].level = chunk.i32();
+				}
+				capture.framebuffers.push_back(framebuffer);
+				break;
+			}
+			case CHUNK_CALL: {
+				CapturedCall call;
+				GLuint entry = chunk.u32();
+				call.entry = entry < entries.size() ? entries[entry] : TRACE_ENTRY_COUNT;
+				call.arguments.resize(chunk.u8());
+				for (size_t a = 0; a < call.arguments.size(); a++) {
+					call.arguments[a].kind = (char)chunk.u8();
+					call.arguments[a].unsignedInteger = chunk.u64();
+				}
+				chunk.blob(call.data);
+				capture.calls.push_back(call);
+				break;
+			}
+			default:
+				break;
+			}
+
+			if (!chunk.isOk()) {
+				fprintf(stderr, "ERROR: chunk %u of %s is truncated\n", type, fileName);
+				return false;
+			}
+		}
+
+		if (!in.isOk() || !hasState) {
+			fprintf(stderr, "ERROR: %s is truncated\n", fileName);
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,196 @@
+#ifndef FrameCaptureFile_hpp
+#define FrameCaptureFile_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include "GLTrace.hpp"
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Contents of a frame capture: the GL state when the frame began, every object its calls
+    // touched as it was when the frame ended, and the calls themselves
+    const int CAPTURE_TEXTURE_UNITS = 16;
+    const int CAPTURE_UNIFORM_BINDINGS = 16;
+    const int CAPTURE_VERTEX_ATTRIBUTES = 16;
+
+    // Capabilities the state snapshot records and the replay restores
+    const GLenum captureCapabilities[] = {
+        GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_FRAMEBUFFER_SRGB, GL_MULTISAMPLE, GL_SCISSOR_TEST,
+        GL_POLYGON_OFFSET_FILL, GL_PROGRAM_POINT_SIZE
+    };
+    const int CAPTURE_CAPABILITY_COUNT = sizeof(captureCapabilities) / sizeof(captureCapabilities[0]);
+
+    // Parameters of textures and samplers, samplers only have the first CAPTURE_SAMPLER_PARAMETER_COUNT
+    const GLenum captureTextureParameters[] = {
+        GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER, GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_WRAP_R,
+        GL_TEXTURE_COMPARE_MODE, GL_TEXTURE_COMPARE_FUNC, GL_TEXTURE_BASE_LEVEL, GL_TEXTURE_MAX_LEVEL
+    };
+    const int CAPTURE_TEXTURE_PARAMETER_COUNT = sizeof(captureTextureParameters) / sizeof(captureTextureParameters[0]);
+    const int CAPTURE_SAMPLER_PARAMETER_COUNT = 7;
+
+    struct CapturedState {
+        GLuint program;
+        GLuint vertexArray;
+        GLuint drawFramebuffer;
+        GLuint activeTexture;
+        GLuint arrayBuffer;
+        GLuint uniformBuffer;
+        GLuint drawIndirectBuffer;
+        // 2D, cube map and 2D array bindings of every unit
+        GLuint textures[CAPTURE_TEXTURE_UNITS][3];
+        GLuint samplers[CAPTURE_TEXTURE_UNITS];
+        GLuint uniformBuffers[CAPTURE_UNIFORM_BINDINGS];
+        GLint64 uniformStarts[CAPTURE_UNIFORM_BINDINGS];
+        GLint64 uniformSizes[CAPTURE_UNIFORM_BINDINGS];
+        GLint viewport[4];
+        GLboolean capabilities[CAPTURE_CAPABILITY_COUNT];
+        GLfloat clearColor[4];
+        GLint blendSource;
+        GLint blendDestination;
+        GLint cullFaceMode;
+        GLint frontFace;
+        GLint depthFunc;
+        GLint polygonMode;
+        GLboolean depthMask;
+        GLint unpackAlignment;
+    };
+
+    struct CapturedBuffer {
+        GLuint name;
+        GLint64 size;
+        bool immutable;
+        // storage flags of immutable buffers, usage of the others
+        GLint flags;
+        std::vector<char> data;
+    };
+
+    // One level of one face, target is the face for cube maps
+    struct CapturedImage {
+        GLenum target;
+        GLint level;
+        GLint width;
+        GLint height;
+        GLint depth;
+        std::vector<char> data;
+    };
+
+    struct CapturedTexture {
+        GLuint name;
+        GLenum target;
+        GLint internalFormat;
+        bool compressed;
+        // how the uncompressed images are stored
+        GLenum format;
+        GLenum type;
+        GLint parameters[CAPTURE_TEXTURE_PARAMETER_COUNT];
+        GLfloat borderColor[4];
+        // render targets only keep their size, the frame overwrites them anyway
+        std::vector<CapturedImage> images;
+    };
+
+    struct CapturedSampler {
+        GLuint name;
+        GLint parameters[CAPTURE_SAMPLER_PARAMETER_COUNT];
+        GLfloat borderColor[4];
+    };
+
+    struct CapturedShader {
+        GLenum type;
+        std::string source;
+    };
+
+    // Value of one uniform outside the blocks, array elements are separate uniforms
+    struct CapturedUniform {
+        std::string name;
+        GLenum type;
+        GLint location;
+        // raw 32 bit components
+        std::vector<GLuint> words;
+    };
+
+    struct CapturedBinding {
+        std::string name;
+        GLint index;
+    };
+
+    struct CapturedProgram {
+        GLuint name;
+        std::vector<CapturedShader> shaders;
+        // attribute locations, replays bind them before linking in case the driver would pick others
+        std::vector<CapturedBinding> attributes;
+        std::vector<CapturedBinding> uniformBlocks;
+        std::vector<CapturedUniform> uniforms;
+    };
+
+    struct CapturedAttribute {
+        GLuint index;
+        GLint enabled;
+        GLint size;
+        GLenum type;
+        GLint normalized;
+        GLint integer;
+        GLint stride;
+        GLuint64 offset;
+        GLuint buffer;
+        GLuint divisor;
+    };
+
+    struct CapturedVertexArray {
+        GLuint name;
+        GLuint elementBuffer;
+        std::vector<CapturedAttribute> attributes;
+    };
+
+    struct CapturedAttachment {
+        GLenum attachment;
+        GLuint texture;
+        GLint level;
+    };
+
+    struct CapturedFramebuffer {
+        GLuint name;
+        GLenum drawBuffer;
+        GLenum readBuffer;
+        std::vector<CapturedAttachment> attachments;
+    };
+
+    struct CapturedCall {
+        // TRACE_ENTRY_COUNT when the file names an entry point this build does not trace
+        GLTraceEntry entry;
+        std::vector<GLTraceArgument> arguments;
+        // what the pointer argument pointed to: uniform values, buffer and texture uploads
+        std::vector<char> data;
+    };
+
+    struct FrameCaptureData {
+        int width;
+        int height;
+        CapturedState state;
+        std::vector<CapturedBuffer> buffers;
+        std::vector<CapturedTexture> textures;
+        std::vector<CapturedSampler> samplers;
+        std::vector<CapturedProgram> programs;
+        std::vector<CapturedVertexArray> vertexArrays;
+        std::vector<CapturedFramebuffer> framebuffers;
+        std::vector<CapturedCall> calls;
+    };
+
+    // Components of a uniform type, isFloat and isUnsigned tell which glGetUniform* reads it
+    int getUniformComponents(GLenum type, bool& isFloat, bool& isUnsigned);
+
+    // Binary file: a header, the table of entry point names the calls index into, then one
+    // chunk per object and per call. Chunks carry their size, readers skip the types they do not know
+    bool writeFrameCapture(const char* fileName, const FrameCaptureData& capture);
+    bool readFrameCapture(const char* fileName, FrameCaptureData& capture);
+}
+
+#endif /* FrameCaptureFile_hpp */
@@ -0,0 +1,680 @@
+// Replays a frame capture of the application in a loop and times it, without the models, the textures
+// on disk or the scene logic. The window is hidden, --context osmesa runs it on llvmpipe without a GPU.
+
+#include "Window.h"
+#include "FrameCaptureFile.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace {
+
+	// Names of the capture mapped to the objects of the replay
+	struct ReplayObjects {
+		std::map<GLuint, GLuint> buffers;
+		std::map<GLuint, GLuint> textures;
+		std::map<GLuint, GLuint> samplers;
+		std::map<GLuint, GLuint> programs;
+		std::map<GLuint, GLuint> vertexArrays;
+		std::map<GLuint, GLuint> framebuffers;
+		// captured program and uniform location to the location in the replay
+		std::map<std::pair<GLuint, GLint>, GLint> locations;
+		// what a mapped range is filled with, the capture only has the buffers as the frame left them
+		std::map<GLuint, const gps::CapturedBuffer*> contents;
+	};
+
+	// What the calls of one iteration changed, in names of the capture
+	struct ReplayState {
+		GLuint program;
+		std::map<GLenum, GLuint> boundBuffers;
+		std::map<GLenum, bool> mapped;
+	};
+
+	GLuint lookup(const std::map<GLuint, GLuint>& names, GLuint64 name) {
+
+		std::map<GLuint, GLuint>::const_iterator it = names.find((GLuint)name);
+		return it != names.end() ? it->second : 0;
+	}
+
+	const void* dataOf(const gps::CapturedCall& call) {
+		return call.data.empty() ? NULL : &call.data[0];
+	}
+
+	void createBuffers(const gps::FrameCaptureData& capture, ReplayObjects& objects) {
+
+		for (size_t i = 0; i < capture.buffers.size(); i++) {
+
+			const gps::CapturedBuffer& captured = capture.buffers[i];
+			GLuint buffer;
+			glGenBuffers(1, &buffer);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+			const void* data = captured.data.empty() ? NULL : &captured.data[0];
+#if !defined (__APPLE__)
+			if (captured.immutable && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage))
+				glBufferStorage(GL_COPY_WRITE_BUFFER, captured.size, data, captured.flags);
+			else
+#endif
+				glBufferData(GL_COPY_WRITE_BUFFER, captured.size, data, captured.immutable ? GL_DYNAMIC_DRAW : captured.flags);
+
+			objects.buffers[captured.name] = buffer;
+			objects.contents[captured.name] = &captured;
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	void createTextures(const gps::FrameCaptureData& capture, ReplayObjects& objects) {
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (size_t i = 0; i < capture.textures.size(); i++) {
+
+			const gps::CapturedTexture& captured = capture.textures[i];
+			GLuint texture;
+			glGenTextures(1, &texture);
+			glBindTexture(captured.target, texture);
+
+			for (size_t image = 0; image < captured.images.size(); image++) {
+
+				const gps::CapturedImage& level = captured.images[image];
+				const void* data = level.data.empty() ? NULL : &level.data[0];
+				if (captured.target == GL_TEXTURE_2D_ARRAY) {
+					if (captured.compressed)
+						glCompressedTexImage3D(level.target, level.level, captured.internalFormat, level.width, level.height,
+							level.depth, 0, (GLsizei)level.data.size(), data);
+					else
+						glTexImage3D(level.target, level.level, captured.internalFormat, level.width, level.height, level.depth,
+							0, captured.format, captured.type, data);
+				}
+				else if (captured.compressed)
+					glCompressedTexImage2D(level.target, level.level, captured.internalFormat, level.width, level.height, 0,
+						(GLsizei)level.data.size(), data);
+				else
+					glTexImage2D(level.target, level.level, captured.internalFormat, level.width, level.height, 0,
+						captured.format, captured.type, data);
+			}
+
+			for (int p = 0; p < gps::CAPTURE_TEXTURE_PARAMETER_COUNT; p++)
+				glTexParameteri(captured.target, gps::captureTextureParameters[p], captured.parameters[p]);
+			glTexParameterfv(captured.target, GL_TEXTURE_BORDER_COLOR, captured.borderColor);
+
+			objects.textures[captured.name] = texture;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	void createSamplers(const gps::FrameCaptureData& capture, ReplayObjects& objects) {
+
+		for (size_t i = 0; i < capture.samplers.size(); i++) {
+
+			const gps::CapturedSampler& captured = capture.samplers[i];
+			GLuint sampler;
+			glGenSamplers(1, &sampler);
+			for (int p = 0; p < gps::CAPTURE_SAMPLER_PARAMETER_COUNT; p++)
+				glSamplerParameteri(sampler, gps::captureTextureParameters[p], captured.parameters[p]);
+			glSamplerParameterfv(sampler, GL_TEXTURE_BORDER_COLOR, captured.borderColor);
+			objects.samplers[captured.name] = sampler;
+		}
+	}
+
+	void setUniform(const gps::CapturedUniform& uniform, GLint location) {
+
+		bool isFloat;
+		bool isUnsigned;
+		int components = gps::getUniformComponents(uniform.type, isFloat, isUnsigned);
+		if ((int)uniform.words.size() < components)
+			return;
+
+		const GLfloat* floats = (const GLfloat*)&uniform.words[0];
+		const GLint* ints = (const GLint*)&uniform.words[0];
+		const GLuint* uints = &uniform.words[0];
+		switch (uniform.type) {
+		case GL_FLOAT_MAT2: glUniformMatrix2fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT3: glUniformMatrix3fv(location, 1, GL_FALSE, floats); return;
+		case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, floats); return;
+		}
+
+		if (isFloat) {
+			switch (components) {
+			case 1: glUniform1fv(location, 1, floats); break;
+			case 2: glUniform2fv(location, 1, floats); break;
+			case 3: glUniform3fv(location, 1, floats); break;
+			case 4: glUniform4fv(location, 1, floats); break;
+			}
+		}
+		else if (isUnsigned) {
+			switch (components) {
+			case 1: glUniform1uiv(location, 1, uints); break;
+			case 2: glUniform2uiv(location, 1, uints); break;
+			case 3: glUniform3uiv(location, 1, uints); break;
+			case 4: glUniform4uiv(location, 1, uints); break;
+			}
+		}
+		else {
+			switch (components) {
+			case 1: glUniform1iv(location, 1, ints); break;
+			case 2: glUniform2iv(location, 1, ints); break;
+			case 3: glUniform3iv(location, 1, ints); break;
+			case 4: glUniform4iv(location, 1, ints); break;
+			}
+		}
+	}
+
+	bool createPrograms(const gps::FrameCaptureData& capture, ReplayObjects& objects) {
+
+		bool linked = true;
+		for (size_t i = 0; i < capture.programs.size(); i++) {
+
+			const gps::CapturedProgram& captured = capture.programs[i];
+			GLuint program = glCreateProgram();
+
+			for (size_t s = 0; s < captured.shaders.size(); s++) {
+				GLuint shader = glCreateShader(captured.shaders[s].type);
+				const GLchar* source = captured.shaders[s].source.c_str();
+				glShaderSource(shader, 1, &source, NULL);
+				glCompileShader(shader);
+				glAttachShader(program, shader);
+				glDeleteShader(shader);
+			}
+			for (size_t a = 0; a < captured.attributes.size(); a++) {
+				if (captured.attributes[a].index >= 0)
+					glBindAttribLocation(program, captured.attributes[a].index, captured.attributes[a].name.c_str());
+			}
+			glLinkProgram(program);
+
+			GLint status = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &status);
+			if (!status) {
+				GLchar log[1024];
+				glGetProgramInfoLog(program, sizeof(log), NULL, log);
+				fprintf(stderr, "ERROR: program %u of the capture does not link on this driver\n%s\n", captured.name, log);
+				linked = false;
+			}
+
+			glUseProgram(program);
+			for (size_t u = 0; u < captured.uniforms.size(); u++) {
+				const gps::CapturedUniform& uniform = captured.uniforms[u];
+				GLint location = glGetUniformLocation(program, uniform.name.c_str());
+				objects.locations[std::make_pair(captured.name, uniform.location)] = location;
+				if (location != -1)
+					setUniform(uniform, location);
+			}
+			for (size_t b = 0; b < captured.uniformBlocks.size(); b++) {
+				GLuint blockIndex = glGetUniformBlockIndex(program, captured.uniformBlocks[b].name.c_str());
+				if (blockIndex != GL_INVALID_INDEX)
+					glUniformBlockBinding(program, blockIndex, captured.uniformBlocks[b].index);
+			}
+
+			objects.programs[captured.name] = program;
+		}
+		glUseProgram(0);
+		return linked;
+	}
+
+	void createVertexArrays(const gps::FrameCaptureData& capture, ReplayObjects& objects) {
+
+		for (size_t i = 0; i < capture.vertexArrays.size(); i++) {
+
+			const gps::CapturedVertexArray& captured = capture.vertexArrays[i];
+			GLuint vertexArray;
+			glGenVertexArrays(1, &vertexArray);
+			glBindVertexArray(vertexArray);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lookup(objects.buffers, captured.elementBuffer));
+
+			for (size_t a = 0; a < captured.attributes.size(); a++) {
+
+				const gps::CapturedAttribute& attribute = captured.attributes[a];
+				glBindBuffer(GL_ARRAY_BUFFER, lookup(objects.buffers, attribute.buffer));
+				const void* offset = (const void*)(size_t)attribute.offset;
+				if (attribute.integer)
+					glVertexAttribIPointer(attribute.index, attribute.size, attribute.type, attribute.stride, offset);
+				else
+					glVertexAttribPointer(attribute.index, attribute.size, attribute.type, (GLboolean)attribute.normalized,
+						attribute.stride, offset);
+				if (attribute.enabled)
+					glEnableVertexAttribArray(attribute.index);
+				glVertexAttribDivisor(attribute.index, attribute.divisor);
+			}
+
+			objects.vertexArrays[captured.name] = vertexArray;
+		}
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void createFramebuffers(const gps::FrameCaptureData& capture, ReplayObjects& objects) {
+
+		for (size_t i = 0; i < capture.framebuffers.size(); i++) {
+
+			const gps::CapturedFramebuffer& captured = capture.framebuffers[i];
+			GLuint framebuffer;
+			glGenFramebuffers(1, &framebuffer);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			for (size_t a = 0; a < captured.attachments.size(); a++) {
+				const gps::CapturedAttachment& attachment = captured.attachments[a];
+				glFramebufferTexture2D(GL_FRAMEBUFFER, attachment.attachment, GL_TEXTURE_2D,
+					lookup(objects.textures, attachment.texture), attachment.level);
+			}
+			glDrawBuffer(captured.drawBuffer);
+			glReadBuffer(captured.readBuffer);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+				fprintf(stderr, "ERROR: framebuffer %u of the capture is not complete on this driver\n", captured.name);
+
+			objects.framebuffers[captured.name] = framebuffer;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Puts GL back where the captured frame started, every iteration begins here
+	void applyState(const gps::CapturedState& state, const ReplayObjects& objects, ReplayState& replay) {
+
+		glUseProgram(lookup(objects.programs, state.program));
+		glBindVertexArray(lookup(objects.vertexArrays, state.vertexArray));
+		glBindFramebuffer(GL_FRAMEBUFFER, lookup(objects.framebuffers, state.drawFramebuffer));
+
+		const GLenum targets[3] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY };
+		for (int unit = 0; unit < gps::CAPTURE_TEXTURE_UNITS; unit++) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			for (int target = 0; target < 3; target++)
+				glBindTexture(targets[target], lookup(objects.textures, state.textures[unit][target]));
+			glBindSampler(unit, lookup(objects.samplers, state.samplers[unit]));
+		}
+		glActiveTexture(state.activeTexture);
+
+		for (int binding = 0; binding < gps::CAPTURE_UNIFORM_BINDINGS; binding++) {
+			GLuint buffer = lookup(objects.buffers, state.uniformBuffers[binding]);
+			if (buffer != 0 && state.uniformSizes[binding] > 0)
+				glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, (GLintptr)state.uniformStarts[binding],
+					(GLsizeiptr)state.uniformSizes[binding]);
+			else
+				glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, lookup(objects.buffers, state.uniformBuffer));
+		glBindBuffer(GL_ARRAY_BUFFER, lookup(objects.buffers, state.arrayBuffer));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, lookup(objects.buffers, state.drawIndirectBuffer));
+
+		glViewport(state.viewport[0], state.viewport[1], state.viewport[2], state.viewport[3]);
+		for (int i = 0; i < gps::CAPTURE_CAPABILITY_COUNT; i++) {
+			if (state.capabilities[i])
+				glEnable(gps::captureCapabilities[i]);
+			else
+				glDisable(gps::captureCapabilities[i]);
+		}
+		glClearColor(state.clearColor[0], state.clearColor[1], state.clearColor[2], state.clearColor[3]);
+		glBlendFunc(state.blendSource, state.blendDestination);
+		glCullFace(state.cullFaceMode);
+		glFrontFace(state.frontFace);
+		glDepthFunc(state.depthFunc);
+		glPolygonMode(GL_FRONT_AND_BACK, state.polygonMode);
+		glDepthMask(state.depthMask);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, state.unpackAlignment);
+
+		replay.program = state.program;
+		replay.boundBuffers.clear();
+		replay.boundBuffers[GL_UNIFORM_BUFFER] = state.uniformBuffer;
+		replay.boundBuffers[GL_ARRAY_BUFFER] = state.arrayBuffer;
+		replay.boundBuffers[GL_DRAW_INDIRECT_BUFFER] = state.drawIndirectBuffer;
+		replay.mapped.clear();
+	}
+
+	GLint location(const ReplayObjects& objects, const ReplayState& replay, const gps::GLTraceArgument& argument) {
+
+		std::map<std::pair<GLuint, GLint>, GLint>::const_iterator it =
+			objects.locations.find(std::make_pair(replay.program, (GLint)argument.integer));
+		return it != objects.locations.end() ? it->second : -1;
+	}
+
+	// Returns false for the calls a replay leaves out: queries, fences, reads and object deletion
+	bool replayCall(const gps::CapturedCall& call, const ReplayObjects& objects, ReplayState& replay) {
+
+		gps::GLTraceArgument a[gps::GLTraceCall::MAX_ARGUMENTS];
+		memset(a, 0, sizeof(a));
+		for (size_t i = 0; i < call.arguments.size() && i < (size_t)gps::GLTraceCall::MAX_ARGUMENTS; i++)
+			a[i] = call.arguments[i];
+		const void* data = dataOf(call);
+
+		switch (call.entry) {
+		case gps::TRACE_glUseProgram:
+			glUseProgram(lookup(objects.programs, a[0].unsignedInteger));
+			replay.program = (GLuint)a[0].unsignedInteger;
+			return true;
+		case gps::TRACE_glBindVertexArray:
+			glBindVertexArray(lookup(objects.vertexArrays, a[0].unsignedInteger));
+			return true;
+		case gps::TRACE_glBindBuffer:
+			glBindBuffer((GLenum)a[0].unsignedInteger, lookup(objects.buffers, a[1].unsignedInteger));
+			replay.boundBuffers[(GLenum)a[0].unsignedInteger] = (GLuint)a[1].unsignedInteger;
+			return true;
+		case gps::TRACE_glBindBufferRange:
+			glBindBufferRange((GLenum)a[0].unsignedInteger, (GLuint)a[1].unsignedInteger, lookup(objects.buffers, a[2].unsignedInteger),
+				(GLintptr)a[3].integer, (GLsizeiptr)a[4].integer);
+			replay.boundBuffers[(GLenum)a[0].unsignedInteger] = (GLuint)a[2].unsignedInteger;
+			return true;
+		case gps::TRACE_glBindBufferBase:
+			glBindBufferBase((GLenum)a[0].unsignedInteger, (GLuint)a[1].unsignedInteger, lookup(objects.buffers, a[2].unsignedInteger));
+			replay.boundBuffers[(GLenum)a[0].unsignedInteger] = (GLuint)a[2].unsignedInteger;
+			return true;
+		case gps::TRACE_glBindFramebuffer:
+			glBindFramebuffer((GLenum)a[0].unsignedInteger, lookup(objects.framebuffers, a[1].unsignedInteger));
+			return true;
+		case gps::TRACE_glBindSampler:
+			glBindSampler((GLuint)a[0].unsignedInteger, lookup(objects.samplers, a[1].unsignedInteger));
+			return true;
+		case gps::TRACE_glActiveTexture:
+			glActiveTexture((GLenum)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glBindTexture:
+			glBindTexture((GLenum)a[0].unsignedInteger, lookup(objects.textures, a[1].unsignedInteger));
+			return true;
+
+		case gps::TRACE_glBufferData:
+			glBufferData((GLenum)a[0].unsignedInteger, (GLsizeiptr)a[1].integer, data, (GLenum)a[3].unsignedInteger);
+			return true;
+		case gps::TRACE_glBufferSubData:
+			if (data == NULL)
+				return false;
+			glBufferSubData((GLenum)a[0].unsignedInteger, (GLintptr)a[1].integer, (GLsizeiptr)call.data.size(), data);
+			return true;
+		case gps::TRACE_glMapBufferRange: {
+			GLenum target = (GLenum)a[0].unsignedInteger;
+			GLintptr offset = (GLintptr)a[1].integer;
+			GLsizeiptr length = (GLsizeiptr)a[2].integer;
+			GLbitfield access = (GLbitfield)a[3].unsignedInteger;
+			// persistent maps belong to buffer creation, a replay never writes through them
+			if ((access & GL_MAP_PERSISTENT_BIT) != 0)
+				return false;
+			void* pointer = glMapBufferRange(target, offset, length, access);
+			if (pointer == NULL)
+				return false;
+			replay.mapped[target] = true;
+			std::map<GLuint, const gps::CapturedBuffer*>::const_iterator contents = objects.contents.find(replay.boundBuffers[target]);
+			if (contents != objects.contents.end() && offset < (GLintptr)contents->second->data.size())
+				memcpy(pointer, &contents->second->data[offset], std::min((size_t)length, contents->second->data.size() - offset));
+			return true;
+		}
+		case gps::TRACE_glUnmapBuffer:
+			if (!replay.mapped[(GLenum)a[0].unsignedInteger])
+				return false;
+			glUnmapBuffer((GLenum)a[0].unsignedInteger);
+			replay.mapped[(GLenum)a[0].unsignedInteger] = false;
+			return true;
+
+		case gps::TRACE_glUniform1i:
+			glUniform1i(location(objects, replay, a[0]), (GLint)a[1].integer);
+			return true;
+		case gps::TRACE_glUniform1f:
+			glUniform1f(location(objects, replay, a[0]), (GLfloat)a[1].real);
+			return true;
+		case gps::TRACE_glUniform2f:
+			glUniform2f(location(objects, replay, a[0]), (GLfloat)a[1].real, (GLfloat)a[2].real);
+			return true;
+		case gps::TRACE_glUniform3fv:
+			glUniform3fv(location(objects, replay, a[0]), (GLsizei)a[1].integer, (const GLfloat*)data);
+			return data != NULL;
+		case gps::TRACE_glUniform4fv:
+			glUniform4fv(location(objects, replay, a[0]), (GLsizei)a[1].integer, (const GLfloat*)data);
+			return data != NULL;
+		case gps::TRACE_glUniformMatrix3fv:
+			glUniformMatrix3fv(location(objects, replay, a[0]), (GLsizei)a[1].integer, (GLboolean)a[2].unsignedInteger, (const GLfloat*)data);
+			return data != NULL;
+		case gps::TRACE_glUniformMatrix4fv:
+			glUniformMatrix4fv(location(objects, replay, a[0]), (GLsizei)a[1].integer, (GLboolean)a[2].unsignedInteger, (const GLfloat*)data);
+			return data != NULL;
+
+		// index and indirect pointers are offsets into the bound buffers
+		case gps::TRACE_glDrawArrays:
+			glDrawArrays((GLenum)a[0].unsignedInteger, (GLint)a[1].integer, (GLsizei)a[2].integer);
+			return true;
+		case gps::TRACE_glDrawElements:
+			glDrawElements((GLenum)a[0].unsignedInteger, (GLsizei)a[1].integer, (GLenum)a[2].unsignedInteger, a[3].pointer);
+			return true;
+		case gps::TRACE_glDrawArraysInstanced:
+			glDrawArraysInstanced((GLenum)a[0].unsignedInteger, (GLint)a[1].integer, (GLsizei)a[2].integer, (GLsizei)a[3].integer);
+			return true;
+		case gps::TRACE_glDrawElementsInstanced:
+			glDrawElementsInstanced((GLenum)a[0].unsignedInteger, (GLsizei)a[1].integer, (GLenum)a[2].unsignedInteger,
+				a[3].pointer, (GLsizei)a[4].integer);
+			return true;
+#if !defined (__APPLE__)
+		case gps::TRACE_glMultiDrawElementsIndirect:
+			glMultiDrawElementsIndirect((GLenum)a[0].unsignedInteger, (GLenum)a[1].unsignedInteger, a[2].pointer,
+				(GLsizei)a[3].integer, (GLsizei)a[4].integer);
+			return true;
+#endif
+
+		case gps::TRACE_glViewport:
+			glViewport((GLint)a[0].integer, (GLint)a[1].integer, (GLsizei)a[2].integer, (GLsizei)a[3].integer);
+			return true;
+		case gps::TRACE_glClear:
+			glClear((GLbitfield)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glClearColor:
+			glClearColor((GLfloat)a[0].real, (GLfloat)a[1].real, (GLfloat)a[2].real, (GLfloat)a[3].real);
+			return true;
+		case gps::TRACE_glEnable:
+			glEnable((GLenum)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glDisable:
+			glDisable((GLenum)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glDepthFunc:
+			glDepthFunc((GLenum)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glDepthMask:
+			glDepthMask((GLboolean)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glBlendFunc:
+			glBlendFunc((GLenum)a[0].unsignedInteger, (GLenum)a[1].unsignedInteger);
+			return true;
+		case gps::TRACE_glCullFace:
+			glCullFace((GLenum)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glFrontFace:
+			glFrontFace((GLenum)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glPolygonMode:
+			glPolygonMode((GLenum)a[0].unsignedInteger, (GLenum)a[1].unsignedInteger);
+			return true;
+		case gps::TRACE_glPixelStorei:
+			glPixelStorei((GLenum)a[0].unsignedInteger, (GLint)a[1].integer);
+			return true;
+		case gps::TRACE_glTexParameteri:
+			glTexParameteri((GLenum)a[0].unsignedInteger, (GLenum)a[1].unsignedInteger, (GLint)a[2].integer);
+			return true;
+		case gps::TRACE_glSamplerParameteri:
+			glSamplerParameteri(lookup(objects.samplers, a[0].unsignedInteger), (GLenum)a[1].unsignedInteger, (GLint)a[2].integer);
+			return true;
+		case gps::TRACE_glDrawBuffer:
+			glDrawBuffer((GLenum)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glReadBuffer:
+			glReadBuffer((GLenum)a[0].unsignedInteger);
+			return true;
+
+		case gps::TRACE_glTexImage2D:
+			glTexImage2D((GLenum)a[0].unsignedInteger, (GLint)a[1].integer, (GLint)a[2].integer, (GLsizei)a[3].integer,
+				(GLsizei)a[4].integer, (GLint)a[5].integer, (GLenum)a[6].unsignedInteger, (GLenum)a[7].unsignedInteger, data);
+			return true;
+		case gps::TRACE_glTexSubImage2D:
+			if (data == NULL)
+				return false;
+			glTexSubImage2D((GLenum)a[0].unsignedInteger, (GLint)a[1].integer, (GLint)a[2].integer, (GLint)a[3].integer,
+				(GLsizei)a[4].integer, (GLsizei)a[5].integer, (GLenum)a[6].unsignedInteger, (GLenum)a[7].unsignedInteger, data);
+			return true;
+		case gps::TRACE_glTexImage3D:
+			glTexImage3D((GLenum)a[0].unsignedInteger, (GLint)a[1].integer, (GLint)a[2].integer, (GLsizei)a[3].integer,
+				(GLsizei)a[4].integer, (GLsizei)a[5].integer, (GLint)a[6].integer, (GLenum)a[7].unsignedInteger,
+				(GLenum)a[8].unsignedInteger, data);
+			return true;
+		case gps::TRACE_glTexSubImage3D:
+			if (data == NULL)
+				return false;
+			glTexSubImage3D((GLenum)a[0].unsignedInteger, (GLint)a[1].integer, (GLint)a[2].integer, (GLint)a[3].integer,
+				(GLint)a[4].integer, (GLsizei)a[5].integer, (GLsizei)a[6].integer, (GLsizei)a[7].integer,
+				(GLenum)a[8].unsignedInteger, (GLenum)a[9].unsignedInteger, data);
+			return true;
+		case gps::TRACE_glCompressedTexImage2D:
+			glCompressedTexImage2D((GLenum)a[0].unsignedInteger, (GLint)a[1].integer, (GLenum)a[2].unsignedInteger,
+				(GLsizei)a[3].integer, (GLsizei)a[4].integer, (GLint)a[5].integer, (GLsizei)call.data.size(), data);
+			return true;
+		case gps::TRACE_glCompressedTexSubImage2D:
+			if (data == NULL)
+				return false;
+			glCompressedTexSubImage2D((GLenum)a[0].unsignedInteger, (GLint)a[1].integer, (GLint)a[2].integer, (GLint)a[3].integer,
+				(GLsizei)a[4].integer, (GLsizei)a[5].integer, (GLenum)a[6].unsignedInteger, (GLsizei)call.data.size(), data);
+			return true;
+		case gps::TRACE_glGenerateMipmap:
+			glGenerateMipmap((GLenum)a[0].unsignedInteger);
+			return true;
+
+		case gps::TRACE_glVertexAttribPointer:
+			glVertexAttribPointer((GLuint)a[0].unsignedInteger, (GLint)a[1].integer, (GLenum)a[2].unsignedInteger,
+				(GLboolean)a[3].unsignedInteger, (GLsizei)a[4].integer, a[5].pointer);
+			return true;
+		case gps::TRACE_glVertexAttribIPointer:
+			glVertexAttribIPointer((GLuint)a[0].unsignedInteger, (GLint)a[1].integer, (GLenum)a[2].unsignedInteger,
+				(GLsizei)a[3].integer, a[4].pointer);
+			return true;
+		case gps::TRACE_glEnableVertexAttribArray:
+			glEnableVertexAttribArray((GLuint)a[0].unsignedInteger);
+			return true;
+		case gps::TRACE_glVertexAttribDivisor:
+			glVertexAttribDivisor((GLuint)a[0].unsignedInteger, (GLuint)a[1].unsignedInteger);
+			return true;
+
+		case gps::TRACE_glFinish:
+			glFinish();
+			return true;
+		case gps::TRACE_glFlush:
+			glFlush();
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	double percentile(std::vector<double> samples, double fraction) {
+
+		if (samples.empty())
+			return 0.0;
+		std::sort(samples.begin(), samples.end());
+		return samples[(size_t)(fraction * (samples.size() - 1) + 0.5)];
+	}
+
+	void printUsage() {
+		fprintf(stdout,
+			"usage: FrameReplay capture.gpsframe [options]\n"
+			"  --frames N           timed replays of the frame (default 200)\n"
+			"  --warmup N           replays before timing (default 10)\n"
+			"  --context egl|osmesa context of the replay, osmesa runs on llvmpipe without a GPU\n");
+	}
+}
+
+int main(int argc, const char* argv[]) {
+
+	const char* captureFile = NULL;
+	int frames = 200;
+	int warmupFrames = 10;
+	gps::WindowContextApi contextApi = gps::CONTEXT_API_NATIVE;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+			frames = std::max(atoi(argv[++i]), 1);
+		else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+			warmupFrames = std::max(atoi(argv[++i]), 0);
+		else if (strcmp(argv[i], "--context") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "egl") == 0)
+				contextApi = gps::CONTEXT_API_EGL;
+			else if (strcmp(argv[i], "osmesa") == 0)
+				contextApi = gps::CONTEXT_API_OSMESA;
+		}
+		else if (argv[i][0] != '-' && captureFile == NULL)
+			captureFile = argv[i];
+		else {
+			printUsage();
+			return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : 2;
+		}
+	}
+	if (captureFile == NULL) {
+		printUsage();
+		return 2;
+	}
+
+	gps::FrameCaptureData capture;
+	if (!gps::readFrameCapture(captureFile, capture))
+		return 2;
+
+	gps::Window window;
+	try {
+		window.Create(capture.width, capture.height, "Frame replay", false, contextApi);
+	}
+	catch (const std::exception& e) {
+		fprintf(stderr, "ERROR: %s\n", e.what());
+		return 2;
+	}
+
+	ReplayObjects objects;
+	createBuffers(capture, objects);
+	createTextures(capture, objects);
+	createSamplers(capture, objects);
+	createVertexArrays(capture, objects);
+	createFramebuffers(capture, objects);
+	if (!createPrograms(capture, objects)) {
+		window.Delete();
+		return 2;
+	}
+	glFinish();
+
+	ReplayState replay;
+	std::vector<unsigned int> skipped(gps::TRACE_ENTRY_COUNT + 1, 0);
+	std::vector<double> submitMs;
+	std::vector<double> frameMs;
+
+	for (int frame = 0; frame < warmupFrames + frames; frame++) {
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		applyState(capture.state, objects, replay);
+		for (size_t i = 0; i < capture.calls.size(); i++) {
+			bool replayed = replayCall(capture.calls[i], objects, replay);
+			if (frame == 0 && !replayed)
+				skipped[capture.calls[i].entry]++;
+		}
+		std::chrono::steady_clock::time_point submitted = std::chrono::steady_clock::now();
+		// the iterations must not overlap, each one is timed until the GPU is done with it
+		glFinish();
+		std::chrono::steady_clock::time_point finished = std::chrono::steady_clock::now();
+
+		if (frame >= warmupFrames) {
+			submitMs.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+			frameMs.push_back(std::chrono::duration<double, std::milli>(finished - start).count());
+		}
+	}
+
+	fprintf(stdout, "Calls left out of the replay:\n");
+	for (int entry = 0; entry <= gps::TRACE_ENTRY_COUNT; entry++) {
+		if (skipped[entry] > 0)
+			fprintf(stdout, "  %-28s %u\n", entry < gps::TRACE_ENTRY_COUNT ? gps::getTraceEntryName((gps::GLTraceEntry)entry) : "unknown",
+				skipped[entry]);
+	}
+
+	double submitTotal = 0.0;
+	double frameTotal = 0.0;
+	for (size_t i = 0; i < frameMs.size(); i++) {
+		submitTotal += submitMs[i];
+		frameTotal += frameMs[i];
+	}
+	fprintf(stdout, "Replayed %s %d times, %u calls per frame, %dx%d\n", captureFile, frames,
+		(unsigned int)capture.calls.size(), capture.width, capture.height);
+	fprintf(stdout, "  submit    min %8.3f  p50 %8.3f  p95 %8.3f  mean %8.3f ms\n", percentile(submitMs, 0.0),
+		percentile(submitMs, 0.5), percentile(submitMs, 0.95), submitTotal / submitMs.size());
+	fprintf(stdout, "  finished  min %8.3f  p50 %8.3f  p95 %8.3f  mean %8.3f ms\n", percentile(frameMs, 0.0),
+		percentile(frameMs, 0.5), percentile(frameMs, 0.95), frameTotal / frameMs.size());
+
+	window.Delete();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,173 @@
+#include "FrameRing.hpp"
+#include "GpuResources.hpp"
+#include "GLTrace.hpp"
+
+#include <stdio.h>
+
+namespace gps {
+
+	FrameRing::FrameRing() {
+
+		target = GL_UNIFORM_BUFFER;
+		buffer = 0;
+		frameSize = 0;
+		alignment = 1;
+		frameCount = 0;
+		currentFrame = 0;
+		headFrame = 0;
+		head = 0;
+		persistent = false;
+		persistentPointer = NULL;
+		mapped = false;
+	}
+
+	void FrameRing::init(GLenum target, GLsizeiptr frameSize) {
+
+		this->target = target;
+		this->owner = gpuResources().getOwner("frame ring");
+		this->frameCount = frameSync().getFramesInFlight();
+
+		GLint offsetAlignment = 16;
+		if (target == GL_UNIFORM_BUFFER)
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+#if !defined (__APPLE__)
+		else if (target == GL_SHADER_STORAGE_BUFFER)
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+#endif
+		alignment = offsetAlignment > 0 ? offsetAlignment : 16;
+
+#if defined (__APPLE__)
+		persistent = false;
+#else
+		persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+#endif
+
+		this->frameSize = alignedSize(frameSize);
+		currentFrame = frameSync().getFrameSlot();
+		headFrame = frameSync().getFrameCount();
+		head = 0;
+		createBuffer();
+	}
+
+	void FrameRing::createBuffer() {
+
+		GLsizeiptr totalSize = frameSize * frameCount;
+
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+
+#if !defined (__APPLE__)
+		if (persistent) {
+			// mapped once for the lifetime of the buffer, coherent so no explicit flush is needed
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, totalSize, NULL, flags);
+			persistentPointer = (char*)glMapBufferRange(target, 0, totalSize, flags);
+			if (persistentPointer == NULL) {
+				fprintf(stderr, "ERROR: could not map the frame ring persistently\n");
+				persistent = false;
+				glBindBuffer(target, 0);
+				glDeleteBuffers(1, &buffer);
+				glGenBuffers(1, &buffer);
+				glBindBuffer(target, buffer);
+			}
+		}
+#endif
+		if (!persistent)
+			glBufferData(target, totalSize, NULL, GL_STREAM_DRAW);
+
+		glBindBuffer(target, 0);
+		gpuResources().add(GPU_BUFFER, buffer, totalSize, target, owner, __FILE__, __LINE__);
+	}
+
+	void FrameRing::destroyBuffer() {
+
+		if (buffer == 0)
+			return;
+
+		if (persistent && persistentPointer != NULL) {
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			glBindBuffer(target, 0);
+		}
+		persistentPointer = NULL;
+
+		// the driver keeps the storage alive until the commands still reading it are done
+		glDeleteBuffers(1, &buffer);
+		gpuResources().remove(GPU_BUFFER, buffer);
+		buffer = 0;
+	}
+
+	void* FrameRing::map(GLsizeiptr size, GLintptr& offset) {
+
+		size = alignedSize(size);
+
+		// first allocation of a new frame, frameSync() already waited for the GPU to release its section
+		if (headFrame != frameSync().getFrameCount()) {
+			headFrame = frameSync().getFrameCount();
+			currentFrame = frameSync().getFrameSlot();
+			head = 0;
+		}
+
+		if (head + size > frameSize) {
+			// the section is full: replace the buffer with a bigger one, draws already
+			// issued this frame keep reading the old storage
+			GLsizeiptr newSize = frameSize;
+			while (newSize < size)
+				newSize *= 2;
+			newSize *= 2;
+
+			destroyBuffer();
+			frameSize = newSize;
+			createBuffer();
+			head = 0;
+		}
+
+		offset = (GLintptr)(frameSize * currentFrame + head);
+		head += size;
+
+		if (persistent)
+			return persistentPointer + offset;
+
+		// the fence of this section has already been waited on, the driver does not need to sync
+		glBindBuffer(target, buffer);
+		void* pointer = glMapBufferRange(target, offset, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		mapped = pointer != NULL;
+		if (!mapped)
+			fprintf(stderr, "ERROR: could not map %ld bytes of the frame ring\n", (long)size);
+		return pointer;
+	}
+
+	void FrameRing::unmap() {
+
+		if (!mapped)
+			return;
+
+		glBindBuffer(target, buffer);
+		glUnmapBuffer(target);
+		glBindBuffer(target, 0);
+		mapped = false;
+	}
+
+	GLsizeiptr FrameRing::alignedSize(GLsizeiptr size) const {
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+	GLuint FrameRing::getBuffer() const {
+		return buffer;
+	}
+
+	bool FrameRing::isPersistent() const {
+		return persistent;
+	}
+
+	bool FrameRing::isInitialized() const {
+		return buffer != 0;
+	}
+
+	void FrameRing::Delete() {
+
+		unmap();
+		destroyBuffer();
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef FrameRing_hpp
+#define FrameRing_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include "FrameSync.hpp"
+
+#include <string>
+
+namespace gps {
+
+    // Streaming buffer split in one section per frame in flight. Data is suballocated by bumping
+    // an offset in the section of the current frame slot of frameSync(), whose fences guard the sections
+    class FrameRing {
+
+    public:
+        FrameRing();
+
+        // frameSize is the starting size of a section, it grows when a frame asks for more
+        void init(GLenum target, GLsizeiptr frameSize);
+
+        // Reserves size bytes in the current section and returns where to write them,
+        // offset receives their position in the buffer. Must be followed by unmap before drawing
+        void* map(GLsizeiptr size, GLintptr& offset);
+        void unmap();
+
+        // Size of an element rounded up to the offset alignment of the target
+        GLsizeiptr alignedSize(GLsizeiptr size) const;
+
+        GLuint getBuffer() const;
+        // True when the buffer stays mapped (GL 4.4 / ARB_buffer_storage)
+        bool isPersistent() const;
+        bool isInitialized() const;
+
+        void Delete();
+
+    private:
+        GLenum target;
+        GLuint buffer;
+        GLsizeiptr frameSize;
+        GLsizeiptr alignment;
+        int frameCount;
+        int currentFrame;
+        // frame of frameSync() the head belongs to
+        unsigned int headFrame;
+        GLsizeiptr head;
+
+        bool persistent;
+        char* persistentPointer;
+        bool mapped;
+        // owner in the GPU resource registry, taken from the scopes open during init
+        std::string owner;
+
+        void createBuffer();
+        void destroyBuffer();
+    };
+}
+
+#endif /* FrameRing_hpp */
@@ -0,0 +1,104 @@
+#include "FrameSync.hpp"
+
+#include <stdio.h>
+#include <chrono>
+
+namespace gps {
+
+	// how long a single glClientWaitSync call may block, in nanoseconds
+	static const GLuint64 FENCE_WAIT_TIMEOUT = 1000000;
+
+	FrameSync::FrameSync() {
+
+		framesInFlight = 2;
+		slot = 0;
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+			fences[i] = 0;
+		lastWaitMs = 0.0;
+		totalWaitMs = 0.0;
+		frameCount = 0;
+	}
+
+	void FrameSync::setFramesInFlight(int frames) {
+
+		if (frameCount > 0) {
+			fprintf(stderr, "ERROR: frames in flight can only change before the first frame\n");
+			return;
+		}
+		framesInFlight = frames < 1 ? 1 : (frames > MAX_FRAMES_IN_FLIGHT ? MAX_FRAMES_IN_FLIGHT : frames);
+	}
+
+	int FrameSync::getFramesInFlight() const {
+		return framesInFlight;
+	}
+
+	void FrameSync::beginFrame() {
+
+		slot = (int)(frameCount % framesInFlight);
+		lastWaitMs = 0.0;
+
+		if (fences[slot] != 0) {
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			// only the first call flushes, the fence is already on its way after that
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			while (true) {
+				GLenum result = glClientWaitSync(fences[slot], flags, FENCE_WAIT_TIMEOUT);
+				if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+					break;
+				if (result == GL_WAIT_FAILED) {
+					fprintf(stderr, "ERROR: waiting on the frame fence failed\n");
+					break;
+				}
+				flags = 0;
+			}
+
+			glDeleteSync(fences[slot]);
+			fences[slot] = 0;
+
+			lastWaitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			totalWaitMs += lastWaitMs;
+		}
+	}
+
+	void FrameSync::endFrame() {
+
+		if (fences[slot] != 0)
+			glDeleteSync(fences[slot]);
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		frameCount++;
+	}
+
+	int FrameSync::getFrameSlot() const {
+		return slot;
+	}
+
+	double FrameSync::getLastWaitMs() const {
+		return lastWaitMs;
+	}
+
+	double FrameSync::getAverageWaitMs() const {
+		return frameCount > 0 ? totalWaitMs / frameCount : 0.0;
+	}
+
+	unsigned int FrameSync::getFrameCount() const {
+		return frameCount;
+	}
+
+	void FrameSync::Delete() {
+
+		for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+			if (fences[i] != 0) {
+				glDeleteSync(fences[i]);
+				fences[i] = 0;
+			}
+		}
+	}
+
+	FrameSync& frameSync() {
+
+		static FrameSync sync;
+		return sync;
+	}
+}
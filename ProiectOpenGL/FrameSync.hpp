@@ -0,0 +1,56 @@
+#ifndef FrameSync_hpp
+#define FrameSync_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+namespace gps {
+
+    // Lets the CPU record up to framesInFlight frames ahead of the GPU. Every frame gets a slot,
+    // the dynamic buffers keep one copy per slot and a fence tells when the GPU released it
+    class FrameSync {
+
+    public:
+        static const int MAX_FRAMES_IN_FLIGHT = 4;
+
+        FrameSync();
+
+        // Clamped to [1, MAX_FRAMES_IN_FLIGHT], only before the first frame
+        void setFramesInFlight(int frames);
+        int getFramesInFlight() const;
+
+        // Moves to the next slot, blocks until the GPU finished the frame that used it last
+        void beginFrame();
+        // Fences the commands of the frame, call after the last draw and before the swap
+        void endFrame();
+
+        // Slot of the current frame, in [0, getFramesInFlight())
+        int getFrameSlot() const;
+
+        // Time the CPU spent blocked in beginFrame, in milliseconds
+        double getLastWaitMs() const;
+        double getAverageWaitMs() const;
+        unsigned int getFrameCount() const;
+
+        void Delete();
+
+    private:
+        int framesInFlight;
+        int slot;
+        GLsync fences[MAX_FRAMES_IN_FLIGHT];
+
+        double lastWaitMs;
+        double totalWaitMs;
+        unsigned int frameCount;
+    };
+
+    // Synchronization of the frames of the application, shared by its dynamic buffers
+    FrameSync& frameSync();
+}
+
+#endif /* FrameSync_hpp */
@@ -0,0 +1,308 @@
+#include "GLState.hpp"
+#include "GLTrace.hpp"
+
+#include <stdio.h>
+
+namespace gps {
+
+	static const GLuint UNKNOWN_BINDING = 0xFFFFFFFF;
+
+	static const char* stateKindNames[STATE_KIND_COUNT] = {
+		"program", "vertex array", "texture", "sampler", "framebuffer", "viewport", "depth func", "polygon mode"
+	};
+
+	// Slot of a texture target in the cache, -1 for targets that are not shadowed
+	static int textureTargetIndex(GLenum target) {
+
+		switch (target) {
+		case GL_TEXTURE_2D:
+			return 0;
+		case GL_TEXTURE_CUBE_MAP:
+			return 1;
+		case GL_TEXTURE_2D_ARRAY:
+			return 2;
+		}
+		return -1;
+	}
+
+	GLuint GLStateCounters::totalIssued() const {
+
+		GLuint total = 0;
+		for (int i = 0; i < STATE_KIND_COUNT; i++)
+			total += issued[i];
+		return total;
+	}
+
+	GLuint GLStateCounters::totalElided() const {
+
+		GLuint total = 0;
+		for (int i = 0; i < STATE_KIND_COUNT; i++)
+			total += elided[i];
+		return total;
+	}
+
+	GLStateCache::GLStateCache() {
+
+		frameCounters = GLStateCounters();
+		lastFrameCounters = GLStateCounters();
+		invalidate();
+	}
+
+	void GLStateCache::invalidate() {
+
+		program = UNKNOWN_BINDING;
+		vertexArray = UNKNOWN_BINDING;
+		activeUnit = UNKNOWN_BINDING;
+		for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+			for (int target = 0; target < 3; target++)
+				textures[unit][target] = UNKNOWN_BINDING;
+			samplers[unit] = UNKNOWN_BINDING;
+		}
+		framebuffer = UNKNOWN_BINDING;
+		for (int i = 0; i < 4; i++)
+			viewportRect[i] = -1;
+		depthFunction = UNKNOWN_BINDING;
+		polygonRasterMode = UNKNOWN_BINDING;
+	}
+
+	bool GLStateCache::count(GLStateKind kind, bool changed) {
+
+		if (changed)
+			frameCounters.issued[kind]++;
+		else {
+			frameCounters.elided[kind]++;
+			validate(kind, activeUnit, GL_TEXTURE_2D);
+		}
+		return changed;
+	}
+
+	bool GLStateCache::useProgram(GLuint program) {
+
+		if (this->program == program)
+			return count(STATE_PROGRAM, false);
+
+		glUseProgram(program);
+		this->program = program;
+		return count(STATE_PROGRAM, true);
+	}
+
+	bool GLStateCache::bindVertexArray(GLuint vertexArray) {
+
+		if (this->vertexArray == vertexArray)
+			return count(STATE_VERTEX_ARRAY, false);
+
+		glBindVertexArray(vertexArray);
+		this->vertexArray = vertexArray;
+		return count(STATE_VERTEX_ARRAY, true);
+	}
+
+	bool GLStateCache::setActiveUnit(GLuint unit) {
+
+		if (activeUnit == unit)
+			return false;
+
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+		return true;
+	}
+
+	bool GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+
+		int targetIndex = textureTargetIndex(target);
+
+		if (unit < MAX_TEXTURE_UNITS && targetIndex != -1) {
+
+			if (textures[unit][targetIndex] == texture) {
+				frameCounters.elided[STATE_TEXTURE]++;
+				validate(STATE_TEXTURE, unit, target);
+				return false;
+			}
+			textures[unit][targetIndex] = texture;
+		}
+
+		setActiveUnit(unit);
+		glBindTexture(target, texture);
+		return count(STATE_TEXTURE, true);
+	}
+
+	bool GLStateCache::bindSampler(GLuint unit, GLuint sampler) {
+
+		if (unit < MAX_TEXTURE_UNITS) {
+
+			if (samplers[unit] == sampler) {
+				frameCounters.elided[STATE_SAMPLER]++;
+				validate(STATE_SAMPLER, unit, GL_NONE);
+				return false;
+			}
+			samplers[unit] = sampler;
+		}
+
+		glBindSampler(unit, sampler);
+		return count(STATE_SAMPLER, true);
+	}
+
+	bool GLStateCache::bindFramebuffer(GLuint framebuffer) {
+
+		if (this->framebuffer == framebuffer)
+			return count(STATE_FRAMEBUFFER, false);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		this->framebuffer = framebuffer;
+		return count(STATE_FRAMEBUFFER, true);
+	}
+
+	bool GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+
+		if (viewportRect[0] == x && viewportRect[1] == y && viewportRect[2] == width && viewportRect[3] == height)
+			return count(STATE_VIEWPORT, false);
+
+		glViewport(x, y, width, height);
+		viewportRect[0] = x;
+		viewportRect[1] = y;
+		viewportRect[2] = width;
+		viewportRect[3] = height;
+		return count(STATE_VIEWPORT, true);
+	}
+
+	bool GLStateCache::depthFunc(GLenum func) {
+
+		if (depthFunction == func)
+			return count(STATE_DEPTH_FUNC, false);
+
+		glDepthFunc(func);
+		depthFunction = func;
+		return count(STATE_DEPTH_FUNC, true);
+	}
+
+	bool GLStateCache::polygonMode(GLenum mode) {
+
+		if (polygonRasterMode == mode)
+			return count(STATE_POLYGON_MODE, false);
+
+		glPolygonMode(GL_FRONT_AND_BACK, mode);
+		polygonRasterMode = mode;
+		return count(STATE_POLYGON_MODE, true);
+	}
+
+	GLenum GLStateCache::getPolygonMode() const {
+		return polygonRasterMode == UNKNOWN_BINDING ? GL_NONE : polygonRasterMode;
+	}
+
+	void GLStateCache::deleteTexture(GLuint texture) {
+
+		for (int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+			for (int target = 0; target < 3; target++) {
+				if (textures[unit][target] == texture)
+					textures[unit][target] = 0;
+			}
+		}
+		glDeleteTextures(1, &texture);
+	}
+
+	void GLStateCache::deleteVertexArray(GLuint vertexArray) {
+
+		if (this->vertexArray == vertexArray)
+			this->vertexArray = 0;
+		glDeleteVertexArrays(1, &vertexArray);
+	}
+
+	void GLStateCache::deleteFramebuffer(GLuint framebuffer) {
+
+		if (this->framebuffer == framebuffer)
+			this->framebuffer = 0;
+		glDeleteFramebuffers(1, &framebuffer);
+	}
+
+	void GLStateCache::deleteProgram(GLuint program) {
+
+		// a program in use stays alive until another one replaces it, the cache stays valid
+		glDeleteProgram(program);
+	}
+
+	void GLStateCache::beginFrame() {
+
+		lastFrameCounters = frameCounters;
+		frameCounters = GLStateCounters();
+	}
+
+	GLStateCounters GLStateCache::getFrameCounters() const {
+		return lastFrameCounters;
+	}
+
+	const char* GLStateCache::getKindName(GLStateKind kind) const {
+		return stateKindNames[kind];
+	}
+
+	void GLStateCache::validate(GLStateKind kind, GLuint unit, GLenum target) {
+
+#ifndef NDEBUG
+		GLint actual[4] = { 0, 0, 0, 0 };
+		GLint expected[4] = { 0, 0, 0, 0 };
+		int valueCount = 1;
+
+		switch (kind) {
+		case STATE_PROGRAM:
+			glGetIntegerv(GL_CURRENT_PROGRAM, actual);
+			expected[0] = (GLint)program;
+			break;
+		case STATE_VERTEX_ARRAY:
+			glGetIntegerv(GL_VERTEX_ARRAY_BINDING, actual);
+			expected[0] = (GLint)vertexArray;
+			break;
+		case STATE_TEXTURE:
+		case STATE_SAMPLER: {
+			// bindings are queried on the active unit, switching it here would change the state we check
+			GLint active = 0;
+			glGetIntegerv(GL_ACTIVE_TEXTURE, &active);
+			if ((GLuint)active != GL_TEXTURE0 + unit)
+				return;
+			if (kind == STATE_SAMPLER) {
+				glGetIntegerv(GL_SAMPLER_BINDING, actual);
+				expected[0] = (GLint)samplers[unit];
+			}
+			else {
+				GLenum bindingQuery = target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_BINDING_CUBE_MAP :
+					target == GL_TEXTURE_2D_ARRAY ? GL_TEXTURE_BINDING_2D_ARRAY : GL_TEXTURE_BINDING_2D;
+				glGetIntegerv(bindingQuery, actual);
+				expected[0] = (GLint)textures[unit][textureTargetIndex(target)];
+			}
+			break;
+		}
+		case STATE_FRAMEBUFFER:
+			glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, actual);
+			expected[0] = (GLint)framebuffer;
+			break;
+		case STATE_VIEWPORT:
+			glGetIntegerv(GL_VIEWPORT, actual);
+			for (int i = 0; i < 4; i++)
+				expected[i] = viewportRect[i];
+			valueCount = 4;
+			break;
+		case STATE_DEPTH_FUNC:
+			glGetIntegerv(GL_DEPTH_FUNC, actual);
+			expected[0] = (GLint)depthFunction;
+			break;
+		default:
+			// polygon mode cannot be queried on every core profile
+			return;
+		}
+
+		for (int i = 0; i < valueCount; i++) {
+
+			if (actual[i] != expected[i]) {
+				fprintf(stderr, "ERROR: GL state cache out of sync on %s (GL has %d, cache has %d)\n",
+					getKindName(kind), actual[i], expected[i]);
+				// something bypassed the cache, stop trusting it
+				invalidate();
+				return;
+			}
+		}
+#endif
+	}
+
+	GLStateCache& glState() {
+
+		static GLStateCache cache;
+		return cache;
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef GLState_hpp
+#define GLState_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+namespace gps {
+
+    enum GLStateKind {
+        STATE_PROGRAM = 0,
+        STATE_VERTEX_ARRAY,
+        STATE_TEXTURE,
+        STATE_SAMPLER,
+        STATE_FRAMEBUFFER,
+        STATE_VIEWPORT,
+        STATE_DEPTH_FUNC,
+        STATE_POLYGON_MODE,
+        STATE_KIND_COUNT
+    };
+
+    struct GLStateCounters {
+        // calls forwarded to GL
+        GLuint issued[STATE_KIND_COUNT];
+        // calls skipped because they would not have changed anything
+        GLuint elided[STATE_KIND_COUNT];
+
+        GLuint totalIssued() const;
+        GLuint totalElided() const;
+    };
+
+    // Shadow copy of the GL bindings the engine changes, every bind should go through it.
+    // The bind functions return true when the call reached GL.
+    class GLStateCache {
+
+    public:
+        static const int MAX_TEXTURE_UNITS = 16;
+
+        GLStateCache();
+
+        // Forgets everything, the next call of every kind reaches GL
+        void invalidate();
+
+        bool useProgram(GLuint program);
+        bool bindVertexArray(GLuint vertexArray);
+        bool bindTexture(GLuint unit, GLenum target, GLuint texture);
+        bool bindSampler(GLuint unit, GLuint sampler);
+        bool bindFramebuffer(GLuint framebuffer);
+        bool viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+        bool depthFunc(GLenum func);
+        bool polygonMode(GLenum mode);
+        // Last mode set through the cache, GL_NONE before the first one
+        GLenum getPolygonMode() const;
+
+        // Deleting a bound object resets its binding to 0, so deletions go through the cache too
+        void deleteTexture(GLuint texture);
+        void deleteVertexArray(GLuint vertexArray);
+        void deleteFramebuffer(GLuint framebuffer);
+        void deleteProgram(GLuint program);
+
+        // Closes the counters of the previous frame
+        void beginFrame();
+        GLStateCounters getFrameCounters() const;
+
+        const char* getKindName(GLStateKind kind) const;
+
+    private:
+        GLuint program;
+        GLuint vertexArray;
+        GLuint activeUnit;
+        // bound textures per unit, for the 2D, cube map and 2D array targets
+        GLuint textures[MAX_TEXTURE_UNITS][3];
+        GLuint samplers[MAX_TEXTURE_UNITS];
+        GLuint framebuffer;
+        GLint viewportRect[4];
+        GLenum depthFunction;
+        GLenum polygonRasterMode;
+
+        GLStateCounters frameCounters;
+        GLStateCounters lastFrameCounters;
+
+        bool setActiveUnit(GLuint unit);
+        bool count(GLStateKind kind, bool changed);
+        // Builds without NDEBUG check that an elided call really matched the GL state
+        void validate(GLStateKind kind, GLuint unit, GLenum target);
+    };
+
+    // The cache of the current context
+    GLStateCache& glState();
+}
+
+#endif /* GLState_hpp */
@@ -0,0 +1,526 @@
+#define GPS_GL_TRACE_IMPLEMENTATION
+#include "GLTrace.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace gps {
+
+	static const std::chrono::steady_clock::time_point traceStart = std::chrono::steady_clock::now();
+
+	static const char* entryNames[TRACE_ENTRY_COUNT] = {
+#define GPS_GL_TRACE_NAME(name) "gl" #name,
+		GPS_GL_TRACE_GLEW_FUNCTIONS(GPS_GL_TRACE_NAME)
+		GPS_GL_TRACE_CORE_FUNCTIONS(GPS_GL_TRACE_NAME)
+#undef GPS_GL_TRACE_NAME
+	};
+
+	static double traceNow() {
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - traceStart).count();
+	}
+
+	const char* getTraceEntryName(GLTraceEntry entry) {
+		return entry >= 0 && entry < TRACE_ENTRY_COUNT ? entryNames[entry] : "unknown";
+	}
+
+	GLuint64 getTracePixelSize(GLuint64 format, GLuint64 type) {
+
+		GLuint64 channels = 4;
+		switch (format) {
+		case GL_RED:
+		case GL_DEPTH_COMPONENT:
+			channels = 1;
+			break;
+		case GL_RG:
+			channels = 2;
+			break;
+		case GL_RGB:
+		case GL_BGR:
+			channels = 3;
+			break;
+		}
+
+		switch (type) {
+		case GL_UNSIGNED_BYTE:
+		case GL_BYTE:
+			return channels;
+		case GL_UNSIGNED_SHORT:
+		case GL_SHORT:
+		case GL_HALF_FLOAT:
+			return channels * 2;
+		case GL_UNSIGNED_INT:
+		case GL_INT:
+		case GL_FLOAT:
+			return channels * 4;
+		}
+		return 4;
+	}
+
+	unsigned int GLTraceReport::totalRedundant() const {
+
+		unsigned int total = 0;
+		for (int i = 0; i < TRACE_ENTRY_COUNT; i++)
+			total += redundant[i];
+		return total;
+	}
+
+	unsigned int GLTraceReport::totalSync() const {
+
+		unsigned int total = 0;
+		for (int i = 0; i < TRACE_ENTRY_COUNT; i++)
+			total += sync[i];
+		return total;
+	}
+
+	GLTrace::GLTrace() {
+
+		installed = false;
+		inFrame = false;
+		observer = NULL;
+		frameIndex = 0;
+		activeUnit = GL_TEXTURE0;
+		resetReport(current);
+		resetReport(last);
+	}
+
+#if !defined (__APPLE__)
+	template <GLTraceEntry Entry, typename Function>
+	static void installHook(Function& pointer) {
+
+		// entry points the context does not have stay NULL
+		if (pointer == NULL)
+			return;
+		GLTraceHook<Entry, Function>::real = pointer;
+		pointer = &GLTraceHook<Entry, Function>::call;
+	}
+
+	static void GLAPIENTRY debugMessageCallback(GLenum, GLenum type, GLuint id, GLenum,
+		GLsizei, const GLchar* message, const void*) {
+
+		if (type == GL_DEBUG_TYPE_PERFORMANCE || type == GL_DEBUG_TYPE_ERROR)
+			glTrace().addMessage(id, type, message);
+	}
+#endif
+
+	void GLTrace::install() {
+
+		if (installed)
+			return;
+
+#if !defined (__APPLE__)
+#define GPS_GL_TRACE_INSTALL(name) installHook<TRACE_gl##name>(__glew##name);
+		GPS_GL_TRACE_GLEW_FUNCTIONS(GPS_GL_TRACE_INSTALL)
+#undef GPS_GL_TRACE_INSTALL
+
+		// messages arrive on the thread and in the frame of the call that caused them
+		if (GLEW_KHR_debug || GLEW_VERSION_4_3) {
+			glEnable(GL_DEBUG_OUTPUT);
+			glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+			glDebugMessageCallback(debugMessageCallback, NULL);
+			glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+		}
+		else
+			fprintf(stdout, "KHR_debug is not available, the GL trace has no driver messages\n");
+#else
+		// no GLEW pointers to swap, only the GL 1.1 calls of files that include GLTrace.hpp are traced
+		fprintf(stdout, "The GL trace only sees GL 1.1 calls on macOS\n");
+#endif
+		installed = true;
+	}
+
+	bool GLTrace::isInstalled() const {
+		return installed;
+	}
+
+	void GLTrace::beginFrame() {
+
+		if (!installed)
+			return;
+		if (observer != NULL)
+			observer->frameBegin();
+		calls.clear();
+		resetReport(current);
+		current.frame = frameIndex;
+		inFrame = true;
+	}
+
+	void GLTrace::endFrame() {
+
+		if (!inFrame)
+			return;
+		inFrame = false;
+
+		for (std::map<std::pair<GLuint, std::string>, LookupHistory>::iterator it = lookups.begin(); it != lookups.end(); ++it) {
+
+			LookupHistory& history = it->second;
+			if (history.thisFrame > 1 || (history.thisFrame > 0 && history.earlierFrames)) {
+				GLTraceLookup lookup;
+				lookup.program = it->first.first;
+				lookup.name = it->first.second;
+				lookup.count = history.thisFrame;
+				current.repeatedLookups.push_back(lookup);
+			}
+			if (history.thisFrame > 0)
+				history.earlierFrames = true;
+			history.thisFrame = 0;
+		}
+		std::sort(current.repeatedLookups.begin(), current.repeatedLookups.end(),
+			[](const GLTraceLookup& a, const GLTraceLookup& b) { return a.count > b.count; });
+
+		for (std::map<GLuint, GLTraceMessage>::const_iterator it = messages.begin(); it != messages.end(); ++it)
+			current.messages.push_back(it->second);
+		messages.clear();
+
+		last = current;
+		lastCalls.swap(calls);
+		frameIndex++;
+
+		if (observer != NULL)
+			observer->frameEnd();
+	}
+
+	bool GLTrace::isRecording() const {
+		return inFrame;
+	}
+
+	void GLTrace::setObserver(GLTraceObserver* observer) {
+		this->observer = observer;
+	}
+
+	void GLTrace::resetReport(GLTraceReport& report) {
+
+		report.frame = 0;
+		report.totalCalls = 0;
+		report.totalCpuMs = 0.0;
+		for (int i = 0; i < TRACE_ENTRY_COUNT; i++) {
+			report.calls[i] = 0;
+			report.cpuMs[i] = 0.0;
+			report.redundant[i] = 0;
+			report.sync[i] = 0;
+		}
+		report.repeatedLookups.clear();
+		report.largestUploads.clear();
+		report.messages.clear();
+	}
+
+	void GLTrace::record(const GLTraceCall& call) {
+
+		if (calls.size() < MAX_CALLS_PER_FRAME)
+			calls.push_back(call);
+
+		current.totalCalls++;
+		current.totalCpuMs += call.cpuUs / 1000.0;
+		current.calls[call.entry]++;
+		current.cpuMs[call.entry] += call.cpuUs / 1000.0;
+		analyze(call);
+		if (observer != NULL)
+			observer->call(call);
+	}
+
+	void GLTrace::addMessage(GLuint id, GLenum type, const char* text) {
+
+		std::map<GLuint, GLTraceMessage>::iterator it = messages.find(id);
+		if (it != messages.end()) {
+			it->second.count++;
+			return;
+		}
+
+		GLTraceMessage& message = messages[id];
+		message.id = id;
+		message.type = type;
+		message.count = 1;
+		message.text = text != NULL ? text : "";
+	}
+
+	bool GLTrace::isRedundantBind(GLTraceEntry entry, GLuint64 target, GLuint64 a, GLuint64 b, GLuint64 c) {
+
+		GLuint64 key = ((GLuint64)entry << 48) | (target & 0xFFFFFFFFFFFFull);
+		std::map<GLuint64, Binding>::iterator it = bindings.find(key);
+		if (it != bindings.end() && it->second.values[0] == a && it->second.values[1] == b && it->second.values[2] == c)
+			return true;
+
+		Binding& binding = bindings[key];
+		binding.values[0] = a;
+		binding.values[1] = b;
+		binding.values[2] = c;
+		return false;
+	}
+
+	void GLTrace::analyze(const GLTraceCall& call) {
+
+		const GLTraceArgument* a = call.arguments;
+		bool redundant = false;
+		bool sync = false;
+
+		switch (call.entry) {
+		case TRACE_glUseProgram:
+			redundant = isRedundantBind(call.entry, 0, a[0].unsignedInteger);
+			break;
+		case TRACE_glBindVertexArray:
+			redundant = isRedundantBind(call.entry, 0, a[0].unsignedInteger);
+			// the element array binding belongs to the vertex array
+			if (!redundant)
+				bindings.erase(((GLuint64)TRACE_glBindBuffer << 48) | GL_ELEMENT_ARRAY_BUFFER);
+			break;
+		case TRACE_glBindBuffer:
+		case TRACE_glBindFramebuffer:
+		case TRACE_glBindSampler:
+			redundant = isRedundantBind(call.entry, a[0].unsignedInteger, a[1].unsignedInteger);
+			break;
+		case TRACE_glBindBufferRange:
+			redundant = isRedundantBind(call.entry, (a[0].unsignedInteger << 32) | a[1].unsignedInteger,
+				a[2].unsignedInteger, a[3].unsignedInteger, a[4].unsignedInteger);
+			// also binds the buffer to the generic target
+			isRedundantBind(TRACE_glBindBuffer, a[0].unsignedInteger, a[2].unsignedInteger);
+			break;
+		case TRACE_glBindBufferBase:
+			// the whole buffer, the same binding point as a range with offset and size 0
+			redundant = isRedundantBind(TRACE_glBindBufferRange, (a[0].unsignedInteger << 32) | a[1].unsignedInteger,
+				a[2].unsignedInteger, 0, 0);
+			isRedundantBind(TRACE_glBindBuffer, a[0].unsignedInteger, a[2].unsignedInteger);
+			break;
+		case TRACE_glActiveTexture:
+			redundant = a[0].unsignedInteger == activeUnit;
+			activeUnit = (GLuint)a[0].unsignedInteger;
+			break;
+		case TRACE_glBindTexture:
+			redundant = isRedundantBind(call.entry, ((GLuint64)activeUnit << 32) | a[0].unsignedInteger, a[1].unsignedInteger);
+			break;
+		case TRACE_glEnable:
+			redundant = isRedundantBind(TRACE_glEnable, a[0].unsignedInteger, 1);
+			break;
+		case TRACE_glDisable:
+			redundant = isRedundantBind(TRACE_glEnable, a[0].unsignedInteger, 0);
+			break;
+		case TRACE_glBlendFunc:
+		case TRACE_glCullFace:
+		case TRACE_glDepthFunc:
+		case TRACE_glDepthMask:
+		case TRACE_glFrontFace:
+		case TRACE_glPolygonMode:
+			redundant = isRedundantBind(call.entry, 0, a[0].unsignedInteger, call.argumentCount > 1 ? a[1].unsignedInteger : 0);
+			break;
+		case TRACE_glViewport:
+			redundant = isRedundantBind(call.entry, 0, (a[0].unsignedInteger << 32) | (a[1].unsignedInteger & 0xFFFFFFFFull),
+				a[2].unsignedInteger, a[3].unsignedInteger);
+			break;
+
+		// a deleted object unbinds itself, the next bind of anything is not redundant
+		case TRACE_glDeleteBuffers:
+		case TRACE_glDeleteFramebuffers:
+		case TRACE_glDeleteProgram:
+		case TRACE_glDeleteTextures:
+		case TRACE_glDeleteVertexArrays:
+			bindings.clear();
+			break;
+
+		case TRACE_glGetUniformLocation:
+		case TRACE_glGetUniformBlockIndex:
+			if (a[1].pointer != NULL)
+				lookups[std::make_pair((GLuint)a[0].unsignedInteger, std::string((const char*)a[1].pointer))].thisFrame++;
+			break;
+
+		case TRACE_glMapBufferRange:
+			sync = (a[3].unsignedInteger & GL_MAP_UNSYNCHRONIZED_BIT) == 0;
+			break;
+		case TRACE_glCheckFramebufferStatus:
+		case TRACE_glClientWaitSync:
+		case TRACE_glFinish:
+		case TRACE_glGetBooleanv:
+		case TRACE_glGetBufferSubData:
+		case TRACE_glGetCompressedTexImage:
+		case TRACE_glGetError:
+		case TRACE_glGetFloatv:
+		case TRACE_glGetInteger64v:
+		case TRACE_glGetIntegerv:
+		case TRACE_glGetProgramiv:
+		case TRACE_glGetQueryObjectui64v:
+		case TRACE_glGetQueryObjectuiv:
+		case TRACE_glGetShaderiv:
+		case TRACE_glGetTexImage:
+		case TRACE_glReadPixels:
+			sync = true;
+			break;
+
+		case TRACE_glBufferData:
+		case TRACE_glBufferStorage:
+			addUpload(call.entry, a[1].unsignedInteger);
+			break;
+		case TRACE_glBufferSubData:
+			addUpload(call.entry, a[2].unsignedInteger);
+			break;
+		case TRACE_glTexImage2D:
+			// without pixels it only allocates
+			if (a[8].pointer != NULL)
+				addUpload(call.entry, a[3].unsignedInteger * a[4].unsignedInteger * getTracePixelSize(a[6].unsignedInteger, a[7].unsignedInteger));
+			break;
+		case TRACE_glTexSubImage2D:
+			addUpload(call.entry, a[4].unsignedInteger * a[5].unsignedInteger * getTracePixelSize(a[6].unsignedInteger, a[7].unsignedInteger));
+			break;
+		case TRACE_glTexImage3D:
+			if (a[9].pointer != NULL)
+				addUpload(call.entry, a[3].unsignedInteger * a[4].unsignedInteger * a[5].unsignedInteger *
+					getTracePixelSize(a[7].unsignedInteger, a[8].unsignedInteger));
+			break;
+		case TRACE_glTexSubImage3D:
+			addUpload(call.entry, a[5].unsignedInteger * a[6].unsignedInteger * a[7].unsignedInteger *
+				getTracePixelSize(a[8].unsignedInteger, a[9].unsignedInteger));
+			break;
+		case TRACE_glCompressedTexImage2D:
+			addUpload(call.entry, a[6].unsignedInteger);
+			break;
+		case TRACE_glCompressedTexSubImage2D:
+		case TRACE_glCompressedTexImage3D:
+			addUpload(call.entry, a[7].unsignedInteger);
+			break;
+
+		default:
+			break;
+		}
+
+		if (redundant)
+			current.redundant[call.entry]++;
+		if (sync)
+			current.sync[call.entry]++;
+	}
+
+	void GLTrace::addUpload(GLTraceEntry entry, GLuint64 bytes) {
+
+		std::vector<GLTraceUpload>& uploads = current.largestUploads;
+		if (uploads.size() == GLTraceReport::LARGEST_UPLOADS && bytes <= uploads.back().bytes)
+			return;
+
+		GLTraceUpload upload;
+		upload.entry = entry;
+		upload.bytes = bytes;
+		std::vector<GLTraceUpload>::iterator position = uploads.begin();
+		while (position != uploads.end() && position->bytes >= bytes)
+			++position;
+		uploads.insert(position, upload);
+		if (uploads.size() > GLTraceReport::LARGEST_UPLOADS)
+			uploads.pop_back();
+	}
+
+	const GLTraceReport& GLTrace::getLastReport() const {
+		return last;
+	}
+
+	void GLTrace::printReport(FILE* file) const {
+
+		const GLTraceReport& report = last;
+		fprintf(file, "GL trace of frame %u: %u calls, %.3f ms CPU, %u redundant, %u sync points\n",
+			report.frame, report.totalCalls, report.totalCpuMs, report.totalRedundant(), report.totalSync());
+
+		std::vector<int> entries;
+		for (int i = 0; i < TRACE_ENTRY_COUNT; i++) {
+			if (report.calls[i] > 0)
+				entries.push_back(i);
+		}
+		std::sort(entries.begin(), entries.end(), [&report](int a, int b) { return report.calls[a] > report.calls[b]; });
+
+		fprintf(file, "  %-28s %7s %9s %9s %5s\n", "entry point", "calls", "cpu ms", "redundant", "sync");
+		for (size_t i = 0; i < entries.size(); i++) {
+			int entry = entries[i];
+			fprintf(file, "  %-28s %7u %9.3f %9u %5u\n", entryNames[entry], report.calls[entry], report.cpuMs[entry],
+				report.redundant[entry], report.sync[entry]);
+		}
+
+		if (!report.repeatedLookups.empty()) {
+			fprintf(file, "  Uniform lookups that could be cached:\n");
+			for (size_t i = 0; i < report.repeatedLookups.size(); i++) {
+				const GLTraceLookup& lookup = report.repeatedLookups[i];
+				fprintf(file, "    program %u \"%s\" x%u\n", lookup.program, lookup.name.c_str(), lookup.count);
+			}
+		}
+
+		if (!report.largestUploads.empty()) {
+			fprintf(file, "  Largest uploads:\n");
+			for (size_t i = 0; i < report.largestUploads.size(); i++) {
+				const GLTraceUpload& upload = report.largestUploads[i];
+				fprintf(file, "    %-24s %10.1f KB\n", entryNames[upload.entry], upload.bytes / 1024.0);
+			}
+		}
+
+		if (!report.messages.empty()) {
+			fprintf(file, "  Driver messages:\n");
+			for (size_t i = 0; i < report.messages.size(); i++) {
+				const GLTraceMessage& message = report.messages[i];
+				fprintf(file, "    [%s %u] x%u %s\n", message.type == GL_DEBUG_TYPE_ERROR ? "error" : "performance",
+					message.id, message.count, message.text.c_str());
+			}
+		}
+	}
+
+	bool GLTrace::writeFrame(const char* fileName) const {
+
+		FILE* file = fopen(fileName, "w");
+		if (file == NULL) {
+			fprintf(stderr, "ERROR: could not write the GL trace to %s\n", fileName);
+			return false;
+		}
+
+		printReport(file);
+		fprintf(file, "\nCalls (%u kept):\n", (unsigned int)lastCalls.size());
+		for (size_t i = 0; i < lastCalls.size(); i++) {
+
+			const GLTraceCall& call = lastCalls[i];
+			fprintf(file, "%9.3f us  %s(", call.cpuUs, entryNames[call.entry]);
+			for (int argument = 0; argument < call.argumentCount; argument++) {
+
+				const GLTraceArgument& value = call.arguments[argument];
+				const char* separator = argument == 0 ? "" : ", ";
+				switch (value.kind) {
+				case 'i':
+					fprintf(file, "%s%lld", separator, (long long)value.integer);
+					break;
+				case 'f':
+					fprintf(file, "%s%g", separator, value.real);
+					break;
+				case 'p':
+					fprintf(file, "%s%p", separator, value.pointer);
+					break;
+				default:
+					// unsigned values from 0x100 up are mostly enums and bit masks
+					if (value.unsignedInteger >= 0x100)
+						fprintf(file, "%s0x%llx", separator, (unsigned long long)value.unsignedInteger);
+					else
+						fprintf(file, "%s%llu", separator, (unsigned long long)value.unsignedInteger);
+					break;
+				}
+			}
+			fprintf(file, ")\n");
+		}
+
+		fclose(file);
+		fprintf(stdout, "GL trace of frame %u written to %s\n", last.frame, fileName);
+		return true;
+	}
+
+	GLTrace& glTrace() {
+
+		static GLTrace instance;
+		return instance;
+	}
+
+	GLTraceCallScope::GLTraceCallScope(GLTraceEntry entry, std::initializer_list<GLTraceArgument> arguments) {
+
+		recording = glTrace().isRecording();
+		if (!recording)
+			return;
+
+		call.entry = entry;
+		call.argumentCount = 0;
+		for (std::initializer_list<GLTraceArgument>::const_iterator it = arguments.begin();
+			it != arguments.end() && call.argumentCount < GLTraceCall::MAX_ARGUMENTS; ++it)
+			call.arguments[call.argumentCount++] = *it;
+		start = traceNow();
+	}
+
+	GLTraceCallScope::~GLTraceCallScope() {
+
+		if (!recording)
+			return;
+		call.cpuUs = traceNow() - start;
+		glTrace().record(call);
+	}
+}
@@ -0,0 +1,332 @@
+#ifndef GLTrace_hpp
+#define GLTrace_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#if !defined (GLAPIENTRY)
+    #define GLAPIENTRY
+#endif
+
+#include <cstdio>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Every entry point the application calls is in one of the two lists, calls missing from them are not
+// traced. grep -ohE "\bgl[A-Z]\w*\(" *.cpp | sort -u lists what the sources call.
+// Entry points reached through GLEW function pointers, the trace swaps the pointers for wrappers
+#define GPS_GL_TRACE_GLEW_FUNCTIONS(X) \
+    X(ActiveTexture) X(AttachShader) X(BindBuffer) X(BindBufferBase) X(BindBufferRange) X(BindFramebuffer) \
+    X(BindSampler) X(BindVertexArray) X(BufferData) X(BufferStorage) X(BufferSubData) \
+    X(CheckFramebufferStatus) X(ClientWaitSync) X(CompileShader) X(CompressedTexImage2D) \
+    X(CompressedTexImage3D) X(CompressedTexSubImage2D) X(CopyBufferSubData) X(CopyImageSubData) X(CreateProgram) X(CreateShader) \
+    X(DeleteBuffers) X(DeleteFramebuffers) X(DeleteProgram) X(DeleteQueries) X(DeleteShader) X(DeleteSync) \
+    X(DeleteVertexArrays) X(DrawArraysInstanced) X(DrawElementsInstanced) X(EnableVertexAttribArray) \
+    X(FenceSync) X(FramebufferTexture2D) X(GenBuffers) X(GenFramebuffers) X(GenQueries) X(GenVertexArrays) \
+    X(GenerateMipmap) X(GetActiveAttrib) X(GetActiveUniform) X(GetActiveUniformBlockName) \
+    X(GetActiveUniformBlockiv) X(GetActiveUniformsiv) X(GetAttachedShaders) X(GetAttribLocation) \
+    X(GetBufferParameteri64v) X(GetBufferParameteriv) X(GetBufferSubData) X(GetCompressedTexImage) \
+    X(GetFramebufferAttachmentParameteriv) X(GetInteger64v) X(GetInternalformativ) X(GetProgramInfoLog) \
+    X(GetProgramiv) X(GetQueryObjectui64v) X(GetQueryObjectuiv) X(GetSamplerParameterfv) \
+    X(GetSamplerParameteriv) X(GetShaderInfoLog) X(GetShaderSource) X(GetShaderiv) X(GetUniformBlockIndex) \
+    X(GetUniformLocation) X(GetUniformfv) X(GetUniformiv) X(GetUniformuiv) X(GetVertexAttribPointerv) \
+    X(GetVertexAttribiv) X(IsBuffer) X(IsFramebuffer) X(IsProgram) X(IsSampler) X(IsVertexArray) \
+    X(LinkProgram) X(MapBufferRange) X(MultiDrawElementsIndirect) X(QueryCounter) X(SamplerParameteri) \
+    X(ShaderSource) X(TexImage3D) X(TexPageCommitmentARB) X(TexStorage2D) X(TexStorage3D) X(TexSubImage3D) \
+    X(Uniform1f) X(Uniform1i) X(Uniform2f) X(Uniform3fv) X(Uniform4fv) X(UniformBlockBinding) \
+    X(UniformMatrix3fv) X(UniformMatrix4fv) X(UnmapBuffer) X(UseProgram) X(VertexAttribDivisor) \
+    X(VertexAttribIPointer) X(VertexAttribPointer)
+
+// GL 1.1 entry points are exported by the GL library itself, GLEW has no pointer for them.
+// Files that include this header reach them through macros instead, see the end of the file
+#define GPS_GL_TRACE_CORE_FUNCTIONS(X) \
+    X(BindTexture) X(BlendFunc) X(Clear) X(ClearColor) X(CullFace) X(DeleteTextures) X(DepthFunc) X(DepthMask) \
+    X(Disable) X(DrawArrays) X(DrawBuffer) X(DrawElements) X(Enable) X(Finish) X(Flush) X(FrontFace) \
+    X(GenTextures) X(GetBooleanv) X(GetError) X(GetFloatv) X(GetIntegerv) X(GetString) X(GetTexImage) \
+    X(GetTexLevelParameteriv) X(GetTexParameterfv) X(GetTexParameteriv) X(IsEnabled) X(IsTexture) \
+    X(PixelStorei) X(PolygonMode) X(ReadBuffer) X(ReadPixels) X(TexImage2D) X(TexParameterfv) X(TexParameteri) \
+    X(TexSubImage2D) X(Viewport)
+
+namespace gps {
+
+    enum GLTraceEntry {
+#define GPS_GL_TRACE_ENUM(name) TRACE_gl##name,
+        GPS_GL_TRACE_GLEW_FUNCTIONS(GPS_GL_TRACE_ENUM)
+        GPS_GL_TRACE_CORE_FUNCTIONS(GPS_GL_TRACE_ENUM)
+#undef GPS_GL_TRACE_ENUM
+        TRACE_ENTRY_COUNT
+    };
+
+    const char* getTraceEntryName(GLTraceEntry entry);
+    // Bytes per pixel of an uncompressed upload, packed types count as one channel
+    GLuint64 getTracePixelSize(GLuint64 format, GLuint64 type);
+
+    // One argument of a traced call, kind is 'i' (signed), 'u' (unsigned), 'f' (floating point) or 'p' (pointer)
+    struct GLTraceArgument {
+        char kind;
+        union {
+            GLint64 integer;
+            GLuint64 unsignedInteger;
+            double real;
+            const void* pointer;
+        };
+    };
+
+    struct GLTraceCall {
+        static const int MAX_ARGUMENTS = 11;
+
+        GLTraceEntry entry;
+        int argumentCount;
+        GLTraceArgument arguments[MAX_ARGUMENTS];
+        double cpuUs;
+    };
+
+    struct GLTraceUpload {
+        GLTraceEntry entry;
+        GLuint64 bytes;
+    };
+
+    struct GLTraceLookup {
+        GLuint program;
+        std::string name;
+        unsigned int count;
+    };
+
+    // KHR_debug message of the driver, repeats of the same id are counted once
+    struct GLTraceMessage {
+        GLuint id;
+        GLenum type;
+        unsigned int count;
+        std::string text;
+    };
+
+    struct GLTraceReport {
+        static const int LARGEST_UPLOADS = 5;
+
+        unsigned int frame;
+        unsigned int totalCalls;
+        double totalCpuMs;
+        unsigned int calls[TRACE_ENTRY_COUNT];
+        double cpuMs[TRACE_ENTRY_COUNT];
+        // binds and state changes that set what was already set
+        unsigned int redundant[TRACE_ENTRY_COUNT];
+        // calls that may wait for the GPU or the driver thread
+        unsigned int sync[TRACE_ENTRY_COUNT];
+        // uniform and block lookups of a program and name that was already looked up
+        std::vector<GLTraceLookup> repeatedLookups;
+        std::vector<GLTraceUpload> largestUploads;
+        std::vector<GLTraceMessage> messages;
+
+        unsigned int totalRedundant() const;
+        unsigned int totalSync() const;
+    };
+
+    // Sees the calls of every traced frame, FrameCapture uses it to serialize one
+    class GLTraceObserver {
+
+    public:
+        virtual ~GLTraceObserver() {}
+
+        // Called just outside the frame, the GL calls made here are not traced
+        virtual void frameBegin() = 0;
+        virtual void frameEnd() = 0;
+        // Called right after the call returned, its pointer arguments are still valid
+        virtual void call(const GLTraceCall& call) = 0;
+    };
+
+    // Records every GL call of a frame with its arguments and CPU time, and turns each frame into a
+    // report: calls per entry point, redundant binds, repeated uniform lookups, sync points, the
+    // largest uploads and the KHR_debug performance messages of the driver.
+    // Calls only reach it in builds with GPS_GL_TRACING defined, it costs two clock reads per call
+    class GLTrace {
+
+    public:
+        // calls kept for the call list, the counters of the report go on past it
+        static const size_t MAX_CALLS_PER_FRAME = 1 << 16;
+
+        GLTrace();
+
+        // Swaps the GLEW pointers for the tracing wrappers and routes KHR_debug messages into the
+        // report, call once after glewInit
+        void install();
+        bool isInstalled() const;
+
+        void beginFrame();
+        void endFrame();
+        bool isRecording() const;
+        // NULL detaches the observer
+        void setObserver(GLTraceObserver* observer);
+
+        // Called by the wrappers
+        void record(const GLTraceCall& call);
+        void addMessage(GLuint id, GLenum type, const char* text);
+
+        const GLTraceReport& getLastReport() const;
+        void printReport(FILE* file) const;
+        // The report and every call of the last frame
+        bool writeFrame(const char* fileName) const;
+
+    private:
+        struct Binding {
+            GLuint64 values[3];
+        };
+
+        struct LookupHistory {
+            unsigned int thisFrame;
+            bool earlierFrames;
+        };
+
+        bool installed;
+        bool inFrame;
+        GLTraceObserver* observer;
+        unsigned int frameIndex;
+
+        std::vector<GLTraceCall> calls;
+        std::vector<GLTraceCall> lastCalls;
+        GLTraceReport current;
+        GLTraceReport last;
+
+        // what the traced calls bound so far, by entry point and target
+        std::map<GLuint64, Binding> bindings;
+        GLuint activeUnit;
+        std::map<std::pair<GLuint, std::string>, LookupHistory> lookups;
+        std::map<GLuint, GLTraceMessage> messages;
+
+        void resetReport(GLTraceReport& report);
+        bool isRedundantBind(GLTraceEntry entry, GLuint64 target, GLuint64 a, GLuint64 b = 0, GLuint64 c = 0);
+        void analyze(const GLTraceCall& call);
+        void addUpload(GLTraceEntry entry, GLuint64 bytes);
+    };
+
+    GLTrace& glTrace();
+
+    template <typename T>
+    inline GLTraceArgument traceArgument(T* value) {
+        GLTraceArgument argument;
+        argument.kind = 'p';
+        argument.pointer = value;
+        return argument;
+    }
+
+    inline GLTraceArgument traceArgument(double value) {
+        GLTraceArgument argument;
+        argument.kind = 'f';
+        argument.real = value;
+        return argument;
+    }
+
+    inline GLTraceArgument traceArgument(float value) {
+        return traceArgument((double)value);
+    }
+
+    template <typename T>
+    inline GLTraceArgument traceArgument(T value) {
+        static_assert(std::is_integral<T>::value, "GL arguments are integers, floats or pointers");
+        GLTraceArgument argument;
+        argument.kind = std::is_signed<T>::value ? 'i' : 'u';
+        argument.integer = (GLint64)value;
+        return argument;
+    }
+
+    // Times one call and hands it to the trace when it returns
+    class GLTraceCallScope {
+
+    public:
+        GLTraceCallScope(GLTraceEntry entry, std::initializer_list<GLTraceArgument> arguments);
+        ~GLTraceCallScope();
+
+    private:
+        GLTraceCall call;
+        bool recording;
+        double start;
+    };
+
+    // Keeps the arguments of traceCall out of the deduction, the call site converts them to the
+    // parameter types like a direct call would (NULL to a pointer, int to GLenum)
+    template <typename T>
+    struct GLTraceParameter {
+        typedef T type;
+    };
+
+    template <typename R, typename... P>
+    inline R traceCall(GLTraceEntry entry, R (GLAPIENTRY* function)(P...), typename GLTraceParameter<P>::type... arguments) {
+        GLTraceCallScope scope(entry, { traceArgument(arguments)... });
+        return function(arguments...);
+    }
+
+    // Wrapper that replaces the GLEW pointer of one entry point
+    template <GLTraceEntry Entry, typename Function>
+    struct GLTraceHook;
+
+    template <GLTraceEntry Entry, typename R, typename... P>
+    struct GLTraceHook<Entry, R (GLAPIENTRY*)(P...)> {
+        static R (GLAPIENTRY* real)(P...);
+
+        static R GLAPIENTRY call(P... arguments) {
+            return traceCall(Entry, real, arguments...);
+        }
+    };
+
+    template <GLTraceEntry Entry, typename R, typename... P>
+    R (GLAPIENTRY* GLTraceHook<Entry, R (GLAPIENTRY*)(P...)>::real)(P...) = NULL;
+}
+
+// Build with GPS_GL_TRACING defined to trace, without it the macros expand to nothing and GL is called directly
+#ifdef GPS_GL_TRACING
+    #define GPS_GL_TRACE_BEGIN_FRAME() gps::glTrace().beginFrame()
+    #define GPS_GL_TRACE_END_FRAME() gps::glTrace().endFrame()
+
+    #ifndef GPS_GL_TRACE_IMPLEMENTATION
+        #define glBindTexture(...) gps::traceCall(gps::TRACE_glBindTexture, &::glBindTexture, __VA_ARGS__)
+        #define glBlendFunc(...) gps::traceCall(gps::TRACE_glBlendFunc, &::glBlendFunc, __VA_ARGS__)
+        #define glClear(...) gps::traceCall(gps::TRACE_glClear, &::glClear, __VA_ARGS__)
+        #define glClearColor(...) gps::traceCall(gps::TRACE_glClearColor, &::glClearColor, __VA_ARGS__)
+        #define glCullFace(...) gps::traceCall(gps::TRACE_glCullFace, &::glCullFace, __VA_ARGS__)
+        #define glDeleteTextures(...) gps::traceCall(gps::TRACE_glDeleteTextures, &::glDeleteTextures, __VA_ARGS__)
+        #define glDepthFunc(...) gps::traceCall(gps::TRACE_glDepthFunc, &::glDepthFunc, __VA_ARGS__)
+        #define glDepthMask(...) gps::traceCall(gps::TRACE_glDepthMask, &::glDepthMask, __VA_ARGS__)
+        #define glDisable(...) gps::traceCall(gps::TRACE_glDisable, &::glDisable, __VA_ARGS__)
+        #define glDrawArrays(...) gps::traceCall(gps::TRACE_glDrawArrays, &::glDrawArrays, __VA_ARGS__)
+        #define glDrawBuffer(...) gps::traceCall(gps::TRACE_glDrawBuffer, &::glDrawBuffer, __VA_ARGS__)
+        #define glDrawElements(...) gps::traceCall(gps::TRACE_glDrawElements, &::glDrawElements, __VA_ARGS__)
+        #define glEnable(...) gps::traceCall(gps::TRACE_glEnable, &::glEnable, __VA_ARGS__)
+        #define glFinish() gps::traceCall(gps::TRACE_glFinish, &::glFinish)
+        #define glFlush() gps::traceCall(gps::TRACE_glFlush, &::glFlush)
+        #define glFrontFace(...) gps::traceCall(gps::TRACE_glFrontFace, &::glFrontFace, __VA_ARGS__)
+        #define glGenTextures(...) gps::traceCall(gps::TRACE_glGenTextures, &::glGenTextures, __VA_ARGS__)
+        #define glGetBooleanv(...) gps::traceCall(gps::TRACE_glGetBooleanv, &::glGetBooleanv, __VA_ARGS__)
+        #define glGetError() gps::traceCall(gps::TRACE_glGetError, &::glGetError)
+        #define glGetFloatv(...) gps::traceCall(gps::TRACE_glGetFloatv, &::glGetFloatv, __VA_ARGS__)
+        #define glGetIntegerv(...) gps::traceCall(gps::TRACE_glGetIntegerv, &::glGetIntegerv, __VA_ARGS__)
+        #define glGetString(...) gps::traceCall(gps::TRACE_glGetString, &::glGetString, __VA_ARGS__)
+        #define glGetTexImage(...) gps::traceCall(gps::TRACE_glGetTexImage, &::glGetTexImage, __VA_ARGS__)
+        #define glGetTexLevelParameteriv(...) gps::traceCall(gps::TRACE_glGetTexLevelParameteriv, &::glGetTexLevelParameteriv, __VA_ARGS__)
+        #define glGetTexParameterfv(...) gps::traceCall(gps::TRACE_glGetTexParameterfv, &::glGetTexParameterfv, __VA_ARGS__)
+        #define glGetTexParameteriv(...) gps::traceCall(gps::TRACE_glGetTexParameteriv, &::glGetTexParameteriv, __VA_ARGS__)
+        #define glIsEnabled(...) gps::traceCall(gps::TRACE_glIsEnabled, &::glIsEnabled, __VA_ARGS__)
+        #define glIsTexture(...) gps::traceCall(gps::TRACE_glIsTexture, &::glIsTexture, __VA_ARGS__)
+        #define glPixelStorei(...) gps::traceCall(gps::TRACE_glPixelStorei, &::glPixelStorei, __VA_ARGS__)
+        #define glPolygonMode(...) gps::traceCall(gps::TRACE_glPolygonMode, &::glPolygonMode, __VA_ARGS__)
+        #define glReadBuffer(...) gps::traceCall(gps::TRACE_glReadBuffer, &::glReadBuffer, __VA_ARGS__)
+        #define glReadPixels(...) gps::traceCall(gps::TRACE_glReadPixels, &::glReadPixels, __VA_ARGS__)
+        #define glTexImage2D(...) gps::traceCall(gps::TRACE_glTexImage2D, &::glTexImage2D, __VA_ARGS__)
+        #define glTexParameterfv(...) gps::traceCall(gps::TRACE_glTexParameterfv, &::glTexParameterfv, __VA_ARGS__)
+        #define glTexParameteri(...) gps::traceCall(gps::TRACE_glTexParameteri, &::glTexParameteri, __VA_ARGS__)
+        #define glTexSubImage2D(...) gps::traceCall(gps::TRACE_glTexSubImage2D, &::glTexSubImage2D, __VA_ARGS__)
+        #define glViewport(...) gps::traceCall(gps::TRACE_glViewport, &::glViewport, __VA_ARGS__)
+    #endif
+#else
+    #define GPS_GL_TRACE_BEGIN_FRAME() ((void)0)
+    #define GPS_GL_TRACE_END_FRAME() ((void)0)
+#endif
+
+#endif /* GLTrace_hpp */
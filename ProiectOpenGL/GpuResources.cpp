@@ -0,0 +1,287 @@
+#include "GpuResources.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace gps {
+
+	static const char* kindNames[GPU_RESOURCE_KIND_COUNT] = { "textures", "buffers", "vertex arrays", "framebuffers" };
+
+	static double toMB(GLuint64 bytes) {
+		return bytes / (1024.0 * 1024.0);
+	}
+
+	// __FILE__ is a full path with some compilers
+	static const char* baseName(const char* file) {
+
+		const char* slash = strrchr(file, '/');
+		const char* backslash = strrchr(file, '\\');
+		const char* last = slash > backslash ? slash : backslash;
+		return last != NULL ? last + 1 : file;
+	}
+
+	static const char* formatName(GLenum format) {
+
+		switch (format) {
+		case GL_R8: return "R8";
+		case GL_RG8: return "RG8";
+		case GL_RGB: return "RGB";
+		case GL_RGB8: return "RGB8";
+		case GL_RGBA: return "RGBA";
+		case GL_RGBA8: return "RGBA8";
+		case GL_SRGB: return "SRGB";
+		case GL_SRGB8: return "SRGB8";
+		case GL_SRGB8_ALPHA8: return "SRGB8_ALPHA8";
+		case GL_RGBA16F: return "RGBA16F";
+		case GL_DEPTH_COMPONENT: return "DEPTH";
+		case GL_DEPTH_COMPONENT24: return "DEPTH24";
+		case GL_DEPTH_COMPONENT32F: return "DEPTH32F";
+		case GL_ARRAY_BUFFER: return "vertices";
+		case GL_ELEMENT_ARRAY_BUFFER: return "indices";
+		case GL_UNIFORM_BUFFER: return "uniforms";
+#if !defined (__APPLE__)
+		case GL_SHADER_STORAGE_BUFFER: return "storage";
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: return "SRGB_BC1";
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: return "SRGB_BC3";
+		case GL_COMPRESSED_RED_RGTC1: return "BC4";
+		case GL_COMPRESSED_RG_RGTC2: return "BC5";
+#endif
+		case GL_DRAW_INDIRECT_BUFFER: return "indirect";
+		default: return "-";
+		}
+	}
+
+	// Bytes per texel, three channel formats are stored as four
+	static GLuint64 texelSize(GLenum internalFormat) {
+
+		switch (internalFormat) {
+		case GL_R8:
+		case GL_RED:
+			return 1;
+		case GL_RG8:
+		case GL_RG:
+		case GL_DEPTH_COMPONENT16:
+			return 2;
+		case GL_RGBA16F:
+		case GL_RG32F:
+			return 8;
+		case GL_RGBA32F:
+			return 16;
+		default:
+			return 4;
+		}
+	}
+
+	// Bytes per 4x4 block of the compressed formats, 0 for the others
+	static GLuint64 blockSize(GLenum internalFormat) {
+
+		switch (internalFormat) {
+#if !defined (__APPLE__)
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_RED_RGTC1:
+			return 8;
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RG_RGTC2:
+			return 16;
+#endif
+		default:
+			return 0;
+		}
+	}
+
+	GLint getMipLevels(GLint width, GLint height) {
+
+		GLint levels = 1;
+		while (width > 1 || height > 1) {
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+			levels++;
+		}
+		return levels;
+	}
+
+	GLuint64 getTextureBytes(GLenum internalFormat, GLint width, GLint height, GLint depth, GLint levels) {
+
+		GLuint64 bytes = 0;
+		GLuint64 block = blockSize(internalFormat);
+		for (GLint level = 0; level < levels; level++) {
+			if (block != 0)
+				bytes += (GLuint64)((width + 3) / 4) * ((height + 3) / 4) * depth * block;
+			else
+				bytes += (GLuint64)width * height * depth * texelSize(internalFormat);
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+		}
+		return bytes;
+	}
+
+	GpuResourceRegistry::GpuResourceRegistry() {
+
+		for (int i = 0; i < GPU_RESOURCE_KIND_COUNT; i++)
+			totals[i] = 0;
+		budget = 0;
+		overBudget = false;
+	}
+
+	void GpuResourceRegistry::add(GpuResourceKind kind, GLuint name, GLuint64 bytes, GLenum format, const std::string& owner,
+		const char* file, int line) {
+
+		if (name == 0)
+			return;
+
+		std::pair<int, GLuint> key = std::make_pair((int)kind, name);
+		std::map<std::pair<int, GLuint>, GpuResource>::iterator it = resources.find(key);
+		if (it != resources.end())
+			totals[kind] -= it->second.bytes;
+
+		GpuResource& resource = resources[key];
+		resource.kind = kind;
+		resource.name = name;
+		resource.bytes = bytes;
+		resource.format = format;
+		resource.owner = owner;
+		resource.file = baseName(file);
+		resource.line = line;
+		totals[kind] += bytes;
+
+		checkBudget(resource);
+	}
+
+	void GpuResourceRegistry::remove(GpuResourceKind kind, GLuint name) {
+
+		std::map<std::pair<int, GLuint>, GpuResource>::iterator it = resources.find(std::make_pair((int)kind, name));
+		if (it == resources.end())
+			return;
+
+		totals[kind] -= it->second.bytes;
+		resources.erase(it);
+		if (overBudget && getTotalBytes() <= budget)
+			overBudget = false;
+	}
+
+	void GpuResourceRegistry::checkBudget(const GpuResource& resource) {
+
+		if (budget == 0 || overBudget || getTotalBytes() <= budget)
+			return;
+
+		// once per crossing, it warns again after the total went back under the budget
+		overBudget = true;
+		fprintf(stderr, "WARNING: GPU memory is %.1f MB, over the %.1f MB budget, after %.1f MB for %s (%s:%d)\n",
+			toMB(getTotalBytes()), toMB(budget), toMB(resource.bytes), resource.owner.c_str(), resource.file, resource.line);
+	}
+
+	void GpuResourceRegistry::pushOwner(const std::string& owner) {
+		owners.push_back(owner);
+	}
+
+	void GpuResourceRegistry::popOwner() {
+		if (!owners.empty())
+			owners.pop_back();
+	}
+
+	std::string GpuResourceRegistry::getOwner(const char* label) const {
+
+		std::string owner;
+		for (size_t i = 0; i < owners.size(); i++)
+			owner += owners[i] + "/";
+		return owner + label;
+	}
+
+	void GpuResourceRegistry::setBudget(GLuint64 bytes) {
+
+		budget = bytes;
+		overBudget = false;
+		if (!resources.empty() && budget > 0 && getTotalBytes() > budget) {
+			overBudget = true;
+			fprintf(stderr, "WARNING: GPU memory is %.1f MB, already over the %.1f MB budget\n", toMB(getTotalBytes()), toMB(budget));
+		}
+	}
+
+	GLuint64 GpuResourceRegistry::getBudget() const {
+		return budget;
+	}
+
+	GLuint64 GpuResourceRegistry::getTotalBytes() const {
+
+		GLuint64 total = 0;
+		for (int i = 0; i < GPU_RESOURCE_KIND_COUNT; i++)
+			total += totals[i];
+		return total;
+	}
+
+	GLuint64 GpuResourceRegistry::getBytes(GpuResourceKind kind) const {
+		return totals[kind];
+	}
+
+	size_t GpuResourceRegistry::getCount() const {
+		return resources.size();
+	}
+
+	void GpuResourceRegistry::printReport(FILE* file) const {
+
+		fprintf(file, "GPU memory: %.1f MB in %u objects", toMB(getTotalBytes()), (unsigned int)resources.size());
+		if (budget > 0)
+			fprintf(file, ", budget %.1f MB", toMB(budget));
+		fprintf(file, "\n");
+
+		unsigned int counts[GPU_RESOURCE_KIND_COUNT] = {};
+		// owners without the label of the object, "models/dodge.obj/mesh" counts for "models/dodge.obj"
+		std::map<std::string, GLuint64> ownerBytes;
+		std::vector<const GpuResource*> largest;
+		for (std::map<std::pair<int, GLuint>, GpuResource>::const_iterator it = resources.begin(); it != resources.end(); ++it) {
+			const GpuResource& resource = it->second;
+			counts[resource.kind]++;
+			size_t slash = resource.owner.find_last_of('/');
+			ownerBytes[slash != std::string::npos ? resource.owner.substr(0, slash) : resource.owner] += resource.bytes;
+			largest.push_back(&resource);
+		}
+
+		for (int i = 0; i < GPU_RESOURCE_KIND_COUNT; i++)
+			fprintf(file, "  %-16s %6u  %9.2f MB\n", kindNames[i], counts[i], toMB(totals[i]));
+
+		std::vector<std::pair<GLuint64, std::string> > byOwner;
+		for (std::map<std::string, GLuint64>::const_iterator it = ownerBytes.begin(); it != ownerBytes.end(); ++it)
+			byOwner.push_back(std::make_pair(it->second, it->first));
+		std::sort(byOwner.rbegin(), byOwner.rend());
+		fprintf(file, "  by owner:\n");
+		for (size_t i = 0; i < byOwner.size(); i++)
+			fprintf(file, "    %-40s %9.2f MB\n", byOwner[i].second.c_str(), toMB(byOwner[i].first));
+
+		const size_t LARGEST = 5;
+		size_t shown = std::min(largest.size(), LARGEST);
+		std::partial_sort(largest.begin(), largest.begin() + shown, largest.end(),
+			[](const GpuResource* a, const GpuResource* b) { return a->bytes > b->bytes; });
+		fprintf(file, "  largest:\n");
+		for (size_t i = 0; i < shown; i++)
+			fprintf(file, "    %9.2f MB  %-12s %-40s %s:%d\n", toMB(largest[i]->bytes), formatName(largest[i]->format),
+				largest[i]->owner.c_str(), largest[i]->file, largest[i]->line);
+	}
+
+	size_t GpuResourceRegistry::reportLeaks(FILE* file) const {
+
+		if (resources.empty())
+			return 0;
+
+		fprintf(file, "ERROR: %u GL objects were not deleted, %.1f MB\n", (unsigned int)resources.size(), toMB(getTotalBytes()));
+		for (std::map<std::pair<int, GLuint>, GpuResource>::const_iterator it = resources.begin(); it != resources.end(); ++it) {
+			const GpuResource& resource = it->second;
+			fprintf(file, "  %-14s %5u  %9.2f MB  %-40s %s:%d\n", kindNames[resource.kind], resource.name, toMB(resource.bytes),
+				resource.owner.c_str(), resource.file, resource.line);
+		}
+		return resources.size();
+	}
+
+	GpuResourceRegistry& gpuResources() {
+
+		static GpuResourceRegistry instance;
+		return instance;
+	}
+
+	GpuOwnerScope::GpuOwnerScope(const std::string& owner) {
+		gpuResources().pushOwner(owner);
+	}
+
+	GpuOwnerScope::~GpuOwnerScope() {
+		gpuResources().popOwner();
+	}
+}
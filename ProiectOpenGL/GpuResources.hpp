@@ -0,0 +1,102 @@
+#ifndef GpuResources_hpp
+#define GpuResources_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    enum GpuResourceKind {
+        GPU_TEXTURE,
+        GPU_BUFFER,
+        GPU_VERTEX_ARRAY,
+        GPU_FRAMEBUFFER,
+        GPU_RESOURCE_KIND_COUNT
+    };
+
+    // One live GL object. Sizes are what the object needs, drivers may round them up
+    struct GpuResource {
+        GpuResourceKind kind;
+        GLuint name;
+        GLuint64 bytes;
+        // internal format of textures, target of buffers
+        GLenum format;
+        // scopes that were open when it was created, then its own label: "models/dodge.obj/mesh"
+        std::string owner;
+        const char* file;
+        int line;
+    };
+
+    // Record of every texture, buffer, vertex array and framebuffer the application creates.
+    // Reports the totals by kind and by owner, warns when the total goes over the budget and
+    // lists whatever is still alive at shutdown
+    class GpuResourceRegistry {
+
+    public:
+        GpuResourceRegistry();
+
+        // Registering a name again replaces it, buffers that are specified again only change size
+        void add(GpuResourceKind kind, GLuint name, GLuint64 bytes, GLenum format, const std::string& owner,
+            const char* file, int line);
+        void remove(GpuResourceKind kind, GLuint name);
+
+        // Owner scopes, every resource created while one is open is grouped under it
+        void pushOwner(const std::string& owner);
+        void popOwner();
+        // Open scopes followed by label
+        std::string getOwner(const char* label) const;
+
+        // 0 disables the warning
+        void setBudget(GLuint64 bytes);
+        GLuint64 getBudget() const;
+
+        GLuint64 getTotalBytes() const;
+        GLuint64 getBytes(GpuResourceKind kind) const;
+        size_t getCount() const;
+
+        void printReport(FILE* file) const;
+        // Lists the resources nobody deleted, returns how many there are
+        size_t reportLeaks(FILE* file) const;
+
+    private:
+        std::map<std::pair<int, GLuint>, GpuResource> resources;
+        std::vector<std::string> owners;
+        GLuint64 totals[GPU_RESOURCE_KIND_COUNT];
+        GLuint64 budget;
+        bool overBudget;
+
+        void checkBudget(const GpuResource& resource);
+    };
+
+    GpuResourceRegistry& gpuResources();
+
+    // Bytes of a texture with the given levels, layers count as depth. Unknown formats count 4 bytes
+    // per texel, three channel formats too since drivers pad them
+    GLuint64 getTextureBytes(GLenum internalFormat, GLint width, GLint height, GLint depth, GLint levels);
+    // Levels of a full mip chain
+    GLint getMipLevels(GLint width, GLint height);
+
+    // Groups the resources created until the end of the enclosing block under owner
+    class GpuOwnerScope {
+
+    public:
+        GpuOwnerScope(const std::string& owner);
+        ~GpuOwnerScope();
+    };
+}
+
+// Registers a resource under the open owner scopes, with the file and line that created it
+#define GPS_GPU_RESOURCE(kind, name, bytes, format, label) \
+    gps::gpuResources().add(kind, name, bytes, format, gps::gpuResources().getOwner(label), __FILE__, __LINE__)
+
+#endif /* GpuResources_hpp */
@@ -0,0 +1,432 @@
+#include "Hud.hpp"
+#include "GpuResources.hpp"
+#include "GLTrace.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdio.h>
+
+namespace gps {
+
+	// the atlas holds printable ASCII in 8x8 cells, 16 per row
+	static const int ATLAS_COLUMNS = 16;
+	static const int ATLAS_ROWS = 6;
+	static const int CELL_SIZE = 8;
+	static const int ATLAS_WIDTH = ATLAS_COLUMNS * CELL_SIZE;
+	static const int ATLAS_HEIGHT = ATLAS_ROWS * CELL_SIZE;
+	static const int GLYPH_WIDTH = 5;
+	static const int GLYPH_HEIGHT = 7;
+	// the cell of DEL is filled, rectangles sample it
+	static const int SOLID_CELL = 127 - 32;
+
+	static const GLuint FONT_TEXTURE_UNIT = 4;
+	// the panel is rebuilt every frame, a few hundred quads
+	static const GLsizeiptr INSTANCE_FRAME_SIZE = 512 * sizeof(HudQuad);
+	static const int MEMORY_QUERY_INTERVAL = 30;
+
+	// graph scale, a bar reaches the top at 30 fps
+	static const float GRAPH_MAX_MS = 33.3f;
+	static const float TARGET_FRAME_MS = 1000.0f / 60.0f;
+
+	struct Glyph {
+		char character;
+		// one row per byte, top to bottom, bit 4 is the left column
+		unsigned char rows[GLYPH_HEIGHT];
+	};
+
+	// 5x7 font, lower case letters are drawn with the upper case glyphs
+	static const Glyph glyphs[] = {
+		{ '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+		{ '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+		{ '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+		{ '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+		{ '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+		{ '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+		{ '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+		{ '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+		{ '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+		{ 'A', { 0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+		{ 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+		{ 'C', { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E } },
+		{ 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+		{ 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+		{ 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+		{ 'G', { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F } },
+		{ 'H', { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+		{ 'I', { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C } },
+		{ 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+		{ 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F } },
+		{ 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+		{ 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+		{ 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+		{ 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+		{ 'Q', { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D } },
+		{ 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+		{ 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+		{ 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+		{ 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+		{ 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+		{ 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+		{ 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+		{ 'Y', { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 } },
+		{ 'Z', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F } },
+		{ '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+		{ ',', { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 } },
+		{ ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+		{ '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+		{ '%', { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 } },
+		{ '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+		{ '(', { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 } },
+		{ ')', { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 } }
+	};
+
+	static const glm::vec4 panelColor(0.0f, 0.0f, 0.0f, 0.6f);
+	static const glm::vec4 textColor(1.0f, 1.0f, 1.0f, 1.0f);
+	static const glm::vec4 labelColor(0.6f, 0.8f, 1.0f, 1.0f);
+	static const glm::vec4 goodColor(0.3f, 0.9f, 0.3f, 1.0f);
+	static const glm::vec4 slowColor(1.0f, 0.4f, 0.2f, 1.0f);
+
+	static glm::vec4 cellRect(int cell, float width, float height) {
+
+		float u = (float)(cell % ATLAS_COLUMNS * CELL_SIZE) / ATLAS_WIDTH;
+		float v = (float)(cell / ATLAS_COLUMNS * CELL_SIZE) / ATLAS_HEIGHT;
+		return glm::vec4(u, v, u + width / ATLAS_WIDTH, v + height / ATLAS_HEIGHT);
+	}
+
+	Hud::Hud() {
+
+		visible = false;
+		screenSizeLoc = -1;
+		fontTexture = 0;
+		vao = 0;
+		quadVBO = 0;
+		for (int i = 0; i < FRAME_HISTORY; i++)
+			frameTimes[i] = 0.0f;
+		frameCursor = 0;
+		frameTimeCount = 0;
+		totalMemoryMB = -1;
+		availableMemoryMB = -1;
+		memoryQueryCountdown = 0;
+	}
+
+	void Hud::init() {
+
+		GpuOwnerScope owner("hud");
+		shader.loadShader("shaders/hud.vert", "shaders/hud.frag");
+		shader.useShaderProgram();
+		screenSizeLoc = glGetUniformLocation(shader.getProgram(), "screenSize");
+		glUniform1i(glGetUniformLocation(shader.getProgram(), "fontAtlas"), FONT_TEXTURE_UNIT);
+
+		bakeFont();
+
+		// triangle strip over the unit square, the instances scale and move it
+		const GLfloat corners[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &quadVBO);
+		glState().bindVertexArray(vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		GPS_GPU_RESOURCE(GPU_VERTEX_ARRAY, vao, 0, GL_NONE, "quad");
+		GPS_GPU_RESOURCE(GPU_BUFFER, quadVBO, sizeof(corners), GL_ARRAY_BUFFER, "quad");
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
+
+		for (GLuint attribute = 1; attribute <= 3; attribute++) {
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribDivisor(attribute, 1);
+		}
+
+		glState().bindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		instanceRing.init(GL_ARRAY_BUFFER, INSTANCE_FRAME_SIZE);
+		quads.reserve(INSTANCE_FRAME_SIZE / sizeof(HudQuad));
+		sortedFrameTimes.reserve(FRAME_HISTORY);
+	}
+
+	void Hud::bakeFont() {
+
+		std::vector<unsigned char> pixels(ATLAS_WIDTH * ATLAS_HEIGHT, 0);
+
+		for (size_t i = 0; i < sizeof(glyphs) / sizeof(glyphs[0]); i++) {
+			int cell = glyphs[i].character - 32;
+			int cellX = cell % ATLAS_COLUMNS * CELL_SIZE;
+			int cellY = cell / ATLAS_COLUMNS * CELL_SIZE;
+			for (int row = 0; row < GLYPH_HEIGHT; row++)
+				for (int column = 0; column < GLYPH_WIDTH; column++)
+					if (glyphs[i].rows[row] & (0x10 >> column))
+						pixels[(cellY + row) * ATLAS_WIDTH + cellX + column] = 255;
+		}
+
+		int solidX = SOLID_CELL % ATLAS_COLUMNS * CELL_SIZE;
+		int solidY = SOLID_CELL / ATLAS_COLUMNS * CELL_SIZE;
+		for (int row = 0; row < CELL_SIZE; row++)
+			for (int column = 0; column < CELL_SIZE; column++)
+				pixels[(solidY + row) * ATLAS_WIDTH + solidX + column] = 255;
+
+		glGenTextures(1, &fontTexture);
+		glState().bindTexture(FONT_TEXTURE_UNIT, GL_TEXTURE_2D, fontTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, &pixels[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		GPS_GPU_RESOURCE(GPU_TEXTURE, fontTexture, getTextureBytes(GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT, 1, 1), GL_R8, "font");
+
+		// pixel sized glyphs, scaled by whole factors only
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	void Hud::toggle() {
+		visible = !visible;
+	}
+
+	bool Hud::isVisible() const {
+		return visible;
+	}
+
+	void Hud::addFrameTime(float frameMs) {
+
+		frameTimes[frameCursor] = frameMs;
+		frameCursor = (frameCursor + 1) % FRAME_HISTORY;
+		if (frameTimeCount < FRAME_HISTORY)
+			frameTimeCount++;
+	}
+
+	void Hud::queryMemory() {
+
+		// the driver queries can stall, a few refreshes per second are enough
+		if (memoryQueryCountdown-- > 0)
+			return;
+		memoryQueryCountdown = MEMORY_QUERY_INTERVAL;
+
+#if !defined (__APPLE__)
+		if (GLEW_NVX_gpu_memory_info) {
+			GLint totalKB = 0;
+			GLint availableKB = 0;
+			glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &totalKB);
+			glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &availableKB);
+			totalMemoryMB = totalKB / 1024;
+			availableMemoryMB = availableKB / 1024;
+		}
+		else if (GLEW_ATI_meminfo) {
+			// free memory, largest free block and the same for auxiliary memory, the total is not reported
+			GLint freeKB[4] = { 0, 0, 0, 0 };
+			glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, freeKB);
+			totalMemoryMB = -1;
+			availableMemoryMB = freeKB[0] / 1024;
+		}
+#endif
+	}
+
+	void Hud::addRect(float x, float y, float width, float height, const glm::vec4& color) {
+
+		HudQuad quad;
+		quad.rect = glm::vec4(x, y, width, height);
+		// the middle of the solid cell, away from its neighbours
+		quad.texRect = cellRect(SOLID_CELL, 4.0f, 4.0f) + glm::vec4(2.0f / ATLAS_WIDTH, 2.0f / ATLAS_HEIGHT, 2.0f / ATLAS_WIDTH, 2.0f / ATLAS_HEIGHT);
+		quad.color = color;
+		quads.push_back(quad);
+	}
+
+	float Hud::addText(float x, float y, float scale, const glm::vec4& color, const char* text) {
+
+		for (const char* c = text; *c != '\0'; c++) {
+
+			char character = *c;
+			if (character >= 'a' && character <= 'z')
+				character = character - 'a' + 'A';
+
+			// spaces and characters without a glyph only advance
+			if (character > ' ' && character < 127) {
+				HudQuad quad;
+				quad.rect = glm::vec4(x, y, GLYPH_WIDTH * scale, GLYPH_HEIGHT * scale);
+				quad.texRect = cellRect(character - 32, (float)GLYPH_WIDTH, (float)GLYPH_HEIGHT);
+				quad.color = color;
+				quads.push_back(quad);
+			}
+			x += (GLYPH_WIDTH + 1) * scale;
+		}
+		return x;
+	}
+
+	void Hud::draw(int width, int height, const gps::RenderStats& stats) {
+
+		if (!visible || width <= 0 || height <= 0)
+			return;
+
+		queryMemory();
+		quads.clear();
+
+		const float scale = 2.0f;
+		const float lineHeight = (GLYPH_HEIGHT + 3) * scale;
+		const float panelWidth = 420.0f;
+		const float graphHeight = 60.0f;
+		const float x = 10.0f;
+		float y = 10.0f;
+		char line[128];
+
+		// the panel goes first so everything else blends over it
+		addRect(0.0f, 0.0f, panelWidth, 10 * lineHeight + graphHeight + 30.0f, panelColor);
+
+		// frame times, oldest first
+		int count = frameTimeCount;
+		int first = (frameCursor - count + FRAME_HISTORY) % FRAME_HISTORY;
+		float lastMs = count > 0 ? frameTimes[(frameCursor - 1 + FRAME_HISTORY) % FRAME_HISTORY] : 0.0f;
+
+		sortedFrameTimes.clear();
+		for (int i = 0; i < count; i++)
+			sortedFrameTimes.push_back(frameTimes[(first + i) % FRAME_HISTORY]);
+		std::sort(sortedFrameTimes.begin(), sortedFrameTimes.end());
+		float p50 = count > 0 ? sortedFrameTimes[count / 2] : 0.0f;
+		float p95 = count > 0 ? sortedFrameTimes[(count * 95) / 100] : 0.0f;
+		float p99 = count > 0 ? sortedFrameTimes[(count * 99) / 100] : 0.0f;
+
+		snprintf(line, sizeof(line), "FRAME %.2f MS  (%.0f FPS)", lastMs, lastMs > 0.0f ? 1000.0f / lastMs : 0.0f);
+		addText(x, y, scale, lastMs > TARGET_FRAME_MS * 1.1f ? slowColor : goodColor, line);
+		y += lineHeight;
+		snprintf(line, sizeof(line), "P50 %.2f  P95 %.2f  P99 %.2f", p50, p95, p99);
+		addText(x, y, scale, textColor, line);
+		y += lineHeight;
+
+		// one bar per frame, the line marks 60 fps
+		float barWidth = (panelWidth - 2 * x) / FRAME_HISTORY;
+		for (int i = 0; i < count; i++) {
+			float ms = frameTimes[(first + i) % FRAME_HISTORY];
+			float barHeight = std::min(ms / GRAPH_MAX_MS, 1.0f) * graphHeight;
+			addRect(x + i * barWidth, y + graphHeight - barHeight, std::max(barWidth - 1.0f, 1.0f), barHeight,
+				ms > TARGET_FRAME_MS * 1.1f ? slowColor : goodColor);
+		}
+		addRect(x, y + graphHeight - TARGET_FRAME_MS / GRAPH_MAX_MS * graphHeight, panelWidth - 2 * x, 1.0f, labelColor);
+		y += graphHeight + 10.0f;
+
+		snprintf(line, sizeof(line), "DRAWS %u  PACKETS %u", stats.drawCalls, stats.packets);
+		addText(x, y, scale, textColor, line);
+		y += lineHeight;
+		snprintf(line, sizeof(line), "TRIS %u  CULLED %u", stats.triangles, stats.trianglesCulled);
+		addText(x, y, scale, textColor, line);
+		y += lineHeight;
+		snprintf(line, sizeof(line), "MESHES CULLED %u", stats.packetsCulled);
+		addText(x, y, scale, textColor, line);
+		y += lineHeight;
+		snprintf(line, sizeof(line), "BINDS PROG %u  TEX %u  VAO %u", stats.programChanges, stats.textureChanges, stats.vaoChanges);
+		addText(x, y, scale, textColor, line);
+		y += lineHeight;
+		snprintf(line, sizeof(line), "UNIFORMS %u  RANGES %u", stats.uniformUploads, stats.bufferRangeBinds);
+		addText(x, y, scale, textColor, line);
+		y += lineHeight;
+
+		if (availableMemoryMB < 0)
+			snprintf(line, sizeof(line), "GPU MEM N/A");
+		else if (totalMemoryMB < 0)
+			snprintf(line, sizeof(line), "GPU MEM %d MB FREE", availableMemoryMB);
+		else
+			snprintf(line, sizeof(line), "GPU MEM %d / %d MB", totalMemoryMB - availableMemoryMB, totalMemoryMB);
+		addText(x, y, scale, labelColor, line);
+		y += lineHeight;
+
+		// what the application allocated itself, from the resource registry
+		double registeredMB = gpuResources().getTotalBytes() / (1024.0 * 1024.0);
+		if (gpuResources().getBudget() > 0)
+			snprintf(line, sizeof(line), "APP GPU %.0f / %.0f MB", registeredMB, gpuResources().getBudget() / (1024.0 * 1024.0));
+		else
+			snprintf(line, sizeof(line), "APP GPU %.0f MB", registeredMB);
+		bool overBudget = gpuResources().getBudget() > 0 && gpuResources().getTotalBytes() > gpuResources().getBudget();
+		addText(x, y, scale, overBudget ? slowColor : labelColor, line);
+		y += lineHeight;
+
+		snprintf(line, sizeof(line), "CPU WAIT %.2f MS", frameSync().getLastWaitMs());
+		addText(x, y, scale, labelColor, line);
+
+		flush(width, height);
+	}
+
+	void Hud::drawLoading(int width, int height, float progress, const char* label) {
+
+		if (width <= 0 || height <= 0)
+			return;
+
+		quads.clear();
+
+		progress = std::min(std::max(progress, 0.0f), 1.0f);
+		float barWidth = width * 0.5f;
+		float barX = (width - barWidth) * 0.5f;
+		float barY = height * 0.5f;
+		char line[128];
+
+		snprintf(line, sizeof(line), "LOADING %.0f%%", progress * 100.0f);
+		addText(barX, barY - 60.0f, 3.0f, textColor, line);
+		addText(barX, barY - 26.0f, 2.0f, labelColor, label);
+		addRect(barX, barY, barWidth, 20.0f, panelColor);
+		addRect(barX, barY, barWidth * progress, 20.0f, goodColor);
+
+		flush(width, height);
+	}
+
+	void Hud::flush(int width, int height) {
+
+		if (quads.empty())
+			return;
+
+		GLintptr offset = 0;
+		GLsizeiptr size = quads.size() * sizeof(HudQuad);
+		void* destination = instanceRing.map(size, offset);
+		// without its quads the frame goes without the overlay
+		if (destination == NULL)
+			return;
+		memcpy(destination, &quads[0], size);
+		instanceRing.unmap();
+
+		shader.useShaderProgram();
+		glUniform2f(screenSizeLoc, (float)width, (float)height);
+		glState().bindTexture(FONT_TEXTURE_UNIT, GL_TEXTURE_2D, fontTexture);
+		glState().viewport(0, 0, width, height);
+
+		// the ring section moves every frame, so the instance attributes are pointed at it again
+		glState().bindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceRing.getBuffer());
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(HudQuad), (GLvoid*)(offset + offsetof(HudQuad, rect)));
+		glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(HudQuad), (GLvoid*)(offset + offsetof(HudQuad, texRect)));
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(HudQuad), (GLvoid*)(offset + offsetof(HudQuad, color)));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		// drawn over the scene as it is, wireframe mode included
+		GLenum polygonMode = glState().getPolygonMode();
+		glState().polygonMode(GL_FILL);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_CULL_FACE);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)quads.size());
+
+		glDisable(GL_BLEND);
+		glEnable(GL_CULL_FACE);
+		glEnable(GL_DEPTH_TEST);
+		if (polygonMode != GL_NONE)
+			glState().polygonMode(polygonMode);
+
+		glState().bindVertexArray(0);
+	}
+
+	void Hud::Delete() {
+
+		instanceRing.Delete();
+		glState().deleteVertexArray(vao);
+		glDeleteBuffers(1, &quadVBO);
+		glState().deleteTexture(fontTexture);
+		gpuResources().remove(GPU_VERTEX_ARRAY, vao);
+		gpuResources().remove(GPU_BUFFER, quadVBO);
+		gpuResources().remove(GPU_TEXTURE, fontTexture);
+		shader.Delete();
+		vao = 0;
+		quadVBO = 0;
+		fontTexture = 0;
+	}
+}
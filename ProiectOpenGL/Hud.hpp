@@ -0,0 +1,86 @@
+#ifndef Hud_hpp
+#define Hud_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "Shader.hpp"
+#include "FrameRing.hpp"
+#include "RenderQueue.hpp"
+
+#include <vector>
+
+namespace gps {
+
+    // One textured rectangle of the overlay, in pixels from the top left corner of the window
+    struct HudQuad {
+        glm::vec4 rect;
+        // atlas rectangle, min uv then max uv
+        glm::vec4 texRect;
+        glm::vec4 color;
+    };
+
+    // Performance overlay: frame times, render queue counters and GPU memory. Text and graph bars are
+    // instances of one quad sampling a font atlas baked at startup, so the overlay is a single draw call
+    class Hud {
+
+    public:
+        static const int FRAME_HISTORY = 120;
+
+        Hud();
+
+        void init();
+
+        void toggle();
+        bool isVisible() const;
+
+        // Frame time in milliseconds, swap to swap
+        void addFrameTime(float frameMs);
+
+        // Draws the overlay over the current framebuffer when it is visible
+        void draw(int width, int height, const gps::RenderStats& stats);
+        // Progress bar shown while the scene loads, progress goes from 0 to 1
+        void drawLoading(int width, int height, float progress, const char* label);
+
+        void Delete();
+
+    private:
+        bool visible;
+
+        gps::Shader shader;
+        GLint screenSizeLoc;
+        GLuint fontTexture;
+        GLuint vao;
+        GLuint quadVBO;
+        gps::FrameRing instanceRing;
+        std::vector<HudQuad> quads;
+
+        float frameTimes[FRAME_HISTORY];
+        int frameCursor;
+        int frameTimeCount;
+        std::vector<float> sortedFrameTimes;
+
+        // GPU memory in MB, -1 when the driver does not report it
+        int totalMemoryMB;
+        int availableMemoryMB;
+        int memoryQueryCountdown;
+
+        void bakeFont();
+        void queryMemory();
+
+        void addRect(float x, float y, float width, float height, const glm::vec4& color);
+        // Returns the x after the last character
+        float addText(float x, float y, float scale, const glm::vec4& color, const char* text);
+        // Uploads the quads of the frame and draws them
+        void flush(int width, int height);
+    };
+}
+
+#endif /* Hud_hpp */
@@ -0,0 +1,222 @@
+#include "InputQueue.hpp"
+
+#include <sstream>
+#include <iostream>
+
+namespace gps {
+
+	static const char* inputFileHeader = "# input recording v1";
+
+	static InputEvent makeEvent(InputEventType type, double time) {
+
+		InputEvent event;
+		event.type = type;
+		event.frame = 0;
+		event.time = time;
+		event.key = 0;
+		event.scancode = 0;
+		event.action = 0;
+		event.mods = 0;
+		event.x = 0.0;
+		event.y = 0.0;
+		return event;
+	}
+
+	InputQueue::InputQueue() {
+
+		frame = 0;
+		frameTime = 0.0;
+		recording = false;
+		replaying = false;
+		replayCursor = 0;
+	}
+
+	void InputQueue::push(const InputEvent& event) {
+
+		// live input would change the replayed session
+		if (replaying)
+			return;
+		pending.push_back(event);
+	}
+
+	void InputQueue::pushKey(double time, int key, int scancode, int action, int mods) {
+
+		InputEvent event = makeEvent(INPUT_KEY, time);
+		event.key = key;
+		event.scancode = scancode;
+		event.action = action;
+		event.mods = mods;
+		push(event);
+	}
+
+	void InputQueue::pushCursor(double time, double x, double y) {
+
+		InputEvent event = makeEvent(INPUT_CURSOR, time);
+		event.x = x;
+		event.y = y;
+		push(event);
+	}
+
+	void InputQueue::pushMouseButton(double time, int button, int action, int mods) {
+
+		InputEvent event = makeEvent(INPUT_MOUSE_BUTTON, time);
+		event.key = button;
+		event.action = action;
+		event.mods = mods;
+		push(event);
+	}
+
+	void InputQueue::beginFrame(double liveTime) {
+
+		frame++;
+		frameEvents.clear();
+
+		if (replaying) {
+
+			frameTime = frame - 1 < replayFrameTimes.size() ? replayFrameTimes[frame - 1] : liveTime;
+			while (replayCursor < replayEvents.size() && replayEvents[replayCursor].frame <= frame)
+				frameEvents.push_back(replayEvents[replayCursor++]);
+
+			if (frame >= replayFrameTimes.size() && replayCursor >= replayEvents.size()) {
+				replaying = false;
+				std::cout << "Input replay finished after " << frame << " frames" << std::endl;
+			}
+		}
+		else {
+			frameTime = liveTime;
+			frameEvents.swap(pending);
+			pending.clear();
+			for (size_t i = 0; i < frameEvents.size(); i++)
+				frameEvents[i].frame = frame;
+		}
+
+		if (recording) {
+			recordFile << "F " << frame << " " << frameTime << "\n";
+			for (size_t i = 0; i < frameEvents.size(); i++)
+				writeEvent(frameEvents[i]);
+		}
+	}
+
+	void InputQueue::writeEvent(const InputEvent& event) {
+
+		switch (event.type) {
+		case INPUT_KEY:
+			recordFile << "K " << event.frame << " " << event.time << " "
+				<< event.key << " " << event.scancode << " " << event.action << " " << event.mods << "\n";
+			break;
+		case INPUT_CURSOR:
+			recordFile << "M " << event.frame << " " << event.time << " " << event.x << " " << event.y << "\n";
+			break;
+		case INPUT_MOUSE_BUTTON:
+			recordFile << "B " << event.frame << " " << event.time << " "
+				<< event.key << " " << event.action << " " << event.mods << "\n";
+			break;
+		}
+	}
+
+	const std::vector<InputEvent>& InputQueue::getFrameEvents() const {
+		return frameEvents;
+	}
+
+	double InputQueue::getFrameTime() const {
+		return frameTime;
+	}
+
+	unsigned int InputQueue::getFrame() const {
+		return frame;
+	}
+
+	bool InputQueue::startRecording(const std::string& fileName) {
+
+		recordFile.open(fileName.c_str());
+		if (!recordFile.is_open()) {
+			std::cerr << "ERROR: could not write the input recording " << fileName << std::endl;
+			return false;
+		}
+
+		// times and cursor positions must come back bit for bit
+		recordFile.precision(17);
+		recordFile << inputFileHeader << "\n";
+		recording = true;
+		return true;
+	}
+
+	void InputQueue::stopRecording() {
+
+		if (!recording)
+			return;
+		recordFile.close();
+		recording = false;
+	}
+
+	bool InputQueue::isRecording() const {
+		return recording;
+	}
+
+	bool InputQueue::loadReplay(const std::string& fileName) {
+
+		std::ifstream file(fileName.c_str());
+		if (!file.is_open()) {
+			std::cerr << "ERROR: could not open the input recording " << fileName << std::endl;
+			return false;
+		}
+
+		std::vector<InputEvent> events;
+		std::vector<double> frameTimes;
+		std::string line;
+		while (std::getline(file, line)) {
+
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			std::istringstream values(line);
+			char kind = 0;
+			unsigned int eventFrame = 0;
+			double time = 0.0;
+			values >> kind >> eventFrame >> time;
+			if (values.fail() || eventFrame == 0) {
+				std::cerr << "ERROR: bad input event in " << fileName << ": " << line << std::endl;
+				return false;
+			}
+
+			InputEvent event = makeEvent(INPUT_KEY, time);
+			event.frame = eventFrame;
+
+			if (kind == 'F') {
+				// frames are written in order, one line each
+				frameTimes.resize(eventFrame, time);
+				frameTimes[eventFrame - 1] = time;
+				continue;
+			}
+			else if (kind == 'K')
+				values >> event.key >> event.scancode >> event.action >> event.mods;
+			else if (kind == 'M') {
+				event.type = INPUT_CURSOR;
+				values >> event.x >> event.y;
+			}
+			else if (kind == 'B') {
+				event.type = INPUT_MOUSE_BUTTON;
+				values >> event.key >> event.action >> event.mods;
+			}
+			else
+				values.setstate(std::ios::failbit);
+
+			if (values.fail()) {
+				std::cerr << "ERROR: bad input event in " << fileName << ": " << line << std::endl;
+				return false;
+			}
+			events.push_back(event);
+		}
+
+		replayEvents.swap(events);
+		replayFrameTimes.swap(frameTimes);
+		replayCursor = 0;
+		replaying = true;
+		pending.clear();
+		return true;
+	}
+
+	bool InputQueue::isReplaying() const {
+		return replaying;
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef InputQueue_hpp
+#define InputQueue_hpp
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    enum InputEventType {
+        INPUT_KEY,
+        INPUT_CURSOR,
+        INPUT_MOUSE_BUTTON
+    };
+
+    // One GLFW callback, kept with the frame that applies it
+    struct InputEvent {
+        InputEventType type;
+        unsigned int frame;
+        // seconds, when the callback fired
+        double time;
+        // key or mouse button
+        int key;
+        int scancode;
+        int action;
+        int mods;
+        // cursor position
+        double x;
+        double y;
+    };
+
+    // Callbacks only queue their events, the application applies them once per frame at a fixed point.
+    // A recording keeps the events and the time of every frame, a replay feeds them back frame by frame
+    // so the session runs through exactly the same states
+    class InputQueue {
+
+    public:
+        InputQueue();
+
+        void pushKey(double time, int key, int scancode, int action, int mods);
+        void pushCursor(double time, double x, double y);
+        void pushMouseButton(double time, int button, int action, int mods);
+
+        // Starts a frame and collects its events. liveTime is used unless a replay provides the frame time
+        void beginFrame(double liveTime);
+        const std::vector<InputEvent>& getFrameEvents() const;
+        // Time of the current frame, in seconds
+        double getFrameTime() const;
+        unsigned int getFrame() const;
+
+        // Text file, written as the session goes so a crash keeps everything up to the last frame
+        bool startRecording(const std::string& fileName);
+        void stopRecording();
+        bool isRecording() const;
+
+        bool loadReplay(const std::string& fileName);
+        bool isReplaying() const;
+
+    private:
+        std::vector<InputEvent> pending;
+        std::vector<InputEvent> frameEvents;
+        unsigned int frame;
+        double frameTime;
+
+        bool recording;
+        std::ofstream recordFile;
+
+        bool replaying;
+        std::vector<InputEvent> replayEvents;
+        std::vector<double> replayFrameTimes;
+        size_t replayCursor;
+
+        void push(const InputEvent& event);
+        void writeEvent(const InputEvent& event);
+    };
+}
+
+#endif /* InputQueue_hpp */
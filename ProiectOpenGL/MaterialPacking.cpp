@@ -0,0 +1,112 @@
+#include "MaterialPacking.hpp"
+#include "AssetPackage.hpp"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+namespace gps {
+
+	static bool loadMap(const std::string& path, int& width, int& height, unsigned char*& pixels) {
+
+		int channels;
+		AssetData file;
+		pixels = NULL;
+		if (vfs().read(path, file) && file.size > 0)
+			pixels = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 4);
+		if (pixels == NULL) {
+			fprintf(stderr, "ERROR: could not load %s\n", path.c_str());
+			return false;
+		}
+		flipImageRows(pixels, width, height, 4);
+		return true;
+	}
+
+	void packMaterialTextures(gps::ObjData& data, std::vector<gps::PackedMaterialFile>& materials) {
+
+		std::map<std::string, size_t> indices;
+		for (size_t s = 0; s < data.meshes.size(); s++) {
+
+			std::vector<gps::TextureFile>& textures = data.meshes[s].textures;
+			gps::PackedMaterialFile material;
+			for (size_t t = 0; t < textures.size(); t++) {
+				if (textures[t].type == "diffuseTexture")
+					material.diffusePath = textures[t].path;
+				else if (textures[t].type == "specularTexture")
+					material.specularPath = textures[t].path;
+			}
+			// the separator cannot be part of a file name
+			material.path = "packed:" + material.diffusePath + "|" + material.specularPath;
+
+			std::vector<gps::TextureFile> remapped;
+			for (size_t t = 0; t < textures.size(); t++) {
+				if (textures[t].type != "diffuseTexture" && textures[t].type != "specularTexture")
+					remapped.push_back(textures[t]);
+			}
+			gps::TextureFile packed;
+			packed.path = material.path;
+			packed.type = "diffuseTexture";
+			remapped.push_back(packed);
+			textures.swap(remapped);
+
+			if (indices.count(material.path) == 0) {
+				indices[material.path] = materials.size();
+				materials.push_back(material);
+			}
+		}
+	}
+
+	bool buildPackedMaterial(const gps::PackedMaterialFile& material, int& width, int& height, std::vector<unsigned char>& pixels) {
+
+		unsigned char* diffuse = NULL;
+		unsigned char* specular = NULL;
+		int specularWidth = 1, specularHeight = 1;
+		width = 1;
+		height = 1;
+		if (!material.diffusePath.empty() && !loadMap(material.diffusePath, width, height, diffuse))
+			return false;
+		if (!material.specularPath.empty() && !loadMap(material.specularPath, specularWidth, specularHeight, specular)) {
+			stbi_image_free(diffuse);
+			return false;
+		}
+		if (diffuse == NULL && specular != NULL) {
+			width = specularWidth;
+			height = specularHeight;
+		}
+
+		// the old shader read the specular map through an sRGB format, the mask keeps its decoded values
+		float toLinear[256];
+		for (int i = 0; i < 256; i++) {
+			float value = i / 255.0f;
+			toLinear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		pixels.assign((size_t)width * height * 4, 0);
+		for (int y = 0; y < height; y++) {
+			// nearest texel of the specular map, a mask loses little to it
+			int specularY = (int)(((size_t)y * specularHeight + specularHeight / 2) / height);
+			for (int x = 0; x < width; x++) {
+				unsigned char* texel = &pixels[((size_t)y * width + x) * 4];
+				if (diffuse != NULL) {
+					const unsigned char* source = diffuse + ((size_t)y * width + x) * 4;
+					texel[0] = source[0];
+					texel[1] = source[1];
+					texel[2] = source[2];
+				}
+				if (specular != NULL) {
+					int specularX = (int)(((size_t)x * specularWidth + specularWidth / 2) / width);
+					const unsigned char* source = specular + ((size_t)specularY * specularWidth + specularX) * 4;
+					float mask = (toLinear[source[0]] + toLinear[source[1]] + toLinear[source[2]]) / 3.0f;
+					texel[3] = (unsigned char)(std::min(mask, 1.0f) * 255.0f + 0.5f);
+				}
+			}
+		}
+
+		stbi_image_free(diffuse);
+		stbi_image_free(specular);
+		return true;
+	}
+}
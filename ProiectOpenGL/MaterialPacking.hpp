@@ -0,0 +1,32 @@
+#ifndef MaterialPacking_hpp
+#define MaterialPacking_hpp
+
+#include "ModelLoader.hpp"
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Diffuse and specular map of a material that become one texture
+    struct PackedMaterialFile {
+        // what the TextureFile paths of the remapped meshes refer to
+        std::string path;
+        // empty when the material has no such map
+        std::string diffusePath;
+        std::string specularPath;
+    };
+
+    // Points the diffuse and specular textures of every mesh at one packed texture per pair of maps,
+    // meshes with neither get a black one so the packed shader never samples an empty unit.
+    // The materials are returned once each, in the order the meshes first use them
+    void packMaterialTextures(gps::ObjData& data, std::vector<gps::PackedMaterialFile>& materials);
+
+    // Diffuse RGB with the specular mask in alpha, RGBA rows bottom first like the textures of Model3D.
+    // The mask is the average of the specular channels in linear space, alpha is not sRGB encoded,
+    // and it is resized to the diffuse map when their sizes differ. A missing diffuse map is black,
+    // a missing specular map masks the specular light out. False when a map cannot be read
+    bool buildPackedMaterial(const gps::PackedMaterialFile& material, int& width, int& height, std::vector<unsigned char>& pixels);
+}
+
+#endif /* MaterialPacking_hpp */
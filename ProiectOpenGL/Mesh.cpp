@@ -1,60 +1,143 @@
 #include "Mesh.hpp"
+#include "GpuResources.hpp"
+
+#include <cmath>
+#include <type_traits>
+
 namespace gps {
 
+	// meshes are stored and copied in flat arrays
+	static_assert(std::is_trivially_copyable<Texture>::value, "Texture has to stay a plain record");
+	static_assert(std::is_trivially_copyable<Mesh>::value, "Mesh has to stay a plain record");
+
+	bool getTextureSlot(const std::string& type, TextureSlot& slot) {
+
+		if (type == "diffuseTexture")
+			slot = TEXTURE_DIFFUSE;
+		else if (type == "specularTexture")
+			slot = TEXTURE_SPECULAR;
+		else if (type == "ambientTexture")
+			slot = TEXTURE_AMBIENT;
+		else
+			return false;
+		return true;
+	}
+
 	/* Mesh Constructor */
-	Mesh::Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures) {
+	Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, const std::vector<Texture>& textures) {
 
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		this->setupMesh(vertices, indices);
+		this->setupDrawInfo(vertices, indices, textures);
+	}
+
+	Buffers Mesh::getBuffers() const {
 
-		this->setupMesh();
+		Buffers buffers;
+		buffers.VAO = resources().get(this->vertexArray);
+		buffers.VBO = resources().get(this->vertexBuffer);
+		buffers.EBO = resources().get(this->indexBuffer);
+		return buffers;
 	}
 
-	Buffers Mesh::getBuffers() {
-	    return this->buffers;
+	void Mesh::Delete() {
+
+		resources().destroy(this->vertexArray);
+		resources().destroy(this->vertexBuffer);
+		resources().destroy(this->indexBuffer);
 	}
 
-	/* Mesh drawing function - also applies associated textures */
-	void Mesh::Draw(gps::Shader shader)	{
+	GLsizei Mesh::getVertexCount() const {
+		return this->vertexCount;
+	}
 
-		shader.useShaderProgram();
+	GLsizei Mesh::getIndexCount() const {
+		return this->indexCount;
+	}
 
-		//set textures
-		for (GLuint i = 0; i < textures.size(); i++) {
+	GLuint Mesh::getTexture(TextureSlot slot) const {
+		return resources().get(this->slotTextures[slot]);
+	}
 
-			glActiveTexture(GL_TEXTURE0 + i);
-			glUniform1i(glGetUniformLocation(shader.shaderProgram, this->textures[i].type.c_str()), i);
-			glBindTexture(GL_TEXTURE_2D, this->textures[i].id);
-		}
+	GLuint Mesh::getMaterialKey() const {
+		// handles are unique, so the diffuse one identifies the material well enough
+		return !this->slotTextures[TEXTURE_DIFFUSE].isNull() ? this->slotTextures[TEXTURE_DIFFUSE].value : this->slotTextures[TEXTURE_SPECULAR].value;
+	}
 
-		glBindVertexArray(this->buffers.VAO);
-		glDrawElements(GL_TRIANGLES, (GLsizei)this->indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
+	glm::vec3 Mesh::getBoundsCenter() const {
+		return this->boundsCenter;
+	}
 
-        for(GLuint i = 0; i < this->textures.size(); i++) {
+	float Mesh::getBoundsRadius() const {
+		return this->boundsRadius;
+	}
+
+	float Mesh::getUvDensity() const {
+		return this->uvDensity;
+	}
+
+	// Computes the texture slots and the bounding sphere
+	void Mesh::setupDrawInfo(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, const std::vector<Texture>& textures) {
+
+		this->vertexCount = (GLsizei)vertices.size();
+		this->indexCount = (GLsizei)indices.size();
+
+		for (int i = 0; i < TEXTURE_SLOT_COUNT; i++)
+			this->slotTextures[i] = TextureHandle();
 
-            glActiveTexture(GL_TEXTURE0 + i);
-            glBindTexture(GL_TEXTURE_2D, 0);
-        }
+		for (size_t i = 0; i < textures.size(); i++)
+			this->slotTextures[textures[i].slot] = textures[i].handle;
 
-    }
+		glm::vec3 minPos(0.0f);
+		glm::vec3 maxPos(0.0f);
+		if (!vertices.empty()) {
+			minPos = vertices[0].Position;
+			maxPos = vertices[0].Position;
+		}
+		for (size_t i = 1; i < vertices.size(); i++) {
+			minPos = glm::min(minPos, vertices[i].Position);
+			maxPos = glm::max(maxPos, vertices[i].Position);
+		}
+		this->boundsCenter = (minPos + maxPos) * 0.5f;
+		this->boundsRadius = glm::length(maxPos - this->boundsCenter);
+
+		// texture streaming picks mip levels from it, the ratio of the areas gives the scale along one axis
+		double modelArea = 0.0;
+		double uvArea = 0.0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			const Vertex& a = vertices[indices[i]];
+			const Vertex& b = vertices[indices[i + 1]];
+			const Vertex& c = vertices[indices[i + 2]];
+			modelArea += glm::length(glm::cross(b.Position - a.Position, c.Position - a.Position));
+			glm::vec2 u = b.TexCoords - a.TexCoords;
+			glm::vec2 v = c.TexCoords - a.TexCoords;
+			uvArea += std::fabs(u.x * v.y - u.y * v.x);
+		}
+		this->uvDensity = modelArea > 0.0 ? (float)std::sqrt(uvArea / modelArea) : 0.0f;
+	}
 
 	// Initializes all the buffer objects/arrays
-	void Mesh::setupMesh() {
+	void Mesh::setupMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices) {
 
 		// Create buffers/arrays
-		glGenVertexArrays(1, &this->buffers.VAO);
-		glGenBuffers(1, &this->buffers.VBO);
-		glGenBuffers(1, &this->buffers.EBO);
-
-		glBindVertexArray(this->buffers.VAO);
+		Buffers buffers;
+		glGenVertexArrays(1, &buffers.VAO);
+		glGenBuffers(1, &buffers.VBO);
+		glGenBuffers(1, &buffers.EBO);
+		this->vertexArray = resources().add<RESOURCE_VERTEX_ARRAY>(buffers.VAO);
+		this->vertexBuffer = resources().add<RESOURCE_BUFFER>(buffers.VBO);
+		this->indexBuffer = resources().add<RESOURCE_BUFFER>(buffers.EBO);
+
+		glState().bindVertexArray(buffers.VAO);
 		// Load data into vertex buffers
-		glBindBuffer(GL_ARRAY_BUFFER, this->buffers.VBO);
-		glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(Vertex), &this->vertices[0], GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->buffers.EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(GLuint), &this->indices[0], GL_STATIC_DRAW);
+		GPS_GPU_RESOURCE(GPU_VERTEX_ARRAY, buffers.VAO, 0, GL_NONE, "mesh");
+		GPS_GPU_RESOURCE(GPU_BUFFER, buffers.VBO, vertices.size() * sizeof(Vertex), GL_ARRAY_BUFFER, "mesh");
+		GPS_GPU_RESOURCE(GPU_BUFFER, buffers.EBO, indices.size() * sizeof(GLuint), GL_ELEMENT_ARRAY_BUFFER, "mesh");
 
 		// Set the vertex attribute pointers
 		// Vertex Positions
@@ -67,6 +150,6 @@ namespace gps {
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
 
-		glBindVertexArray(0);
+		glState().bindVertexArray(0);
 	}
 }
@@ -12,6 +12,7 @@
 #include <glm/glm.hpp>
 
 #include "Shader.hpp"
+#include "ResourceManager.hpp"
 
 #include <string>
 #include <vector>
@@ -26,14 +27,6 @@ namespace gps {
         glm::vec2 TexCoords;
     };
 
-    struct Texture {
-
-        GLuint id;
-        //ambientTexture, diffuseTexture, specularTexture
-        std::string type;
-        std::string path;
-    };
-
     struct Material {
 
         glm::vec3 ambient;
@@ -47,25 +40,64 @@ namespace gps {
         GLuint EBO;
     };
 
-    class Mesh {
+    // Fixed texture unit for each sampler type, so samplers never have to be re-pointed between draws
+    enum TextureSlot {
+        TEXTURE_DIFFUSE = 0,
+        TEXTURE_SPECULAR = 1,
+        TEXTURE_AMBIENT = 2,
+        TEXTURE_SLOT_COUNT = 3
+    };
 
-    public:
-        std::vector<Vertex> vertices;
-        std::vector<GLuint> indices;
-        std::vector<Texture> textures;
+    // Plain record, the type strings of the model files become slots when they are loaded
+    struct Texture {
+
+        gps::TextureHandle handle;
+        TextureSlot slot;
+    };
 
-	    Mesh(std::vector<Vertex> vertices, std::vector<GLuint> indices, std::vector<Texture> textures);
+    // Slot for a model file texture type (ambientTexture, diffuseTexture, specularTexture), false for other types
+    bool getTextureSlot(const std::string& type, TextureSlot& slot);
 
-	    Buffers getBuffers();
+    class Mesh {
 
-	    void Draw(gps::Shader shader);
+    public:
+	    // Uploads the geometry, the mesh keeps no copy of it in memory
+	    Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, const std::vector<Texture>& textures);
+
+	    // Names of the buffers, 0 once the mesh was deleted
+	    Buffers getBuffers() const;
+	    // Destroys the buffers, copies of the mesh see them gone too. The textures belong to the model
+	    void Delete();
+
+	    GLsizei getVertexCount() const;
+	    GLsizei getIndexCount() const;
+	    // Texture bound to the given slot, 0 when the material has none
+	    GLuint getTexture(TextureSlot slot) const;
+	    // Key used to group meshes sharing the same textures
+	    GLuint getMaterialKey() const;
+	    // Bounding sphere in model space
+	    glm::vec3 getBoundsCenter() const;
+	    float getBoundsRadius() const;
+	    // Texture coordinate units per model space unit, averaged over the triangles. 0 without texture coordinates
+	    float getUvDensity() const;
 
     private:
-        /*  Render data  */
-        Buffers buffers;
+        /*  Render data, handles and counts only so meshes are plain records  */
+        gps::VertexArrayHandle vertexArray;
+        gps::BufferHandle vertexBuffer;
+        gps::BufferHandle indexBuffer;
+        GLsizei vertexCount;
+        GLsizei indexCount;
+        gps::TextureHandle slotTextures[TEXTURE_SLOT_COUNT];
+        glm::vec3 boundsCenter;
+        float boundsRadius;
+        float uvDensity;
 
 	    // Initializes all the buffer objects/arrays
-	    void setupMesh();
+	    void setupMesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices);
+
+	    // Computes the texture slots and the bounding sphere
+	    void setupDrawInfo(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, const std::vector<Texture>& textures);
 
     };
 
@@ -0,0 +1,449 @@
+// Microbenchmarks of the CPU hot paths: model parsing, asset reads, the texture flip, the camera and the per-frame matrix math.
+// None of them needs a GL context. Every benchmark is sampled until the 95% confidence interval of its mean
+// is within the target error, or the sample or time limits are reached.
+
+#include "ModelLoader.hpp"
+#include "AssetPackage.hpp"
+#include "AsyncReader.hpp"
+#include "SceneAnimation.hpp"
+#include "Camera.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined (__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined (_MSC_VER)
+#include <intrin.h>
+#define GPS_HAS_TSC 1
+#elif defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#define GPS_HAS_TSC 1
+#endif
+
+namespace {
+
+	// results are folded in here so the compiler cannot drop the measured work
+	volatile float benchmarkSink = 0.0f;
+
+	uint64_t readCycles() {
+#ifdef GPS_HAS_TSC
+		return __rdtsc();
+#else
+		return 0;
+#endif
+	}
+
+	struct SamplingOptions {
+		int minSamples;
+		int maxSamples;
+		// half width of the 95% confidence interval, relative to the mean
+		double targetError;
+		// a sample runs the operation often enough to last at least this long
+		double minSampleMs;
+		// a benchmark stops sampling after this long once it has minSamples
+		double maxBenchmarkMs;
+	};
+
+	struct Microbenchmark {
+		std::string name;
+		// runs the operation this many times
+		std::function<void(size_t)> run;
+		// bytes processed by one operation, 0 when throughput makes no sense
+		double bytesPerOp;
+	};
+
+	struct SampleStats {
+		double nsPerOp;
+		double cyclesPerOp;
+		double error;
+		int samples;
+	};
+
+	SampleStats measure(const Microbenchmark& benchmark, const SamplingOptions& options) {
+
+		typedef std::chrono::steady_clock Clock;
+
+		// grows the batch until one sample is long enough for the clock resolution not to matter
+		size_t iterations = 1;
+		while (true) {
+			Clock::time_point start = Clock::now();
+			benchmark.run(iterations);
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			if (ms >= options.minSampleMs || iterations >= ((size_t)1 << 30))
+				break;
+			iterations *= ms > 0.0 ? std::max<size_t>(2, (size_t)(options.minSampleMs / ms)) : 16;
+		}
+
+		std::vector<double> nsPerOp;
+		std::vector<double> cyclesPerOp;
+		Clock::time_point benchmarkStart = Clock::now();
+		double error = 1.0;
+
+		while ((int)nsPerOp.size() < options.maxSamples) {
+
+			Clock::time_point start = Clock::now();
+			uint64_t startCycles = readCycles();
+			benchmark.run(iterations);
+			uint64_t cycles = readCycles() - startCycles;
+			double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+			nsPerOp.push_back(ns / iterations);
+			cyclesPerOp.push_back((double)cycles / iterations);
+
+			int count = (int)nsPerOp.size();
+			if (count < options.minSamples)
+				continue;
+
+			double mean = 0.0;
+			for (int i = 0; i < count; i++)
+				mean += nsPerOp[i];
+			mean /= count;
+			double variance = 0.0;
+			for (int i = 0; i < count; i++)
+				variance += (nsPerOp[i] - mean) * (nsPerOp[i] - mean);
+			variance /= count - 1;
+			error = mean > 0.0 ? 1.96 * std::sqrt(variance / count) / mean : 0.0;
+
+			double elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - benchmarkStart).count();
+			if (error <= options.targetError || elapsedMs >= options.maxBenchmarkMs)
+				break;
+		}
+
+		// the median ignores the samples an interrupt or a page fault landed in
+		std::sort(nsPerOp.begin(), nsPerOp.end());
+		std::sort(cyclesPerOp.begin(), cyclesPerOp.end());
+
+		SampleStats stats;
+		stats.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+		stats.cyclesPerOp = cyclesPerOp[cyclesPerOp.size() / 2];
+		stats.error = error;
+		stats.samples = (int)nsPerOp.size();
+		return stats;
+	}
+
+	// Square grid of quads with positions, normals and texture coordinates, two triangles per quad
+	bool writeGridObj(const std::string& fileName, size_t triangles, double& fileSize) {
+
+		FILE* file = fopen(fileName.c_str(), "w");
+		if (file == NULL) {
+			fprintf(stderr, "ERROR: could not write %s\n", fileName.c_str());
+			return false;
+		}
+
+		size_t quads = std::max<size_t>(triangles / 2, 1);
+		size_t side = (size_t)std::ceil(std::sqrt((double)quads));
+		size_t points = side + 1;
+
+		for (size_t z = 0; z < points; z++)
+			for (size_t x = 0; x < points; x++) {
+				fprintf(file, "v %f %f %f\n", (float)x, 0.1f * (float)((x * 7 + z * 13) % 5), (float)z);
+				fprintf(file, "vt %f %f\n", (float)x / side, (float)z / side);
+				fprintf(file, "vn 0 1 0\n");
+			}
+
+		// only the requested number of quads, the last row of the grid may stay partly empty
+		for (size_t q = 0; q < quads; q++) {
+			size_t x = q % side;
+			size_t z = q / side;
+			size_t a = z * points + x + 1;
+			size_t b = a + 1;
+			size_t c = a + points;
+			size_t d = c + 1;
+			fprintf(file, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, c, c, c, b, b, b);
+			fprintf(file, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", b, b, b, c, c, c, d, d, d);
+		}
+
+		fileSize = (double)ftell(file);
+		fclose(file);
+		return true;
+	}
+
+	// Files of about the size of the model textures, with bytes a compressor would not shrink either
+	bool writeAssetFiles(const std::string& prefix, int count, size_t size, std::vector<std::string>& fileNames) {
+
+		std::vector<unsigned char> contents(size);
+		uint32_t state = 12345;
+		for (int f = 0; f < count; f++) {
+			for (size_t i = 0; i < size; i++) {
+				state = state * 1664525u + 1013904223u;
+				contents[i] = (unsigned char)(state >> 24);
+			}
+			std::string fileName = prefix + std::to_string(f) + ".bin";
+			FILE* file = fopen(fileName.c_str(), "wb");
+			if (file == NULL || fwrite(&contents[0], 1, size, file) != size) {
+				fprintf(stderr, "ERROR: could not write %s\n", fileName.c_str());
+				if (file != NULL)
+					fclose(file);
+				return false;
+			}
+			fclose(file);
+			fileNames.push_back(fileName);
+		}
+		return true;
+	}
+
+	// Evicts the files from the page cache, the next read comes from the disk
+	void dropCachedFiles(const std::vector<std::string>& fileNames) {
+#if defined (__linux__)
+		for (size_t i = 0; i < fileNames.size(); i++) {
+			int file = open(fileNames[i].c_str(), O_RDONLY);
+			if (file < 0)
+				continue;
+			// only clean pages are dropped
+			fdatasync(file);
+			posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+			close(file);
+		}
+#endif
+	}
+
+	void printUsage() {
+		fprintf(stdout,
+			"usage: Microbenchmarks [options]\n"
+			"  --filter text        runs the benchmarks whose name contains text\n"
+			"  --max-triangles N    largest synthetic model parsed (default 1000000, up to 10000000)\n"
+			"  --min-samples N      samples taken at least (default 5)\n"
+			"  --max-samples N      samples taken at most (default 50)\n"
+			"  --target-error F     relative 95%% confidence interval to reach (default 0.02)\n"
+			"  --max-time-ms F      sampling time per benchmark once min-samples is reached (default 5000)\n");
+	}
+}
+
+int main(int argc, const char* argv[]) {
+
+	SamplingOptions options;
+	options.minSamples = 5;
+	options.maxSamples = 50;
+	options.targetError = 0.02;
+	options.minSampleMs = 10.0;
+	options.maxBenchmarkMs = 5000.0;
+	size_t maxTriangles = 1000000;
+	std::string filter;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+			filter = argv[++i];
+		else if (strcmp(argv[i], "--max-triangles") == 0 && i + 1 < argc)
+			maxTriangles = (size_t)atof(argv[++i]);
+		else if (strcmp(argv[i], "--min-samples") == 0 && i + 1 < argc)
+			options.minSamples = std::max(atoi(argv[++i]), 2);
+		else if (strcmp(argv[i], "--max-samples") == 0 && i + 1 < argc)
+			options.maxSamples = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--target-error") == 0 && i + 1 < argc)
+			options.targetError = atof(argv[++i]);
+		else if (strcmp(argv[i], "--max-time-ms") == 0 && i + 1 < argc)
+			options.maxBenchmarkMs = atof(argv[++i]);
+		else {
+			printUsage();
+			return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	options.maxSamples = std::max(options.maxSamples, options.minSamples);
+
+	std::vector<Microbenchmark> benchmarks;
+	std::vector<std::string> temporaryFiles;
+
+	// ReadOBJ without the upload, on grids from 1K to 10M triangles
+	const size_t objSizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+	for (size_t s = 0; s < sizeof(objSizes) / sizeof(objSizes[0]); s++) {
+
+		size_t triangles = objSizes[s];
+		char name[64];
+		snprintf(name, sizeof(name), "parseOBJ/%zu", triangles);
+		if (triangles > maxTriangles || (!filter.empty() && std::string(name).find(filter) == std::string::npos))
+			continue;
+
+		std::string fileName = std::string("microbench_grid_") + std::to_string(triangles) + ".obj";
+		double fileSize = 0.0;
+		if (!writeGridObj(fileName, triangles, fileSize))
+			return EXIT_FAILURE;
+		temporaryFiles.push_back(fileName);
+
+		Microbenchmark benchmark;
+		benchmark.name = name;
+		benchmark.bytesPerOp = fileSize;
+		benchmark.run = [fileName](size_t iterations) {
+			for (size_t i = 0; i < iterations; i++) {
+				gps::ObjData data;
+				if (gps::parseOBJ(fileName, "", data) && !data.meshes.empty())
+					benchmarkSink = benchmarkSink + (float)data.meshes[0].vertices.size();
+			}
+		};
+		benchmarks.push_back(benchmark);
+	}
+
+	// the loading of 64 texture-sized files: one blocking read after the other like before, and one
+	// batch for the async reader taken in the same order. Cold runs evict the files before every pass
+	{
+		std::shared_ptr<std::vector<std::string>> fileNames = std::make_shared<std::vector<std::string>>();
+		const int fileCount = 64;
+		const size_t fileSize = 512 * 1024;
+		gps::asyncReader().start();
+
+#if defined (__linux__)
+		const int cacheStates = 2;
+#else
+		const int cacheStates = 1;
+#endif
+		for (int cold = 0; cold < cacheStates; cold++) {
+			for (int async = 0; async < 2; async++) {
+
+				Microbenchmark benchmark;
+				benchmark.name = std::string("assetReads/") + (async ? gps::asyncReader().getBackendName() : "blocking") + (cold ? "/cold" : "/warm");
+				if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+					continue;
+				if (fileNames->empty()) {
+					if (!writeAssetFiles("microbench_asset_", fileCount, fileSize, *fileNames))
+						return EXIT_FAILURE;
+					temporaryFiles.insert(temporaryFiles.end(), fileNames->begin(), fileNames->end());
+				}
+				benchmark.bytesPerOp = (double)fileCount * fileSize;
+				benchmark.run = [fileNames, cold, async](size_t iterations) {
+					for (size_t i = 0; i < iterations; i++) {
+						if (cold)
+							dropCachedFiles(*fileNames);
+						if (async)
+							gps::vfs().prefetch(*fileNames);
+						for (size_t f = 0; f < fileNames->size(); f++) {
+							gps::AssetData asset;
+							if (gps::vfs().read((*fileNames)[f], asset) && asset.size > 0)
+								benchmarkSink = benchmarkSink + asset.data[0];
+						}
+					}
+				};
+				benchmarks.push_back(benchmark);
+			}
+		}
+	}
+
+	// the flip of ReadTextureFromFile on a 2048x2048 RGBA texture
+	{
+		const int size = 2048;
+		std::shared_ptr<std::vector<unsigned char>> pixels = std::make_shared<std::vector<unsigned char>>(size * size * 4);
+		for (size_t i = 0; i < pixels->size(); i++)
+			(*pixels)[i] = (unsigned char)(i * 31);
+
+		Microbenchmark benchmark;
+		benchmark.name = "flipImageRows/2048x2048";
+		benchmark.bytesPerOp = (double)pixels->size();
+		benchmark.run = [pixels, size](size_t iterations) {
+			for (size_t i = 0; i < iterations; i++)
+				gps::flipImageRows(&(*pixels)[0], size, size, 4);
+			benchmarkSink = benchmarkSink + (*pixels)[0];
+		};
+		benchmarks.push_back(benchmark);
+	}
+
+	{
+		std::shared_ptr<gps::Camera> camera = std::make_shared<gps::Camera>(
+			glm::vec3(0.0f, 2.0f, 5.5f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+		Microbenchmark viewMatrix;
+		viewMatrix.name = "Camera::getViewMatrix";
+		viewMatrix.bytesPerOp = 0.0;
+		viewMatrix.run = [camera](size_t iterations) {
+			// only the lookAt, the camera stays put. Camera.cpp is another translation unit, so the call
+			// is not hoisted out of the loop
+			float sum = 0.0f;
+			for (size_t i = 0; i < iterations; i++)
+				sum += camera->getViewMatrix()[3][2];
+			benchmarkSink = benchmarkSink + sum;
+		};
+		benchmarks.push_back(viewMatrix);
+
+		Microbenchmark rotate;
+		rotate.name = "Camera::rotate";
+		rotate.bytesPerOp = 0.0;
+		rotate.run = [camera](size_t iterations) {
+			for (size_t i = 0; i < iterations; i++)
+				camera->rotate((float)(i % 89), (float)(i % 360));
+			benchmarkSink = benchmarkSink + camera->getCameraFrontDirection().x;
+		};
+		benchmarks.push_back(rotate);
+	}
+
+	// one frame of renderAnimations and drawObjects: the prop matrices and the normal matrices the queue derives
+	{
+		std::shared_ptr<gps::PropAnimation> animation = std::make_shared<gps::PropAnimation>();
+
+		Microbenchmark benchmark;
+		benchmark.name = "frameMatrices";
+		benchmark.bytesPerOp = 0.0;
+		benchmark.run = [animation](size_t iterations) {
+			glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 5.5f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			float sum = 0.0f;
+			for (size_t i = 0; i < iterations; i++) {
+				glm::mat4 models[4];
+				models[0] = glm::rotate(glm::mat4(1.0f), glm::radians((float)(i % 360)), glm::vec3(0, 1, 0));
+				models[1] = animation->getDodgeMatrix();
+				models[2] = animation->getEliceZMatrix();
+				models[3] = animation->getEliceYMatrix();
+				for (int m = 0; m < 4; m++)
+					sum += glm::inverseTranspose(glm::mat3(view * models[m]))[0][0];
+				animation->step();
+			}
+			benchmarkSink = benchmarkSink + sum;
+		};
+		benchmarks.push_back(benchmark);
+	}
+
+	// the rain placement of one frame, 6000 drops
+	{
+		std::shared_ptr<std::vector<glm::mat4>> drops = std::make_shared<std::vector<glm::mat4>>();
+
+		Microbenchmark benchmark;
+		benchmark.name = "placeRainDrops";
+		benchmark.bytesPerOp = 0.0;
+		benchmark.run = [drops](size_t iterations) {
+			gps::RainGrid grid = gps::defaultRainGrid();
+			for (size_t i = 0; i < iterations; i++)
+				gps::placeRainDrops(grid, -50.0f + (float)(i % 100), *drops);
+			benchmarkSink = benchmarkSink + (*drops)[0][3][1];
+		};
+		benchmarks.push_back(benchmark);
+	}
+
+#ifndef GPS_HAS_TSC
+	fprintf(stdout, "No cycle counter on this platform, cycles/op is reported as 0\n");
+#endif
+	fprintf(stdout, "%-26s %14s %14s %12s %9s %8s\n", "benchmark", "ns/op", "cycles/op", "MB/s", "+-95%", "samples");
+
+	for (size_t b = 0; b < benchmarks.size(); b++) {
+
+		const Microbenchmark& benchmark = benchmarks[b];
+		if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+			continue;
+
+		SampleStats stats = measure(benchmark, options);
+		if (benchmark.bytesPerOp > 0.0)
+			fprintf(stdout, "%-26s %14.1f %14.1f %12.1f %8.1f%% %8d\n", benchmark.name.c_str(), stats.nsPerOp, stats.cyclesPerOp,
+				benchmark.bytesPerOp / stats.nsPerOp * 1000.0, stats.error * 100.0, stats.samples);
+		else
+			fprintf(stdout, "%-26s %14.1f %14.1f %12s %8.1f%% %8d\n", benchmark.name.c_str(), stats.nsPerOp, stats.cyclesPerOp,
+				"-", stats.error * 100.0, stats.samples);
+		fflush(stdout);
+	}
+
+	gps::asyncReader().stop();
+	for (size_t i = 0; i < temporaryFiles.size(); i++)
+		remove(temporaryFiles[i].c_str());
+
+	return EXIT_SUCCESS;
+}
@@ -1,7 +1,28 @@
 #include "Model3D.hpp"
+#include "AssetPackage.hpp"
+#include "GpuResources.hpp"
+#include "TextureStreamer.hpp"
+#include "TextureCompression.hpp"
+#include "GLTrace.hpp"
 
 namespace gps {
 
+	bool Model3D::textureAtlas = false;
+	bool Model3D::textureCompression = false;
+	bool Model3D::materialPacking = false;
+
+	void Model3D::setTextureAtlas(bool enabled) {
+		textureAtlas = enabled;
+	}
+
+	void Model3D::setTextureCompression(bool enabled) {
+		textureCompression = enabled;
+	}
+
+	void Model3D::setMaterialPacking(bool enabled) {
+		materialPacking = enabled;
+	}
+
 	void Model3D::LoadModel(std::string fileName) {
 
         std::string basePath = fileName.substr(0, fileName.find_last_of('/')) + "/";
@@ -13,175 +34,146 @@ namespace gps {
 		ReadOBJ(fileName, basePath);
 	}
 
-	// Draw each mesh from the model
-	void Model3D::Draw(gps::Shader shaderProgram) {
+	// Queues each mesh from the model
+	void Model3D::Draw(gps::RenderQueue& queue, const gps::Shader& shaderProgram, const glm::mat4& modelMatrix) {
 
+		GLuint instance = queue.addInstance(modelMatrix);
 		for (int i = 0; i < meshes.size(); i++)
-			meshes[i].Draw(shaderProgram);
+			queue.submit(meshes[i], shaderProgram, instance);
+	}
+
+	void Model3D::getBounds(glm::vec3& minCorner, glm::vec3& maxCorner) const {
+
+		minCorner = glm::vec3(0.0f);
+		maxCorner = glm::vec3(0.0f);
+		for (size_t i = 0; i < meshes.size(); i++) {
+			glm::vec3 center = meshes[i].getBoundsCenter();
+			glm::vec3 radius(meshes[i].getBoundsRadius());
+			minCorner = i == 0 ? center - radius : glm::min(minCorner, center - radius);
+			maxCorner = i == 0 ? center + radius : glm::max(maxCorner, center + radius);
+		}
 	}
 
 	// Does the parsing of the .obj file and fills in the data structure
 	void Model3D::ReadOBJ(std::string fileName, std::string basePath) {
 
         std::cout << "Loading : " << fileName << std::endl;
-		tinyobj::attrib_t attrib;
-		std::vector<tinyobj::shape_t> shapes;
-		std::vector<tinyobj::material_t> materials;
-		int materialId;
-
-		std::string err;
-		bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, fileName.c_str(), basePath.c_str(), GL_TRUE);
+		GpuOwnerScope owner(fileName);
 
-		if (!err.empty()) {
-
-			// `err` may contain warning message.
-			std::cerr << err << std::endl;
-		}
-
-		if (!ret) {
+		gps::ObjData data;
+		if (!gps::parseOBJ(fileName, basePath, data)) {
 
 			exit(1);
 		}
 
-		std::cout << "# of shapes    : " << shapes.size() << std::endl;
-		std::cout << "# of materials : " << materials.size() << std::endl;
-
-		// Loop over shapes
-		for (size_t s = 0; s < shapes.size(); s++) {
-
-			std::vector<gps::Vertex> vertices;
-			std::vector<GLuint> indices;
-			std::vector<gps::Texture> textures;
-
-			// Loop over faces(polygon)
-			size_t index_offset = 0;
-			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
-
-				int fv = shapes[s].mesh.num_face_vertices[f];
-
-				//gps::Texture currentTexture = LoadTexture("index1.png", "ambientTexture");
-				//textures.push_back(currentTexture);
-
-				// Loop over vertices in the face.
-				for (size_t v = 0; v < fv; v++) {
-
-					// access to vertex
-					tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-
-					float vx = attrib.vertices[3 * idx.vertex_index + 0];
-					float vy = attrib.vertices[3 * idx.vertex_index + 1];
-					float vz = attrib.vertices[3 * idx.vertex_index + 2];
-					float nx = attrib.normals[3 * idx.normal_index + 0];
-					float ny = attrib.normals[3 * idx.normal_index + 1];
-					float nz = attrib.normals[3 * idx.normal_index + 2];
-					float tx = 0.0f;
-					float ty = 0.0f;
-
-					if (idx.texcoord_index != -1) {
-
-						tx = attrib.texcoords[2 * idx.texcoord_index + 0];
-						ty = attrib.texcoords[2 * idx.texcoord_index + 1];
-					}
-
-					glm::vec3 vertexPosition(vx, vy, vz);
-					glm::vec3 vertexNormal(nx, ny, nz);
-					glm::vec2 vertexTexCoords(tx, ty);
-
-					gps::Vertex currentVertex;
-					currentVertex.Position = vertexPosition;
-					currentVertex.Normal = vertexNormal;
-					currentVertex.TexCoords = vertexTexCoords;
-
-					vertices.push_back(currentVertex);
-
-					indices.push_back((GLuint)(index_offset + v));
+		std::cout << "# of shapes    : " << data.meshes.size() << std::endl;
+		std::cout << "# of materials : " << data.materialCount << std::endl;
+
+		// the images of every material are read in one batch while the first ones decode,
+		// streamed textures read their cooked files instead, compressed ones their block files
+		if (!textureStreamer().isEnabled()) {
+			std::vector<std::string> texturePaths;
+			for (size_t s = 0; s < data.meshes.size(); s++) {
+				for (size_t t = 0; t < data.meshes[s].textures.size(); t++) {
+					// packed maps are decoded to be combined, the others load their blocks
+					const gps::TextureFile& texture = data.meshes[s].textures[t];
+					bool packed = materialPacking && (texture.type == "diffuseTexture" || texture.type == "specularTexture");
+					texturePaths.push_back(texture.path + (textureCompression && !packed ? ".bct" : ""));
 				}
-
-				index_offset += fv;
 			}
+			vfs().prefetch(texturePaths);
+		}
 
-			// get material id
-			// Only try to read materials if the .mtl file is present
-			size_t a = shapes[s].mesh.material_ids.size();
-
-			if (a > 0 && materials.size()>0) {
-
-				materialId = shapes[s].mesh.material_ids[0];
-				if (materialId != -1) {
-
-					gps::Material currentMaterial;
-					currentMaterial.ambient = glm::vec3(materials[materialId].ambient[0], materials[materialId].ambient[1], materials[materialId].ambient[2]);
-					currentMaterial.diffuse = glm::vec3(materials[materialId].diffuse[0], materials[materialId].diffuse[1], materials[materialId].diffuse[2]);
-					currentMaterial.specular = glm::vec3(materials[materialId].specular[0], materials[materialId].specular[1], materials[materialId].specular[2]);
-
-					//ambient texture
-					std::string ambientTexturePath = materials[materialId].ambient_texname;
-
-					if (!ambientTexturePath.empty()) {
-
-						gps::Texture currentTexture;
-						currentTexture = LoadTexture(basePath + ambientTexturePath, "ambientTexture");
-						textures.push_back(currentTexture);
-					}
-
-					//diffuse texture
-					std::string diffuseTexturePath = materials[materialId].diffuse_texname;
-
-					if (!diffuseTexturePath.empty()) {
+		// the paths only live while loading, the meshes keep the handles
+		std::unordered_map<std::string, gps::TextureHandle> texturesByPath;
+
+		// the meshes of atlased materials now point to the pages, LoadTexture finds them by path
+		if (textureAtlas) {
+			std::vector<gps::AtlasPage> pages;
+			size_t atlased = gps::buildTextureAtlas(data, fileName, pages);
+			for (size_t p = 0; p < pages.size(); p++)
+				texturesByPath[pages[p].path] = AddTexture(UploadAtlasPage(pages[p]));
+			if (atlased > 0)
+				std::cout << "# in atlases   : " << atlased << " materials, " << pages.size() << " pages" << std::endl;
+		}
 
-						gps::Texture currentTexture;
-						currentTexture = LoadTexture(basePath + diffuseTexturePath, "diffuseTexture");
-						textures.push_back(currentTexture);
-					}
+		// the meshes now point to one texture per material, LoadTexture finds them by path
+		if (materialPacking) {
+			std::vector<gps::PackedMaterialFile> materials;
+			gps::packMaterialTextures(data, materials);
+			// a material whose maps cannot be read keeps the null handle, its path is no file to retry
+			for (size_t m = 0; m < materials.size(); m++)
+				texturesByPath[materials[m].path] = AddTexture(UploadPackedMaterial(materials[m]));
+		}
 
-					//specular texture
-					std::string specularTexturePath = materials[materialId].specular_texname;
+		for (size_t s = 0; s < data.meshes.size(); s++) {
 
-					if (!specularTexturePath.empty()) {
+			std::vector<gps::Texture> textures;
+			for (size_t t = 0; t < data.meshes[s].textures.size(); t++) {
 
-						gps::Texture currentTexture;
-						currentTexture = LoadTexture(basePath + specularTexturePath, "specularTexture");
-						textures.push_back(currentTexture);
-					}
-				}
+				gps::Texture texture;
+				if (!gps::getTextureSlot(data.meshes[s].textures[t].type, texture.slot))
+					continue;
+				texture.handle = LoadTexture(data.meshes[s].textures[t].path, texturesByPath);
+				textures.push_back(texture);
 			}
 
-			meshes.push_back(gps::Mesh(vertices, indices, textures));
+			meshes.push_back(gps::Mesh(data.meshes[s].vertices, data.meshes[s].indices, textures));
 		}
 	}
 
-	// Retrieves a texture associated with the object - by its name and type
-	gps::Texture Model3D::LoadTexture(std::string path, std::string type) {
+	// Retrieves a texture associated with the object - by its name, loading it the first time
+	gps::TextureHandle Model3D::LoadTexture(const std::string& path, std::unordered_map<std::string, gps::TextureHandle>& texturesByPath) {
 
-			for (int i = 0; i < loadedTextures.size(); i++) {
+		std::unordered_map<std::string, gps::TextureHandle>::const_iterator it = texturesByPath.find(path);
+		if (it != texturesByPath.end()) {
 
-				if (loadedTextures[i].path == path)	{
+			//already loaded texture
+			return it->second;
+		}
 
-					//already loaded texture
-					return loadedTextures[i];
-				}
-			}
+		gps::TextureHandle handle = AddTexture(ReadTextureFromFile(path.c_str()));
+		texturesByPath[path] = handle;
+		return handle;
+	}
 
-			gps::Texture currentTexture;
-			currentTexture.id = ReadTextureFromFile(path.c_str());
-			currentTexture.type = std::string(type);
-			currentTexture.path = path;
+	gps::TextureHandle Model3D::AddTexture(GLuint textureID) {
 
-			loadedTextures.push_back(currentTexture);
+		if (textureID == 0)
+			return gps::TextureHandle();
 
-			return currentTexture;
-		}
+		gps::TextureHandle handle = resources().add<RESOURCE_TEXTURE>(textureID);
+		loadedTextures.push_back(handle);
+		return handle;
+	}
 
 	// Reads the pixel data from an image file and loads it into the video memory
 	GLuint Model3D::ReadTextureFromFile(const char* file_name) {
 
+		// streamed textures start at their small levels, the render queue asks for the rest
+		if (textureStreamer().isEnabled()) {
+			GLuint streamed = textureStreamer().load(file_name);
+			if (streamed != 0)
+				return streamed;
+		}
+
+		// the blocks go to the GPU as they are, a quarter or less of the memory of the image
+		if (textureCompression) {
+			GLuint compressed = loadCompressedTexture(file_name);
+			if (compressed != 0)
+				return compressed;
+		}
+
 		int x, y, n;
 		int force_channels = 4;
-		unsigned char* image_data = stbi_load(file_name, &x, &y, &n, force_channels);
+		AssetData file;
+		unsigned char* image_data = NULL;
+		if (vfs().read(file_name, file) && file.size > 0)
+			image_data = stbi_load_from_memory(file.data, (int)file.size, &x, &y, &n, force_channels);
 
 		if (!image_data) {
 			fprintf(stderr, "ERROR: could not load %s\n", file_name);
-			return false;
+			return 0;
 		}
 		// NPOT check
 		if ((x & (x - 1)) != 0 || (y & (y - 1)) != 0) {
@@ -190,30 +182,11 @@ namespace gps {
 			);
 		}
 
-		int width_in_bytes = x * 4;
-		unsigned char *top = NULL;
-		unsigned char *bottom = NULL;
-		unsigned char temp = 0;
-		int half_height = y / 2;
-
-		for (int row = 0; row < half_height; row++) {
-
-			top = image_data + row * width_in_bytes;
-			bottom = image_data + (y - row - 1) * width_in_bytes;
-
-			for (int col = 0; col < width_in_bytes; col++) {
-
-				temp = *top;
-				*top = *bottom;
-				*bottom = temp;
-				top++;
-				bottom++;
-			}
-		}
+		flipImageRows(image_data, x, y, force_channels);
 
 		GLuint textureID;
 		glGenTextures(1, &textureID);
-		glBindTexture(GL_TEXTURE_2D, textureID);
+		glState().bindTexture(0, GL_TEXTURE_2D, textureID);
 		glTexImage2D(
 			GL_TEXTURE_2D,
 			0,
@@ -226,31 +199,91 @@ namespace gps {
 			image_data
 		);
 		glGenerateMipmap(GL_TEXTURE_2D);
+		GPS_GPU_RESOURCE(GPU_TEXTURE, textureID, getTextureBytes(GL_SRGB, x, y, 1, getMipLevels(x, y)), GL_SRGB, "texture");
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glBindTexture(GL_TEXTURE_2D, 0);
+		glState().bindTexture(0, GL_TEXTURE_2D, 0);
+
+		return textureID;
+	}
+
+	GLuint Model3D::UploadAtlasPage(const gps::AtlasPage& page) {
+
+		GLuint textureID;
+		glGenTextures(1, &textureID);
+		glState().bindTexture(0, GL_TEXTURE_2D, textureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB, page.width, page.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &page.pixels[0]);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		GPS_GPU_RESOURCE(GPU_TEXTURE, textureID, getTextureBytes(GL_SRGB, page.width, page.height, 1, getMipLevels(page.width, page.height)),
+			GL_SRGB, "atlas");
+
+		// the whole chain exists, but below ATLAS_MIP_LEVELS the texels mix neighbouring materials
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ATLAS_MIP_LEVELS - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glState().bindTexture(0, GL_TEXTURE_2D, 0);
+
+		return textureID;
+	}
+
+	GLuint Model3D::UploadPackedMaterial(const gps::PackedMaterialFile& material) {
+
+		int width, height;
+		std::vector<unsigned char> pixels;
+		if (!gps::buildPackedMaterial(material, width, height, pixels))
+			return 0;
+
+		// the pair has no file of its own to cook, the blocks are encoded on every load
+		if (textureCompression) {
+			GLuint compressed = createCompressedTexture(&pixels[0], width, height, "packed material");
+			if (compressed != 0)
+				return compressed;
+		}
+
+		// sRGB applies to the color only, the specular mask in alpha stays linear
+		GLuint textureID;
+		glGenTextures(1, &textureID);
+		glState().bindTexture(0, GL_TEXTURE_2D, textureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB_ALPHA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		GPS_GPU_RESOURCE(GPU_TEXTURE, textureID, getTextureBytes(GL_SRGB_ALPHA, width, height, 1, getMipLevels(width, height)),
+			GL_SRGB_ALPHA, "packed material");
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glState().bindTexture(0, GL_TEXTURE_2D, 0);
 
 		return textureID;
 	}
 
 	Model3D::~Model3D() {
 
+		Delete();
+	}
+
+	void Model3D::Delete() {
+
+        // the objects go once the frames in flight are done with them, see ResourceManager
         for (size_t i = 0; i < loadedTextures.size(); i++) {
 
-            glDeleteTextures(1, &loadedTextures.at(i).id);
+            // streamed textures are deleted by the streamer itself
+            if (textureStreamer().release(resources().get(loadedTextures.at(i))))
+                resources().forget(loadedTextures.at(i));
+            else
+                resources().destroy(loadedTextures.at(i));
         }
 
-        for (size_t i = 0; i < meshes.size(); i++) {
+        for (size_t i = 0; i < meshes.size(); i++)
+            meshes.at(i).Delete();
 
-            GLuint VBO = meshes.at(i).getBuffers().VBO;
-            GLuint EBO = meshes.at(i).getBuffers().EBO;
-            GLuint VAO = meshes.at(i).getBuffers().VAO;
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
-            glDeleteVertexArrays(1, &VAO);
-        }
+        loadedTextures.clear();
+        meshes.clear();
 	}
 }
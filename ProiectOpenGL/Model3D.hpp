@@ -2,12 +2,16 @@
 #define Model3D_hpp
 
 #include "Mesh.hpp"
+#include "RenderQueue.hpp"
+#include "ModelLoader.hpp"
+#include "TextureAtlas.hpp"
+#include "MaterialPacking.hpp"
 
-#include "tiny_obj_loader.h"
 #include "stb_image.h"
 
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace gps {
@@ -17,26 +21,54 @@ namespace gps {
     public:
         ~Model3D();
 
+		// Deletes the textures and buffers of the model, the destructor runs too late for a GL context
+		void Delete();
+
 		void LoadModel(std::string fileName);
 
 		void LoadModel(std::string fileName, std::string basePath);
 
-		void Draw(gps::Shader shaderProgram);
+		// Queues every mesh of the model with the given model matrix
+		void Draw(gps::RenderQueue& queue, const gps::Shader& shaderProgram, const glm::mat4& modelMatrix);
+
+		// Box around the bounding spheres of the meshes, in model space
+		void getBounds(glm::vec3& minCorner, glm::vec3& maxCorner) const;
+
+		// Packs the small textures of the models loaded afterwards into atlases, see TextureAtlas.hpp
+		static void setTextureAtlas(bool enabled);
+		// Uploads the textures loaded afterwards as BC1 or BC3 blocks, see TextureCompression.hpp
+		static void setTextureCompression(bool enabled);
+		// Loads the diffuse and specular map of every material as one texture, for the shaders
+		// built with PACKED_MATERIALS, see MaterialPacking.hpp
+		static void setMaterialPacking(bool enabled);
 
     private:
 		// Component meshes - group of objects
         std::vector<gps::Mesh> meshes;
-		// Associated textures
-        std::vector<gps::Texture> loadedTextures;
+		// Textures the model owns, each one once however many meshes use it
+        std::vector<gps::TextureHandle> loadedTextures;
 
 		// Does the parsing of the .obj file and fills in the data structure
 		void ReadOBJ(std::string fileName, std::string basePath);
 
-		// Retrieves a texture associated with the object - by its name and type
-		gps::Texture LoadTexture(std::string path, std::string type);
+		// Retrieves a texture associated with the object - by its name, loading it the first time
+		gps::TextureHandle LoadTexture(const std::string& path, std::unordered_map<std::string, gps::TextureHandle>& texturesByPath);
+
+		// Takes over a loaded texture, the null handle when it could not be loaded
+		gps::TextureHandle AddTexture(GLuint textureID);
 
 		// Reads the pixel data from an image file and loads it into the video memory
 		GLuint ReadTextureFromFile(const char* file_name);
+
+		// Uploads an atlas page, with only the mip levels its gutters keep apart
+		GLuint UploadAtlasPage(const gps::AtlasPage& page);
+
+		// Uploads the diffuse color and specular mask of a material, 0 when its maps cannot be read
+		GLuint UploadPackedMaterial(const gps::PackedMaterialFile& material);
+
+		static bool textureAtlas;
+		static bool textureCompression;
+		static bool materialPacking;
     };
 }
 
@@ -0,0 +1,210 @@
+#include "ModelLoader.hpp"
+#include "AssetPackage.hpp"
+
+#include "tiny_obj_loader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <streambuf>
+
+namespace gps {
+
+	// Stream over the bytes of an asset, tinyobj parses them where they are
+	class AssetStreamBuffer : public std::streambuf {
+
+	public:
+		AssetStreamBuffer(const AssetData& asset) {
+			// the get area is only read from
+			char* begin = (char*)asset.data;
+			setg(begin, begin, begin + asset.size);
+		}
+	};
+
+	// Loads the material libraries of a model through the asset file system
+	class AssetMaterialReader : public tinyobj::MaterialReader {
+
+	public:
+		explicit AssetMaterialReader(const std::string& basePath) : basePath(basePath) {}
+
+		virtual bool operator()(const std::string& matId, std::vector<tinyobj::material_t>* materials,
+			std::map<std::string, int>* matMap, std::string* err) {
+
+			// like tinyobj, a missing library still gets the default material
+			AssetData file;
+			if (!vfs().read(basePath + matId, file) && err != NULL)
+				*err += "WARN: Material file [ " + basePath + matId + " ] not found. Created a default material.";
+			AssetStreamBuffer buffer(file);
+			std::istream stream(&buffer);
+			tinyobj::LoadMtl(matMap, materials, &stream);
+			return true;
+		}
+
+	private:
+		std::string basePath;
+	};
+
+	bool parseOBJ(const std::string& fileName, const std::string& basePath, gps::ObjData& data) {
+
+		tinyobj::attrib_t attrib;
+		std::vector<tinyobj::shape_t> shapes;
+		std::vector<tinyobj::material_t> materials;
+		int materialId;
+
+		AssetData file;
+		if (!vfs().read(fileName, file)) {
+			std::cerr << "Cannot open file [" << fileName << "]" << std::endl;
+			return false;
+		}
+		AssetStreamBuffer buffer(file);
+		std::istream stream(&buffer);
+		AssetMaterialReader materialReader(basePath);
+
+		std::string err;
+		bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &stream, &materialReader, GL_TRUE);
+
+		if (!err.empty()) {
+
+			// `err` may contain warning message.
+			std::cerr << err << std::endl;
+		}
+
+		if (!ret)
+			return false;
+
+		data.meshes.clear();
+		data.meshes.resize(shapes.size());
+		data.materialCount = materials.size();
+
+		// Loop over shapes
+		for (size_t s = 0; s < shapes.size(); s++) {
+
+			std::vector<gps::Vertex>& vertices = data.meshes[s].vertices;
+			std::vector<GLuint>& indices = data.meshes[s].indices;
+			std::vector<gps::TextureFile>& textures = data.meshes[s].textures;
+
+			// Loop over faces(polygon)
+			size_t index_offset = 0;
+			for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++) {
+
+				int fv = shapes[s].mesh.num_face_vertices[f];
+
+				// Loop over vertices in the face.
+				for (size_t v = 0; v < fv; v++) {
+
+					// access to vertex
+					tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
+
+					float vx = attrib.vertices[3 * idx.vertex_index + 0];
+					float vy = attrib.vertices[3 * idx.vertex_index + 1];
+					float vz = attrib.vertices[3 * idx.vertex_index + 2];
+					float nx = attrib.normals[3 * idx.normal_index + 0];
+					float ny = attrib.normals[3 * idx.normal_index + 1];
+					float nz = attrib.normals[3 * idx.normal_index + 2];
+					float tx = 0.0f;
+					float ty = 0.0f;
+
+					if (idx.texcoord_index != -1) {
+
+						tx = attrib.texcoords[2 * idx.texcoord_index + 0];
+						ty = attrib.texcoords[2 * idx.texcoord_index + 1];
+					}
+
+					gps::Vertex currentVertex;
+					currentVertex.Position = glm::vec3(vx, vy, vz);
+					currentVertex.Normal = glm::vec3(nx, ny, nz);
+					currentVertex.TexCoords = glm::vec2(tx, ty);
+
+					vertices.push_back(currentVertex);
+
+					indices.push_back((GLuint)(index_offset + v));
+				}
+
+				index_offset += fv;
+			}
+
+			// get material id
+			// Only try to read materials if the .mtl file is present
+			size_t a = shapes[s].mesh.material_ids.size();
+
+			if (a > 0 && materials.size() > 0) {
+
+				materialId = shapes[s].mesh.material_ids[0];
+				if (materialId != -1) {
+
+					const tinyobj::material_t& material = materials[materialId];
+					const std::string* texturePaths[] = { &material.ambient_texname, &material.diffuse_texname, &material.specular_texname };
+					const char* textureTypes[] = { "ambientTexture", "diffuseTexture", "specularTexture" };
+
+					for (int t = 0; t < 3; t++) {
+
+						if (!texturePaths[t]->empty()) {
+
+							gps::TextureFile texture;
+							texture.path = basePath + *texturePaths[t];
+							texture.type = textureTypes[t];
+							textures.push_back(texture);
+						}
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	void flipImageRows(unsigned char* pixels, int width, int height, int channels) {
+
+		int width_in_bytes = width * channels;
+		unsigned char *top = NULL;
+		unsigned char *bottom = NULL;
+		unsigned char temp = 0;
+		int half_height = height / 2;
+
+		for (int row = 0; row < half_height; row++) {
+
+			top = pixels + row * width_in_bytes;
+			bottom = pixels + (height - row - 1) * width_in_bytes;
+
+			for (int col = 0; col < width_in_bytes; col++) {
+
+				temp = *top;
+				*top = *bottom;
+				*bottom = temp;
+				top++;
+				bottom++;
+			}
+		}
+	}
+
+	void downsampleSrgb(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& result) {
+
+		static float toLinear[256];
+		static bool tableReady = false;
+		if (!tableReady) {
+			for (int i = 0; i < 256; i++) {
+				float value = i / 255.0f;
+				toLinear[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+			}
+			tableReady = true;
+		}
+
+		int resultWidth = std::max(width / 2, 1);
+		int resultHeight = std::max(height / 2, 1);
+		result.resize((size_t)resultWidth * resultHeight * channels);
+
+		for (int y = 0; y < resultHeight; y++) {
+			const unsigned char* row0 = pixels + (size_t)std::min(2 * y, height - 1) * width * channels;
+			const unsigned char* row1 = pixels + (size_t)std::min(2 * y + 1, height - 1) * width * channels;
+			for (int x = 0; x < resultWidth; x++) {
+				int x0 = std::min(2 * x, width - 1) * channels;
+				int x1 = std::min(2 * x + 1, width - 1) * channels;
+				for (int c = 0; c < channels; c++) {
+					float linear = (toLinear[row0[x0 + c]] + toLinear[row0[x1 + c]] + toLinear[row1[x0 + c]] + toLinear[row1[x1 + c]]) * 0.25f;
+					float value = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+					result[((size_t)y * resultWidth + x) * channels + c] = (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef ModelLoader_hpp
+#define ModelLoader_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include "Mesh.hpp"
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Texture a material refers to, not loaded yet
+    struct TextureFile {
+        std::string path;
+        //ambientTexture, diffuseTexture, specularTexture
+        std::string type;
+    };
+
+    // One shape of an .obj file, ready to be uploaded
+    struct MeshData {
+        std::vector<gps::Vertex> vertices;
+        std::vector<GLuint> indices;
+        std::vector<gps::TextureFile> textures;
+    };
+
+    struct ObjData {
+        std::vector<gps::MeshData> meshes;
+        size_t materialCount;
+    };
+
+    // CPU half of the model loading, nothing here touches GL so it can run without a context
+
+    // Parses an .obj file and its materials, texture paths are prefixed with basePath
+    bool parseOBJ(const std::string& fileName, const std::string& basePath, gps::ObjData& data);
+
+    // Flips an image upside down in place, images are stored top row first and GL expects the bottom row first
+    void flipImageRows(unsigned char* pixels, int width, int height, int channels);
+
+    // Next mip level of an 8 bit sRGB image, each texel averages a 2x2 block in linear space.
+    // Odd sizes repeat their last row or column
+    void downsampleSrgb(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& result);
+}
+
+#endif /* ModelLoader_hpp */
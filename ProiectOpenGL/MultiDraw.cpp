@@ -0,0 +1,280 @@
+#include "MultiDraw.hpp"
+#include "GLState.hpp"
+#include "GpuResources.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace gps {
+
+	bool MultiDrawBatcher::isSupported() {
+
+#if defined (__APPLE__)
+		// macOS stops at GL 4.1
+		return false;
+#else
+		// the _mdi shaders are #version 430, the extensions alone do not compile them
+		return GLEW_VERSION_4_3;
+#endif
+	}
+
+	MultiDrawBatcher::MultiDrawBatcher() {
+
+		initialized = false;
+		vao = 0;
+		vertexBuffer = 0;
+		indexBuffer = 0;
+		drawIdBuffer = 0;
+		drawIdCapacity = 0;
+		materialBuffer = 0;
+		textureArrays = NULL;
+		commandOffset = 0;
+		totalVertices = 0;
+		totalIndices = 0;
+		geometryDirty = false;
+	}
+
+	void MultiDrawBatcher::setTextureArrays(gps::TextureArrayPool* pool) {
+		this->textureArrays = pool;
+	}
+
+	gps::TextureArrayPool* MultiDrawBatcher::getTextureArrays() const {
+		return textureArrays;
+	}
+
+	void MultiDrawBatcher::init() {
+
+		GpuOwnerScope owner("multi-draw");
+		glGenVertexArrays(1, &vao);
+		glGenBuffers(1, &vertexBuffer);
+		glGenBuffers(1, &indexBuffer);
+		glGenBuffers(1, &drawIdBuffer);
+		drawDataRing.init(GL_SHADER_STORAGE_BUFFER, 256 * 1024);
+		commandRing.init(GL_DRAW_INDIRECT_BUFFER, 64 * 1024);
+
+		// same layout as Mesh::setupMesh, plus the draw id
+		glState().bindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords));
+
+		// one id per instance, each command starts reading at its base instance
+		glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+		glEnableVertexAttribArray(DRAW_ID_ATTRIBUTE);
+		glVertexAttribIPointer(DRAW_ID_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+		glVertexAttribDivisor(DRAW_ID_ATTRIBUTE, 1);
+
+		// the layers are constant over a mesh, but per vertex they need no extra indirection
+		if (textureArrays != NULL) {
+			glGenBuffers(1, &materialBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, materialBuffer);
+			glEnableVertexAttribArray(MATERIAL_LAYERS_ATTRIBUTE);
+			glVertexAttribIPointer(MATERIAL_LAYERS_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+		}
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glState().bindVertexArray(0);
+
+		GPS_GPU_RESOURCE(GPU_VERTEX_ARRAY, vao, 0, GL_NONE, "geometry");
+		initialized = true;
+	}
+
+	void MultiDrawBatcher::begin() {
+
+		commands.clear();
+		drawData.clear();
+	}
+
+	GLuint MultiDrawBatcher::addDrawData(const glm::mat4& modelMatrix, const glm::mat4& normalMatrix) {
+
+		DrawData data;
+		data.model = modelMatrix;
+		data.normalMatrix = normalMatrix;
+		drawData.push_back(data);
+
+		return (GLuint)(drawData.size() - 1);
+	}
+
+	const MultiDrawBatcher::MeshRange& MultiDrawBatcher::getRange(const gps::Mesh& mesh) {
+
+		std::unordered_map<const gps::Mesh*, GLuint>::const_iterator it = meshRanges.find(&mesh);
+		if (it != meshRanges.end())
+			return ranges[it->second];
+
+		// first time this mesh is drawn, it is appended to the shared buffers before the next draw
+		MeshRange range;
+		range.firstIndex = totalIndices;
+		range.baseVertex = (GLint)totalVertices;
+		range.indexCount = (GLuint)mesh.getIndexCount();
+
+		totalVertices += (GLuint)mesh.getVertexCount();
+		totalIndices += range.indexCount;
+
+		meshes.push_back(&mesh);
+		ranges.push_back(range);
+		meshRanges[&mesh] = (GLuint)(ranges.size() - 1);
+		geometryDirty = true;
+
+		if (textureArrays != NULL) {
+			textureArrays->addTexture(mesh.getTexture(TEXTURE_DIFFUSE));
+			textureArrays->addTexture(mesh.getTexture(TEXTURE_SPECULAR));
+		}
+
+		return ranges.back();
+	}
+
+	GLuint MultiDrawBatcher::addCommand(const gps::Mesh& mesh, GLuint drawDataIndex) {
+
+		const MeshRange& range = getRange(mesh);
+
+		DrawElementsIndirectCommand command;
+		command.count = range.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = range.baseVertex;
+		command.baseInstance = drawDataIndex;
+		commands.push_back(command);
+
+		return (GLuint)(commands.size() - 1);
+	}
+
+	void MultiDrawBatcher::uploadGeometry() {
+
+		// rebuilt on the GPU from the meshes' own buffers, this only happens while new models show up
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, totalVertices * sizeof(Vertex), NULL, GL_STATIC_DRAW);
+
+		glState().bindVertexArray(vao);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalIndices * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+		GPS_GPU_RESOURCE(GPU_BUFFER, vertexBuffer, totalVertices * sizeof(Vertex), GL_ARRAY_BUFFER, "multi-draw/geometry");
+		GPS_GPU_RESOURCE(GPU_BUFFER, indexBuffer, totalIndices * sizeof(GLuint), GL_ELEMENT_ARRAY_BUFFER, "multi-draw/geometry");
+
+		for (size_t i = 0; i < meshes.size(); i++) {
+
+			const gps::Mesh& mesh = *meshes[i];
+			const MeshRange& range = ranges[i];
+			Buffers buffers = mesh.getBuffers();
+			// deleted meshes leave their range empty
+			if (buffers.VBO == 0 || buffers.EBO == 0 || range.indexCount == 0)
+				continue;
+
+			glBindBuffer(GL_COPY_READ_BUFFER, buffers.VBO);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, range.baseVertex * sizeof(Vertex),
+				mesh.getVertexCount() * sizeof(Vertex));
+			glBindBuffer(GL_COPY_READ_BUFFER, buffers.EBO);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0, range.firstIndex * sizeof(GLuint),
+				range.indexCount * sizeof(GLuint));
+		}
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+		if (textureArrays != NULL)
+			uploadMaterialLayers();
+
+		geometryDirty = false;
+	}
+
+	void MultiDrawBatcher::uploadMaterialLayers() {
+
+		std::vector<GLuint> layers(totalVertices);
+		for (size_t i = 0; i < meshes.size(); i++) {
+
+			const gps::Mesh& mesh = *meshes[i];
+			GLuint packed = textureArrays->getLayer(mesh.getTexture(TEXTURE_DIFFUSE)) |
+				(textureArrays->getLayer(mesh.getTexture(TEXTURE_SPECULAR)) << 16);
+			std::fill(layers.begin() + ranges[i].baseVertex, layers.begin() + ranges[i].baseVertex + mesh.getVertexCount(), packed);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, materialBuffer);
+		glBufferData(GL_ARRAY_BUFFER, layers.size() * sizeof(GLuint), layers.empty() ? NULL : &layers[0], GL_STATIC_DRAW);
+		GPS_GPU_RESOURCE(GPU_BUFFER, materialBuffer, layers.size() * sizeof(GLuint), GL_ARRAY_BUFFER, "multi-draw/material layers");
+	}
+
+	void MultiDrawBatcher::ensureDrawIds(GLuint count) {
+
+		if (count <= drawIdCapacity)
+			return;
+
+		GLuint capacity = drawIdCapacity > 0 ? drawIdCapacity : 1024;
+		while (capacity < count)
+			capacity *= 2;
+
+		std::vector<GLuint> ids(capacity);
+		for (GLuint i = 0; i < capacity; i++)
+			ids[i] = i;
+
+		glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+		glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(GLuint), &ids[0], GL_STATIC_DRAW);
+		GPS_GPU_RESOURCE(GPU_BUFFER, drawIdBuffer, capacity * sizeof(GLuint), GL_ARRAY_BUFFER, "multi-draw/draw ids");
+		drawIdCapacity = capacity;
+	}
+
+	void MultiDrawBatcher::upload() {
+
+		if (!initialized)
+			init();
+
+		// new textures move the layers of the meshes already in the buffers
+		if (textureArrays != NULL && textureArrays->update())
+			geometryDirty = true;
+
+		if (geometryDirty)
+			uploadGeometry();
+
+		ensureDrawIds((GLuint)drawData.size());
+
+		// the previous frames may still be reading their sections of the rings
+		if (!drawData.empty()) {
+			GLsizeiptr size = drawData.size() * sizeof(DrawData);
+			GLintptr offset = 0;
+			void* data = drawDataRing.map(size, offset);
+			if (data != NULL) {
+				memcpy(data, &drawData[0], size);
+				drawDataRing.unmap();
+				glBindBufferRange(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataRing.getBuffer(), offset, size);
+			}
+		}
+
+		if (!commands.empty()) {
+			GLsizeiptr size = commands.size() * sizeof(DrawElementsIndirectCommand);
+			void* data = commandRing.map(size, commandOffset);
+			if (data != NULL) {
+				memcpy(data, &commands[0], size);
+				commandRing.unmap();
+			}
+		}
+	}
+
+	void MultiDrawBatcher::draw(GLuint firstCommand, GLuint commandCount) {
+
+		glState().bindVertexArray(vao);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandRing.getBuffer());
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+			(const GLvoid*)(commandOffset + firstCommand * sizeof(DrawElementsIndirectCommand)), commandCount, 0);
+	}
+
+	void MultiDrawBatcher::Delete() {
+
+		if (!initialized)
+			return;
+
+		glState().deleteVertexArray(vao);
+		glDeleteBuffers(1, &vertexBuffer);
+		glDeleteBuffers(1, &indexBuffer);
+		glDeleteBuffers(1, &drawIdBuffer);
+		glDeleteBuffers(1, &materialBuffer);
+		gpuResources().remove(GPU_VERTEX_ARRAY, vao);
+		gpuResources().remove(GPU_BUFFER, vertexBuffer);
+		gpuResources().remove(GPU_BUFFER, indexBuffer);
+		gpuResources().remove(GPU_BUFFER, drawIdBuffer);
+		gpuResources().remove(GPU_BUFFER, materialBuffer);
+		materialBuffer = 0;
+		drawDataRing.Delete();
+		commandRing.Delete();
+		initialized = false;
+	}
+}
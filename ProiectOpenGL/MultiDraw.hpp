@@ -0,0 +1,121 @@
+#ifndef MultiDraw_hpp
+#define MultiDraw_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "Mesh.hpp"
+#include "FrameRing.hpp"
+#include "TextureArrays.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace gps {
+
+    // Layout expected by glMultiDrawElementsIndirect
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    // Per instance data read by the _mdi vertex shaders, std430 layout
+    struct DrawData {
+        glm::mat4 model;
+        // mat3 columns are padded to vec4 in std430, a mat4 keeps both sides simple
+        glm::mat4 normalMatrix;
+    };
+
+    // GL 4.3 backend of the render queue: all meshes live in one vertex/index buffer, so a run of
+    // packets sharing program and textures goes out in a single glMultiDrawElementsIndirect call
+    class MultiDrawBatcher {
+
+    public:
+        // Shader storage binding of the DrawData array
+        static const GLuint DRAW_DATA_BINDING = 0;
+        // Vertex attribute carrying the DrawData index, sourced from the base instance
+        static const GLuint DRAW_ID_ATTRIBUTE = 3;
+        // Vertex attribute with the texture array layers of the mesh, diffuse in the low 16 bits
+        static const GLuint MATERIAL_LAYERS_ATTRIBUTE = 4;
+
+        // True on GL 4.3 contexts, which have multi-draw indirect, base instance, shader storage buffers
+        // and the GLSL version of the _mdi shaders
+        static bool isSupported();
+
+        MultiDrawBatcher();
+
+        // Pools the diffuse and specular textures of the meshes it draws, set before the first pass
+        void setTextureArrays(gps::TextureArrayPool* pool);
+        gps::TextureArrayPool* getTextureArrays() const;
+
+        // Clears the commands and the draw data of the previous pass
+        void begin();
+
+        // Returns the index the commands of this instance should point to
+        GLuint addDrawData(const glm::mat4& modelMatrix, const glm::mat4& normalMatrix);
+
+        // Returns the index of the command in the pass
+        GLuint addCommand(const gps::Mesh& mesh, GLuint drawDataIndex);
+
+        // Sends the geometry of new meshes, the draw data and the commands to the GPU
+        void upload();
+
+        // Issues one multi-draw call for a range of commands, the program and textures must be bound
+        void draw(GLuint firstCommand, GLuint commandCount);
+
+        void Delete();
+
+    private:
+        struct MeshRange {
+            GLuint firstIndex;
+            GLint baseVertex;
+            GLuint indexCount;
+        };
+
+        bool initialized;
+
+        GLuint vao;
+        GLuint vertexBuffer;
+        GLuint indexBuffer;
+        GLuint drawIdBuffer;
+        GLuint drawIdCapacity;
+        GLuint materialBuffer;
+
+        gps::TextureArrayPool* textureArrays;
+
+        // rewritten every pass, one section per frame in flight
+        gps::FrameRing drawDataRing;
+        gps::FrameRing commandRing;
+        GLintptr commandOffset;
+
+        // meshes already copied in the shared buffers
+        std::vector<const gps::Mesh*> meshes;
+        std::vector<MeshRange> ranges;
+        std::unordered_map<const gps::Mesh*, GLuint> meshRanges;
+        GLuint totalVertices;
+        GLuint totalIndices;
+        bool geometryDirty;
+
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<DrawData> drawData;
+
+        void init();
+        const MeshRange& getRange(const gps::Mesh& mesh);
+        void uploadGeometry();
+        // Packed layers of every vertex, rewritten with the geometry
+        void uploadMaterialLayers();
+        void ensureDrawIds(GLuint count);
+    };
+}
+
+#endif /* MultiDraw_hpp */
@@ -0,0 +1,311 @@
+#include "Profiler.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+namespace gps {
+
+	static const std::chrono::steady_clock::time_point profilerStart = std::chrono::steady_clock::now();
+
+	static double averageOf(const double* samples, int count) {
+
+		if (count == 0)
+			return 0.0;
+		int n = count < ProfileScopeStats::WINDOW ? count : ProfileScopeStats::WINDOW;
+		double sum = 0.0;
+		for (int i = 0; i < n; i++)
+			sum += samples[i];
+		return sum / n;
+	}
+
+	static double maxOf(const double* samples, int count) {
+
+		int n = count < ProfileScopeStats::WINDOW ? count : ProfileScopeStats::WINDOW;
+		double result = 0.0;
+		for (int i = 0; i < n; i++) {
+			if (samples[i] > result)
+				result = samples[i];
+		}
+		return result;
+	}
+
+	double ProfileScopeStats::averageCpuMs() const {
+		return averageOf(cpuMs, cpuSamples);
+	}
+
+	double ProfileScopeStats::maxCpuMs() const {
+		return maxOf(cpuMs, cpuSamples);
+	}
+
+	double ProfileScopeStats::averageGpuMs() const {
+		return averageOf(gpuMs, gpuSamples);
+	}
+
+	double ProfileScopeStats::maxGpuMs() const {
+		return maxOf(gpuMs, gpuSamples);
+	}
+
+	Profiler::Profiler() {
+
+		enabled = true;
+		initialized = false;
+		inFrame = false;
+		frameIndex = 0;
+		depth = 0;
+		currentFrame = 0;
+		gpuToCpuOffset = 0.0;
+		capturing = false;
+		droppedFrames = 0;
+		for (int i = 0; i < QUERY_FRAMES; i++) {
+			frames[i].pending = false;
+			for (int q = 0; q < 2 * MAX_SCOPES_PER_FRAME; q++)
+				frames[i].queries[q] = 0;
+		}
+	}
+
+	void Profiler::init() {
+
+		for (int i = 0; i < QUERY_FRAMES; i++) {
+			glGenQueries(2 * MAX_SCOPES_PER_FRAME, frames[i].queries);
+			frames[i].events.reserve(MAX_SCOPES_PER_FRAME);
+		}
+
+		// puts the GPU timestamps on the CPU timeline, close enough for a trace view
+		GLint64 gpuTime = 0;
+		glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+		gpuToCpuOffset = gpuTime / 1000.0 - cpuNow();
+
+		initialized = true;
+	}
+
+	double Profiler::cpuNow() const {
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - profilerStart).count();
+	}
+
+	void Profiler::setEnabled(bool enabled) {
+		this->enabled = enabled;
+	}
+
+	bool Profiler::isEnabled() const {
+		return enabled;
+	}
+
+	void Profiler::beginFrame() {
+
+		if (!enabled)
+			return;
+		if (!initialized)
+			init();
+
+		currentFrame = frameIndex % QUERY_FRAMES;
+		FrameRecord& frame = frames[currentFrame];
+
+		// the queries are about to be reused, a frame the GPU has not finished yet loses its GPU times
+		if (!resolveFrame(frame, false)) {
+			frame.pending = false;
+			droppedFrames++;
+		}
+
+		frame.events.clear();
+		depth = 0;
+		inFrame = true;
+	}
+
+	void Profiler::endFrame() {
+
+		if (!inFrame)
+			return;
+		inFrame = false;
+
+		FrameRecord& frame = frames[currentFrame];
+		for (size_t i = 0; i < frame.events.size(); i++)
+			record(frame.events[i], false);
+		frame.pending = !frame.events.empty();
+		frameIndex++;
+
+		// collect whatever the GPU already finished, without waiting for the rest
+		for (int i = 0; i < QUERY_FRAMES; i++) {
+			if (i != currentFrame)
+				resolveFrame(frames[i], false);
+		}
+	}
+
+	int Profiler::beginScope(const char* name) {
+
+		if (!inFrame)
+			return -1;
+
+		FrameRecord& frame = frames[currentFrame];
+		if ((int)frame.events.size() >= MAX_SCOPES_PER_FRAME)
+			return -1;
+
+		int index = (int)frame.events.size();
+
+		ProfileEvent event;
+		event.name = name;
+		event.depth = depth++;
+		event.cpuBegin = cpuNow();
+		event.cpuEnd = event.cpuBegin;
+		event.gpuBegin = 0.0;
+		event.gpuEnd = 0.0;
+		event.hasGpu = false;
+		frame.events.push_back(event);
+
+		glQueryCounter(frame.queries[2 * index], GL_TIMESTAMP);
+		return index;
+	}
+
+	void Profiler::endScope(int index) {
+
+		if (index < 0 || !inFrame)
+			return;
+
+		FrameRecord& frame = frames[currentFrame];
+		glQueryCounter(frame.queries[2 * index + 1], GL_TIMESTAMP);
+		frame.events[index].cpuEnd = cpuNow();
+		depth--;
+	}
+
+	bool Profiler::resolveFrame(FrameRecord& frame, bool wait) {
+
+		if (!frame.pending)
+			return true;
+
+		// the last query was issued last, when it is ready the others are too
+		GLuint lastQuery = frame.queries[2 * frame.events.size() - 1];
+		if (!wait) {
+			GLuint available = 0;
+			glGetQueryObjectuiv(lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+				return false;
+		}
+
+		for (size_t i = 0; i < frame.events.size(); i++) {
+
+			GLuint64 begin = 0;
+			GLuint64 end = 0;
+			glGetQueryObjectui64v(frame.queries[2 * i], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(frame.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+
+			ProfileEvent& event = frame.events[i];
+			event.gpuBegin = begin / 1000.0 - gpuToCpuOffset;
+			event.gpuEnd = end / 1000.0 - gpuToCpuOffset;
+			event.hasGpu = true;
+			record(event, true);
+		}
+
+		frame.pending = false;
+		return true;
+	}
+
+	ProfileScopeStats& Profiler::getStats(const char* name) {
+
+		for (size_t i = 0; i < stats.size(); i++) {
+			if (stats[i].name == name || strcmp(stats[i].name, name) == 0)
+				return stats[i];
+		}
+
+		ProfileScopeStats scopeStats;
+		memset(&scopeStats, 0, sizeof(scopeStats));
+		scopeStats.name = name;
+		stats.push_back(scopeStats);
+		return stats.back();
+	}
+
+	void Profiler::record(const ProfileEvent& event, bool gpu) {
+
+		ProfileScopeStats& scopeStats = getStats(event.name);
+		if (gpu)
+			scopeStats.gpuMs[scopeStats.gpuSamples++ % ProfileScopeStats::WINDOW] = (event.gpuEnd - event.gpuBegin) / 1000.0;
+		else
+			scopeStats.cpuMs[scopeStats.cpuSamples++ % ProfileScopeStats::WINDOW] = (event.cpuEnd - event.cpuBegin) / 1000.0;
+
+		if (capturing && traceEvents.size() < MAX_TRACE_EVENTS) {
+			// hasGpu tells which timeline the trace entry belongs to
+			ProfileEvent traceEvent = event;
+			traceEvent.hasGpu = gpu;
+			traceEvents.push_back(traceEvent);
+		}
+	}
+
+	void Profiler::startCapture() {
+
+		traceEvents.clear();
+		capturing = true;
+	}
+
+	bool Profiler::isCapturing() const {
+		return capturing;
+	}
+
+	bool Profiler::writeTrace(const char* fileName) {
+
+		// the frames still on the GPU belong to the capture, wait for them once
+		for (int i = 0; i < QUERY_FRAMES; i++)
+			resolveFrame(frames[i], true);
+		capturing = false;
+
+		FILE* file = fopen(fileName, "w");
+		if (file == NULL) {
+			fprintf(stderr, "ERROR: could not write the trace to %s\n", fileName);
+			return false;
+		}
+
+		fprintf(file, "{\"traceEvents\":[\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+
+		for (size_t i = 0; i < traceEvents.size(); i++) {
+
+			const ProfileEvent& event = traceEvents[i];
+			double begin = event.hasGpu ? event.gpuBegin : event.cpuBegin;
+			double end = event.hasGpu ? event.gpuEnd : event.cpuEnd;
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+				event.name, event.hasGpu ? "gpu" : "cpu", begin, end - begin, event.hasGpu ? 2 : 1);
+		}
+
+		fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+		fclose(file);
+
+		fprintf(stdout, "Wrote %u trace events to %s\n", (unsigned int)traceEvents.size(), fileName);
+		traceEvents.clear();
+		return true;
+	}
+
+	void Profiler::printStats() const {
+
+		fprintf(stdout, "Profile over the last %d frames (%u frames without GPU times):\n",
+			ProfileScopeStats::WINDOW, droppedFrames);
+		for (size_t i = 0; i < stats.size(); i++) {
+
+			const ProfileScopeStats& scopeStats = stats[i];
+			fprintf(stdout, "  %-16s cpu %7.3f ms (max %7.3f)  gpu %7.3f ms (max %7.3f)\n", scopeStats.name,
+				scopeStats.averageCpuMs(), scopeStats.maxCpuMs(), scopeStats.averageGpuMs(), scopeStats.maxGpuMs());
+		}
+	}
+
+	void Profiler::Delete() {
+
+		if (!initialized)
+			return;
+
+		for (int i = 0; i < QUERY_FRAMES; i++)
+			glDeleteQueries(2 * MAX_SCOPES_PER_FRAME, frames[i].queries);
+		initialized = false;
+	}
+
+	Profiler& profiler() {
+
+		static Profiler instance;
+		return instance;
+	}
+
+	ProfileScope::ProfileScope(const char* name) {
+		index = profiler().beginScope(name);
+	}
+
+	ProfileScope::~ProfileScope() {
+		profiler().endScope(index);
+	}
+}
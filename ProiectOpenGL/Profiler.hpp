@@ -0,0 +1,139 @@
+#ifndef Profiler_hpp
+#define Profiler_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <cstddef>
+#include <vector>
+
+namespace gps {
+
+    // One timed scope of a frame, the GPU side is filled once its queries come back
+    struct ProfileEvent {
+        const char* name;
+        int depth;
+        // microseconds since the profiler started
+        double cpuBegin;
+        double cpuEnd;
+        double gpuBegin;
+        double gpuEnd;
+        bool hasGpu;
+    };
+
+    // Rolling CPU and GPU times of a scope name over the last frames
+    struct ProfileScopeStats {
+        static const int WINDOW = 120;
+
+        const char* name;
+        double cpuMs[WINDOW];
+        double gpuMs[WINDOW];
+        int cpuSamples;
+        int gpuSamples;
+
+        double averageCpuMs() const;
+        double maxCpuMs() const;
+        double averageGpuMs() const;
+        double maxGpuMs() const;
+    };
+
+    // Scoped CPU timers paired with GL_TIMESTAMP queries. GL_TIME_ELAPSED queries cannot nest,
+    // so every scope takes two timestamps instead. Queries are read a few frames later without
+    // blocking, the frames whose results are still missing when their slot comes back are dropped
+    class Profiler {
+
+    public:
+        static const int MAX_SCOPES_PER_FRAME = 64;
+        // frames the GPU results may lag behind
+        static const int QUERY_FRAMES = 4;
+        // cap of a trace capture, about a minute of frames
+        static const size_t MAX_TRACE_EVENTS = 1 << 18;
+
+        Profiler();
+
+        void setEnabled(bool enabled);
+        bool isEnabled() const;
+
+        void beginFrame();
+        void endFrame();
+
+        // Returns the index of the scope in the frame, -1 when it is not recorded
+        int beginScope(const char* name);
+        void endScope(int index);
+
+        // Starts collecting events for a trace, writeTrace saves them and stops the capture
+        void startCapture();
+        bool isCapturing() const;
+        // chrome://tracing and Perfetto JSON, CPU scopes on thread 1 and GPU scopes on thread 2
+        bool writeTrace(const char* fileName);
+
+        void printStats() const;
+
+        void Delete();
+
+    private:
+        struct FrameRecord {
+            std::vector<ProfileEvent> events;
+            GLuint queries[2 * MAX_SCOPES_PER_FRAME];
+            bool pending;
+        };
+
+        bool enabled;
+        bool initialized;
+        bool inFrame;
+        unsigned int frameIndex;
+        int depth;
+
+        FrameRecord frames[QUERY_FRAMES];
+        int currentFrame;
+
+        // GL timestamp minus CPU time, both in microseconds
+        double gpuToCpuOffset;
+
+        std::vector<ProfileScopeStats> stats;
+
+        bool capturing;
+        std::vector<ProfileEvent> traceEvents;
+        unsigned int droppedFrames;
+
+        void init();
+        double cpuNow() const;
+        // Reads the queries of a frame, returns false if the GPU is not done with them yet
+        bool resolveFrame(FrameRecord& frame, bool force);
+        ProfileScopeStats& getStats(const char* name);
+        void record(const ProfileEvent& event, bool gpu);
+    };
+
+    Profiler& profiler();
+
+    // Times the enclosing block
+    class ProfileScope {
+
+    public:
+        explicit ProfileScope(const char* name);
+        ~ProfileScope();
+
+    private:
+        int index;
+    };
+}
+
+// Build with GPS_PROFILING defined to record the scopes, without it the macros expand to nothing
+#ifdef GPS_PROFILING
+    #define GPS_PROFILE_CONCAT_(a, b) a##b
+    #define GPS_PROFILE_CONCAT(a, b) GPS_PROFILE_CONCAT_(a, b)
+    #define GPS_PROFILE(name) gps::ProfileScope GPS_PROFILE_CONCAT(profileScope_, __LINE__)(name)
+    #define GPS_PROFILE_BEGIN_FRAME() gps::profiler().beginFrame()
+    #define GPS_PROFILE_END_FRAME() gps::profiler().endFrame()
+#else
+    #define GPS_PROFILE(name) ((void)0)
+    #define GPS_PROFILE_BEGIN_FRAME() ((void)0)
+    #define GPS_PROFILE_END_FRAME() ((void)0)
+#endif
+
+#endif /* Profiler_hpp */
@@ -0,0 +1,401 @@
+#include "RenderQueue.hpp"
+#include "GLState.hpp"
+#include "MultiDraw.hpp"
+#include "GpuResources.hpp"
+#include "TextureStreamer.hpp"
+#include "GLTrace.hpp"
+
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include <cstring>
+
+namespace gps {
+
+	// sampler uniform for each texture slot
+	static const char* slotSamplerNames[TEXTURE_SLOT_COUNT] = { "diffuseTexture", "specularTexture", "ambientTexture" };
+
+	static const GLuint UNKNOWN_BINDING = 0xFFFFFFFF;
+
+	// starting size of a frame section of the draw ring, it grows with the scene
+	static const GLsizeiptr DRAW_RING_FRAME_SIZE = 256 * 1024;
+
+	RenderQueue::RenderQueue() {
+
+		this->viewMatrix = glm::mat4(1.0f);
+		this->nearPlane = 0.0f;
+		this->farPlane = 1.0f;
+		this->depthOnly = false;
+		this->cullingEnabled = false;
+		this->multiDraw = NULL;
+		resetStats();
+	}
+
+	void RenderQueue::begin(const glm::mat4& viewMatrix, float nearPlane, float farPlane, bool depthOnly) {
+
+		this->viewMatrix = viewMatrix;
+		this->nearPlane = nearPlane;
+		this->farPlane = farPlane;
+		this->depthOnly = depthOnly;
+		this->cullingEnabled = false;
+
+		packets.clear();
+		instances.clear();
+	}
+
+	void RenderQueue::setCullFrustum(const glm::mat4& viewProjection) {
+
+		// Gribb-Hartmann: each plane is the last row of the matrix plus or minus one of the others
+		for (int i = 0; i < 3; i++) {
+			for (int side = 0; side < 2; side++) {
+				float sign = side == 0 ? 1.0f : -1.0f;
+				glm::vec4 plane;
+				plane.x = viewProjection[0][3] + sign * viewProjection[0][i];
+				plane.y = viewProjection[1][3] + sign * viewProjection[1][i];
+				plane.z = viewProjection[2][3] + sign * viewProjection[2][i];
+				plane.w = viewProjection[3][3] + sign * viewProjection[3][i];
+				frustumPlanes[2 * i + side] = plane / glm::length(glm::vec3(plane));
+			}
+		}
+		cullingEnabled = true;
+	}
+
+	bool RenderQueue::isInsideFrustum(const gps::Mesh& mesh, const glm::mat4& modelMatrix) const {
+
+		glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(mesh.getBoundsCenter(), 1.0f));
+		float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])),
+			glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+		float radius = mesh.getBoundsRadius() * scale;
+
+		for (int i = 0; i < 6; i++) {
+			const glm::vec4& plane = frustumPlanes[i];
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+				return false;
+		}
+		return true;
+	}
+
+	GLuint RenderQueue::addInstance(const glm::mat4& modelMatrix) {
+
+		instances.push_back(modelMatrix);
+		return (GLuint)(instances.size() - 1);
+	}
+
+	void RenderQueue::submit(const gps::Mesh& mesh, const gps::Shader& shader, GLuint instance) {
+
+		if (cullingEnabled && !isInsideFrustum(mesh, instances[instance])) {
+			stats.packetsCulled++;
+			stats.trianglesCulled += mesh.getIndexCount() / 3;
+			return;
+		}
+
+		// the textures of what is drawn stream in at the level its distance needs
+		if (!depthOnly && textureStreamer().isEnabled()) {
+			const glm::mat4& modelMatrix = instances[instance];
+			float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])),
+				glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+			glm::vec3 center = glm::vec3(viewMatrix * modelMatrix * glm::vec4(mesh.getBoundsCenter(), 1.0f));
+			float distance = glm::max(glm::length(center) - mesh.getBoundsRadius() * scale, nearPlane);
+			textureStreamer().request(mesh, distance, scale);
+		}
+
+		DrawPacket packet;
+		packet.mesh = &mesh;
+		packet.program = shader.getProgram();
+		packet.instance = instance;
+		packet.key = makeKey(mesh, packet.program, instance);
+
+		packets.push_back(packet);
+	}
+
+	uint64_t RenderQueue::makeKey(const gps::Mesh& mesh, GLuint program, GLuint instance) const {
+
+		// view space distance of the bounding sphere center, normalized to the depth range
+		glm::vec4 center = viewMatrix * instances[instance] * glm::vec4(mesh.getBoundsCenter(), 1.0f);
+		float depth = glm::clamp((-center.z - nearPlane) / (farPlane - nearPlane), 0.0f, 1.0f);
+
+		uint64_t fineDepth = (uint64_t)(depth * 16777215.0f);
+		uint64_t depthBucket = fineDepth >> 16;
+
+		// the depth pass only switches vertex arrays, so group by those instead of by textures
+		uint64_t state = depthOnly ? mesh.getBuffers().VAO : mesh.getMaterialKey();
+
+		if (multiDraw != NULL) {
+			// every mesh shares one vertex array and a batch ends at each material change,
+			// so the material goes above the depth to keep the batches long
+			if (depthOnly)
+				state = 0;
+			else if (multiDraw->getTextureArrays() != NULL)
+				state = getArrayKey(mesh);
+			return ((uint64_t)(program & 0xFF) << 56) |
+				((state & 0xFFFFFF) << 24) |
+				fineDepth;
+		}
+
+		return ((uint64_t)(program & 0xFF) << 56) |
+			(depthBucket << 48) |
+			((state & 0xFFFFFF) << 24) |
+			fineDepth;
+	}
+
+	void RenderQueue::sortPackets() {
+
+		sortScratch.resize(packets.size());
+
+		for (int shift = 0; shift < 64; shift += 8) {
+
+			size_t counts[256] = { 0 };
+			for (size_t i = 0; i < packets.size(); i++)
+				counts[(packets[i].key >> shift) & 0xFF]++;
+
+			// every key has the same digit, this pass would not move anything
+			if (counts[(packets[0].key >> shift) & 0xFF] == packets.size())
+				continue;
+
+			size_t offsets[256];
+			size_t sum = 0;
+			for (int d = 0; d < 256; d++) {
+				offsets[d] = sum;
+				sum += counts[d];
+			}
+
+			for (size_t i = 0; i < packets.size(); i++)
+				sortScratch[offsets[(packets[i].key >> shift) & 0xFF]++] = packets[i];
+
+			packets.swap(sortScratch);
+		}
+	}
+
+	void RenderQueue::setupProgram(GLuint program) {
+
+		for (size_t i = 0; i < setupPrograms.size(); i++) {
+
+			if (setupPrograms[i] == program)
+				return;
+		}
+
+		// the program is already in use, the sampler units never change afterwards
+		for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+
+			GLint samplerLoc = glGetUniformLocation(program, slotSamplerNames[slot]);
+			if (samplerLoc != -1)
+				glUniform1i(samplerLoc, slot);
+		}
+
+		GLuint blockIndex = glGetUniformBlockIndex(program, "DrawBlock");
+		if (blockIndex != GL_INVALID_INDEX)
+			glUniformBlockBinding(program, blockIndex, DRAW_BLOCK_BINDING);
+
+		setupPrograms.push_back(program);
+	}
+
+	void RenderQueue::setMultiDraw(gps::MultiDrawBatcher* batcher) {
+		this->multiDraw = batcher;
+	}
+
+	void RenderQueue::bindProgram(GLuint program) {
+
+		if (glState().useProgram(program))
+			stats.programChanges++;
+		setupProgram(program);
+	}
+
+	// Pooled meshes only change batch where their arrays change, not at every material
+	uint64_t RenderQueue::getArrayKey(const gps::Mesh& mesh) const {
+
+		const gps::TextureArrayPool* arrays = multiDraw->getTextureArrays();
+		return ((uint64_t)(arrays->getArray(mesh.getTexture(TEXTURE_DIFFUSE)) & 0xFFF) << 12) |
+			(arrays->getArray(mesh.getTexture(TEXTURE_SPECULAR)) & 0xFFF);
+	}
+
+	GLuint RenderQueue::bindMaterial(const gps::Mesh& mesh) {
+
+		GLuint textureCount = 0;
+		for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+
+			GLuint texture = mesh.getTexture((TextureSlot)slot);
+			if (texture != 0)
+				textureCount++;
+
+			// a missing texture is bound as 0 so the previous material does not leak into this one
+			if (glState().bindTexture(slot, GL_TEXTURE_2D, texture))
+				stats.textureChanges++;
+		}
+		return textureCount;
+	}
+
+	void RenderQueue::bindMaterialArrays(const gps::Mesh& mesh) {
+
+		const gps::TextureArrayPool* arrays = multiDraw->getTextureArrays();
+		const TextureSlot slots[] = { TEXTURE_DIFFUSE, TEXTURE_SPECULAR };
+		for (int i = 0; i < 2; i++) {
+			if (glState().bindTexture(slots[i], GL_TEXTURE_2D_ARRAY, arrays->getArray(mesh.getTexture(slots[i]))))
+				stats.textureChanges++;
+		}
+	}
+
+	glm::mat3 RenderQueue::computeNormalMatrix(const glm::mat4& modelMatrix) const {
+		return glm::inverseTranspose(glm::mat3(viewMatrix * modelMatrix));
+	}
+
+	void RenderQueue::flush() {
+
+		if (packets.empty())
+			return;
+
+		sortPackets();
+
+		if (multiDraw != NULL)
+			flushMultiDraw();
+		else
+			flushSingle();
+	}
+
+	void RenderQueue::flushSingle() {
+
+		if (!drawRing.isInitialized()) {
+			GpuOwnerScope owner("render queue");
+			drawRing.init(GL_UNIFORM_BUFFER, DRAW_RING_FRAME_SIZE);
+		}
+
+		// the matrices of every instance go into the ring in one block, the draws only pick their range
+		GLsizeiptr stride = drawRing.alignedSize(sizeof(DrawData));
+		GLintptr baseOffset = 0;
+		char* ringData = (char*)drawRing.map(stride * instances.size(), baseOffset);
+		if (ringData == NULL)
+			return;
+
+		glm::mat4 identity(1.0f);
+		for (size_t i = 0; i < instances.size(); i++) {
+
+			DrawData data;
+			data.model = instances[i];
+			data.normalMatrix = depthOnly ? identity : glm::mat4(computeNormalMatrix(instances[i]));
+			// the ring may be write-combined memory, write it once and never read it back
+			memcpy(ringData + stride * i, &data, sizeof(DrawData));
+		}
+		drawRing.unmap();
+		stats.uniformUploads++;
+
+		GLuint currentProgram = UNKNOWN_BINDING;
+		GLuint currentInstance = UNKNOWN_BINDING;
+
+		for (size_t i = 0; i < packets.size(); i++) {
+
+			const DrawPacket& packet = packets[i];
+			const gps::Mesh& mesh = *packet.mesh;
+
+			if (packet.program != currentProgram) {
+				bindProgram(packet.program);
+				currentProgram = packet.program;
+			}
+
+			// the binding point is shared by every program, it survives program changes
+			if (packet.instance != currentInstance) {
+
+				glBindBufferRange(GL_UNIFORM_BUFFER, DRAW_BLOCK_BINDING, drawRing.getBuffer(),
+					baseOffset + stride * packet.instance, sizeof(DrawData));
+				stats.bufferRangeBinds++;
+				currentInstance = packet.instance;
+			}
+
+			GLuint textureCount = 0;
+			if (!depthOnly)
+				textureCount = bindMaterial(mesh);
+
+			if (glState().bindVertexArray(mesh.getBuffers().VAO))
+				stats.vaoChanges++;
+
+			glDrawElements(GL_TRIANGLES, mesh.getIndexCount(), GL_UNSIGNED_INT, 0);
+
+			stats.packets++;
+			stats.drawCalls++;
+			stats.triangles += mesh.getIndexCount() / 3;
+			// useProgram, bind + unbind of the VAO and of every texture
+			stats.immediateStateChanges += 1 + 2 + 2 * textureCount;
+		}
+	}
+
+	// Packets of the same program and material form one batch of indirect commands,
+	// with texture arrays the same arrays are enough
+	static bool sameBatch(const DrawPacket& a, const DrawPacket& b, bool depthOnly, const gps::TextureArrayPool* arrays) {
+
+		if (a.program != b.program)
+			return false;
+		if (depthOnly)
+			return true;
+
+		if (arrays != NULL) {
+			return arrays->getArray(a.mesh->getTexture(TEXTURE_DIFFUSE)) == arrays->getArray(b.mesh->getTexture(TEXTURE_DIFFUSE)) &&
+				arrays->getArray(a.mesh->getTexture(TEXTURE_SPECULAR)) == arrays->getArray(b.mesh->getTexture(TEXTURE_SPECULAR));
+		}
+
+		for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+			if (a.mesh->getTexture((TextureSlot)slot) != b.mesh->getTexture((TextureSlot)slot))
+				return false;
+		}
+		return true;
+	}
+
+	void RenderQueue::flushMultiDraw() {
+
+		multiDraw->begin();
+
+		// one entry per instance, the commands of all its meshes point to it
+		glm::mat4 identity(1.0f);
+		for (size_t i = 0; i < instances.size(); i++) {
+			glm::mat4 normalMatrix = depthOnly ? identity : glm::mat4(computeNormalMatrix(instances[i]));
+			multiDraw->addDrawData(instances[i], normalMatrix);
+		}
+
+		for (size_t i = 0; i < packets.size(); i++)
+			multiDraw->addCommand(*packets[i].mesh, packets[i].instance);
+
+		multiDraw->upload();
+		stats.uniformUploads++;
+
+		const gps::TextureArrayPool* arrays = multiDraw->getTextureArrays();
+		size_t batchStart = 0;
+		while (batchStart < packets.size()) {
+
+			size_t batchEnd = batchStart + 1;
+			while (batchEnd < packets.size() && sameBatch(packets[batchStart], packets[batchEnd], depthOnly, arrays))
+				batchEnd++;
+
+			const DrawPacket& first = packets[batchStart];
+			bindProgram(first.program);
+			if (!depthOnly && arrays != NULL)
+				bindMaterialArrays(*first.mesh);
+			else if (!depthOnly)
+				bindMaterial(*first.mesh);
+
+			multiDraw->draw((GLuint)batchStart, (GLuint)(batchEnd - batchStart));
+			stats.drawCalls++;
+
+			for (size_t i = batchStart; i < batchEnd; i++) {
+
+				GLuint textureCount = 0;
+				for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+					if (packets[i].mesh->getTexture((TextureSlot)slot) != 0)
+						textureCount++;
+				}
+				stats.packets++;
+				stats.triangles += packets[i].mesh->getIndexCount() / 3;
+				stats.immediateStateChanges += 1 + 2 + 2 * (depthOnly ? 0 : textureCount);
+			}
+
+			batchStart = batchEnd;
+		}
+	}
+
+	RenderStats RenderQueue::getStats() const {
+		return stats;
+	}
+
+	void RenderQueue::resetStats() {
+		stats = RenderStats();
+	}
+
+	void RenderQueue::Delete() {
+		drawRing.Delete();
+	}
+}
@@ -0,0 +1,126 @@
+#ifndef RenderQueue_hpp
+#define RenderQueue_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "Mesh.hpp"
+#include "Shader.hpp"
+#include "FrameRing.hpp"
+#include "UniformBuffers.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    class MultiDrawBatcher;
+
+    // Binding point of the per draw block, right after the shared blocks of UniformBuffers.hpp
+    static const GLuint DRAW_BLOCK_BINDING = UNIFORM_BLOCK_COUNT;
+
+    // One mesh to be drawn with one program and one model matrix
+    struct DrawPacket {
+        // program | depth bucket | material | depth, so sorting groups state and goes front-to-back
+        uint64_t key;
+        const gps::Mesh* mesh;
+        GLuint program;
+        // index into the instance transforms of the current pass
+        GLuint instance;
+    };
+
+    struct RenderStats {
+        GLuint packets;
+        GLuint drawCalls;
+        GLuint triangles;
+        // submitted meshes whose bounding sphere was outside the frustum of the pass
+        GLuint packetsCulled;
+        GLuint trianglesCulled;
+        GLuint programChanges;
+        GLuint vaoChanges;
+        GLuint textureChanges;
+        GLuint uniformUploads;
+        // ranges of the frame ring bound to the per draw block
+        GLuint bufferRangeBinds;
+        // state changes the old immediate-mode drawing would have issued for the same packets
+        GLuint immediateStateChanges;
+    };
+
+    class RenderQueue {
+
+    public:
+        RenderQueue();
+
+        // Starts a new pass. The view matrix and depth range are only used to order the packets,
+        // depthOnly passes skip textures and normal matrices
+        void begin(const glm::mat4& viewMatrix, float nearPlane, float farPlane, bool depthOnly);
+
+        // Drops the meshes outside this frustum from the current pass, begin turns culling off again
+        void setCullFrustum(const glm::mat4& viewProjection);
+
+        // Registers a model matrix for the meshes submitted after it
+        GLuint addInstance(const glm::mat4& modelMatrix);
+
+        void submit(const gps::Mesh& mesh, const gps::Shader& shader, GLuint instance);
+
+        // Sorts the packets of the pass and issues the GL calls
+        void flush();
+
+        // Sends the passes through multi-draw indirect batches, NULL goes back to one draw per packet
+        void setMultiDraw(gps::MultiDrawBatcher* batcher);
+
+        RenderStats getStats() const;
+        void resetStats();
+
+        void Delete();
+
+    private:
+        glm::mat4 viewMatrix;
+        float nearPlane;
+        float farPlane;
+        bool depthOnly;
+
+        bool cullingEnabled;
+        // left, right, bottom, top, near, far, xyz is the inward normal
+        glm::vec4 frustumPlanes[6];
+
+        std::vector<DrawPacket> packets;
+        std::vector<DrawPacket> sortScratch;
+        std::vector<glm::mat4> instances;
+        std::vector<GLuint> setupPrograms;
+
+        gps::MultiDrawBatcher* multiDraw;
+        // model and normal matrices of the GL 4.1 path, one aligned DrawData per instance
+        gps::FrameRing drawRing;
+
+        RenderStats stats;
+
+        bool isInsideFrustum(const gps::Mesh& mesh, const glm::mat4& modelMatrix) const;
+        uint64_t makeKey(const gps::Mesh& mesh, GLuint program, GLuint instance) const;
+        // Stable LSD radix sort on the 64-bit keys
+        void sortPackets();
+        // Points the samplers and the per draw block of a program to their slots, once per program
+        void setupProgram(GLuint program);
+        void bindProgram(GLuint program);
+        // Binds the mesh textures to their slots, returns how many the mesh has
+        GLuint bindMaterial(const gps::Mesh& mesh);
+        // Binds the texture arrays holding the diffuse and specular textures of the mesh
+        void bindMaterialArrays(const gps::Mesh& mesh);
+        uint64_t getArrayKey(const gps::Mesh& mesh) const;
+        glm::mat3 computeNormalMatrix(const glm::mat4& modelMatrix) const;
+
+        // GL 4.1 path, one glDrawElements per packet, the matrices come from the frame ring
+        void flushSingle();
+        // GL 4.3 path, one glMultiDrawElementsIndirect per program and material
+        void flushMultiDraw();
+    };
+}
+
+#endif /* RenderQueue_hpp */
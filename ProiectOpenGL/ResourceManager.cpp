@@ -0,0 +1,137 @@
+#include "ResourceManager.hpp"
+#include "GLState.hpp"
+#include "GpuResources.hpp"
+#include "GLTrace.hpp"
+
+namespace gps {
+
+	static const uint32_t INDEX_MASK = (1u << ResourceManager::INDEX_BITS) - 1;
+	static const uint32_t GENERATION_MASK = (1u << ResourceManager::GENERATION_BITS) - 1;
+
+	ResourceManager::ResourceManager() {
+
+		for (int i = 0; i < RESOURCE_TYPE_COUNT; i++)
+			pools[i].live = 0;
+	}
+
+	uint32_t ResourceManager::addName(ResourceType type, GLuint name) {
+
+		if (name == 0)
+			return 0;
+
+		Pool& pool = pools[type];
+		uint32_t slot;
+		if (!pool.freeSlots.empty()) {
+			slot = pool.freeSlots.back();
+			pool.freeSlots.pop_back();
+		}
+		else {
+			if (pool.names.size() > INDEX_MASK) {
+				fprintf(stderr, "ERROR: more than %u live objects of one type, the handle is null\n", INDEX_MASK + 1);
+				return 0;
+			}
+			slot = (uint32_t)pool.names.size();
+			pool.names.push_back(0);
+			// generation 0 never appears, so no handle is 0
+			pool.generations.push_back(1);
+		}
+
+		pool.names[slot] = name;
+		pool.live++;
+		return ((uint32_t)pool.generations[slot] << INDEX_BITS) | slot;
+	}
+
+	GLuint ResourceManager::getName(ResourceType type, uint32_t value) const {
+
+		const Pool& pool = pools[type];
+		uint32_t slot = value & INDEX_MASK;
+		if (value == 0 || slot >= pool.names.size() || pool.generations[slot] != (value >> INDEX_BITS))
+			return 0;
+		return pool.names[slot];
+	}
+
+	void ResourceManager::removeName(ResourceType type, uint32_t value, bool deleteObject) {
+
+		GLuint name = getName(type, value);
+		if (name == 0)
+			return;
+
+		Pool& pool = pools[type];
+		uint32_t slot = value & INDEX_MASK;
+		pool.names[slot] = 0;
+		// every handle to the slot goes stale, the generation wraps past 0
+		pool.generations[slot] = (uint16_t)(pool.generations[slot] % GENERATION_MASK + 1);
+		pool.freeSlots.push_back(slot);
+		pool.live--;
+
+		if (deleteObject) {
+			PendingDelete object;
+			object.type = type;
+			object.name = name;
+			pending[frameSync().getFrameSlot()].push_back(object);
+		}
+	}
+
+	void ResourceManager::deleteObject(const PendingDelete& object) {
+
+		switch (object.type) {
+		case RESOURCE_TEXTURE:
+			glState().deleteTexture(object.name);
+			gpuResources().remove(GPU_TEXTURE, object.name);
+			break;
+		case RESOURCE_BUFFER:
+			glDeleteBuffers(1, &object.name);
+			gpuResources().remove(GPU_BUFFER, object.name);
+			break;
+		case RESOURCE_VERTEX_ARRAY:
+			glState().deleteVertexArray(object.name);
+			gpuResources().remove(GPU_VERTEX_ARRAY, object.name);
+			break;
+		case RESOURCE_PROGRAM:
+			glState().deleteProgram(object.name);
+			break;
+		case RESOURCE_FRAMEBUFFER:
+			glState().deleteFramebuffer(object.name);
+			gpuResources().remove(GPU_FRAMEBUFFER, object.name);
+			break;
+		default:
+			break;
+		}
+	}
+
+	void ResourceManager::collect() {
+
+		std::vector<PendingDelete>& objects = pending[frameSync().getFrameSlot()];
+		for (size_t i = 0; i < objects.size(); i++)
+			deleteObject(objects[i]);
+		objects.clear();
+	}
+
+	size_t ResourceManager::getLiveCount(ResourceType type) const {
+		return pools[type].live;
+	}
+
+	size_t ResourceManager::getPendingCount() const {
+
+		size_t count = 0;
+		for (int slot = 0; slot < FrameSync::MAX_FRAMES_IN_FLIGHT; slot++)
+			count += pending[slot].size();
+		return count;
+	}
+
+	void ResourceManager::Delete() {
+
+		// GL keeps objects the queued commands still use alive until they finish
+		for (int slot = 0; slot < FrameSync::MAX_FRAMES_IN_FLIGHT; slot++) {
+			for (size_t i = 0; i < pending[slot].size(); i++)
+				deleteObject(pending[slot][i]);
+			pending[slot].clear();
+		}
+	}
+
+	ResourceManager& resources() {
+
+		static ResourceManager instance;
+		return instance;
+	}
+}
@@ -0,0 +1,122 @@
+#ifndef ResourceManager_hpp
+#define ResourceManager_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include "FrameSync.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gps {
+
+    enum ResourceType {
+        RESOURCE_TEXTURE,
+        RESOURCE_BUFFER,
+        RESOURCE_VERTEX_ARRAY,
+        RESOURCE_PROGRAM,
+        RESOURCE_FRAMEBUFFER,
+        RESOURCE_TYPE_COUNT
+    };
+
+    // Reference to a GL object owned by the resource manager. The low 20 bits are the slot of the
+    // object, the high 12 bits the generation of the slot, so a handle kept after its object was
+    // destroyed resolves to 0 instead of to whatever reuses the slot. 0 is the null handle
+    template <ResourceType T>
+    struct Handle {
+        uint32_t value;
+
+        Handle() : value(0) {}
+        explicit Handle(uint32_t value) : value(value) {}
+
+        bool isNull() const { return value == 0; }
+        bool operator==(const Handle& other) const { return value == other.value; }
+        bool operator!=(const Handle& other) const { return value != other.value; }
+    };
+
+    typedef Handle<RESOURCE_TEXTURE> TextureHandle;
+    typedef Handle<RESOURCE_BUFFER> BufferHandle;
+    typedef Handle<RESOURCE_VERTEX_ARRAY> VertexArrayHandle;
+    typedef Handle<RESOURCE_PROGRAM> ProgramHandle;
+    typedef Handle<RESOURCE_FRAMEBUFFER> FramebufferHandle;
+
+    // Owner of the GL objects behind the handles, one dense pool of names per type. Destroying a
+    // handle invalidates it at once, the object itself is deleted once the frames in flight that
+    // may still use it are done
+    class ResourceManager {
+
+    public:
+        static const uint32_t INDEX_BITS = 20;
+        static const uint32_t GENERATION_BITS = 12;
+
+        ResourceManager();
+
+        // Takes over a GL object, returns the null handle for 0
+        template <ResourceType T>
+        Handle<T> add(GLuint name) {
+            return Handle<T>(addName(T, name));
+        }
+
+        // Name of the object, 0 for the null handle and for destroyed ones
+        template <ResourceType T>
+        GLuint get(Handle<T> handle) const {
+            return getName(T, handle.value);
+        }
+
+        // Queues the object for deletion, stale and null handles are ignored
+        template <ResourceType T>
+        void destroy(Handle<T> handle) {
+            removeName(T, handle.value, true);
+        }
+
+        // Drops the handle without deleting the object, for objects some other owner deletes
+        template <ResourceType T>
+        void forget(Handle<T> handle) {
+            removeName(T, handle.value, false);
+        }
+
+        // Deletes what was destroyed the last time the current frame slot was used, the GPU is done
+        // with it once frameSync().beginFrame() returned
+        void collect();
+
+        size_t getLiveCount(ResourceType type) const;
+        size_t getPendingCount() const;
+
+        // Deletes every pending object, at shutdown before the context goes away
+        void Delete();
+
+    private:
+        struct Pool {
+            // indexed by slot, 0 for free slots
+            std::vector<GLuint> names;
+            std::vector<uint16_t> generations;
+            std::vector<uint32_t> freeSlots;
+            size_t live;
+        };
+
+        struct PendingDelete {
+            ResourceType type;
+            GLuint name;
+        };
+
+        Pool pools[RESOURCE_TYPE_COUNT];
+        // per frame slot, what was destroyed while the slot was current
+        std::vector<PendingDelete> pending[FrameSync::MAX_FRAMES_IN_FLIGHT];
+
+        uint32_t addName(ResourceType type, GLuint name);
+        GLuint getName(ResourceType type, uint32_t value) const;
+        void removeName(ResourceType type, uint32_t value, bool deleteObject);
+        void deleteObject(const PendingDelete& object);
+    };
+
+    ResourceManager& resources();
+}
+
+#endif /* ResourceManager_hpp */
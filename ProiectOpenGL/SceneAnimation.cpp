@@ -0,0 +1,89 @@
+#include "SceneAnimation.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace gps {
+
+	PropAnimation::PropAnimation() {
+
+		dodgeRotation = 0.0f;
+		eliceZRotation = 0.0f;
+		eliceYRotation = 0.0f;
+	}
+
+	void PropAnimation::step() {
+
+		dodgeRotation -= 0.5;
+		if (dodgeRotation <= -360)
+			dodgeRotation = 0;
+
+		eliceZRotation += 7.0;
+		if (eliceZRotation >= 360)
+			eliceZRotation = 0;
+
+		eliceYRotation += 7.0;
+		if (eliceYRotation >= 360)
+			eliceYRotation = 0;
+	}
+
+	glm::mat4 PropAnimation::getDodgeMatrix() const {
+
+		glm::mat4 dodgeModelMatrix;
+		dodgeModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.3f, 0.0f, 0.0f));
+		dodgeModelMatrix = glm::rotate(dodgeModelMatrix, glm::radians(dodgeRotation), glm::vec3(0, -1, 0));
+		return dodgeModelMatrix;
+	}
+
+	// the propellers turn around their own hub, so they are moved to the origin and back
+	glm::mat4 PropAnimation::getEliceZMatrix() const {
+
+		glm::mat4 eliceZModelMatrix;
+		eliceZModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(10.2446f, 19.292f, -11.0723f));
+		eliceZModelMatrix = glm::rotate(eliceZModelMatrix, glm::radians(eliceZRotation), glm::vec3(0, -1, 0));
+		eliceZModelMatrix = glm::translate(eliceZModelMatrix, glm::vec3(-10.2446f, -19.292f, 11.0723f));
+		return eliceZModelMatrix;
+	}
+
+	glm::mat4 PropAnimation::getEliceYMatrix() const {
+
+		glm::mat4 eliceYModelMatrix;
+		eliceYModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(15.0883f, 18.0833f, -16.2909f));
+		eliceYModelMatrix = glm::rotate(eliceYModelMatrix, glm::radians(51.0162f), glm::vec3(0, 1, 0));
+		eliceYModelMatrix = glm::rotate(eliceYModelMatrix, glm::radians(eliceYRotation), glm::vec3(0, 0, 1));
+		eliceYModelMatrix = glm::rotate(eliceYModelMatrix, glm::radians(-51.0162f), glm::vec3(0, 1, 0));
+		eliceYModelMatrix = glm::translate(eliceYModelMatrix, glm::vec3(-15.0883f, -18.0833f, 16.2909f));
+		return eliceYModelMatrix;
+	}
+
+	RainGrid defaultRainGrid() {
+
+		RainGrid grid;
+		grid.rows = 20;
+		grid.columns = 20;
+		grid.dropsPerCell = 15;
+		grid.spacing = 12.5f;
+		grid.origin = -190.0f;
+		return grid;
+	}
+
+	void placeRainDrops(const RainGrid& grid, float rainY, std::vector<glm::mat4>& dropMatrices) {
+
+		dropMatrices.clear();
+
+		for (int i = 0; i < grid.rows; i++) {
+			for (int j = 0; j < grid.columns; j++) {
+				float currRainX = grid.origin + i * grid.spacing;
+				float currRainZ = grid.origin + j * grid.spacing;
+
+				// drops alternate on both sides of the cell centre, each one higher than the last
+				for (int k = 0; k < grid.dropsPerCell; k++) {
+					float offsetX = (k % 2 == 0) ? (k / 2) * 7.5f : -((k / 2) * 7.5f);
+					float offsetZ = (k % 2 == 0) ? (k / 2) * 2.5f : -((k / 2) * 2.5f);
+					float offsetY = k * 5.0f;
+
+					dropMatrices.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(currRainX + offsetX, rainY + offsetY, currRainZ + offsetZ)));
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef SceneAnimation_hpp
+#define SceneAnimation_hpp
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace gps {
+
+    // Rotations of the animated props: the car on the turntable and the two propellers
+    class PropAnimation {
+
+    public:
+        PropAnimation();
+
+        // Advances the rotations by one frame
+        void step();
+
+        glm::mat4 getDodgeMatrix() const;
+        glm::mat4 getEliceZMatrix() const;
+        glm::mat4 getEliceYMatrix() const;
+
+    private:
+        float dodgeRotation;
+        float eliceZRotation;
+        float eliceYRotation;
+    };
+
+    // Layout of the rain, a grid of cells each holding a column of drops
+    struct RainGrid {
+        int rows;
+        int columns;
+        int dropsPerCell;
+        float spacing;
+        float origin;
+    };
+
+    RainGrid defaultRainGrid();
+
+    // Fills one model matrix per drop, rainY is the height of the lowest drop of every column
+    void placeRainDrops(const RainGrid& grid, float rainY, std::vector<glm::mat4>& dropMatrices);
+}
+
+#endif /* SceneAnimation_hpp */
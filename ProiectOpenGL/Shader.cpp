@@ -7,27 +7,18 @@
 //
 
 #include "Shader.hpp"
+#include "AssetPackage.hpp"
 
 namespace gps {
     std::string Shader::readShaderFile(std::string fileName) {
 
-        std::ifstream shaderFile;
-        std::string shaderString;
+        //read shader file, from the asset package when it has it
+        AssetData shaderFile;
+        if (!vfs().read(fileName, shaderFile) || shaderFile.size == 0)
+            return std::string();
         
-        //open shader file
-        shaderFile.open(fileName);
-        
-        std::stringstream shaderStringStream;
-        
-        //read shader content into stream
-        shaderStringStream << shaderFile.rdbuf();
-        
-        //close shader file
-        shaderFile.close();
-        
-        //convert stream into GLchar array
-        shaderString = shaderStringStream.str();
-        return shaderString;
+        //convert file content into GLchar array
+        return std::string((const char*)shaderFile.data, shaderFile.size);
     }
     
     void Shader::shaderCompileLog(GLuint shaderId) {
@@ -53,15 +44,29 @@ namespace gps {
         //check linking info
         glGetProgramiv(shaderProgramId, GL_LINK_STATUS, &success);
         if(!success) {
-            glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+            glGetProgramInfoLog(shaderProgramId, 512, NULL, infoLog);
             std::cout << "Shader linking error\n" << infoLog << std::endl;
         }
     }
     
+    std::string Shader::addDefines(const std::string& source, const std::string& defines) {
+
+        //the defines have to come after the #version line
+        size_t lineEnd = source.find('\n');
+        if (defines.empty() || lineEnd == std::string::npos)
+            return source;
+        return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+    }
+
     void Shader::loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName) {
 
+        loadShader(vertexShaderFileName, fragmentShaderFileName, "");
+    }
+
+    void Shader::loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName, const std::string& defines) {
+
         //read, parse and compile the vertex shader
-        std::string v = readShaderFile(vertexShaderFileName);
+        std::string v = addDefines(readShaderFile(vertexShaderFileName), defines);
         const GLchar* vertexShaderString = v.c_str();
         GLuint vertexShader;
         vertexShader = glCreateShader(GL_VERTEX_SHADER);
@@ -71,7 +76,7 @@ namespace gps {
         shaderCompileLog(vertexShader);
         
         //read, parse and compile the vertex shader
-        std::string f = readShaderFile(fragmentShaderFileName);
+        std::string f = addDefines(readShaderFile(fragmentShaderFileName), defines);
         const GLchar* fragmentShaderString = f.c_str();
         GLuint fragmentShader;
         fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
@@ -80,20 +85,32 @@ namespace gps {
         //check compilation status
         shaderCompileLog(fragmentShader);
         
-        //attach and link the shader programs
-        this->shaderProgram = glCreateProgram();
-        glAttachShader(this->shaderProgram, vertexShader);
-        glAttachShader(this->shaderProgram, fragmentShader);
-        glLinkProgram(this->shaderProgram);
+        //attach and link the shader programs, a reload replaces the previous one
+        GLuint shaderProgram = glCreateProgram();
+        glAttachShader(shaderProgram, vertexShader);
+        glAttachShader(shaderProgram, fragmentShader);
+        glLinkProgram(shaderProgram);
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
         //check linking info
-        shaderLinkLog(this->shaderProgram);
+        shaderLinkLog(shaderProgram);
+
+        resources().destroy(this->program);
+        this->program = resources().add<RESOURCE_PROGRAM>(shaderProgram);
     }
     
-    void Shader::useShaderProgram() {
+    void Shader::useShaderProgram() const {
+
+        glState().useProgram(getProgram());
+    }
+
+    GLuint Shader::getProgram() const {
+        return resources().get(this->program);
+    }
+
+    void Shader::Delete() {
 
-        glUseProgram(this->shaderProgram);
+        resources().destroy(this->program);
     }
 
 }
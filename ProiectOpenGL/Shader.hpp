@@ -17,6 +17,9 @@
     #include <GL/glew.h>
 #endif
 
+#include "GLState.hpp"
+#include "ResourceManager.hpp"
+
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -27,12 +30,20 @@ namespace gps {
     class Shader {
 
     public:
-        GLuint shaderProgram;
         void loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName);
-        void useShaderProgram();
+        // defines ("#define NAME\n" lines) go at the top of both stages, to build variants of one source
+        void loadShader(std::string vertexShaderFileName, std::string fragmentShaderFileName, const std::string& defines);
+        void useShaderProgram() const;
+        // Name of the program, 0 before it was loaded and once it was deleted
+        GLuint getProgram() const;
+        // Destroys the program, copies of the shader see it gone too
+        void Delete();
     
     private:
+        gps::ProgramHandle program;
+
         std::string readShaderFile(std::string fileName);
+        std::string addDefines(const std::string& source, const std::string& defines);
         void shaderCompileLog(GLuint shaderId);
         void shaderLinkLog(GLuint shaderProgramId);
     };
@@ -7,71 +7,83 @@
 //
 
 #include "SkyBox.hpp"
+#include "AssetPackage.hpp"
+#include "GpuResources.hpp"
+#include "GLTrace.hpp"
 
 
 namespace gps {
     
     SkyBox::SkyBox()
     {
-        
+        skyboxVAO = 0;
+        skyboxVBO = 0;
+        cubemapTexture = 0;
     }
     
     void SkyBox::Load(std::vector<const GLchar*> cubeMapFaces)
     {
+        GpuOwnerScope owner("skybox");
+        // the night toggle loads the other faces, the old cube map would leak
+        if (cubemapTexture != 0) {
+            glState().deleteTexture(cubemapTexture);
+            gpuResources().remove(GPU_TEXTURE, cubemapTexture);
+        }
         cubemapTexture = LoadSkyBoxTextures(cubeMapFaces);
-        InitSkyBox();
+        if (skyboxVAO == 0)
+            InitSkyBox();
     }
     
-    void SkyBox::Draw(gps::Shader shader, glm::mat4 viewMatrix, glm::mat4 projectionMatrix)
+    void SkyBox::Draw(const gps::Shader& shader)
     {
         shader.useShaderProgram();
         
-        //set the view and projection matrices
-        glm::mat4 transformedView = glm::mat4(glm::mat3(viewMatrix));
-        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "view"), 1, GL_FALSE, glm::value_ptr(transformedView));
-        glUniformMatrix4fv(glGetUniformLocation(shader.shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projectionMatrix));
-        
-        glDepthFunc(GL_LEQUAL);
+        glState().depthFunc(GL_LEQUAL);
         
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glUniform1i(glGetUniformLocation(shader.shaderProgram, "skybox"), 0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        glState().bindVertexArray(skyboxVAO);
+        glUniform1i(glGetUniformLocation(shader.getProgram(), "skybox"), 0);
+        glState().bindTexture(0, GL_TEXTURE_CUBE_MAP, cubemapTexture);
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
         
-        glDepthFunc(GL_LESS);
+        glState().depthFunc(GL_LESS);
     }
     
     GLuint SkyBox::LoadSkyBoxTextures(std::vector<const GLchar*> skyBoxFaces)
     {
         GLuint textureID;
         glGenTextures(1, &textureID);
-        glActiveTexture(GL_TEXTURE0);
         
         int width,height, n;
         unsigned char* image;
         int force_channels = 3;
+        GLuint64 bytes = 0;
         
-        glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+        glState().bindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
         for(GLuint i = 0; i < skyBoxFaces.size(); i++)
         {
-            image = stbi_load(skyBoxFaces[i], &width, &height, &n, force_channels);
+            AssetData face;
+            image = NULL;
+            if (vfs().read(skyBoxFaces[i], face) && face.size > 0)
+                image = stbi_load_from_memory(face.data, (int)face.size, &width, &height, &n, force_channels);
             if (!image) {
                 fprintf(stderr, "ERROR: could not load %s\n", skyBoxFaces[i]);
-                return false;
+                glState().deleteTexture(textureID);
+                return 0;
             }
             glTexImage2D(
                          GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0,
                          GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image
                          );
+            stbi_image_free(image);
+            bytes += getTextureBytes(GL_RGB, width, height, 1, 1);
         }
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        glState().bindTexture(0, GL_TEXTURE_CUBE_MAP, 0);
+        GPS_GPU_RESOURCE(GPU_TEXTURE, textureID, bytes, GL_RGB, "cube map");
         
         return textureID;
     }
@@ -124,18 +136,33 @@ namespace gps {
         glGenVertexArrays(1, &(this->skyboxVAO));
         glGenBuffers(1, &skyboxVBO);
         
-        glBindVertexArray(skyboxVAO);
+        glState().bindVertexArray(skyboxVAO);
         glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+        GPS_GPU_RESOURCE(GPU_VERTEX_ARRAY, skyboxVAO, 0, GL_NONE, "cube");
+        GPS_GPU_RESOURCE(GPU_BUFFER, skyboxVBO, sizeof(skyboxVertices), GL_ARRAY_BUFFER, "cube");
         
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
         
-        glBindVertexArray(0);
+        glState().bindVertexArray(0);
     }
     
     GLuint SkyBox::GetTextureId()
     {
         return cubemapTexture;
     }
+    
+    void SkyBox::Delete()
+    {
+        glState().deleteTexture(cubemapTexture);
+        glState().deleteVertexArray(skyboxVAO);
+        glDeleteBuffers(1, &skyboxVBO);
+        gpuResources().remove(GPU_TEXTURE, cubemapTexture);
+        gpuResources().remove(GPU_VERTEX_ARRAY, skyboxVAO);
+        gpuResources().remove(GPU_BUFFER, skyboxVBO);
+        cubemapTexture = 0;
+        skyboxVAO = 0;
+        skyboxVBO = 0;
+    }
 }
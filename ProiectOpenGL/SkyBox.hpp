@@ -24,9 +24,12 @@ namespace gps {
     {
     public:
         SkyBox();
+        // Loading again replaces the cube map, the cube geometry is created once
         void Load(std::vector<const GLchar*> cubeMapFaces);
-        void Draw(gps::Shader shader, glm::mat4 viewMatrix, glm::mat4 projectionMatrix);
+        // The view and projection come from the shared camera block
+        void Draw(const gps::Shader& shader);
         GLuint GetTextureId();
+        void Delete();
     private:
         GLuint skyboxVAO;
         GLuint skyboxVBO;
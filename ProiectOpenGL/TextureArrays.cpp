@@ -0,0 +1,172 @@
+#include "TextureArrays.hpp"
+#include "GLState.hpp"
+#include "GpuResources.hpp"
+#include "GLTrace.hpp"
+
+#include <algorithm>
+
+namespace gps {
+
+	// glTexStorage3D needs a sized format, the model textures are created with unsized ones
+	static GLenum getSizedFormat(GLenum format) {
+
+		switch (format) {
+		case GL_RGB: return GL_RGB8;
+		case GL_RGBA: return GL_RGBA8;
+		case GL_SRGB: return GL_SRGB8;
+		case GL_SRGB_ALPHA: return GL_SRGB8_ALPHA8;
+		default: return format;
+		}
+	}
+
+	bool TextureArrayPool::isSupported() {
+
+#if defined (__APPLE__)
+		// macOS stops at GL 4.1, without glCopyImageSubData
+		return false;
+#else
+		return GLEW_VERSION_4_3 || (GLEW_ARB_copy_image && (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage));
+#endif
+	}
+
+	TextureArrayPool::TextureArrayPool() {
+		maxLayers = 0;
+	}
+
+	void TextureArrayPool::addTexture(GLuint texture) {
+
+		if (texture == 0 || placements.count(texture) != 0)
+			return;
+		if (std::find(pending.begin(), pending.end(), texture) == pending.end())
+			pending.push_back(texture);
+	}
+
+	bool TextureArrayPool::update() {
+
+		if (pending.empty())
+			return false;
+
+		if (maxLayers == 0) {
+			glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+			// the shader gets 16 bits per layer index
+			maxLayers = std::min(maxLayers, 0xFFFF);
+		}
+
+		for (size_t i = 0; i < pending.size(); i++) {
+
+			GLint width = 0, height = 0, format = 0, maxLevel = 0;
+			glState().bindTexture(0, GL_TEXTURE_2D, pending[i]);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+			if (width == 0 || height == 0) {
+				fprintf(stderr, "WARNING: texture %u has no image, it stays out of the texture arrays\n", pending[i]);
+				continue;
+			}
+
+			size_t index = pools.size();
+			for (size_t p = 0; p < pools.size(); p++) {
+				if (pools[p].width == width && pools[p].height == height && pools[p].format == getSizedFormat(format) &&
+					pools[p].maxLevel == maxLevel &&
+					(GLint)pools[p].textures.size() < maxLayers) {
+					index = p;
+					break;
+				}
+			}
+			if (index == pools.size()) {
+				Pool pool;
+				pool.array = 0;
+				pool.width = width;
+				pool.height = height;
+				pool.format = getSizedFormat(format);
+				pool.levels = getMipLevels(width, height);
+				pool.maxLevel = maxLevel;
+				pool.dirty = false;
+				pools.push_back(pool);
+			}
+
+			Placement placement;
+			placement.pool = index;
+			placement.layer = (GLuint)pools[index].textures.size();
+			placements[pending[i]] = placement;
+			pools[index].textures.push_back(pending[i]);
+			pools[index].dirty = true;
+		}
+		pending.clear();
+		glState().bindTexture(0, GL_TEXTURE_2D, 0);
+
+		bool changed = false;
+		for (size_t p = 0; p < pools.size(); p++) {
+			if (pools[p].dirty) {
+				rebuild(pools[p]);
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	void TextureArrayPool::rebuild(Pool& pool) {
+
+		// immutable storage cannot grow, the array is made again with room for every layer
+		if (pool.array != 0) {
+			glState().deleteTexture(pool.array);
+			gpuResources().remove(GPU_TEXTURE, pool.array);
+		}
+
+		GLsizei layers = (GLsizei)pool.textures.size();
+		glGenTextures(1, &pool.array);
+		glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, pool.array);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, pool.levels, pool.format, pool.width, pool.height, layers);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, pool.maxLevel);
+		glState().bindTexture(0, GL_TEXTURE_2D_ARRAY, 0);
+
+		// the copies stay on the GPU, the sources keep their full mip chains from glGenerateMipmap
+		for (GLsizei layer = 0; layer < layers; layer++) {
+			for (GLint level = 0; level < pool.levels; level++) {
+				glCopyImageSubData(pool.textures[layer], GL_TEXTURE_2D, level, 0, 0, 0,
+					pool.array, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+					std::max(pool.width >> level, 1), std::max(pool.height >> level, 1), 1);
+			}
+		}
+
+		GPS_GPU_RESOURCE(GPU_TEXTURE, pool.array, getTextureBytes(pool.format, pool.width, pool.height, layers, pool.levels),
+			pool.format, "texture array");
+		pool.dirty = false;
+	}
+
+	GLuint TextureArrayPool::getArray(GLuint texture) const {
+
+		std::unordered_map<GLuint, Placement>::const_iterator it = placements.find(texture);
+		return it != placements.end() ? pools[it->second.pool].array : 0;
+	}
+
+	GLuint TextureArrayPool::getLayer(GLuint texture) const {
+
+		std::unordered_map<GLuint, Placement>::const_iterator it = placements.find(texture);
+		return it != placements.end() ? it->second.layer : 0;
+	}
+
+	GLuint TextureArrayPool::getArrayCount() const {
+		return (GLuint)pools.size();
+	}
+
+	GLuint TextureArrayPool::getLayerCount() const {
+		return (GLuint)placements.size();
+	}
+
+	void TextureArrayPool::Delete() {
+
+		for (size_t p = 0; p < pools.size(); p++) {
+			glState().deleteTexture(pools[p].array);
+			gpuResources().remove(GPU_TEXTURE, pools[p].array);
+		}
+		pools.clear();
+		placements.clear();
+		pending.clear();
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef TextureArrays_hpp
+#define TextureArrays_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace gps {
+
+    // Material textures copied into GL_TEXTURE_2D_ARRAY pools, one array per size, internal format and
+    // sampled levels. Meshes whose textures sit in the same arrays can go out in one multi-draw call,
+    // the shader picks the layer. The 2D textures stay the source, an array is rebuilt from them when
+    // a texture of its kind is added
+    class TextureArrayPool {
+
+    public:
+        // True when the context can copy between textures and allocate immutable arrays
+        static bool isSupported();
+
+        TextureArrayPool();
+
+        // Queues a texture for the next update, 0 and textures already pooled are ignored
+        void addTexture(GLuint texture);
+        // Copies the queued textures into their arrays, true when arrays or layers changed
+        bool update();
+
+        // Array holding the texture, 0 when it is not pooled (yet)
+        GLuint getArray(GLuint texture) const;
+        GLuint getLayer(GLuint texture) const;
+
+        GLuint getArrayCount() const;
+        GLuint getLayerCount() const;
+
+        void Delete();
+
+    private:
+        struct Pool {
+            GLuint array;
+            GLint width;
+            GLint height;
+            GLenum format;
+            GLint levels;
+            // GL_TEXTURE_MAX_LEVEL of the sources, atlas pages sample fewer levels than they have
+            GLint maxLevel;
+            // source of every layer, in layer order
+            std::vector<GLuint> textures;
+            bool dirty;
+        };
+
+        struct Placement {
+            size_t pool;
+            GLuint layer;
+        };
+
+        std::vector<GLuint> pending;
+        std::vector<Pool> pools;
+        std::unordered_map<GLuint, Placement> placements;
+        GLint maxLayers;
+
+        void rebuild(Pool& pool);
+    };
+}
+
+#endif /* TextureArrays_hpp */
@@ -0,0 +1,308 @@
+#include "TextureAtlas.hpp"
+#include "AssetPackage.hpp"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+
+namespace gps {
+
+	// UVs this close to the unit square still count as inside it, exporters round them
+	static const float UV_EPSILON = 0.001f;
+
+	static int roundUp(int value, int multiple) {
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	SkylinePacker::SkylinePacker(int width, int height) {
+
+		this->width = width;
+		this->height = height;
+		usedWidth = 0;
+		usedHeight = 0;
+
+		Segment ground;
+		ground.x = 0;
+		ground.y = 0;
+		ground.width = width;
+		skyline.push_back(ground);
+	}
+
+	int SkylinePacker::findY(size_t segment, int width, int height) const {
+
+		if (skyline[segment].x + width > this->width)
+			return -1;
+
+		// the rectangle rests on the highest segment under it
+		int y = 0;
+		int remaining = width;
+		for (size_t i = segment; remaining > 0; i++) {
+			y = std::max(y, skyline[i].y);
+			if (y + height > this->height)
+				return -1;
+			remaining -= skyline[i].width;
+		}
+		return y;
+	}
+
+	bool SkylinePacker::insert(int width, int height, int& x, int& y) {
+
+		size_t best = skyline.size();
+		int bestTop = INT_MAX;
+		int bestY = 0;
+		for (size_t i = 0; i < skyline.size(); i++) {
+			int top = findY(i, width, height);
+			if (top < 0)
+				continue;
+			// lowest top edge first, the narrower segment wastes less on a tie
+			if (top + height < bestTop || (top + height == bestTop && skyline[i].width < skyline[best].width)) {
+				best = i;
+				bestTop = top + height;
+				bestY = top;
+			}
+		}
+		if (best == skyline.size())
+			return false;
+
+		x = skyline[best].x;
+		y = bestY;
+
+		Segment placed;
+		placed.x = x;
+		placed.y = y + height;
+		placed.width = width;
+		skyline.insert(skyline.begin() + best, placed);
+
+		// the segments under the new one shrink or disappear
+		for (size_t i = best + 1; i < skyline.size();) {
+			int overlap = placed.x + placed.width - skyline[i].x;
+			if (overlap <= 0)
+				break;
+			if (skyline[i].width <= overlap) {
+				skyline.erase(skyline.begin() + i);
+				continue;
+			}
+			skyline[i].x += overlap;
+			skyline[i].width -= overlap;
+			break;
+		}
+
+		for (size_t i = 0; i + 1 < skyline.size();) {
+			if (skyline[i].y == skyline[i + 1].y) {
+				skyline[i].width += skyline[i + 1].width;
+				skyline.erase(skyline.begin() + i + 1);
+			}
+			else
+				i++;
+		}
+
+		usedWidth = std::max(usedWidth, x + width);
+		usedHeight = std::max(usedHeight, y + height);
+		return true;
+	}
+
+	int SkylinePacker::getUsedWidth() const {
+		return usedWidth;
+	}
+
+	int SkylinePacker::getUsedHeight() const {
+		return usedHeight;
+	}
+
+	// The textures of a mesh, meshes with the same list share the rectangle
+	struct AtlasMaterial {
+		std::vector<gps::TextureFile> textures;
+		int width;
+		int height;
+		bool eligible;
+		int page;
+		// corner of the texture, the gutter is around it
+		int x;
+		int y;
+	};
+
+	static bool sameTextures(const std::vector<gps::TextureFile>& a, const std::vector<gps::TextureFile>& b) {
+
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++) {
+			if (a[i].path != b[i].path || a[i].type != b[i].type)
+				return false;
+		}
+		return true;
+	}
+
+	static bool checkTextures(AtlasMaterial& material) {
+
+		for (size_t i = 0; i < material.textures.size(); i++) {
+			int width, height, channels;
+			AssetData file;
+			if (!vfs().read(material.textures[i].path, file) || file.size == 0 ||
+				!stbi_info_from_memory(file.data, (int)file.size, &width, &height, &channels))
+				return false;
+			if (i > 0 && (width != material.width || height != material.height))
+				return false;
+			material.width = width;
+			material.height = height;
+		}
+		return std::max(material.width, material.height) <= ATLAS_MAX_TEXTURE_SIZE;
+	}
+
+	static bool hasUnitUVs(const gps::MeshData& mesh) {
+
+		for (size_t i = 0; i < mesh.vertices.size(); i++) {
+			const glm::vec2& uv = mesh.vertices[i].TexCoords;
+			if (uv.x < -UV_EPSILON || uv.x > 1.0f + UV_EPSILON || uv.y < -UV_EPSILON || uv.y > 1.0f + UV_EPSILON)
+				return false;
+		}
+		return true;
+	}
+
+	// Copies an image into its rectangle and repeats its edge texels over the gutter
+	static void blitWithGutter(const unsigned char* image, int width, int height, gps::AtlasPage& page, int x, int y) {
+
+		int blockWidth = roundUp(width, ATLAS_GUTTER) + ATLAS_GUTTER;
+		int blockHeight = roundUp(height, ATLAS_GUTTER) + ATLAS_GUTTER;
+		for (int row = -ATLAS_GUTTER; row < blockHeight; row++) {
+			int sourceRow = std::min(std::max(row, 0), height - 1);
+			unsigned char* target = &page.pixels[((size_t)(y + row) * page.width + (x - ATLAS_GUTTER)) * 4];
+			for (int column = -ATLAS_GUTTER; column < blockWidth; column++) {
+				int sourceColumn = std::min(std::max(column, 0), width - 1);
+				const unsigned char* source = image + ((size_t)sourceRow * width + sourceColumn) * 4;
+				for (int c = 0; c < 4; c++)
+					*target++ = source[c];
+			}
+		}
+	}
+
+	size_t buildTextureAtlas(gps::ObjData& data, const std::string& name, std::vector<gps::AtlasPage>& pages) {
+
+		std::vector<AtlasMaterial> materials;
+		std::vector<int> meshMaterials(data.meshes.size(), -1);
+		for (size_t s = 0; s < data.meshes.size(); s++) {
+
+			const std::vector<gps::TextureFile>& textures = data.meshes[s].textures;
+			if (textures.empty())
+				continue;
+
+			for (size_t m = 0; m < materials.size() && meshMaterials[s] < 0; m++) {
+				if (sameTextures(materials[m].textures, textures))
+					meshMaterials[s] = (int)m;
+			}
+			if (meshMaterials[s] < 0) {
+				AtlasMaterial material;
+				material.textures = textures;
+				material.width = 0;
+				material.height = 0;
+				material.page = -1;
+				material.x = 0;
+				material.y = 0;
+				material.eligible = checkTextures(material);
+				materials.push_back(material);
+				meshMaterials[s] = (int)materials.size() - 1;
+			}
+		}
+
+		// one mesh tiling the texture keeps the whole material out, it needs the texture on its own
+		for (size_t s = 0; s < data.meshes.size(); s++) {
+			if (meshMaterials[s] >= 0 && materials[meshMaterials[s]].eligible && !hasUnitUVs(data.meshes[s]))
+				materials[meshMaterials[s]].eligible = false;
+		}
+
+		std::vector<size_t> order;
+		for (size_t m = 0; m < materials.size(); m++) {
+			if (materials[m].eligible)
+				order.push_back(m);
+		}
+		// a single material would only gain gutters
+		if (order.size() < 2)
+			return 0;
+
+		// tallest first, the skyline stays flatter
+		std::sort(order.begin(), order.end(), [&materials](size_t a, size_t b) {
+			return materials[a].height > materials[b].height;
+		});
+
+		std::vector<SkylinePacker> packers;
+		for (size_t i = 0; i < order.size(); i++) {
+
+			AtlasMaterial& material = materials[order[i]];
+			int blockWidth = roundUp(material.width, ATLAS_GUTTER) + 2 * ATLAS_GUTTER;
+			int blockHeight = roundUp(material.height, ATLAS_GUTTER) + 2 * ATLAS_GUTTER;
+			int x = 0, y = 0;
+			for (size_t p = 0; p < packers.size() && material.page < 0; p++) {
+				if (packers[p].insert(blockWidth, blockHeight, x, y))
+					material.page = (int)p;
+			}
+			if (material.page < 0) {
+				packers.push_back(SkylinePacker(ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE));
+				packers.back().insert(blockWidth, blockHeight, x, y);
+				material.page = (int)packers.size() - 1;
+			}
+			material.x = x + ATLAS_GUTTER;
+			material.y = y + ATLAS_GUTTER;
+		}
+
+		// one page per texture type the materials of a page use, the pages only get as large as their content
+		std::vector<std::vector<int> > pageIndices(packers.size());
+		for (size_t i = 0; i < order.size(); i++) {
+
+			AtlasMaterial& material = materials[order[i]];
+			for (size_t t = 0; t < material.textures.size(); t++) {
+
+				const std::string& type = material.textures[t].type;
+				int index = -1;
+				for (size_t p = 0; p < pageIndices[material.page].size() && index < 0; p++) {
+					if (pages[pageIndices[material.page][p]].type == type)
+						index = pageIndices[material.page][p];
+				}
+				if (index < 0) {
+					gps::AtlasPage page;
+					page.path = name + "#atlas" + std::to_string(material.page) + "/" + type;
+					page.type = type;
+					page.width = packers[material.page].getUsedWidth();
+					page.height = packers[material.page].getUsedHeight();
+					page.pixels.assign((size_t)page.width * page.height * 4, 0);
+					pages.push_back(page);
+					index = (int)pages.size() - 1;
+					pageIndices[material.page].push_back(index);
+				}
+
+				// an image that fails now leaves its rectangle black, like a texture that fails to load
+				int width = 0, height = 0, channels;
+				AssetData file;
+				unsigned char* image = NULL;
+				if (vfs().read(material.textures[t].path, file) && file.size > 0)
+					image = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 4);
+				if (image == NULL || width != material.width || height != material.height)
+					fprintf(stderr, "ERROR: could not load %s into the atlas\n", material.textures[t].path.c_str());
+				else {
+					flipImageRows(image, width, height, 4);
+					blitWithGutter(image, width, height, pages[index], material.x, material.y);
+				}
+				stbi_image_free(image);
+				material.textures[t].path = pages[index].path;
+			}
+		}
+
+		for (size_t s = 0; s < data.meshes.size(); s++) {
+
+			if (meshMaterials[s] < 0 || !materials[meshMaterials[s]].eligible)
+				continue;
+
+			const AtlasMaterial& material = materials[meshMaterials[s]];
+			const SkylinePacker& packer = packers[material.page];
+			glm::vec2 offset((float)material.x / packer.getUsedWidth(), (float)material.y / packer.getUsedHeight());
+			glm::vec2 scale((float)material.width / packer.getUsedWidth(), (float)material.height / packer.getUsedHeight());
+			for (size_t i = 0; i < data.meshes[s].vertices.size(); i++) {
+				glm::vec2& uv = data.meshes[s].vertices[i].TexCoords;
+				uv = offset + glm::clamp(uv, 0.0f, 1.0f) * scale;
+			}
+			data.meshes[s].textures = material.textures;
+		}
+
+		return order.size();
+	}
+}
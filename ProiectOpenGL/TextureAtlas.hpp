@@ -0,0 +1,68 @@
+#ifndef TextureAtlas_hpp
+#define TextureAtlas_hpp
+
+#include "ModelLoader.hpp"
+
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    // Largest texture that goes into an atlas, bigger ones keep their own texture object
+    static const int ATLAS_MAX_TEXTURE_SIZE = 256;
+    static const int ATLAS_PAGE_SIZE = 2048;
+    // Border of repeated edge texels around every rectangle. The rectangles start and end on
+    // multiples of it too, so the first ATLAS_MIP_LEVELS levels never mix two materials
+    static const int ATLAS_GUTTER = 8;
+    static const int ATLAS_MIP_LEVELS = 4;
+
+    // Skyline bottom-left packer, places rectangles on the lowest part of the outline that fits them
+    class SkylinePacker {
+
+    public:
+        SkylinePacker(int width, int height);
+
+        // False when the rectangle does not fit anymore
+        bool insert(int width, int height, int& x, int& y);
+
+        // Corner of the bounding box of everything placed so far
+        int getUsedWidth() const;
+        int getUsedHeight() const;
+
+    private:
+        struct Segment {
+            int x;
+            int y;
+            int width;
+        };
+
+        int width;
+        int height;
+        int usedWidth;
+        int usedHeight;
+        // the outline, left to right, covering the whole width
+        std::vector<Segment> skyline;
+
+        // Height the rectangle would sit at when its left edge starts on this segment, -1 when it does not fit
+        int findY(size_t segment, int width, int height) const;
+    };
+
+    // One atlas image of a texture type, RGBA rows bottom first like the textures of Model3D
+    struct AtlasPage {
+        // what the TextureFile paths of the remapped meshes refer to
+        std::string path;
+        std::string type;
+        int width;
+        int height;
+        std::vector<unsigned char> pixels;
+    };
+
+    // Packs the materials whose textures are small and share one size into atlas pages, one page per
+    // texture type, the rectangle of a material is the same in all of them. The meshes using them get
+    // their UVs moved into the rectangle and their textures pointed at the pages. A material stays
+    // out when one of its meshes has UVs outside [0, 1], those rely on GL_REPEAT.
+    // Returns how many materials went into the pages
+    size_t buildTextureAtlas(gps::ObjData& data, const std::string& name, std::vector<gps::AtlasPage>& pages);
+}
+
+#endif /* TextureAtlas_hpp */
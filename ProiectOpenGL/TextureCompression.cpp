@@ -0,0 +1,468 @@
+#include "TextureCompression.hpp"
+#include "AssetPackage.hpp"
+#include "ModelLoader.hpp"
+#include "GLState.hpp"
+#include "GpuResources.hpp"
+#include "GLTrace.hpp"
+
+#include "stb_image.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define GPS_HAS_SSE2 1
+#endif
+
+namespace gps {
+
+	// Cooked file, the counterpart of the KTX2 layout: this header, the offset and size of every
+	// level, then the blocks of the levels, level 0 first. Like the cooked mip chains of the texture
+	// streamer, the source size and time tell when the image changed and the file is stale
+	struct CompressedHeader {
+		char magic[8];
+		GLuint version;
+		GLenum format;
+		GLint width;
+		GLint height;
+		GLint levels;
+		GLuint64 sourceSize;
+		GLint64 sourceTime;
+	};
+
+	static const char COMPRESSED_MAGIC[8] = { 'G', 'P', 'S', 'B', 'C', 'T', 'X', 0 };
+	static const GLuint COMPRESSED_VERSION = 1;
+	// a thread gets at least this many rows of blocks, small levels stay on the loading thread
+	static const int BLOCK_ROWS_PER_THREAD = 16;
+
+	size_t getBlockBytes(BlockFormat format) {
+		return format == BLOCK_BC1 || format == BLOCK_BC4 ? 8 : 16;
+	}
+
+	static void putU16(unsigned char* block, unsigned int value) {
+		block[0] = (unsigned char)value;
+		block[1] = (unsigned char)(value >> 8);
+	}
+
+	static unsigned int toRgb565(const float color[3]) {
+
+		unsigned int r = (unsigned int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		unsigned int g = (unsigned int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+		unsigned int b = (unsigned int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+		return (r << 11) | (g << 5) | b;
+	}
+
+	// The color the decoder expands a 565 endpoint to
+	static void fromRgb565(unsigned int packed, float color[3]) {
+
+		unsigned int r = (packed >> 11) & 31;
+		unsigned int g = (packed >> 5) & 63;
+		unsigned int b = packed & 31;
+		color[0] = (float)((r << 3) | (r >> 2));
+		color[1] = (float)((g << 2) | (g >> 4));
+		color[2] = (float)((b << 3) | (b >> 2));
+	}
+
+	// Position of every texel on the line from endpoint 0 to endpoint 1 in thirds, rounded to the
+	// nearest of the four palette colors. The palette order is 0, 2, 3, 1 along the line
+	static GLuint selectColorIndices(const float red[16], const float green[16], const float blue[16],
+		const float start[3], const float end[3]) {
+
+		static const GLuint paletteIndex[4] = { 0, 2, 3, 1 };
+		float axis[3] = { end[0] - start[0], end[1] - start[1], end[2] - start[2] };
+		float length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		float scale = length > 0.0f ? 3.0f / length : 0.0f;
+		int steps[16];
+
+#ifdef GPS_HAS_SSE2
+		__m128 axisR = _mm_set1_ps(axis[0] * scale);
+		__m128 axisG = _mm_set1_ps(axis[1] * scale);
+		__m128 axisB = _mm_set1_ps(axis[2] * scale);
+		__m128 startR = _mm_set1_ps(start[0]);
+		__m128 startG = _mm_set1_ps(start[1]);
+		__m128 startB = _mm_set1_ps(start[2]);
+		for (int i = 0; i < 16; i += 4) {
+			__m128 t = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(red + i), startR), axisR),
+				_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(green + i), startG), axisG)),
+				_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(blue + i), startB), axisB));
+			t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(3.0f));
+			// rounds to nearest with the default rounding mode
+			_mm_storeu_si128((__m128i*)(steps + i), _mm_cvtps_epi32(t));
+		}
+#else
+		for (int i = 0; i < 16; i++) {
+			float t = ((red[i] - start[0]) * axis[0] + (green[i] - start[1]) * axis[1] + (blue[i] - start[2]) * axis[2]) * scale;
+			steps[i] = (int)(std::min(std::max(t, 0.0f), 3.0f) + 0.5f);
+		}
+#endif
+
+		GLuint indices = 0;
+		for (int i = 0; i < 16; i++)
+			indices |= paletteIndex[steps[i]] << (2 * i);
+		return indices;
+	}
+
+	// Endpoints on the principal axis of the colors, at the outermost texels moved in by a sixteenth
+	// of the range, which lowers the error of the texels between them
+	static void encodeColorBlock(const unsigned char texels[64], unsigned char* block) {
+
+		float red[16], green[16], blue[16];
+		float mean[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++) {
+			red[i] = texels[4 * i];
+			green[i] = texels[4 * i + 1];
+			blue[i] = texels[4 * i + 2];
+			mean[0] += red[i];
+			mean[1] += green[i];
+			mean[2] += blue[i];
+		}
+		for (int c = 0; c < 3; c++)
+			mean[c] /= 16.0f;
+
+		float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 16; i++) {
+			float r = red[i] - mean[0], g = green[i] - mean[1], b = blue[i] - mean[2];
+			covariance[0] += r * r;
+			covariance[1] += r * g;
+			covariance[2] += r * b;
+			covariance[3] += g * g;
+			covariance[4] += g * b;
+			covariance[5] += b * b;
+		}
+
+		// a few power iterations find the principal axis well enough for 16 colors
+		float axis[3] = { 1.0f, 1.0f, 1.0f };
+		for (int iteration = 0; iteration < 4; iteration++) {
+			float next[3] = {
+				covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+				covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+				covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+			};
+			float largest = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+			if (largest == 0.0f)
+				break;
+			for (int c = 0; c < 3; c++)
+				axis[c] = next[c] / largest;
+		}
+
+		int lowest = 0, highest = 0;
+		float lowestT = 0.0f, highestT = 0.0f;
+		for (int i = 0; i < 16; i++) {
+			float t = (red[i] - mean[0]) * axis[0] + (green[i] - mean[1]) * axis[1] + (blue[i] - mean[2]) * axis[2];
+			if (i == 0 || t < lowestT) {
+				lowestT = t;
+				lowest = i;
+			}
+			if (i == 0 || t > highestT) {
+				highestT = t;
+				highest = i;
+			}
+		}
+
+		float low[3] = { red[lowest], green[lowest], blue[lowest] };
+		float high[3] = { red[highest], green[highest], blue[highest] };
+		for (int c = 0; c < 3; c++) {
+			float inset = (high[c] - low[c]) / 16.0f;
+			low[c] += inset;
+			high[c] -= inset;
+		}
+
+		// color 0 above color 1 selects the four color mode
+		unsigned int color0 = toRgb565(high);
+		unsigned int color1 = toRgb565(low);
+		if (color0 < color1)
+			std::swap(color0, color1);
+		putU16(block, color0);
+		putU16(block + 2, color1);
+
+		GLuint indices = 0;
+		if (color0 != color1) {
+			float start[3], end[3];
+			fromRgb565(color0, start);
+			fromRgb565(color1, end);
+			indices = selectColorIndices(red, green, blue, start, end);
+		}
+		for (int i = 0; i < 4; i++)
+			block[4 + i] = (unsigned char)(indices >> (8 * i));
+	}
+
+	// One channel between its minimum and maximum in sevenths, the eight value mode
+	static void encodeChannelBlock(const unsigned char texels[64], int channel, unsigned char* block) {
+
+		int highest = 0, lowest = 255;
+		for (int i = 0; i < 16; i++) {
+			highest = std::max(highest, (int)texels[4 * i + channel]);
+			lowest = std::min(lowest, (int)texels[4 * i + channel]);
+		}
+		block[0] = (unsigned char)highest;
+		block[1] = (unsigned char)lowest;
+
+		GLuint64 indices = 0;
+		if (highest > lowest) {
+			static const GLuint64 paletteIndex[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+			int range = highest - lowest;
+			for (int i = 0; i < 16; i++) {
+				int step = ((highest - texels[4 * i + channel]) * 7 + range / 2) / range;
+				indices |= paletteIndex[step] << (3 * i);
+			}
+		}
+		for (int i = 0; i < 6; i++)
+			block[2 + i] = (unsigned char)(indices >> (8 * i));
+	}
+
+	static void compressBlockRows(const unsigned char* rgba, int width, int height, BlockFormat format,
+		int firstRow, int lastRow, unsigned char* blocks) {
+
+		int blocksWide = (width + 3) / 4;
+		size_t blockBytes = getBlockBytes(format);
+		unsigned char texels[64];
+		for (int by = firstRow; by < lastRow; by++) {
+			for (int bx = 0; bx < blocksWide; bx++) {
+
+				for (int y = 0; y < 4; y++) {
+					const unsigned char* row = rgba + (size_t)std::min(by * 4 + y, height - 1) * width * 4;
+					for (int x = 0; x < 4; x++)
+						memcpy(texels + (y * 4 + x) * 4, row + std::min(bx * 4 + x, width - 1) * 4, 4);
+				}
+
+				unsigned char* block = blocks + ((size_t)by * blocksWide + bx) * blockBytes;
+				switch (format) {
+				case BLOCK_BC1:
+					encodeColorBlock(texels, block);
+					break;
+				case BLOCK_BC3:
+					encodeChannelBlock(texels, 3, block);
+					encodeColorBlock(texels, block + 8);
+					break;
+				case BLOCK_BC4:
+					encodeChannelBlock(texels, 0, block);
+					break;
+				case BLOCK_BC5:
+					encodeChannelBlock(texels, 0, block);
+					encodeChannelBlock(texels, 1, block + 8);
+					break;
+				}
+			}
+		}
+	}
+
+	void compressImage(const unsigned char* rgba, int width, int height, BlockFormat format, std::vector<unsigned char>& blocks) {
+
+		int blocksWide = (width + 3) / 4;
+		int blocksHigh = (height + 3) / 4;
+		blocks.resize((size_t)blocksWide * blocksHigh * getBlockBytes(format));
+
+		int threads = std::max(1, std::min((int)std::thread::hardware_concurrency(), blocksHigh / BLOCK_ROWS_PER_THREAD));
+		std::vector<std::thread> workers;
+		int rowsPerThread = (blocksHigh + threads - 1) / threads;
+		for (int t = 1; t < threads; t++) {
+			int firstRow = t * rowsPerThread;
+			int lastRow = std::min(firstRow + rowsPerThread, blocksHigh);
+			if (firstRow < lastRow)
+				workers.push_back(std::thread(compressBlockRows, rgba, width, height, format, firstRow, lastRow, &blocks[0]));
+		}
+		compressBlockRows(rgba, width, height, format, 0, std::min(rowsPerThread, blocksHigh), &blocks[0]);
+		for (size_t t = 0; t < workers.size(); t++)
+			workers[t].join();
+	}
+
+	bool isTextureCompressionSupported() {
+
+#if defined (__APPLE__)
+		return false;
+#else
+		return GLEW_EXT_texture_compression_s3tc && GLEW_EXT_texture_sRGB;
+#endif
+	}
+
+	static bool getSourceInfo(const char* fileName, GLuint64& size, GLint64& time) {
+
+		struct stat info;
+		if (stat(fileName, &info) != 0)
+			return false;
+		size = (GLuint64)info.st_size;
+		time = (GLint64)info.st_mtime;
+		return true;
+	}
+
+	// Checks the header and the level table, levels points at the table in contents
+	static bool parseCompressedFile(const unsigned char* contents, size_t size, CompressedHeader& header, const GLuint64*& levels) {
+
+		if (size < sizeof(header))
+			return false;
+		memcpy(&header, contents, sizeof(header));
+		if (memcmp(header.magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) != 0 || header.version != COMPRESSED_VERSION ||
+			header.levels <= 0 || header.levels > 32 || size < sizeof(header) + header.levels * 2 * sizeof(GLuint64))
+			return false;
+
+		levels = (const GLuint64*)(contents + sizeof(header));
+		for (GLint level = 0; level < header.levels; level++) {
+			if (levels[2 * level] > size || levels[2 * level + 1] > size - levels[2 * level])
+				return false;
+		}
+		return true;
+	}
+
+	// Decodes the image once and encodes every level of its mip chain, BC1 unless a texel is transparent
+	static bool cookTexture(const char* fileName, const std::string& cookedFile, GLuint64 sourceSize, GLint64 sourceTime,
+		std::vector<unsigned char>& contents) {
+
+		AssetData file;
+		int width = 0, height = 0, channels;
+		unsigned char* image = NULL;
+		if (vfs().read(fileName, file) && file.size > 0)
+			image = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 4);
+		if (image == NULL) {
+			fprintf(stderr, "ERROR: could not load %s\n", fileName);
+			return false;
+		}
+		flipImageRows(image, width, height, 4);
+
+		bool opaque = true;
+		for (size_t i = 3; i < (size_t)width * height * 4 && opaque; i += 4)
+			opaque = image[i] == 255;
+		BlockFormat format = opaque ? BLOCK_BC1 : BLOCK_BC3;
+
+		// the padding is written too, cleared so cooking the same texture gives the same file
+		CompressedHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+		header.version = COMPRESSED_VERSION;
+		header.format = opaque ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+		header.width = width;
+		header.height = height;
+		header.levels = getMipLevels(width, height);
+		header.sourceSize = sourceSize;
+		header.sourceTime = sourceTime;
+
+		std::vector<GLuint64> table(2 * header.levels);
+		contents.assign((const unsigned char*)&header, (const unsigned char*)&header + sizeof(header));
+		contents.resize(sizeof(header) + table.size() * sizeof(GLuint64));
+
+		std::vector<unsigned char> level(image, image + (size_t)width * height * 4);
+		std::vector<unsigned char> next;
+		std::vector<unsigned char> blocks;
+		stbi_image_free(image);
+		for (GLint i = 0; i < header.levels; i++) {
+			int levelWidth = std::max(width >> i, 1);
+			int levelHeight = std::max(height >> i, 1);
+			compressImage(&level[0], levelWidth, levelHeight, format, blocks);
+			table[2 * i] = contents.size();
+			table[2 * i + 1] = blocks.size();
+			contents.insert(contents.end(), blocks.begin(), blocks.end());
+			if (i + 1 < header.levels) {
+				downsampleSrgb(&level[0], levelWidth, levelHeight, 4, next);
+				level.swap(next);
+			}
+		}
+		memcpy(&contents[sizeof(header)], &table[0], table.size() * sizeof(GLuint64));
+
+		// a file that cannot be written only costs the encoding again next time
+		FILE* cooked = fopen(cookedFile.c_str(), "wb");
+		bool written = cooked != NULL && fwrite(&contents[0], 1, contents.size(), cooked) == contents.size();
+		if (cooked != NULL && (fclose(cooked) != 0 || !written)) {
+			written = false;
+			remove(cookedFile.c_str());
+		}
+		if (!written)
+			fprintf(stderr, "WARNING: could not write the compressed levels of %s to %s\n", fileName, cookedFile.c_str());
+		return true;
+	}
+
+	// Creates the texture from the levels in data, table holds the offset and size of each
+	static GLuint uploadBlockLevels(GLenum format, GLint width, GLint height, GLint levels, const unsigned char* data,
+		const GLuint64* table, const char* label) {
+
+		GLuint textureID;
+		glGenTextures(1, &textureID);
+		glState().bindTexture(0, GL_TEXTURE_2D, textureID);
+		for (GLint level = 0; level < levels; level++) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, format, std::max(width >> level, 1), std::max(height >> level, 1), 0,
+				(GLsizei)table[2 * level + 1], data + table[2 * level]);
+		}
+		GPS_GPU_RESOURCE(GPU_TEXTURE, textureID, getTextureBytes(format, width, height, 1, levels), format, label);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glState().bindTexture(0, GL_TEXTURE_2D, 0);
+
+		return textureID;
+	}
+
+	GLuint loadCompressedTexture(const char* fileName) {
+
+		if (!isTextureCompressionSupported())
+			return 0;
+
+		// without the image on disk, as from a package, the cooked file is taken as it is
+		std::string cookedFile = std::string(fileName) + ".bct";
+		GLuint64 sourceSize = 0;
+		GLint64 sourceTime = 0;
+		bool hasSource = getSourceInfo(fileName, sourceSize, sourceTime);
+
+		AssetData cooked;
+		CompressedHeader header;
+		const GLuint64* levels = NULL;
+		bool valid = vfs().read(cookedFile, cooked) && parseCompressedFile(cooked.data, cooked.size, header, levels) &&
+			(!hasSource || (header.sourceSize == sourceSize && header.sourceTime == sourceTime));
+		if (!valid) {
+			cooked.buffer.clear();
+			if (!cookTexture(fileName, cookedFile, sourceSize, sourceTime, cooked.buffer))
+				return 0;
+			cooked.data = &cooked.buffer[0];
+			cooked.size = cooked.buffer.size();
+			parseCompressedFile(cooked.data, cooked.size, header, levels);
+		}
+
+		return uploadBlockLevels(header.format, header.width, header.height, header.levels, cooked.data, levels, "compressed texture");
+	}
+
+	GLuint createCompressedTexture(const unsigned char* rgba, int width, int height, const char* label) {
+
+		if (!isTextureCompressionSupported())
+			return 0;
+
+		GLint levels = getMipLevels(width, height);
+		std::vector<GLuint64> table(2 * levels);
+		std::vector<unsigned char> contents;
+		std::vector<unsigned char> level(rgba, rgba + (size_t)width * height * 4);
+		std::vector<unsigned char> next;
+		std::vector<unsigned char> blocks;
+		for (GLint i = 0; i < levels; i++) {
+			int levelWidth = std::max(width >> i, 1);
+			int levelHeight = std::max(height >> i, 1);
+			compressImage(&level[0], levelWidth, levelHeight, BLOCK_BC3, blocks);
+			table[2 * i] = contents.size();
+			table[2 * i + 1] = blocks.size();
+			contents.insert(contents.end(), blocks.begin(), blocks.end());
+			if (i + 1 < levels) {
+				downsampleSrgb(&level[0], levelWidth, levelHeight, 4, next);
+				// the sRGB format leaves alpha linear, so is its average
+				int nextWidth = std::max(levelWidth / 2, 1);
+				int nextHeight = std::max(levelHeight / 2, 1);
+				for (int y = 0; y < nextHeight; y++) {
+					const unsigned char* row0 = &level[(size_t)std::min(2 * y, levelHeight - 1) * levelWidth * 4];
+					const unsigned char* row1 = &level[(size_t)std::min(2 * y + 1, levelHeight - 1) * levelWidth * 4];
+					for (int x = 0; x < nextWidth; x++) {
+						int x0 = std::min(2 * x, levelWidth - 1) * 4 + 3;
+						int x1 = std::min(2 * x + 1, levelWidth - 1) * 4 + 3;
+						next[((size_t)y * nextWidth + x) * 4 + 3] = (unsigned char)((row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) / 4);
+					}
+				}
+				level.swap(next);
+			}
+		}
+
+		return uploadBlockLevels(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, width, height, levels, &contents[0], &table[0], label);
+	}
+}
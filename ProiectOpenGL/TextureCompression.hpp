@@ -0,0 +1,46 @@
+#ifndef TextureCompression_hpp
+#define TextureCompression_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <cstddef>
+#include <vector>
+
+namespace gps {
+
+    // 4x4 block formats the encoder writes. BC1 is opaque RGB in 8 bytes, BC3 adds an alpha block,
+    // BC4 is one channel in 8 bytes and BC5 two of them, for data like normal maps
+    enum BlockFormat {
+        BLOCK_BC1,
+        BLOCK_BC3,
+        BLOCK_BC4,
+        BLOCK_BC5
+    };
+
+    size_t getBlockBytes(BlockFormat format);
+
+    // Encodes RGBA rows into rows of blocks, the edge blocks of sizes that are not multiples of 4
+    // repeat the last texels. BC4 encodes the red channel, BC5 red and green. Large images are split
+    // into bands of block rows, one thread each
+    void compressImage(const unsigned char* rgba, int width, int height, BlockFormat format, std::vector<unsigned char>& blocks);
+
+    // S3TC with the sRGB formats, macOS reports them but gl3.h does not name them
+    bool isTextureCompressionSupported();
+
+    // Creates a block-compressed texture with its whole mip chain from the cooked file next to the
+    // image. The first load, or one after the image changed, encodes the image and writes the file,
+    // the others upload the blocks as they are. Returns 0 when the image cannot be read
+    GLuint loadCompressedTexture(const char* fileName);
+
+    // Encodes RGBA rows and their mip chain into a BC3 texture, the color is sRGB and the alpha linear.
+    // Nothing is written to disk. Returns 0 when S3TC is not supported
+    GLuint createCompressedTexture(const unsigned char* rgba, int width, int height, const char* label);
+}
+
+#endif /* TextureCompression_hpp */
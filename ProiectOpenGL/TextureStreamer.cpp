@@ -0,0 +1,487 @@
+#include "TextureStreamer.hpp"
+#include "Mesh.hpp"
+#include "ModelLoader.hpp"
+#include "GLState.hpp"
+#include "GpuResources.hpp"
+#include "GLTrace.hpp"
+
+#include "stb_image.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace gps {
+
+	// Cooked file: this header, the offset and size of every level, then the levels as tightly packed
+	// RGB rows, level 0 first. The source size and time tell when the image changed and the file is stale
+	struct CookedHeader {
+		char magic[8];
+		GLuint version;
+		GLint width;
+		GLint height;
+		GLint levels;
+		GLuint64 sourceSize;
+		GLint64 sourceTime;
+	};
+
+	static const char COOKED_MAGIC[8] = { 'G', 'P', 'S', 'M', 'I', 'P', 'S', 0 };
+	static const GLuint COOKED_VERSION = 1;
+	static const int COOKED_CHANNELS = 3;
+
+	static bool getSourceInfo(const char* fileName, GLuint64& size, GLint64& time) {
+
+		struct stat info;
+		if (stat(fileName, &info) != 0)
+			return false;
+		size = (GLuint64)info.st_size;
+		time = (GLint64)info.st_mtime;
+		return true;
+	}
+
+	static bool readCookedFile(const std::string& cookedFile, GLuint64 sourceSize, GLint64 sourceTime, CookedHeader& header,
+		std::vector<GLuint64>& offsets, std::vector<GLuint64>& sizes) {
+
+		FILE* file = fopen(cookedFile.c_str(), "rb");
+		if (file == NULL)
+			return false;
+
+		bool valid = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, COOKED_MAGIC, sizeof(COOKED_MAGIC)) == 0 &&
+			header.version == COOKED_VERSION && header.sourceSize == sourceSize && header.sourceTime == sourceTime &&
+			header.levels > 0 && header.levels <= 32;
+		if (valid) {
+			offsets.resize(header.levels);
+			sizes.resize(header.levels);
+			for (GLint level = 0; level < header.levels && valid; level++)
+				valid = fread(&offsets[level], sizeof(GLuint64), 1, file) == 1 && fread(&sizes[level], sizeof(GLuint64), 1, file) == 1;
+		}
+		fclose(file);
+		return valid;
+	}
+
+	// Decodes the image once and writes every level of its mip chain
+	static bool cookTexture(const char* fileName, const std::string& cookedFile, GLuint64 sourceSize, GLint64 sourceTime,
+		CookedHeader& header, std::vector<GLuint64>& offsets, std::vector<GLuint64>& sizes) {
+
+		int width, height, channels;
+		unsigned char* image = stbi_load(fileName, &width, &height, &channels, COOKED_CHANNELS);
+		if (image == NULL) {
+			fprintf(stderr, "ERROR: could not load %s\n", fileName);
+			return false;
+		}
+		flipImageRows(image, width, height, COOKED_CHANNELS);
+
+		memcpy(header.magic, COOKED_MAGIC, sizeof(COOKED_MAGIC));
+		header.version = COOKED_VERSION;
+		header.width = width;
+		header.height = height;
+		header.levels = getMipLevels(width, height);
+		header.sourceSize = sourceSize;
+		header.sourceTime = sourceTime;
+
+		offsets.resize(header.levels);
+		sizes.resize(header.levels);
+		GLuint64 offset = sizeof(header) + header.levels * 2 * sizeof(GLuint64);
+		for (GLint level = 0; level < header.levels; level++) {
+			sizes[level] = (GLuint64)std::max(width >> level, 1) * std::max(height >> level, 1) * COOKED_CHANNELS;
+			offsets[level] = offset;
+			offset += sizes[level];
+		}
+
+		FILE* file = fopen(cookedFile.c_str(), "wb");
+		if (file == NULL) {
+			fprintf(stderr, "ERROR: could not write the mip levels of %s to %s\n", fileName, cookedFile.c_str());
+			stbi_image_free(image);
+			return false;
+		}
+
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+		for (GLint level = 0; level < header.levels; level++) {
+			written = written && fwrite(&offsets[level], sizeof(GLuint64), 1, file) == 1;
+			written = written && fwrite(&sizes[level], sizeof(GLuint64), 1, file) == 1;
+		}
+
+		std::vector<unsigned char> level(image, image + sizes[0]);
+		std::vector<unsigned char> next;
+		stbi_image_free(image);
+		for (GLint i = 0; i < header.levels && written; i++) {
+			written = fwrite(&level[0], 1, level.size(), file) == level.size();
+			if (i + 1 < header.levels) {
+				downsampleSrgb(&level[0], std::max(width >> i, 1), std::max(height >> i, 1), COOKED_CHANNELS, next);
+				level.swap(next);
+			}
+		}
+
+		if (fclose(file) != 0 || !written) {
+			fprintf(stderr, "ERROR: could not write %s\n", cookedFile.c_str());
+			remove(cookedFile.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	TextureStreamer::TextureStreamer() {
+
+		enabled = false;
+		sparse = false;
+		budget = 256 * 1024 * 1024;
+		uploadBudget = 8 * 1024 * 1024;
+		residentBytes = 0;
+		frame = 1;
+		pixelsPerUnit = 0.0f;
+		openFile = NULL;
+		pendingLevels = 0;
+		uploads = 0;
+		uploadedBytes = 0;
+		evictions = 0;
+	}
+
+	void TextureStreamer::setEnabled(bool enabled) {
+		this->enabled = enabled;
+	}
+
+	bool TextureStreamer::isEnabled() const {
+		return enabled;
+	}
+
+	void TextureStreamer::setBudget(GLuint64 bytes) {
+		budget = bytes;
+	}
+
+	void TextureStreamer::setUploadBudget(GLuint64 bytes) {
+		uploadBudget = bytes;
+	}
+
+	GLuint TextureStreamer::load(const char* fileName) {
+
+		StreamedTexture streamed;
+		streamed.cookedFile = std::string(fileName) + ".mips";
+
+		GLuint64 sourceSize = 0;
+		GLint64 sourceTime = 0;
+		if (!getSourceInfo(fileName, sourceSize, sourceTime)) {
+			fprintf(stderr, "ERROR: could not load %s\n", fileName);
+			return 0;
+		}
+
+		CookedHeader header;
+		if (!readCookedFile(streamed.cookedFile, sourceSize, sourceTime, header, streamed.levelOffsets, streamed.levelBytes) &&
+			!cookTexture(fileName, streamed.cookedFile, sourceSize, sourceTime, header, streamed.levelOffsets, streamed.levelBytes))
+			return 0;
+
+		streamed.width = header.width;
+		streamed.height = header.height;
+		streamed.levels = header.levels;
+		streamed.permanentBase = streamed.levels - 1;
+		while (streamed.permanentBase > 0 && std::max(streamed.width >> (streamed.permanentBase - 1),
+			streamed.height >> (streamed.permanentBase - 1)) <= ALWAYS_RESIDENT_SIZE)
+			streamed.permanentBase--;
+		streamed.gpuBytes.resize(streamed.levels);
+		for (GLint level = 0; level < streamed.levels; level++)
+			streamed.gpuBytes[level] = getTextureBytes(GL_SRGB8, std::max(streamed.width >> level, 1), std::max(streamed.height >> level, 1), 1, 1);
+		streamed.residentBase = streamed.levels;
+		streamed.wantedBase = streamed.levels;
+		streamed.lastWanted.assign(streamed.levels, 0);
+		streamed.sparseLevels = 0;
+		streamed.owner = gpuResources().getOwner("streamed texture");
+
+		glGenTextures(1, &streamed.texture);
+		glState().bindTexture(0, GL_TEXTURE_2D, streamed.texture);
+
+		// the whole chain is allocated here, streaming only moves the base level afterwards
+#if !defined (__APPLE__)
+		if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+			if (textures.empty() && GLEW_ARB_sparse_texture) {
+				GLint pageSizes = 0;
+				glGetInternalformativ(GL_TEXTURE_2D, GL_SRGB8, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &pageSizes);
+				sparse = pageSizes > 0;
+			}
+			if (sparse)
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+			glTexStorage2D(GL_TEXTURE_2D, streamed.levels, GL_SRGB8, streamed.width, streamed.height);
+			if (sparse)
+				glGetTexParameteriv(GL_TEXTURE_2D, GL_NUM_SPARSE_LEVELS_ARB, &streamed.sparseLevels);
+		}
+		else
+#endif
+		{
+			for (GLint level = 0; level < streamed.levels; level++)
+				glTexImage2D(GL_TEXTURE_2D, level, GL_SRGB8, std::max(streamed.width >> level, 1), std::max(streamed.height >> level, 1),
+					0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		}
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, streamed.levels - 1);
+
+		indices[streamed.texture] = textures.size();
+		textures.push_back(streamed);
+
+		StreamedTexture& added = textures.back();
+		for (GLint level = added.levels - 1; level >= added.permanentBase; level--) {
+			if (!uploadLevel(added, level)) {
+				release(added.texture);
+				return 0;
+			}
+		}
+		closeFile();
+		glState().bindTexture(0, GL_TEXTURE_2D, 0);
+
+		GLuint64 allocated = 0;
+		for (GLint level = 0; level < added.levels; level++)
+			allocated += sparse && level < added.sparseLevels && level < added.residentBase ? 0 : added.gpuBytes[level];
+		gpuResources().add(GPU_TEXTURE, added.texture, allocated, GL_SRGB8, added.owner, __FILE__, __LINE__);
+
+		return added.texture;
+	}
+
+	bool TextureStreamer::release(GLuint texture) {
+
+		std::map<GLuint, size_t>::iterator it = indices.find(texture);
+		if (it == indices.end())
+			return false;
+
+		size_t index = it->second;
+		for (GLint level = textures[index].residentBase; level < textures[index].levels; level++)
+			residentBytes -= textures[index].gpuBytes[level];
+		glState().deleteTexture(texture);
+		gpuResources().remove(GPU_TEXTURE, texture);
+
+		// the last texture takes the place of the released one
+		indices.erase(it);
+		if (index + 1 != textures.size()) {
+			textures[index] = textures.back();
+			indices[textures[index].texture] = index;
+		}
+		textures.pop_back();
+		return true;
+	}
+
+	void TextureStreamer::beginFrame(float pixelsPerUnit) {
+		this->pixelsPerUnit = pixelsPerUnit;
+	}
+
+	void TextureStreamer::request(const gps::Mesh& mesh, float distance, float scale) {
+
+		if (!enabled || pixelsPerUnit <= 0.0f || scale <= 0.0f)
+			return;
+
+		// without texture coordinates assume the texture is stretched once over the bounding sphere
+		float uvDensity = mesh.getUvDensity();
+		if (uvDensity <= 0.0f)
+			uvDensity = 0.5f / std::max(mesh.getBoundsRadius(), 0.001f);
+
+		float pixelsPerWorldUnit = pixelsPerUnit / std::max(distance, 0.01f);
+		float uvPerPixel = uvDensity / scale / pixelsPerWorldUnit;
+		for (int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++) {
+			GLuint texture = mesh.getTexture((TextureSlot)slot);
+			if (texture != 0)
+				requestTexture(texture, uvPerPixel);
+		}
+	}
+
+	void TextureStreamer::requestTexture(GLuint texture, float uvPerPixel) {
+
+		std::map<GLuint, size_t>::iterator it = indices.find(texture);
+		if (it == indices.end())
+			return;
+
+		StreamedTexture& streamed = textures[it->second];
+		// a level is enough once one of its texels covers at least one pixel
+		float texelsPerPixel = uvPerPixel * std::max(streamed.width, streamed.height);
+		GLint level = texelsPerPixel > 1.0f ? (GLint)std::floor(std::log2(texelsPerPixel)) : 0;
+		level = std::min(level, streamed.permanentBase);
+
+		streamed.wantedBase = std::min(streamed.wantedBase, level);
+		for (GLint i = level; i < streamed.permanentBase; i++)
+			streamed.lastWanted[i] = frame;
+	}
+
+	void TextureStreamer::update() {
+
+		pendingLevels = 0;
+		uploads = 0;
+		uploadedBytes = 0;
+		evictions = 0;
+		if (!enabled || textures.empty())
+			return;
+
+		// the textures missing the most levels go first, every pass brings each one a level closer
+		std::vector<size_t> order;
+		for (size_t i = 0; i < textures.size(); i++) {
+			if (textures[i].wantedBase < textures[i].residentBase)
+				order.push_back(i);
+		}
+		std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+			return textures[a].residentBase - textures[a].wantedBase > textures[b].residentBase - textures[b].wantedBase;
+		});
+
+		bool progress = true;
+		bool full = false;
+		while (progress && !full && uploadedBytes < uploadBudget) {
+			progress = false;
+			for (size_t i = 0; i < order.size() && uploadedBytes < uploadBudget; i++) {
+				StreamedTexture& streamed = textures[order[i]];
+				if (streamed.wantedBase >= streamed.residentBase)
+					continue;
+
+				GLint level = streamed.residentBase - 1;
+				if (!makeRoom(streamed.gpuBytes[level])) {
+					full = true;
+					break;
+				}
+				if (!uploadLevel(streamed, level)) {
+					// the cooked file went bad, stop asking for this texture
+					streamed.wantedBase = streamed.residentBase;
+					continue;
+				}
+				progress = true;
+			}
+		}
+		closeFile();
+
+		// a smaller budget takes effect even when nothing is uploaded
+		makeRoom(0);
+
+		for (size_t i = 0; i < textures.size(); i++) {
+			pendingLevels += std::max(textures[i].residentBase - textures[i].wantedBase, 0);
+			textures[i].wantedBase = textures[i].levels;
+		}
+		frame++;
+	}
+
+	bool TextureStreamer::makeRoom(GLuint64 bytes) {
+
+		while (residentBytes + bytes > budget) {
+			// only the base level of a texture can go, the resident levels stay contiguous
+			StreamedTexture* victim = NULL;
+			for (size_t i = 0; i < textures.size(); i++) {
+				StreamedTexture& streamed = textures[i];
+				if (streamed.residentBase >= streamed.permanentBase || streamed.lastWanted[streamed.residentBase] == frame)
+					continue;
+				if (victim == NULL || streamed.lastWanted[streamed.residentBase] < victim->lastWanted[victim->residentBase] ||
+					(streamed.lastWanted[streamed.residentBase] == victim->lastWanted[victim->residentBase] &&
+						streamed.gpuBytes[streamed.residentBase] > victim->gpuBytes[victim->residentBase]))
+					victim = &streamed;
+			}
+			if (victim == NULL)
+				return false;
+			evictLevel(*victim);
+		}
+		return true;
+	}
+
+	bool TextureStreamer::uploadLevel(StreamedTexture& streamed, GLint level) {
+
+		std::vector<unsigned char> pixels;
+		if (!readLevel(streamed, level, pixels))
+			return false;
+
+		glState().bindTexture(0, GL_TEXTURE_2D, streamed.texture);
+		setResidency(streamed, level, true);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, std::max(streamed.width >> level, 1), std::max(streamed.height >> level, 1),
+			GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+		streamed.residentBase = level;
+		residentBytes += streamed.gpuBytes[level];
+		uploads++;
+		uploadedBytes += streamed.levelBytes[level];
+		return true;
+	}
+
+	void TextureStreamer::evictLevel(StreamedTexture& streamed) {
+
+		GLint level = streamed.residentBase;
+		streamed.residentBase++;
+		residentBytes -= streamed.gpuBytes[level];
+		evictions++;
+
+		glState().bindTexture(0, GL_TEXTURE_2D, streamed.texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, streamed.residentBase);
+		setResidency(streamed, level, false);
+	}
+
+	void TextureStreamer::setResidency(StreamedTexture& streamed, GLint level, bool resident) {
+
+#if !defined (__APPLE__)
+		// the mip tail is committed as a whole with the permanent levels and stays that way
+		if (!sparse || (level >= streamed.sparseLevels && !resident))
+			return;
+
+		glTexPageCommitmentARB(GL_TEXTURE_2D, level, 0, 0, 0, std::max(streamed.width >> level, 1), std::max(streamed.height >> level, 1),
+			1, resident ? GL_TRUE : GL_FALSE);
+		if (level < streamed.sparseLevels) {
+			GLuint64 committed = 0;
+			for (GLint i = 0; i < streamed.levels; i++) {
+				bool isResident = i == level ? resident : i >= streamed.residentBase;
+				committed += i >= streamed.sparseLevels || isResident ? streamed.gpuBytes[i] : 0;
+			}
+			gpuResources().add(GPU_TEXTURE, streamed.texture, committed, GL_SRGB8, streamed.owner, __FILE__, __LINE__);
+		}
+#endif
+	}
+
+	bool TextureStreamer::readLevel(const StreamedTexture& streamed, GLint level, std::vector<unsigned char>& pixels) {
+
+		if (openFile == NULL || openFileName != streamed.cookedFile) {
+			closeFile();
+			openFile = fopen(streamed.cookedFile.c_str(), "rb");
+			if (openFile == NULL) {
+				fprintf(stderr, "ERROR: could not open %s\n", streamed.cookedFile.c_str());
+				return false;
+			}
+			openFileName = streamed.cookedFile;
+		}
+
+		pixels.resize((size_t)streamed.levelBytes[level]);
+		if (fseek(openFile, (long)streamed.levelOffsets[level], SEEK_SET) != 0 ||
+			fread(&pixels[0], 1, pixels.size(), openFile) != pixels.size()) {
+			fprintf(stderr, "ERROR: level %d of %s is truncated\n", level, streamed.cookedFile.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	void TextureStreamer::closeFile() {
+
+		if (openFile != NULL)
+			fclose(openFile);
+		openFile = NULL;
+		openFileName.clear();
+	}
+
+	TextureStreamingStats TextureStreamer::getStats() const {
+
+		TextureStreamingStats stats;
+		stats.textures = (GLuint)textures.size();
+		stats.residentBytes = residentBytes;
+		stats.budgetBytes = budget;
+		stats.pendingLevels = pendingLevels;
+		stats.uploads = uploads;
+		stats.uploadedBytes = uploadedBytes;
+		stats.evictions = evictions;
+		stats.sparse = sparse;
+		return stats;
+	}
+
+	void TextureStreamer::Delete() {
+
+		while (!textures.empty())
+			release(textures.back().texture);
+		closeFile();
+	}
+
+	TextureStreamer& textureStreamer() {
+
+		static TextureStreamer instance;
+		return instance;
+	}
+}
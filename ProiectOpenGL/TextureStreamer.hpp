@@ -0,0 +1,130 @@
+#ifndef TextureStreamer_hpp
+#define TextureStreamer_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace gps {
+
+    class Mesh;
+
+    struct TextureStreamingStats {
+        GLuint textures;
+        // levels the shaders can sample, against the budget
+        GLuint64 residentBytes;
+        GLuint64 budgetBytes;
+        // levels the last frame wanted that are not resident yet
+        GLuint pendingLevels;
+        GLuint uploads;
+        GLuint64 uploadedBytes;
+        GLuint evictions;
+        // evicted levels give their memory back (ARB_sparse_texture), otherwise they only stop being sampled
+        bool sparse;
+    };
+
+    // Mip streaming of the model textures. Every texture gets its whole mip chain allocated once, but
+    // only the levels up to ALWAYS_RESIDENT_SIZE are uploaded. The meshes the render queue draws ask
+    // for the level their screen size needs, update() reads the missing levels from a cooked file of
+    // the image and evicts the levels that were needed least recently when the budget is used up.
+    // What the shaders sample is limited with GL_TEXTURE_BASE_LEVEL, textures are never reallocated
+    class TextureStreamer {
+
+    public:
+        // levels this large or smaller are uploaded with the texture and never evicted
+        static const int ALWAYS_RESIDENT_SIZE = 64;
+
+        TextureStreamer();
+
+        void setEnabled(bool enabled);
+        bool isEnabled() const;
+        void setBudget(GLuint64 bytes);
+        // bytes read and uploaded per update, bounds the hitch when the camera turns
+        void setUploadBudget(GLuint64 bytes);
+
+        // Creates the texture of an image, cooking the mip chain next to it on the first load.
+        // Returns 0 when the image cannot be read
+        GLuint load(const char* fileName);
+        // Deletes a streamed texture, false when the texture is not one
+        bool release(GLuint texture);
+
+        // pixelsPerUnit is the projected size of one unit at distance one: viewport height / (2 tan(fov / 2))
+        void beginFrame(float pixelsPerUnit);
+        // The mesh is drawn this frame at this distance from the camera, scale is the largest axis
+        // scale of its model matrix
+        void request(const gps::Mesh& mesh, float distance, float scale);
+        // Applies the requests of the frame: evictions first, then uploads within the upload budget
+        void update();
+
+        TextureStreamingStats getStats() const;
+
+        void Delete();
+
+    private:
+        struct StreamedTexture {
+            GLuint texture;
+            std::string cookedFile;
+            GLint width;
+            GLint height;
+            GLint levels;
+            // where each level is in the cooked file and how large it is there and on the GPU
+            std::vector<GLuint64> levelOffsets;
+            std::vector<GLuint64> levelBytes;
+            std::vector<GLuint64> gpuBytes;
+            // levels below this one are committed and decommitted one by one, the rest is the mip tail
+            GLint sparseLevels;
+            // owner in the GPU resource registry
+            std::string owner;
+            // levels from residentBase to the last one can be sampled
+            GLint residentBase;
+            // first level of the part that never leaves
+            GLint permanentBase;
+            // smallest level a request of the current frame asked for, levels when none did
+            GLint wantedBase;
+            // frame each level was last wanted in
+            std::vector<unsigned int> lastWanted;
+        };
+
+        bool enabled;
+        bool sparse;
+        GLuint64 budget;
+        GLuint64 uploadBudget;
+        GLuint64 residentBytes;
+        unsigned int frame;
+        float pixelsPerUnit;
+
+        std::vector<StreamedTexture> textures;
+        // texture name to its index in textures
+        std::map<GLuint, size_t> indices;
+        // last cooked file read from, consecutive levels of the same image reuse the handle
+        std::string openFileName;
+        FILE* openFile;
+
+        GLuint pendingLevels;
+        GLuint uploads;
+        GLuint64 uploadedBytes;
+        GLuint evictions;
+
+        void requestTexture(GLuint texture, float uvPerPixel);
+        bool uploadLevel(StreamedTexture& streamed, GLint level);
+        void evictLevel(StreamedTexture& streamed);
+        // Frees budget for bytes by evicting levels no request of this frame needs, oldest first
+        bool makeRoom(GLuint64 bytes);
+        void setResidency(StreamedTexture& streamed, GLint level, bool resident);
+        bool readLevel(const StreamedTexture& streamed, GLint level, std::vector<unsigned char>& pixels);
+        void closeFile();
+    };
+
+    TextureStreamer& textureStreamer();
+}
+
+#endif /* TextureStreamer_hpp */
@@ -0,0 +1,62 @@
+#include "UniformBuffers.hpp"
+#include "GpuResources.hpp"
+
+#include <cstring>
+
+namespace gps {
+
+	static const char* blockNames[UNIFORM_BLOCK_COUNT] = { "CameraBlock", "LightBlock", "ShadowBlock" };
+
+	FrameUniforms::FrameUniforms() {
+
+		camera = CameraUniforms();
+		light = LightUniforms();
+		shadow = ShadowUniforms();
+	}
+
+	void FrameUniforms::init() {
+
+		// room for a few uploads per frame, the ring grows if the application sends more
+		GpuOwnerScope owner("frame uniforms");
+		ring.init(GL_UNIFORM_BUFFER, 4 * 1024);
+	}
+
+	void FrameUniforms::bindBlocks(const gps::Shader& shader) {
+
+		for (int i = 0; i < UNIFORM_BLOCK_COUNT; i++) {
+
+			GLuint blockIndex = glGetUniformBlockIndex(shader.getProgram(), blockNames[i]);
+			if (blockIndex != GL_INVALID_INDEX)
+				glUniformBlockBinding(shader.getProgram(), blockIndex, i);
+		}
+	}
+
+	void FrameUniforms::upload() {
+
+		const void* blocks[UNIFORM_BLOCK_COUNT] = { &camera, &light, &shadow };
+		const GLsizeiptr sizes[UNIFORM_BLOCK_COUNT] = { sizeof(CameraUniforms), sizeof(LightUniforms), sizeof(ShadowUniforms) };
+
+		// the three blocks go in one allocation, each one starting on the offset alignment
+		GLsizeiptr offsets[UNIFORM_BLOCK_COUNT];
+		GLsizeiptr totalSize = 0;
+		for (int i = 0; i < UNIFORM_BLOCK_COUNT; i++) {
+			offsets[i] = totalSize;
+			totalSize += ring.alignedSize(sizes[i]);
+		}
+
+		GLintptr baseOffset = 0;
+		char* data = (char*)ring.map(totalSize, baseOffset);
+		if (data == NULL)
+			return;
+		for (int i = 0; i < UNIFORM_BLOCK_COUNT; i++)
+			memcpy(data + offsets[i], blocks[i], sizes[i]);
+		ring.unmap();
+
+		for (int i = 0; i < UNIFORM_BLOCK_COUNT; i++)
+			glBindBufferRange(GL_UNIFORM_BUFFER, i, ring.getBuffer(), baseOffset + offsets[i], sizes[i]);
+	}
+
+	void FrameUniforms::Delete() {
+		ring.Delete();
+	}
+}
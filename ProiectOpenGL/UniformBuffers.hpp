@@ -0,0 +1,86 @@
+#ifndef UniformBuffers_hpp
+#define UniformBuffers_hpp
+
+#if defined (__APPLE__)
+    #define GL_SILENCE_DEPRECATION
+    #include <OpenGL/gl3.h>
+#else
+    #define GLEW_STATIC
+    #include <GL/glew.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include "Shader.hpp"
+#include "FrameRing.hpp"
+
+#include <cstddef>
+
+namespace gps {
+
+    static const int POINT_LIGHT_COUNT = 12;
+
+    // Binding points of the blocks, the same for every program
+    enum UniformBlockBinding {
+        CAMERA_BLOCK_BINDING = 0,
+        LIGHT_BLOCK_BINDING = 1,
+        SHADOW_BLOCK_BINDING = 2,
+        UNIFORM_BLOCK_COUNT = 3
+    };
+
+    // Mirrors of the std140 blocks declared in the shaders, member order and padding must match
+
+    // CameraBlock
+    struct CameraUniforms {
+        glm::mat4 view;
+        glm::mat4 projection;
+    };
+
+    // LightBlock, vec3 members take a whole vec4 in std140
+    struct LightUniforms {
+        glm::vec4 lightDir;
+        glm::vec4 lightColor;
+        glm::vec4 pointLightColor;
+        glm::vec4 pointLight[POINT_LIGHT_COUNT];
+        float fogDensity;
+        float padding[3];
+    };
+
+    // ShadowBlock
+    struct ShadowUniforms {
+        glm::mat4 lightSpaceTrMatrix;
+    };
+
+    static_assert(sizeof(glm::vec4) == 16 && sizeof(glm::mat4) == 64, "glm types must be tightly packed");
+    static_assert(offsetof(CameraUniforms, projection) == 64, "CameraBlock layout");
+    static_assert(sizeof(CameraUniforms) == 128, "CameraBlock size");
+    static_assert(offsetof(LightUniforms, lightColor) == 16, "LightBlock layout");
+    static_assert(offsetof(LightUniforms, pointLightColor) == 32, "LightBlock layout");
+    static_assert(offsetof(LightUniforms, pointLight) == 48, "LightBlock layout");
+    static_assert(offsetof(LightUniforms, fogDensity) == 240, "LightBlock layout");
+    static_assert(sizeof(LightUniforms) == 256, "LightBlock size");
+    static_assert(sizeof(ShadowUniforms) == 64, "ShadowBlock size");
+
+    // Per frame data shared by all programs, filled by the application and sent once per frame
+    // into a frame ring, so the copy the GPU is still reading is never overwritten
+    class FrameUniforms {
+
+    public:
+        CameraUniforms camera;
+        LightUniforms light;
+        ShadowUniforms shadow;
+
+        FrameUniforms();
+
+        void init();
+        // Points the blocks the program declares to the shared binding points
+        void bindBlocks(const gps::Shader& shader);
+        void upload();
+        void Delete();
+
+    private:
+        gps::FrameRing ring;
+    };
+}
+
+#endif /* UniformBuffers_hpp */
@@ -1,15 +1,21 @@
 #include "Window.h"
+#include "GLTrace.hpp"
+
+#include <string>
 
 namespace gps {
 
-    void Window::Create(int width, int height, const char *title) {
+    void Window::Create(int width, int height, const char *title, bool visible, WindowContextApi contextApi) {
+#if defined (GLFW_PLATFORM_NULL)
+        // OSMesa renders to memory, GLFW 3.4 can skip the display server entirely
+        if (contextApi == CONTEXT_API_OSMESA)
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
         if (!glfwInit()) {
             throw std::runtime_error("Could not start GLFW3!");
         }
 
         //window hints
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
         glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -22,19 +28,50 @@ namespace gps {
         //for antialising
         glfwWindowHint(GLFW_SAMPLES, 4);
 
-        this->window = glfwCreateWindow(width, height, title, NULL, NULL);
+        glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+#ifdef GPS_GL_TRACING
+        // drivers only send KHR_debug performance messages to debug contexts
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
+        if (contextApi == CONTEXT_API_EGL)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+        else if (contextApi == CONTEXT_API_OSMESA)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+
+        // newest context first, 4.1 is the fallback the renderer always supports
+#if defined (__APPLE__)
+        const int contextVersions[][2] = { { 4, 1 } };
+#else
+        const int contextVersions[][2] = { { 4, 6 }, { 4, 1 } };
+#endif
+        this->window = NULL;
+        for (size_t i = 0; i < sizeof(contextVersions) / sizeof(contextVersions[0]) && !this->window; i++) {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, contextVersions[i][0]);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, contextVersions[i][1]);
+            this->window = glfwCreateWindow(width, height, title, NULL, NULL);
+        }
         if (!this->window) {
             throw std::runtime_error("Could not create GLFW3 window!");
         }
 
         glfwMakeContextCurrent(window);
 
-        glfwSwapInterval(1);
+        glfwSwapInterval(visible ? 1 : 0);
 
 #if not defined (__APPLE__)
         // start GLEW extension handler
         glewExperimental = GL_TRUE;
-        glewInit();
+        GLenum glewStatus = glewInit();
+#if defined (GLEW_ERROR_NO_GLX_DISPLAY)
+        // a GLEW built for GLX loads every GL function before it looks for the X display EGL and OSMesa do not have
+        if (glewStatus == GLEW_ERROR_NO_GLX_DISPLAY && contextApi != CONTEXT_API_NATIVE)
+            glewStatus = GLEW_OK;
+#endif
+        if (glewStatus != GLEW_OK) {
+            glfwDestroyWindow(window);
+            window = NULL;
+            throw std::runtime_error(std::string("Could not start GLEW: ") + (const char*)glewGetErrorString(glewStatus));
+        }
 #endif
 
         // get version info
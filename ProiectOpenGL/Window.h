@@ -21,10 +21,20 @@ struct WindowDimensions {
 
 namespace gps {
 
+    // Who creates the GL context. EGL and OSMesa let hidden windows run on machines without a display,
+    // OSMesa also on machines without a GPU (Mesa llvmpipe)
+    enum WindowContextApi {
+        CONTEXT_API_NATIVE,
+        CONTEXT_API_EGL,
+        CONTEXT_API_OSMESA
+    };
+
     class Window {
 
     public:
-        void Create(int width=800, int height=600, const char *title="OpenGL Project");
+        // A window that is not visible still has a full default framebuffer, swaps do not wait for vsync
+        void Create(int width=800, int height=600, const char *title="OpenGL Project",
+            bool visible=true, WindowContextApi contextApi=CONTEXT_API_NATIVE);
         void Delete();
 
         GLFWwindow* getWindow();
@@ -0,0 +1,30 @@
+# Scaling curves of the synthetic city, from the table of BenchmarkRunner --city-sweep
+# usage: gnuplot -e "table='city_scaling.csv'" benchmarks/plot_city_scaling.gp
+
+if (!exists("table")) table = 'city_scaling.csv'
+
+set datafile separator ','
+set terminal pngcairo size 1400,1000
+set output 'city_scaling.png'
+set key autotitle columnhead top left
+set logscale x
+set xlabel 'instances'
+set grid
+set multiplot layout 2,2
+
+set title 'Frame time (ms)'
+plot table using 2:6 with linespoints, '' using 2:7 with linespoints
+
+set title 'CPU time per frame (ms)'
+plot table using 2:8 with linespoints, '' using 2:9 with linespoints
+
+set title 'Packets per frame'
+set logscale y
+plot table using 2:10 with linespoints, '' using 2:13 with linespoints, '' using 2:11 with linespoints
+unset logscale y
+
+set title 'Loading'
+set ylabel 'ms / MB'
+plot table using 2:4 with linespoints, '' using 2:5 with linespoints, '' using 2:3 with linespoints
+
+unset multiplot
@@ -18,9 +18,32 @@
 #include "Camera.hpp"
 #include "Model3D.hpp"
 #include "SkyBox.hpp"
+#include "RenderQueue.hpp"
+#include "MultiDraw.hpp"
+#include "UniformBuffers.hpp"
+#include "FrameSync.hpp"
+#include "Profiler.hpp"
+#include "Benchmark.hpp"
+#include "CameraPath.hpp"
+#include "InputQueue.hpp"
+#include "Hud.hpp"
+#include "SceneAnimation.hpp"
+#include "CityGenerator.hpp"
+#include "GLTrace.hpp"
+#include "FrameCapture.hpp"
+#include "GpuResources.hpp"
+#include "TextureStreamer.hpp"
+#include "TextureArrays.hpp"
+#include "ResourceManager.hpp"
+#include "AssetPackage.hpp"
+#include "AsyncReader.hpp"
+#include "TextureCompression.hpp"
 
 
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
 
 // window
 gps::Window myWindow;
@@ -29,30 +52,21 @@ gps::Window myWindow;
 glm::mat4 model;
 glm::mat4 view;
 glm::mat4 projection;
-glm::mat3 normalMatrix;
 
 // light parameters
 glm::vec3 lightDir;
 glm::vec3 lightColor;
 
-// shader uniform locations
-GLint modelLoc;
-GLint viewLoc;
-GLint projectionLoc;
-GLint normalMatrixLoc;
-GLint lightDirLoc;
-GLint lightColorLoc;
-
 // Point Lights
 glm::vec3 pointLight[12];
 glm::vec3 pointLightColor;
 
-GLint pointLightLoc;
-GLint pointLightColorLoc;
-
 // Fog
-GLint fogDensityLoc;
 GLfloat fogDensity;
+const GLfloat MAX_FOG_DENSITY = 0.03f;
+
+// camera, light and shadow blocks shared by all the shaders, sent once per frame
+gps::FrameUniforms frameUniforms;
 
 // camera
 gps::Camera myCamera(
@@ -83,19 +97,85 @@ gps::Shader myBasicShader;
 gps::Shader skyboxShader;
 gps::Shader depthMapShader;
 
+// render queue, every model is drawn through it
+gps::RenderQueue renderQueue;
+gps::RenderStats lastFrameStats;
+
+// GL 4.3+ contexts draw through multi-draw indirect batches, 4.1 keeps one draw per mesh
+gps::MultiDrawBatcher multiDraw;
+bool multiDrawEnabled = false;
+// material textures pooled in arrays, so the multi-draw batches go across materials
+gps::TextureArrayPool textureArrays;
+bool textureArraysEnabled = false;
+// diffuse and specular maps in one texture, the main pass fetches one texel per fragment
+bool packedMaterialsEnabled = false;
+
 // SkyBox
 gps::SkyBox mySkyBox;
 std::vector<const GLchar*> faces;
 std::vector<const GLchar*> faces2;
 
-// Animation
+// Animation, the intro is a camera path played before the user takes control
 bool automaticAnimationInProgress = true;
-float animationStartTime;
 float animationDuration = 6.5f;  // Intro animation time
 
+// Camera paths, played back one fixed step per frame
+const float PATH_TIMESTEP = 1.0f / 60.0f;
+gps::CameraPath introPath;
+gps::CameraPath recordedPath;
+const gps::CameraPath* activePath = &introPath;
+float pathTime = 0.0f;
+// playback speed of the paths, the fast flythrough benchmark plays the intro faster
+float pathSpeed = 1.0f;
+
+// Recording, C starts and stops it, V plays the last recording
+bool recordingPath = false;
+double recordStartTime = 0.0;
+double lastRecordTime = 0.0;
+const double PATH_RECORD_INTERVAL = 1.0 / 30.0;
+const char* recordedPathFile = "camera_path.txt";
+
+// Benchmark mode, a hidden window plays the intro on a fixed clock and prints the frame times
+bool benchmarkMode = false;
+gps::Benchmark benchmark;
+gps::WindowContextApi windowContextApi = gps::CONTEXT_API_NATIVE;
+
+// Starting state of the scene, set from the command line so benchmark scenarios can pick one
+bool startAtNight = false;
+GLfloat startFogDensity = 0.0f;
+bool skipIntro = false;
+
+// Input events, queued by the GLFW callbacks and applied at the start of each frame
+gps::InputQueue inputQueue;
+
+// performance overlay
+gps::Hud hud;
+
+// Synthetic city for scale tests, --city N tiles the suburb N x N times
+int cityGridSize = 0;
+unsigned int citySeed = 1;
+const int CITY_CARS_PER_TILE = 20;
+gps::CityLayout cityLayout;
+double cityGenerateMs = 0.0;
+// time spent queueing the scene in the current frame, both passes
+double drawObjectsMs = 0.0;
+
+#ifdef GPS_GL_TRACING
+// Frame capture for FrameReplay, F captures the next frame, --capture the frame --capture-frame picks
+gps::FrameCapture frameCapture;
+const char* captureFileName = NULL;
+int captureFrame = 120;
+#endif
+
+// Scene clock, benchmark runs step it by a fixed amount per frame so every run renders the same frames.
+// Otherwise it is the time the frame started at, or the recorded one when replaying input
+double sceneTime() {
+	return benchmarkMode ? benchmark.getTime() : inputQueue.getFrameTime();
+}
+
 //Shadow
-GLuint shadowMapFBO;
-GLuint depthMapTexture;
+gps::FramebufferHandle shadowMapFBO;
+gps::TextureHandle depthMapTexture;
 const unsigned int SHADOW_WIDTH = 2048;
 const unsigned int SHADOW_HEIGHT = 2048;
 glm::mat4 lightRotation;
@@ -134,11 +214,10 @@ void windowResizeCallback(GLFWwindow* window, int width, int height) {
 
 	if (width > 0 && height > 0) {
 		// Update the viewport size
-		glViewport(0, 0, width, height);
+		gps::glState().viewport(0, 0, width, height);
 
 		// Update the projection matrix with the new aspect ratio
 		projection = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / static_cast<float>(height), 0.1f, 1000.0f);
-		glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 	}
 }
 
@@ -147,13 +226,13 @@ int renderMode = 0;
 void switchRenderMode(int mode) {
 	switch (mode) {
 	case 0:
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL); // Solid mode
+		gps::glState().polygonMode(GL_FILL); // Solid mode
 		break;
 	case 1:
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Wireframe mode
+		gps::glState().polygonMode(GL_LINE); // Wireframe mode
 		break;
 	case 2:
-		glPolygonMode(GL_FRONT_AND_BACK, GL_POINT); // Poligonal
+		gps::glState().polygonMode(GL_POINT); // Poligonal
 		break;
 	}
 }
@@ -161,15 +240,103 @@ void switchRenderMode(int mode) {
 bool night = false;
 bool rainEffect = false;
 
+void printRenderStats() {
+	const gps::RenderStats& stats = lastFrameStats;
+	GLuint stateChanges = stats.programChanges + stats.vaoChanges + stats.textureChanges;
+	fprintf(stdout, "Draw calls: %u, triangles: %u, uniform uploads: %u, draw ranges bound: %u\n",
+		stats.drawCalls, stats.triangles, stats.uniformUploads, stats.bufferRangeBinds);
+	fprintf(stdout, "Culled: %u meshes, %u triangles\n", stats.packetsCulled, stats.trianglesCulled);
+	fprintf(stdout, "State changes: %u (program %u, VAO %u, texture %u), without sorting: %u\n",
+		stateChanges, stats.programChanges, stats.vaoChanges, stats.textureChanges, stats.immediateStateChanges);
+
+	fprintf(stdout, "Frames in flight: %d, CPU waited on the GPU %.3f ms last frame, %.3f ms on average\n",
+		gps::frameSync().getFramesInFlight(), gps::frameSync().getLastWaitMs(), gps::frameSync().getAverageWaitMs());
+
+	gps::GLStateCounters counters = gps::glState().getFrameCounters();
+	fprintf(stdout, "GL state calls: %u issued, %u elided\n", counters.totalIssued(), counters.totalElided());
+	for (int kind = 0; kind < gps::STATE_KIND_COUNT; kind++) {
+		fprintf(stdout, "  %-13s %5u issued %5u elided\n", gps::glState().getKindName((gps::GLStateKind)kind),
+			counters.issued[kind], counters.elided[kind]);
+	}
 
-void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mode) {
+	if (textureArraysEnabled)
+		fprintf(stdout, "Texture arrays: %u, %u layers\n", textureArrays.getArrayCount(), textureArrays.getLayerCount());
+	gps::gpuResources().printReport(stdout);
+	fprintf(stdout, "Handles: %u textures, %u buffers, %u vertex arrays live, %u objects waiting for the GPU\n",
+		(unsigned int)gps::resources().getLiveCount(gps::RESOURCE_TEXTURE), (unsigned int)gps::resources().getLiveCount(gps::RESOURCE_BUFFER),
+		(unsigned int)gps::resources().getLiveCount(gps::RESOURCE_VERTEX_ARRAY), (unsigned int)gps::resources().getPendingCount());
+	gps::AssetStats assets = gps::vfs().getStats();
+	fprintf(stdout, "Assets: %u from the package (%u decompressed), %u loose files, %.2f MB read\n", assets.packageReads,
+		assets.decompressions, assets.looseReads, assets.bytesRead / (1024.0 * 1024.0));
+	if (gps::textureStreamer().isEnabled()) {
+		gps::TextureStreamingStats streaming = gps::textureStreamer().getStats();
+		fprintf(stdout, "Streamed textures: %u, resident %.1f / %.1f MB%s, %u levels pending\n", streaming.textures,
+			streaming.residentBytes / (1024.0 * 1024.0), streaming.budgetBytes / (1024.0 * 1024.0),
+			streaming.sparse ? " (sparse)" : "", streaming.pendingLevels);
+		fprintf(stdout, "  last frame: %u levels uploaded, %.2f MB read, %u evicted\n", streaming.uploads,
+			streaming.uploadedBytes / (1024.0 * 1024.0), streaming.evictions);
+	}
+
+#ifdef GPS_PROFILING
+	gps::profiler().printStats();
+#endif
+#ifdef GPS_GL_TRACING
+	gps::glTrace().printReport(stdout);
+#endif
+}
+
+
+// The old intro moved the camera 0.2 along x every frame and started climbing past x = 0,
+// always looking at the origin. The path samples that motion at 60 frames per second
+void initIntroPath() {
+	gps::Camera introCamera = myCamera;
+	const int framesPerSample = 6;
+	int frameCount = (int)(animationDuration * 60.0f);
+
+	introPath.clear();
+	introPath.addSample(0.0f, introCamera);
+	for (int frame = 1; frame <= frameCount; frame++) {
+		glm::vec3 camPos = introCamera.getCameraPosition();
+		camPos.x -= 0.2f;
+		if (camPos.x < 0)
+			camPos.y += 0.05f;
+		introCamera.setCameraPosition(camPos);
+
+		if (frame % framesPerSample == 0 || frame == frameCount)
+			introPath.addSample(frame / 60.0f, introCamera);
+	}
+}
+
+// Points the mouse look angles along the camera, so the first mouse move after a path does not jump
+void syncMouseAngles() {
+	glm::vec3 front = myCamera.getCameraFrontDirection();
+	pitch = glm::degrees(asin(glm::clamp(front.y, -1.0f, 1.0f)));
+	yaw = glm::degrees(atan2(front.z, front.x));
+	firstMouse = true;
+}
+
+void startCameraPath(const gps::CameraPath& path) {
+	activePath = &path;
+	pathTime = 0.0f;
+	automaticAnimationInProgress = true;
+}
+
+
+// Night turns the street lights on and swaps the sky, the sun is dimmed by the caller
+void setNight(bool enabled) {
+	pointLightColor = enabled ? glm::vec3(1.0f, 1.0f, 0.5f) : glm::vec3(0.0f, 0.0f, 0.0f);
+	mySkyBox.Load(enabled ? faces2 : faces);
+	night = enabled;
+}
+
+void applyKeyEvent(int key, int scancode, int action, int mode) {
 
 	if (automaticAnimationInProgress) {
 		return;
 	}
 
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-		glfwSetWindowShouldClose(window, GL_TRUE);
+		glfwSetWindowShouldClose(myWindow.getWindow(), GL_TRUE);
 	}
 
 	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
@@ -182,13 +349,8 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
 		lightColor *= 1.6f;
 		lightColor = glm::clamp(lightColor, 0.005f, 1.1f);
 
-		if (lightColor.y > 0.05f && night) {
-			pointLightColor = glm::vec3(0.0f, 0.0f, 0.0f);
-			mySkyBox.Load(faces);
-			night = false;
-		}
-		glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
-		glUniform3fv(pointLightColorLoc, 1, glm::value_ptr(pointLightColor));
+		if (lightColor.y > 0.05f && night)
+			setNight(false);
 	}
 
 	if (key == GLFW_KEY_K && action == GLFW_PRESS) {
@@ -196,29 +358,20 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
 		lightColor *= 0.5f;
 		lightColor = glm::clamp(lightColor, 0.005f, 1.1f);
 
-		if (lightColor.y <= 0.05f && !night) {
-			pointLightColor = glm::vec3(1.0f, 1.0f, 0.5f);
-			mySkyBox.Load(faces2);
-			night = true;
-		}
-		glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
-		glUniform3fv(pointLightColorLoc, 1, glm::value_ptr(pointLightColor));
+		if (lightColor.y <= 0.05f && !night)
+			setNight(true);
 	}
 
 	if (pressedKeys[GLFW_KEY_M]) {
 		fogDensity += 0.003;
-		if (fogDensity > 0.03)
-			fogDensity = 0.03;
-		myBasicShader.useShaderProgram();
-		glUniform1fv(fogDensityLoc, 1, &fogDensity);
+		if (fogDensity > MAX_FOG_DENSITY)
+			fogDensity = MAX_FOG_DENSITY;
 	}
 
 	if (pressedKeys[GLFW_KEY_N]) {
 		fogDensity -= 0.003;
 		if (fogDensity <= 0)
 			fogDensity = 0;
-		myBasicShader.useShaderProgram();
-		glUniform1fv(fogDensityLoc, 1, &fogDensity);
 	}
 
 
@@ -234,6 +387,55 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
 		rainEffect = 1 - rainEffect;
 	}
 
+	if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+		printRenderStats();
+	}
+
+	if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+		hud.toggle();
+	}
+
+	if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+		if (recordingPath) {
+			recordingPath = false;
+			if (recordedPath.save(recordedPathFile))
+				fprintf(stdout, "Saved %u camera samples (%.1f s) to %s\n",
+					(unsigned int)recordedPath.getSampleCount(), recordedPath.getDuration(), recordedPathFile);
+		}
+		else {
+			recordingPath = true;
+			recordedPath.clear();
+			recordStartTime = glfwGetTime();
+			lastRecordTime = -PATH_RECORD_INTERVAL;
+			fprintf(stdout, "Recording the camera path, press C again to stop\n");
+		}
+	}
+
+	if (key == GLFW_KEY_V && action == GLFW_PRESS && !recordingPath && !recordedPath.isEmpty())
+		startCameraPath(recordedPath);
+
+#ifdef GPS_PROFILING
+	// first press starts a trace capture, the second one saves it
+	if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+		if (gps::profiler().isCapturing())
+			gps::profiler().writeTrace("profile_trace.json");
+		else {
+			gps::profiler().startCapture();
+			fprintf(stdout, "Trace capture started, press T again to save it\n");
+		}
+	}
+#endif
+
+#ifdef GPS_GL_TRACING
+	// every GL call of the last frame with its arguments
+	if (key == GLFW_KEY_G && action == GLFW_PRESS)
+		gps::glTrace().writeFrame("gl_trace.txt");
+
+	if (key == GLFW_KEY_F && action == GLFW_PRESS && !frameCapture.isPending())
+		frameCapture.request("frame_capture.gpsframe", myWindow.getWindowDimensions().width,
+			myWindow.getWindowDimensions().height);
+#endif
+
 	if (key >= 0 && key < 1024) {
 		if (action == GLFW_PRESS) {
 			pressedKeys[key] = true;
@@ -245,11 +447,11 @@ void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int
 }
 
 
-void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+void applyMouseButtonEvent(int button, int action, int mods) {
 
 }
 
-void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
+void applyCursorEvent(double xpos, double ypos) {
 
 	if (automaticAnimationInProgress) {
 		return;
@@ -283,19 +485,45 @@ void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
 		pitch = -89.0f;
 
 	myCamera.rotate(pitch, yaw);
-	view = myCamera.getViewMatrix();
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-	normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
 }
-void processMovement() {
+// The callbacks only queue the events, they change the scene state here once per frame
+void keyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mode) {
+	// a replay ignores live input, escape still has to close the window
+	if (inputQueue.isReplaying() && key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, GL_TRUE);
+	inputQueue.pushKey(glfwGetTime(), key, scancode, action, mode);
+}
 
-	view = myCamera.getViewMatrix();
-	myBasicShader.useShaderProgram();
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+	inputQueue.pushMouseButton(glfwGetTime(), button, action, mods);
+}
+
+void mouseCallback(GLFWwindow* window, double xpos, double ypos) {
+	inputQueue.pushCursor(glfwGetTime(), xpos, ypos);
+}
 
-	// Compute normal matrix for cartier
-	normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-	glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+void processInput() {
+	inputQueue.beginFrame(glfwGetTime());
+
+	const std::vector<gps::InputEvent>& events = inputQueue.getFrameEvents();
+	for (size_t i = 0; i < events.size(); i++) {
+		const gps::InputEvent& event = events[i];
+		switch (event.type) {
+		case gps::INPUT_KEY:
+			applyKeyEvent(event.key, event.scancode, event.action, event.mods);
+			break;
+		case gps::INPUT_CURSOR:
+			applyCursorEvent(event.x, event.y);
+			break;
+		case gps::INPUT_MOUSE_BUTTON:
+			applyMouseButtonEvent(event.key, event.action, event.mods);
+			break;
+		}
+	}
+}
+
+void processMovement() {
+	GPS_PROFILE("processMovement");
 
 	if (pressedKeys[GLFW_KEY_W]) {
 		myCamera.move(gps::MOVE_FORWARD, cameraSpeed);
@@ -318,9 +546,14 @@ void processMovement() {
 }
 
 void initOpenGLWindow() {
-	myWindow.Create(1924, 1055, "Speed through the Suburbs");
+	myWindow.Create(1924, 1055, "Speed through the Suburbs", !benchmarkMode, windowContextApi);
+#ifdef GPS_GL_TRACING
+	gps::glTrace().install();
+	gps::glTrace().setObserver(&frameCapture);
+#endif
 
-	glfwSetWindowPos(myWindow.getWindow(), 0, 35);
+	if (!benchmarkMode)
+		glfwSetWindowPos(myWindow.getWindow(), 0, 35);
 
 	// Set the resize callback function
 	glfwSetWindowSizeCallback(myWindow.getWindow(), windowResizeCallback);
@@ -336,10 +569,10 @@ void setWindowCallbacks() {
 
 void initOpenGLState() {
 	glClearColor(0.7f, 0.7f, 0.7f, 1.0f);
-	glViewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
+	gps::glState().viewport(0, 0, myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height);
 	glEnable(GL_FRAMEBUFFER_SRGB);
 	glEnable(GL_DEPTH_TEST); // enable depth-testing
-	glDepthFunc(GL_LESS); // depth-testing interprets a smaller value as "closer"
+	gps::glState().depthFunc(GL_LESS); // depth-testing interprets a smaller value as "closer"
 	glEnable(GL_CULL_FACE); // cull face
 	glCullFace(GL_BACK); // cull back face
 	glFrontFace(GL_CCW); // GL_CCW for counter clock-wise
@@ -347,21 +580,118 @@ void initOpenGLState() {
 
 }
 
+// Presents one frame with the loading bar, before the next model blocks the thread
+void showLoadingProgress(int step, int total, const char* label) {
+	gps::frameSync().beginFrame();
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	hud.drawLoading(myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height, (float)step / total, label);
+	gps::frameSync().endFrame();
+	glfwSwapBuffers(myWindow.getWindow());
+}
+
+const char* modelFileNames[] = {
+	"models/cartier/cartier.obj",
+	"models/dodge/dodge.obj",
+	"models/eliceZ/eliceZ.obj",
+	"models/eliceY/eliceY.obj",
+	"models/rain/rain.obj"
+};
+const char* skyboxFaceNames[] = {
+	"skybox/right.jpg",
+	"skybox/left.jpg",
+	"skybox/top.jpg",
+	"skybox/bottom.jpg",
+	"skybox/back.jpg",
+	"skybox/front.jpg"
+};
+// both variants of the shaders, the render path is only known once the context exists
+const char* shaderFileNames[] = {
+	"shaders/basic.vert", "shaders/basic_mdi.vert", "shaders/basic.frag",
+	"shaders/skyboxShader.vert", "shaders/skyboxShader.frag",
+	"shaders/depthMapShader.vert", "shaders/depthMapShader_mdi.vert", "shaders/depthMapShader.frag",
+	"shaders/hud.vert", "shaders/hud.frag"
+};
+
+// Starts reading the files the loading opens while the window and the context are created,
+// the textures of a model follow once its materials are parsed
+void prefetchAssets() {
+	gps::asyncReader().start();
+	std::vector<std::string> paths(modelFileNames, modelFileNames + sizeof(modelFileNames) / sizeof(modelFileNames[0]));
+	paths.insert(paths.end(), skyboxFaceNames, skyboxFaceNames + sizeof(skyboxFaceNames) / sizeof(skyboxFaceNames[0]));
+	paths.insert(paths.end(), shaderFileNames, shaderFileNames + sizeof(shaderFileNames) / sizeof(shaderFileNames[0]));
+	gps::vfs().prefetch(paths);
+}
+
+// The loading is over, what nobody asked for is dropped with the reader
+void finishAssetReads() {
+	if (!gps::asyncReader().isRunning())
+		return;
+	gps::asyncReader().stop();
+	gps::AsyncReadStats reads = gps::asyncReader().getStats();
+	fprintf(stdout, "Asset reads (%s): %u files, %.2f MB in %.1f ms, %.1f MB/s, loading waited %.1f ms\n", reads.backend,
+		reads.files, reads.bytes / (1024.0 * 1024.0), reads.readSeconds * 1000.0,
+		reads.readSeconds > 0.0 ? reads.bytes / (1024.0 * 1024.0) / reads.readSeconds : 0.0, reads.waitSeconds * 1000.0);
+}
+
 void initModels() {
-	cartier.LoadModel("models/cartier/cartier.obj");
-	dodge.LoadModel("models/dodge/dodge.obj");
-	eliceZ.LoadModel("models/eliceZ/eliceZ.obj");
-	eliceY.LoadModel("models/eliceY/eliceY.obj");
-	rain.LoadModel("models/rain/rain.obj");
+	gps::Model3D* models[] = { &cartier, &dodge, &eliceZ, &eliceY, &rain };
+	const int modelCount = sizeof(models) / sizeof(models[0]);
+
+	for (int i = 0; i < modelCount; i++) {
+		showLoadingProgress(i, modelCount, modelFileNames[i]);
+		models[i]->LoadModel(modelFileNames[i]);
+	}
+	showLoadingProgress(modelCount, modelCount, "");
+}
 
+void initRenderPath(bool allowMultiDraw, bool useTextureArrays) {
+	multiDrawEnabled = allowMultiDraw && gps::MultiDrawBatcher::isSupported();
+	renderQueue.setMultiDraw(multiDrawEnabled ? &multiDraw : NULL);
+	fprintf(stdout, "Render path: %s\n", multiDrawEnabled ? "multi-draw indirect" : "one draw per mesh");
+
+	// the arrays copy whole mip chains once, streamed textures change theirs every frame
+	if (useTextureArrays && (!multiDrawEnabled || !gps::TextureArrayPool::isSupported()))
+		fprintf(stderr, "WARNING: texture arrays need the multi-draw path and glCopyImageSubData, materials stay separate\n");
+	else if (useTextureArrays && gps::textureStreamer().isEnabled())
+		fprintf(stderr, "WARNING: texture arrays do not work with streamed textures, materials stay separate\n");
+	else if (useTextureArrays) {
+		textureArraysEnabled = true;
+		multiDraw.setTextureArrays(&textureArrays);
+	}
+}
+
+void initMaterialTextures(bool useAtlas, bool packMaterials, bool compressTextures) {
+	// the packed shader expects every mesh to have one, atlas pages and streamed levels hold one map each
+	if (packMaterials && gps::textureStreamer().isEnabled())
+		fprintf(stderr, "WARNING: packed materials do not work with streamed textures, the maps stay separate\n");
+	else if (packMaterials && useAtlas)
+		fprintf(stderr, "WARNING: packed materials do not work with atlases, the maps stay separate\n");
+	else if (packMaterials) {
+		packedMaterialsEnabled = true;
+		gps::Model3D::setMaterialPacking(true);
+	}
+	gps::Model3D::setTextureAtlas(useAtlas);
+
+	// streamed textures keep their own cooked levels, the rest are cooked into blocks on first load.
+	// Packed materials are encoded to BC3 when they are built
+	if (compressTextures && !gps::isTextureCompressionSupported())
+		fprintf(stderr, "WARNING: S3TC with sRGB is not supported, textures are uploaded uncompressed\n");
+	else if (compressTextures)
+		gps::Model3D::setTextureCompression(true);
 }
 
 void initShaders() {
-	myBasicShader.loadShader("shaders/basic.vert", "shaders/basic.frag");
+	// the multi-draw vertex shaders read the model matrices from a storage buffer
+	std::string defines;
+	if (textureArraysEnabled)
+		defines += "#define MATERIAL_ARRAYS\n";
+	if (packedMaterialsEnabled)
+		defines += "#define PACKED_MATERIALS\n";
+	myBasicShader.loadShader(multiDrawEnabled ? "shaders/basic_mdi.vert" : "shaders/basic.vert", "shaders/basic.frag", defines);
 	myBasicShader.useShaderProgram();
 	skyboxShader.loadShader("shaders/skyboxShader.vert", "shaders/skyboxShader.frag");
 	skyboxShader.useShaderProgram();
-	depthMapShader.loadShader("shaders/depthMapShader.vert", "shaders/depthMapShader.frag");
+	depthMapShader.loadShader(multiDrawEnabled ? "shaders/depthMapShader_mdi.vert" : "shaders/depthMapShader.vert", "shaders/depthMapShader.frag");
 	depthMapShader.useShaderProgram();
 }
 
@@ -382,69 +712,47 @@ void initPointLights() {
 }
 
 void initUniforms() {
-	myBasicShader.useShaderProgram();
 
 	// create model matrix for cartier
 	model = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-	modelLoc = glGetUniformLocation(myBasicShader.shaderProgram, "model");
 
 	// get view matrix for current camera
 	view = myCamera.getViewMatrix();
-	viewLoc = glGetUniformLocation(myBasicShader.shaderProgram, "view");
-	// send view matrix to shader
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-
-	// compute normal matrix for cartier
-	normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-	normalMatrixLoc = glGetUniformLocation(myBasicShader.shaderProgram, "normalMatrix");
 
 	// create projection matrix
 	projection = glm::perspective(glm::radians(45.0f),
 		(float)myWindow.getWindowDimensions().width / (float)myWindow.getWindowDimensions().height,
 		0.1f, 1000.0f);
-	projectionLoc = glGetUniformLocation(myBasicShader.shaderProgram, "projection");
-	// send projection matrix to shader
-	glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
 
 	//set the light direction (direction towards the light)
 	lightDir = glm::vec3(0.0f, 1.0f, 1.0f);
 	lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(lightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-	lightDirLoc = glGetUniformLocation(myBasicShader.shaderProgram, "lightDir");
-	// send light dir to shader
-	glUniform3fv(lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view * lightRotation)) * lightDir));
 
 	//set light color
 	lightColor = glm::vec3(1.0f, 1.0f, 1.0f); //white light
-	lightColorLoc = glGetUniformLocation(myBasicShader.shaderProgram, "lightColor");
-	// send light color to shader
-	glUniform3fv(lightColorLoc, 1, glm::value_ptr(lightColor));
 
 	initPointLights();
-	//set the light direction (direction towards the object)
-	pointLightLoc = glGetUniformLocation(myBasicShader.shaderProgram, "pointLight");
-	// send light dir to shader
-	glUniform3fv(pointLightLoc, 12, glm::value_ptr(pointLight[0]));
 
 	//set light color
 	pointLightColor = glm::vec3(0.0f, 0.0f, 0.0f); //first off then yellow
-	pointLightColorLoc = glGetUniformLocation(myBasicShader.shaderProgram, "pointLightColor");
-	// send light color to shader
-	glUniform3fv(pointLightColorLoc, 1, glm::value_ptr(pointLightColor));
 
 	// Fog
-	fogDensity = 0.0f;
-	fogDensityLoc = glGetUniformLocation(myBasicShader.shaderProgram, "fogDensity");
-	glUniform1fv(fogDensityLoc, 1, &fogDensity);
+	fogDensity = startFogDensity;
 
+	// every program reads the same camera, light and shadow blocks
+	frameUniforms.init();
+	frameUniforms.bindBlocks(myBasicShader);
+	frameUniforms.bindBlocks(skyboxShader);
+	frameUniforms.bindBlocks(depthMapShader);
+
+	// the shadow map always stays on unit 3
+	myBasicShader.useShaderProgram();
+	glUniform1i(glGetUniformLocation(myBasicShader.getProgram(), "shadowMap"), 3);
 }
 
 void initSkybox() {
-	faces.push_back("skybox/right.jpg");
-	faces.push_back("skybox/left.jpg");
-	faces.push_back("skybox/top.jpg");
-	faces.push_back("skybox/bottom.jpg");
-	faces.push_back("skybox/back.jpg");
-	faces.push_back("skybox/front.jpg");
+	for (size_t i = 0; i < sizeof(skyboxFaceNames) / sizeof(skyboxFaceNames[0]); i++)
+		faces.push_back(skyboxFaceNames[i]);
 
 	faces2.push_back("skybox2/right.tga");
 	faces2.push_back("skybox2/left.tga");
@@ -455,14 +763,43 @@ void initSkybox() {
 	mySkyBox.Load(faces);
 }
 
+void initCity() {
+	if (cityGridSize <= 0)
+		return;
+
+	// tiles as wide as the suburb, so neighbouring copies meet at its edges
+	glm::vec3 minCorner;
+	glm::vec3 maxCorner;
+	cartier.getBounds(minCorner, maxCorner);
+
+	gps::CitySettings settings;
+	settings.gridSize = cityGridSize;
+	settings.seed = citySeed;
+	settings.tileSize = glm::max(maxCorner.x - minCorner.x, maxCorner.z - minCorner.z);
+	settings.carsPerTile = CITY_CARS_PER_TILE;
+
+	std::vector<glm::vec3> tileLights(pointLight, pointLight + gps::POINT_LIGHT_COUNT);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	gps::generateCity(settings, tileLights, cityLayout);
+	cityGenerateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	fprintf(stdout, "City: %d x %d tiles, %u instances, %u street lights, %.1f MB, generated in %.1f ms\n",
+		cityGridSize, cityGridSize, (unsigned int)cityLayout.getInstanceCount(), (unsigned int)cityLayout.lights.size(),
+		cityLayout.getMemorySize() / (1024.0 * 1024.0), cityGenerateMs);
+}
+
 void initFBO() {
 	//TODO - Create the FBO, the depth texture and attach the depth texture to the FBO
 
+	gps::GpuOwnerScope owner("shadow map");
 	//generate FBO ID
-	glGenFramebuffers(1, &shadowMapFBO);
+	GLuint framebuffer;
+	glGenFramebuffers(1, &framebuffer);
 	//create depth texture for FBO
-	glGenTextures(1, &depthMapTexture);
-	glBindTexture(GL_TEXTURE_2D, depthMapTexture);
+	GLuint depthTexture;
+	glGenTextures(1, &depthTexture);
+	gps::glState().bindTexture(0, GL_TEXTURE_2D, depthTexture);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
 		SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -472,17 +809,29 @@ void initFBO() {
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
 	//attach texture to FBO
-	glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMapTexture, 0);
+	gps::glState().bindFramebuffer(framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gps::glState().bindFramebuffer(0);
+
+	GPS_GPU_RESOURCE(gps::GPU_FRAMEBUFFER, framebuffer, 0, GL_NONE, "framebuffer");
+	GPS_GPU_RESOURCE(gps::GPU_TEXTURE, depthTexture,
+		gps::getTextureBytes(GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 1, 1), GL_DEPTH_COMPONENT, "depth");
+	shadowMapFBO = gps::resources().add<gps::RESOURCE_FRAMEBUFFER>(framebuffer);
+	depthMapTexture = gps::resources().add<gps::RESOURCE_TEXTURE>(depthTexture);
+}
+
+const GLfloat lightNearPlane = -100.0f, lightFarPlane = 100.0f;
+
+glm::mat4 computeLightView() {
+	return glm::lookAt(glm::mat3(lightRotation) * lightDir, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 }
 
 glm::mat4 computeLightSpaceTrMatrix() {
 	//TODO - Return the light-space transformation matrix
-	glm::mat4 lightView = glm::lookAt(glm::mat3(lightRotation) * lightDir, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	const GLfloat near_plane = -100.0f, far_plane = 100.0f;
+	glm::mat4 lightView = computeLightView();
+	const GLfloat near_plane = lightNearPlane, far_plane = lightFarPlane;
 	glm::mat4 lightProjection = glm::ortho(-100.0f, 100.0f, -100.0f, 100.0f, near_plane, far_plane);
 	glm::mat4 lightSpaceTrMatrix = lightProjection * lightView;
 
@@ -494,13 +843,12 @@ float fallSpeed = 75.0f;
 float lastFrameTime = 0.0f;
 float groundLevel = -80.0f;
 
-int gridRows = 20;
-int gridCols = 20;
-
-int numDropsPerGrid = 15;
+gps::RainGrid rainGrid = gps::defaultRainGrid();
+std::vector<glm::mat4> rainDropMatrices;
 
 void renderRain(gps::Shader shader) {
-	float currentTime = glfwGetTime();
+	GPS_PROFILE("renderRain");
+	float currentTime = sceneTime();
 	float deltaTime = currentTime - lastFrameTime;
 
 	rainY -= fallSpeed * deltaTime;
@@ -509,177 +857,208 @@ void renderRain(gps::Shader shader) {
 		rainY = -50.0f;
 	}
 
-	float spacingX = 12.5f;
-	float spacingZ = 12.5f;
-
-	for (int i = 0; i < gridRows; i++) {
-		for (int j = 0; j < gridCols; j++) {
-			float currRainX = -190.0f + i * spacingX;
-			float currRainZ = -190.0f + j * spacingZ;
-
-			for (int k = 0; k < numDropsPerGrid; k++) {
-				float offsetX = (k % 2 == 0) ? (k / 2) * 7.5f : -((k / 2) * 7.5f);
-				float offsetZ = (k % 2 == 0) ? (k / 2) * 2.5f : -((k / 2) * 2.5f);
-				float offsetY = k * 5.0f;
-
-				glm::mat4 rainModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(currRainX + offsetX, rainY + offsetY, currRainZ + offsetZ));
-				glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(rainModelMatrix));
-				rain.Draw(shader);
-			}
-		}
-	}
+	gps::placeRainDrops(rainGrid, rainY, rainDropMatrices);
+	for (size_t i = 0; i < rainDropMatrices.size(); i++)
+		rain.Draw(renderQueue, shader, rainDropMatrices[i]);
 
 	lastFrameTime = currentTime;
 }
 
-float dodgeRotation = 0.0f;
-float eliceZRotation = 0.0f;
-float eliceYRotation = 0.0f;
+gps::PropAnimation propAnimation;
 
 void renderAnimations(gps::Shader shader) {
-	shader.useShaderProgram();
-
-	// Set model matrix for Dodge
-	glm::mat4 dodgeModelMatrix;
-	dodgeModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0.3f, 0.0f, 0.0f));
-	dodgeModelMatrix = glm::rotate(dodgeModelMatrix, glm::radians(dodgeRotation), glm::vec3(0, -1, 0));
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(dodgeModelMatrix));
-
-	// Draw Dodge
-	dodge.Draw(shader);
-	dodgeRotation -= 0.5;
-	if (dodgeRotation <= -360)
-		dodgeRotation = 0;
-
-	// Set model matrix for eliceZ
-	glm::mat4 eliceZModelMatrix;
-	eliceZModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(10.2446f, 19.292f, -11.0723f));
-	eliceZModelMatrix = glm::rotate(eliceZModelMatrix, glm::radians(eliceZRotation), glm::vec3(0, -1, 0));
-	eliceZModelMatrix = glm::translate(eliceZModelMatrix, glm::vec3(-10.2446f, -19.292f, 11.0723f));
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(eliceZModelMatrix));
-
-	// Draw eliceZ
-	eliceZ.Draw(shader);
-	eliceZRotation += 7.0;
-	if (eliceZRotation >= 360)
-		eliceZRotation = 0;
-
-	// Set model matrix for eliceY
-	glm::mat4 eliceYModelMatrix;
-	eliceYModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(15.0883f, 18.0833f, -16.2909f));
-	eliceYModelMatrix = glm::rotate(eliceYModelMatrix, glm::radians(51.0162f), glm::vec3(0, 1, 0));
-	eliceYModelMatrix = glm::rotate(eliceYModelMatrix, glm::radians(eliceYRotation), glm::vec3(0, 0, 1));
-	eliceYModelMatrix = glm::rotate(eliceYModelMatrix, glm::radians(-51.0162f), glm::vec3(0, 1, 0));
-	eliceYModelMatrix = glm::translate(eliceYModelMatrix, glm::vec3(-15.0883f, -18.0833f, 16.2909f));
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(eliceYModelMatrix));
-
-	// Draw eliceY
-	eliceY.Draw(shader);
-	eliceYRotation += 7.0;
-	if (eliceYRotation >= 360)
-		eliceYRotation = 0;
-	
+
+	dodge.Draw(renderQueue, shader, propAnimation.getDodgeMatrix());
+	eliceZ.Draw(renderQueue, shader, propAnimation.getEliceZMatrix());
+	eliceY.Draw(renderQueue, shader, propAnimation.getEliceYMatrix());
+
+	propAnimation.step();
 }
 
-void drawObjects(gps::Shader shader, bool depthPass) {
+// Every tile gets the suburb and its animated props, the parked cars come after
+void drawCity(gps::Shader shader) {
+
+	glm::mat4 dodgeMatrix = propAnimation.getDodgeMatrix();
+	glm::mat4 eliceZMatrix = propAnimation.getEliceZMatrix();
+	glm::mat4 eliceYMatrix = propAnimation.getEliceYMatrix();
 
-	// select active shader program
-	shader.useShaderProgram();
+	// CITY_MODELS_PER_TILE counts these for the benchmark
+	for (size_t i = 0; i < cityLayout.tiles.size(); i++) {
+		glm::mat4 tile = model * cityLayout.tiles[i];
+		cartier.Draw(renderQueue, shader, tile);
+		dodge.Draw(renderQueue, shader, tile * dodgeMatrix);
+		eliceZ.Draw(renderQueue, shader, tile * eliceZMatrix);
+		eliceY.Draw(renderQueue, shader, tile * eliceYMatrix);
+	}
 
-	//send model matrix data to shader
-	modelLoc = glGetUniformLocation(shader.shaderProgram, "model");
-	glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+	for (size_t i = 0; i < cityLayout.cars.size(); i++)
+		dodge.Draw(renderQueue, shader, model * cityLayout.cars[i].transform);
 
+	propAnimation.step();
+}
 
-	// do not send the normal matrix if we are rendering in the depth map
-	if (!depthPass) {
-		normalMatrix = glm::mat3(glm::inverseTranspose(view * model));
-		normalMatrixLoc = glGetUniformLocation(shader.shaderProgram, "normalMatrix");
-		glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, glm::value_ptr(normalMatrix));
-		lightDirLoc = glGetUniformLocation(shader.shaderProgram, "lightDir");
-		glUniform3fv(lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view)) * lightDir));
+// Queues the scene, the model and normal matrices are sent by the render queue
+void drawObjects(gps::Shader shader) {
+	GPS_PROFILE("drawObjects");
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
+	if (cityLayout.tiles.empty()) {
+		cartier.Draw(renderQueue, shader, model);
+		renderAnimations(shader);
 	}
+	else
+		drawCity(shader);
 
-	cartier.Draw(shader);
-	renderAnimations(shader);
+	drawObjectsMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
 
+// Gathers the state the callbacks changed into the shared blocks and sends them in one go
+void updateFrameUniforms() {
+	frameUniforms.camera.view = view;
+	frameUniforms.camera.projection = projection;
+
+	// the shading uses the unrotated direction, only the shadows follow lightAngle
+	frameUniforms.light.lightDir = glm::vec4(glm::inverseTranspose(glm::mat3(view)) * lightDir, 0.0f);
+	frameUniforms.light.lightColor = glm::vec4(lightColor, 1.0f);
+	frameUniforms.light.pointLightColor = glm::vec4(pointLightColor, 1.0f);
+	// the city has a set of street lights per tile, the shader gets the ones closest to the camera
+	const glm::vec3* lights = pointLight;
+	if (cityLayout.lights.size() >= gps::POINT_LIGHT_COUNT) {
+		gps::selectNearestLights(cityLayout.lights, myCamera.getCameraPosition(), gps::POINT_LIGHT_COUNT);
+		lights = &cityLayout.lights[0];
+	}
+	for (int i = 0; i < gps::POINT_LIGHT_COUNT; i++)
+		frameUniforms.light.pointLight[i] = glm::vec4(lights[i], 1.0f);
+	frameUniforms.light.fogDensity = fogDensity;
+
+	frameUniforms.shadow.lightSpaceTrMatrix = computeLightSpaceTrMatrix();
+
+	frameUniforms.upload();
 }
 
 void renderScene() {
+	GPS_PROFILE("renderScene");
 
 	if (automaticAnimationInProgress) {
-		float currentTime = glfwGetTime();
-		float elapsedTime = currentTime - animationStartTime;
-
-		if (elapsedTime < animationDuration) {
-			glm::vec3 camPos = myCamera.getCameraPosition();
-			camPos.x -= 0.2f;
-			if (camPos.x < 0)
-				camPos.y += 0.05f;
-			myCamera.setCameraPosition(camPos);
-		}
-		else {
+		activePath->apply(pathTime, myCamera);
+		pathTime += PATH_TIMESTEP * pathSpeed;
+
+		if (pathTime > activePath->getDuration()) {
 			automaticAnimationInProgress = false;
+			syncMouseAngles();
 		}
 	}
+	else if (recordingPath) {
+		double recordTime = glfwGetTime() - recordStartTime;
+		if (recordTime - lastRecordTime >= PATH_RECORD_INTERVAL) {
+			recordedPath.addSample((float)recordTime, myCamera);
+			lastRecordTime = recordTime;
+		}
+	}
+
+	renderQueue.resetStats();
+	gps::glState().beginFrame();
+	drawObjectsMs = 0.0;
+
+	view = myCamera.getViewMatrix();
+	lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(lightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	// the CPU only blocks here, when it is a full set of frames ahead of the GPU
+	gps::frameSync().beginFrame();
+	// the GPU finished the frame that last used this slot, what it destroyed can go now
+	gps::resources().collect();
+	updateFrameUniforms();
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	//render the scene to the depth buffer
+	{
+		GPS_PROFILE("shadow pass");
 
-	depthMapShader.useShaderProgram();
-	glUniformMatrix4fv(glGetUniformLocation(depthMapShader.shaderProgram, "lightSpaceTrMatrix"),
-		1,
-		GL_FALSE,
-		glm::value_ptr(computeLightSpaceTrMatrix()));
-	glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-	glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-	glClear(GL_DEPTH_BUFFER_BIT);
+		gps::glState().viewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+		gps::glState().bindFramebuffer(gps::resources().get(shadowMapFBO));
+		glClear(GL_DEPTH_BUFFER_BIT);
 
-	drawObjects(depthMapShader, true);
+		renderQueue.begin(computeLightView(), lightNearPlane, lightFarPlane, true);
+		// nothing outside the light volume can cast a shadow into the map
+		renderQueue.setCullFrustum(frameUniforms.shadow.lightSpaceTrMatrix);
+		drawObjects(depthMapShader);
+		renderQueue.flush();
 
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		gps::glState().bindFramebuffer(0);
+	}
 
 
 	// final scene rendering pass (with shadows)
+	{
+		GPS_PROFILE("main pass");
 
-	glViewport(0, 0, 1920, 1080);
+		gps::glState().viewport(0, 0, 1920, 1080);
 
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	myBasicShader.useShaderProgram();
+		//bind the shadow map
+		gps::glState().bindTexture(3, GL_TEXTURE_2D, gps::resources().get(depthMapTexture));
 
-	view = myCamera.getViewMatrix();
-	glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+		// projected size of one unit at distance one in the 1080 rows of the pass
+		gps::textureStreamer().beginFrame(projection[1][1] * 0.5f * 1080.0f);
+		renderQueue.begin(view, 0.1f, 1000.0f, false);
+		renderQueue.setCullFrustum(projection * view);
+		drawObjects(myBasicShader);
+		if (rainEffect)
+			renderRain(myBasicShader);
+		renderQueue.flush();
+	}
 
-	lightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(lightAngle), glm::vec3(0.0f, 1.0f, 0.0f));
-	glUniform3fv(lightDirLoc, 1, glm::value_ptr(glm::inverseTranspose(glm::mat3(view * lightRotation)) * lightDir));
+	// the sky goes last, it only passes the depth test where the scene left the cleared far plane
+	{
+		GPS_PROFILE("skybox");
+		mySkyBox.Draw(skyboxShader);
+	}
 
-	//bind the shadow map
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, depthMapTexture);
-	glUniform1i(glGetUniformLocation(myBasicShader.shaderProgram, "shadowMap"), 3);
+	lastFrameStats = renderQueue.getStats();
+	if (hud.isVisible()) {
+		GPS_PROFILE("hud");
+		hud.draw(myWindow.getWindowDimensions().width, myWindow.getWindowDimensions().height, lastFrameStats);
+	}
 
-	glUniformMatrix4fv(glGetUniformLocation(myBasicShader.shaderProgram, "lightSpaceTrMatrix"),
-		1,
-		GL_FALSE,
-		glm::value_ptr(computeLightSpaceTrMatrix()));
+	// levels the main pass asked for are sampled from the next frame on
+	{
+		GPS_PROFILE("texture streaming");
+		gps::textureStreamer().update();
+	}
 
-	mySkyBox.Draw(skyboxShader, view, projection);
-	drawObjects(myBasicShader, false);
-	if (rainEffect)
-		renderRain(myBasicShader);
+	gps::frameSync().endFrame();
 
 }
 
 void cleanup() {
-	myWindow.Delete();
+	inputQueue.stopRecording();
+#ifdef GPS_PROFILING
+	gps::profiler().Delete();
+#endif
+	hud.Delete();
+	multiDraw.Delete();
+	textureArrays.Delete();
+	renderQueue.Delete();
+	frameUniforms.Delete();
+	gps::frameSync().Delete();
 	//cleanup code for your own data
-	glDeleteTextures(1, &depthMapTexture);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glDeleteFramebuffers(1, &shadowMapFBO);
+	gps::Model3D* models[] = { &cartier, &dodge, &eliceZ, &eliceY, &rain };
+	for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++)
+		models[i]->Delete();
+	mySkyBox.Delete();
+	gps::textureStreamer().Delete();
+	myBasicShader.Delete();
+	skyboxShader.Delete();
+	depthMapShader.Delete();
+	gps::resources().destroy(depthMapTexture);
+	gps::resources().destroy(shadowMapFBO);
+	gps::resources().Delete();
+	// everything the application created should be gone by now
+	gps::gpuResources().reportLeaks(stderr);
+	myWindow.Delete();
 	//close GL context and any other GLFW resources
 	glfwTerminate();
 }
@@ -687,12 +1066,133 @@ void cleanup() {
 
 int main(int argc, const char* argv[]) {
 
+	bool allowMultiDraw = true;
+	bool useTextureArrays = false;
+	bool blockingReads = false;
+	bool compressTextures = false;
+	bool useAtlas = false;
+	bool packMaterials = false;
+	const char* recordInputFile = NULL;
+	const char* replayInputFile = NULL;
+	const char* cameraPathFile = NULL;
+	const char* benchmarkOutput = NULL;
+	int benchmarkFrames = 600;
+	int benchmarkWarmup = 30;
+#ifdef GPS_PROFILING
+	const char* traceFileName = NULL;
+#endif
+	for (int i = 1; i < argc; i++) {
+		// forces the GL 4.1 path on capable drivers
+		if (strcmp(argv[i], "--no-multidraw") == 0)
+			allowMultiDraw = false;
+		// one multi-draw call per program and texture array instead of per material
+		else if (strcmp(argv[i], "--texture-arrays") == 0)
+			useTextureArrays = true;
+		// how many frames the CPU may record before waiting for the GPU
+		else if (strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+			gps::frameSync().setFramesInFlight(atoi(argv[++i]));
+#ifdef GPS_PROFILING
+		// records a trace of the whole run, saved at exit
+		else if (strcmp(argv[i], "--profile-trace") == 0 && i + 1 < argc)
+			traceFileName = argv[++i];
+#endif
+		else if (strcmp(argv[i], "--benchmark") == 0)
+			benchmarkMode = true;
+		else if (strcmp(argv[i], "--benchmark-frames") == 0 && i + 1 < argc)
+			benchmarkFrames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--benchmark-warmup") == 0 && i + 1 < argc)
+			benchmarkWarmup = atoi(argv[++i]);
+		// the JSON is also written to this file, stdout carries the rest of the log
+		else if (strcmp(argv[i], "--benchmark-output") == 0 && i + 1 < argc)
+			benchmarkOutput = argv[++i];
+		// egl or osmesa, for machines without a display or without a GPU
+		else if (strcmp(argv[i], "--context") == 0 && i + 1 < argc) {
+			i++;
+			if (strcmp(argv[i], "egl") == 0)
+				windowContextApi = gps::CONTEXT_API_EGL;
+			else if (strcmp(argv[i], "osmesa") == 0)
+				windowContextApi = gps::CONTEXT_API_OSMESA;
+		}
+		else if (strcmp(argv[i], "--rain") == 0)
+			rainEffect = true;
+		// plays a recorded path instead of the intro, benchmarks use it to capture a hot spot
+		else if (strcmp(argv[i], "--camera-path") == 0 && i + 1 < argc)
+			cameraPathFile = argv[++i];
+		else if (strcmp(argv[i], "--record-path") == 0 && i + 1 < argc)
+			recordedPathFile = argv[++i];
+		// the whole session, from the first frame, so a replay starts from the same state
+		else if (strcmp(argv[i], "--record-input") == 0 && i + 1 < argc)
+			recordInputFile = argv[++i];
+		else if (strcmp(argv[i], "--replay-input") == 0 && i + 1 < argc)
+			replayInputFile = argv[++i];
+		// starting state of the scene
+		else if (strcmp(argv[i], "--night") == 0)
+			startAtNight = true;
+		else if (strcmp(argv[i], "--fog") == 0)
+			startFogDensity = MAX_FOG_DENSITY;
+		else if (strcmp(argv[i], "--wireframe") == 0)
+			renderMode = 1;
+		// the camera stays at its starting pose
+		else if (strcmp(argv[i], "--no-intro") == 0)
+			skipIntro = true;
+		else if (strcmp(argv[i], "--path-speed") == 0 && i + 1 < argc)
+			pathSpeed = (float)atof(argv[++i]);
+		// N x N copies of the suburb with parked cars, for scale tests
+		else if (strcmp(argv[i], "--city") == 0 && i + 1 < argc)
+			cityGridSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--city-seed") == 0 && i + 1 < argc)
+			citySeed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		// warns when the textures and buffers the application created go over N MB
+		else if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc)
+			gps::gpuResources().setBudget((GLuint64)(atof(argv[++i]) * 1024.0 * 1024.0));
+		// model textures start small and load the mip levels the view needs, within N MB
+		else if (strcmp(argv[i], "--stream-textures") == 0)
+			gps::textureStreamer().setEnabled(true);
+		else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc)
+			gps::textureStreamer().setBudget((GLuint64)(atof(argv[++i]) * 1024.0 * 1024.0));
+		// materials with small textures share atlas pages, fewer texture objects and binds
+		else if (strcmp(argv[i], "--atlas") == 0)
+			useAtlas = true;
+		// the diffuse color and the specular mask of a material in one RGBA texture
+		else if (strcmp(argv[i], "--pack-materials") == 0)
+			packMaterials = true;
+		// BC1 and BC3 blocks cooked next to the images, a quarter of the texture memory or less
+		else if (strcmp(argv[i], "--compress-textures") == 0)
+			compressTextures = true;
+		// models, textures, the skybox and the shaders come from one mapped file made by AssetPacker
+		else if (strcmp(argv[i], "--package") == 0 && i + 1 < argc)
+			gps::vfs().mount(argv[++i]);
+		// every file is read when the loading opens it, to compare against the async reads
+		else if (strcmp(argv[i], "--blocking-reads") == 0)
+			blockingReads = true;
+#ifdef GPS_GL_TRACING
+		// writes one frame for FrameReplay, by default once the intro is well under way
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+			captureFileName = argv[++i];
+		else if (strcmp(argv[i], "--capture-frame") == 0 && i + 1 < argc)
+			captureFrame = atoi(argv[++i]);
+#endif
+	}
+
+	if (benchmarkMode)
+		benchmark.configure(benchmarkFrames, benchmarkWarmup, 1.0 / 60.0);
+#ifdef GPS_PROFILING
+	// profiling builds would put their timestamp queries into the measured frames unless a trace was asked for
+	if (benchmarkMode && traceFileName == NULL)
+		gps::profiler().setEnabled(false);
+#endif
+
+	std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+	if (!blockingReads)
+		prefetchAssets();
+
 	try {
 		initOpenGLWindow();
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
-		return EXIT_FAILURE;
+		// the benchmark runner tells a scenario that could not run (2) from a failed one
+		return benchmarkMode ? 2 : EXIT_FAILURE;
 	}
 
 	// Set the mouse button and cursor position callbacks
@@ -702,28 +1202,130 @@ int main(int argc, const char* argv[]) {
 
 	initOpenGLState();
 	switchRenderMode(renderMode);
+	initRenderPath(allowMultiDraw, useTextureArrays);
+	initMaterialTextures(useAtlas, packMaterials, compressTextures);
+	hud.init();
 	initModels();
 	initShaders();
 	initUniforms();
+	initCity();
 	setWindowCallbacks();
 	initSkybox();
 	initFBO();
+	finishAssetReads();
 
-	animationStartTime = glfwGetTime();
+	if (startAtNight) {
+		// the same light as after five presses of K
+		lightColor = glm::vec3(0.03125f);
+		setNight(true);
+	}
+
+#ifdef GPS_PROFILING
+	if (traceFileName != NULL)
+		gps::profiler().startCapture();
+#endif
+
+	if (replayInputFile != NULL)
+		inputQueue.loadReplay(replayInputFile);
+	if (recordInputFile != NULL)
+		inputQueue.startRecording(recordInputFile);
+
+	initIntroPath();
+	if (skipIntro) {
+		automaticAnimationInProgress = false;
+		syncMouseAngles();
+	}
+	else if (cameraPathFile != NULL && recordedPath.load(cameraPathFile))
+		startCameraPath(recordedPath);
+	else
+		startCameraPath(introPath);
 	
 
 	glCheckError();
+
+	std::chrono::steady_clock::time_point frameStart = std::chrono::steady_clock::now();
+	benchmark.setLoadTime(std::chrono::duration<double, std::milli>(frameStart - loadStart).count());
+
 	// application loop
-	while (!glfwWindowShouldClose(myWindow.getWindow())) {
+#ifdef GPS_GL_TRACING
+	int frameNumber = 0;
+#endif
+	while (!glfwWindowShouldClose(myWindow.getWindow()) && !(benchmarkMode && benchmark.isFinished())) {
+#ifdef GPS_GL_TRACING
+		if (captureFileName != NULL && ++frameNumber == captureFrame)
+			frameCapture.request(captureFileName, myWindow.getWindowDimensions().width,
+				myWindow.getWindowDimensions().height);
+#endif
+		GPS_PROFILE_BEGIN_FRAME();
+		GPS_GL_TRACE_BEGIN_FRAME();
+
+		processInput();
 		processMovement();
 		renderScene();
 
 		glfwPollEvents();
-		glfwSwapBuffers(myWindow.getWindow());
+		{
+			GPS_PROFILE("swap");
+			glfwSwapBuffers(myWindow.getWindow());
+		}
+
+		GPS_GL_TRACE_END_FRAME();
+		GPS_PROFILE_END_FRAME();
+
+		// swap to swap, it includes the waits on the GPU once the frames in flight are used up
+		std::chrono::steady_clock::time_point frameEnd = std::chrono::steady_clock::now();
+		double frameMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+		frameStart = frameEnd;
 
+		hud.addFrameTime((float)frameMs);
+		if (benchmarkMode)
+			benchmark.endFrame(frameMs, drawObjectsMs, lastFrameStats);
+
+#ifndef NDEBUG
+		// glGetError stalls the pipeline, release builds only check during initialization
 		glCheckError();
+#endif
 	}
 
+	fprintf(stdout, "CPU waited on the GPU %.3f ms per frame on average over %u frames\n",
+		gps::frameSync().getAverageWaitMs(), gps::frameSync().getFrameCount());
+
+	if (benchmarkMode) {
+		gps::BenchmarkInfo info;
+		info.renderer = (const char*)glGetString(GL_RENDERER);
+		info.glVersion = (const char*)glGetString(GL_VERSION);
+		std::string renderPath = !multiDrawEnabled ? "one draw per mesh" :
+			textureArraysEnabled ? "multi-draw indirect, texture arrays" : "multi-draw indirect";
+		if (packedMaterialsEnabled)
+			renderPath += ", packed materials";
+		info.renderPath = renderPath.c_str();
+		info.width = myWindow.getWindowDimensions().width;
+		info.height = myWindow.getWindowDimensions().height;
+		info.cityGridSize = cityGridSize;
+		// without a city, the suburb and its three animated props
+		// the original scene is one tile without the parked cars
+		info.sceneInstances = (unsigned int)(cityLayout.tiles.empty() ? gps::CITY_MODELS_PER_TILE : cityLayout.getInstanceCount());
+		info.sceneMemoryBytes = (double)cityLayout.getMemorySize();
+		info.sceneGenerateMs = cityGenerateMs;
+
+		benchmark.setCpuWaitTime(gps::frameSync().getAverageWaitMs());
+		benchmark.writeJson(stdout, info);
+		if (benchmarkOutput != NULL) {
+			FILE* file = fopen(benchmarkOutput, "w");
+			if (file != NULL) {
+				benchmark.writeJson(file, info);
+				fclose(file);
+			}
+			else
+				fprintf(stderr, "ERROR: could not write the benchmark results to %s\n", benchmarkOutput);
+		}
+	}
+
+#ifdef GPS_PROFILING
+	if (traceFileName != NULL)
+		gps::profiler().writeTrace(traceFileName);
+#endif
+
 
 	cleanup();
 
@@ -2,6 +2,7 @@
 
 in vec3 fPosition;
 in vec3 fNormal;
+in vec3 fNormalEye;
 in vec2 fTexCoords;
 
 in vec3 fragPosEye;
@@ -12,20 +13,33 @@ in vec4 fragPosLightSpace;
 
 out vec4 fColor;
 
-//matrices
-uniform mat4 model;
-uniform mat4 view;
-uniform mat3 normalMatrix;
-//lighting
-uniform vec3 lightDir;
-uniform vec3 lightColor;
-
-uniform vec3 pointLight;
-uniform vec3 pointLightColor;
-
-// textures
+// shared per frame blocks, see UniformBuffers.hpp
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 projection;
+};
+
+layout(std140) uniform LightBlock {
+	vec4 lightDir;
+	vec4 lightColor;
+	vec4 pointLightColor;
+	vec4 pointLight[12];
+	float fogDensity;
+};
+
+// textures, PACKED_MATERIALS has the specular mask in the alpha of the diffuse texture
+#ifdef MATERIAL_ARRAYS
+flat in uint fMaterialLayers;
+uniform sampler2DArray diffuseTexture;
+#ifndef PACKED_MATERIALS
+uniform sampler2DArray specularTexture;
+#endif
+#else
 uniform sampler2D diffuseTexture;
+#ifndef PACKED_MATERIALS
 uniform sampler2D specularTexture;
+#endif
+#endif
 
 uniform sampler2D shadowMap;
 
@@ -44,36 +58,34 @@ vec3 ambientPoint;
 vec3 diffusePoint;
 vec3 specularPoint;
 
-uniform float fogDensity;
-
 void computeDirLight()
 {
     //compute eye space coordinates
-    vec4 fPosEye = view * model * vec4(fPosition, 1.0f);
-    vec3 normalEye = normalize(normalMatrix * fNormal);
+    vec4 fPosEye = vec4(fragPosEye, 1.0f);
+    vec3 normalEye = normalize(fNormalEye);
 
     //normalize light direction
-    vec3 lightDirN = vec3(normalize(view * vec4(lightDir, 0.0f)));
+    vec3 lightDirN = vec3(normalize(view * vec4(lightDir.xyz, 0.0f)));
 
     //compute view direction
     vec3 viewDir = normalize(- fPosEye.xyz);
 
     //compute ambient light
-    ambient = ambientStrength * lightColor;
+    ambient = ambientStrength * lightColor.rgb;
 
     //compute diffuse light
-    diffuse = max(dot(normalEye, lightDirN), 0.0f) * lightColor;
+    diffuse = max(dot(normalEye, lightDirN), 0.0f) * lightColor.rgb;
 
     //compute specular light
     vec3 reflectDir = reflect(-lightDirN, normalEye);
     float specCoeff = pow(max(dot(viewDir, reflectDir), 0.0f), 32);
-    specular = specularStrength * specCoeff * lightColor;
+    specular = specularStrength * specCoeff * lightColor.rgb;
 }
 
 
 void computePointLight(int i)
 {
-	vec3 normalEye = normalize(normalMatrix * fNormal);
+	vec3 normalEye = normalize(fNormalEye);
 	//compute view direction
 	vec3 viewDirN = normalize(viewPosEye);
 	//compute light direction
@@ -82,18 +94,38 @@ void computePointLight(int i)
 	vec3 halfVector = normalize(lightDirN + viewDirN);
 	//compute specular light
 	float specCoeff = pow(max(dot(normalEye, halfVector), 0.0f), 32);
-	specular = specularStrength * specCoeff * pointLightColor;
+	specular = specularStrength * specCoeff * pointLightColor.rgb;
 	//compute distance to light
 	float dist = length(lightPosEye[i] - fragPosEye.xyz);
 	//compute attenuation
 	float att = 1.0f / (constant + linear * dist + quadratic * (dist * dist));
     ///compute ambient light
-	ambientPoint = att * ambientStrength * pointLightColor;
+	ambientPoint = att * ambientStrength * pointLightColor.rgb;
 	//compute diffuse light
-	diffusePoint = att * max(dot(normalEye, lightDirN), 0.0f) * pointLightColor;
-	specularPoint = att * specularStrength * specCoeff * pointLightColor;
+	diffusePoint = att * max(dot(normalEye, lightDirN), 0.0f) * pointLightColor.rgb;
+	specularPoint = att * specularStrength * specCoeff * pointLightColor.rgb;
+}
+
+vec4 sampleDiffuse()
+{
+#ifdef MATERIAL_ARRAYS
+	return texture(diffuseTexture, vec3(fTexCoords, float(fMaterialLayers & 0xFFFFu)));
+#else
+	return texture(diffuseTexture, fTexCoords);
+#endif
 }
 
+#ifndef PACKED_MATERIALS
+vec3 sampleSpecular()
+{
+#ifdef MATERIAL_ARRAYS
+	return texture(specularTexture, vec3(fTexCoords, float(fMaterialLayers >> 16))).rgb;
+#else
+	return texture(specularTexture, fTexCoords).rgb;
+#endif
+}
+#endif
+
 float computeFog()
 {
  float fragmentDistance = length(fragPosEye);
@@ -140,8 +172,16 @@ void main()
 	
 	float shadow = computeShadow();
 
+	// one fetch gives both with packed materials
+	vec4 diffuseColor = sampleDiffuse();
+#ifdef PACKED_MATERIALS
+	vec3 specularMask = vec3(diffuseColor.a);
+#else
+	vec3 specularMask = sampleSpecular();
+#endif
+
     // Compute final vertex color
-    vec3 color = min((totalAmbient + (1.0f - shadow)*totalDiffuse) * texture(diffuseTexture, fTexCoords).rgb + ((1.0f - shadow) * totalSpecular) * texture(specularTexture, fTexCoords).rgb, 1.0f);
+    vec3 color = min((totalAmbient + (1.0f - shadow)*totalDiffuse) * diffuseColor.rgb + ((1.0f - shadow) * totalSpecular) * specularMask, 1.0f);
 
     fColor = mix(fogColor, vec4(color, 1.0f), fogFactor);
 
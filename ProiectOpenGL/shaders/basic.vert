@@ -6,6 +6,7 @@ layout(location=2) in vec2 vTexCoords;
 
 out vec3 fPosition;
 out vec3 fNormal;
+out vec3 fNormalEye;
 out vec2 fTexCoords;
 
 out vec3 fragPosEye;
@@ -14,13 +15,29 @@ out vec3 lightPosEye[12];
 
 out vec4 fragPosLightSpace;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// per draw block, the render queue binds the range of the frame ring holding this draw
+layout(std140) uniform DrawBlock {
+	mat4 model;
+	mat4 normalMatrix;
+};
 
-uniform mat4 lightSpaceTrMatrix;
+// shared per frame blocks, see UniformBuffers.hpp
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 projection;
+};
 
-uniform vec3 pointLight[12];
+layout(std140) uniform LightBlock {
+	vec4 lightDir;
+	vec4 lightColor;
+	vec4 pointLightColor;
+	vec4 pointLight[12];
+	float fogDensity;
+};
+
+layout(std140) uniform ShadowBlock {
+	mat4 lightSpaceTrMatrix;
+};
 
 
 void main() 
@@ -28,6 +45,7 @@ void main()
 	gl_Position = projection * view * model * vec4(vPosition, 1.0f);
 	fPosition = vPosition;
 	fNormal = vNormal;
+	fNormalEye = mat3(normalMatrix) * vNormal;
 	fTexCoords = vTexCoords;
 	
     vec4 fPosEye = view * model * vec4(fPosition, 1.0f);
@@ -35,7 +53,7 @@ void main()
 	fragPosEye = fPosEye.xyz;
 	
 	for (int i = 0; i < 12; i++)
-		lightPosEye[i] = vec3(view * vec4(pointLight[i], 1.0f));
+		lightPosEye[i] = vec3(view * vec4(pointLight[i].xyz, 1.0f));
 
 	fragPosLightSpace = lightSpaceTrMatrix * model * vec4(vPosition, 1.0f); 
 }
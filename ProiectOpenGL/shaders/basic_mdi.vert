@@ -0,0 +1,74 @@
+#version 430 core
+
+layout(location=0) in vec3 vPosition;
+layout(location=1) in vec3 vNormal;
+layout(location=2) in vec2 vTexCoords;
+// index of the draw in the indirect command buffer, fed through the base instance
+layout(location=3) in uint vDrawId;
+#ifdef MATERIAL_ARRAYS
+// layers of the diffuse (low 16 bits) and specular textures in their arrays, see TextureArrays.hpp
+layout(location=4) in uint vMaterialLayers;
+flat out uint fMaterialLayers;
+#endif
+
+out vec3 fPosition;
+out vec3 fNormal;
+out vec3 fNormalEye;
+out vec2 fTexCoords;
+
+out vec3 fragPosEye;
+out vec3 viewPosEye;
+out vec3 lightPosEye[12];
+
+out vec4 fragPosLightSpace;
+
+struct DrawData {
+	mat4 model;
+	mat4 normalMatrix;
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+	DrawData draws[];
+};
+
+// shared per frame blocks, see UniformBuffers.hpp
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 projection;
+};
+
+layout(std140) uniform LightBlock {
+	vec4 lightDir;
+	vec4 lightColor;
+	vec4 pointLightColor;
+	vec4 pointLight[12];
+	float fogDensity;
+};
+
+layout(std140) uniform ShadowBlock {
+	mat4 lightSpaceTrMatrix;
+};
+
+
+void main() 
+{
+	mat4 model = draws[vDrawId].model;
+
+	gl_Position = projection * view * model * vec4(vPosition, 1.0f);
+	fPosition = vPosition;
+	fNormal = vNormal;
+	fNormalEye = mat3(draws[vDrawId].normalMatrix) * vNormal;
+	fTexCoords = vTexCoords;
+#ifdef MATERIAL_ARRAYS
+	fMaterialLayers = vMaterialLayers;
+#endif
+	
+    vec4 fPosEye = view * model * vec4(fPosition, 1.0f);
+	
+	fragPosEye = fPosEye.xyz;
+	
+	for (int i = 0; i < 12; i++)
+		lightPosEye[i] = vec3(view * vec4(pointLight[i].xyz, 1.0f));
+
+	fragPosLightSpace = lightSpaceTrMatrix * model * vec4(vPosition, 1.0f); 
+}
@@ -1,8 +1,15 @@
 #version 410 core
 
 layout(location=0) in vec3 vPosition;
-uniform mat4 lightSpaceTrMatrix;
-uniform mat4 model;
+// shared per frame block, see UniformBuffers.hpp
+layout(std140) uniform ShadowBlock {
+	mat4 lightSpaceTrMatrix;
+};
+// per draw block, the render queue binds the range of the frame ring holding this draw
+layout(std140) uniform DrawBlock {
+	mat4 model;
+	mat4 normalMatrix;
+};
 
 void main()
 {
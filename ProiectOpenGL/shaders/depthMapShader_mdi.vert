@@ -0,0 +1,24 @@
+#version 430 core
+
+layout(location=0) in vec3 vPosition;
+// index of the draw in the indirect command buffer, fed through the base instance
+layout(location=3) in uint vDrawId;
+
+struct DrawData {
+	mat4 model;
+	mat4 normalMatrix;
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+	DrawData draws[];
+};
+
+// shared per frame block, see UniformBuffers.hpp
+layout(std140) uniform ShadowBlock {
+	mat4 lightSpaceTrMatrix;
+};
+
+void main()
+{
+	gl_Position = lightSpaceTrMatrix * draws[vDrawId].model * vec4(vPosition, 1.0f);
+}
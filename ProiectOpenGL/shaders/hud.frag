@@ -0,0 +1,14 @@
+#version 410 core
+
+in vec2 fTexCoords;
+in vec4 fColor;
+
+out vec4 fColorOut;
+
+// single channel glyph coverage
+uniform sampler2D fontAtlas;
+
+void main()
+{
+	fColorOut = vec4(fColor.rgb, fColor.a * texture(fontAtlas, fTexCoords).r);
+}
@@ -0,0 +1,21 @@
+#version 410 core
+
+// corner of the unit quad
+layout(location=0) in vec2 vCorner;
+// per instance: pixel rectangle (x, y, width, height) from the top left, atlas rectangle and color
+layout(location=1) in vec4 vRect;
+layout(location=2) in vec4 vTexRect;
+layout(location=3) in vec4 vColor;
+
+out vec2 fTexCoords;
+out vec4 fColor;
+
+uniform vec2 screenSize;
+
+void main()
+{
+	vec2 pixel = vRect.xy + vCorner * vRect.zw;
+	gl_Position = vec4(pixel.x / screenSize.x * 2.0f - 1.0f, 1.0f - pixel.y / screenSize.y * 2.0f, 0.0f, 1.0f);
+	fTexCoords = mix(vTexRect.xy, vTexRect.zw, vCorner);
+	fColor = vColor;
+}
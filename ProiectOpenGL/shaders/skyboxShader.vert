@@ -3,13 +3,16 @@
 layout (location = 0) in vec3 vertexPosition;
 out vec3 textureCoordinates;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// shared per frame block, see UniformBuffers.hpp
+layout(std140) uniform CameraBlock {
+	mat4 view;
+	mat4 projection;
+};
 
 void main()
 {
-    vec4 tempPos = projection * view * vec4(vertexPosition, 1.0);
+    // drop the camera translation, the sky stays centered on the viewer
+    vec4 tempPos = projection * mat4(mat3(view)) * vec4(vertexPosition, 1.0);
     gl_Position = tempPos.xyww;
     textureCoordinates = vertexPosition;
 }